@@ -0,0 +1,127 @@
+/**
+ *  bench.h - timing helpers shared by the benchmarks in this directory
+ *
+ *  Include this before anything else, it selects the POSIX clock API.
+ **/
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 199309L
+#endif
+#if defined(__linux__) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE // syscall()
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static inline uint64_t
+bench_now_ns(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)((double)now.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// Results are folded into this so the compiler cannot drop the measured work
+static volatile uint64_t bench_sink_;
+#define BENCH_SINK(x) (bench_sink_ = bench_sink_ ^ (uint64_t)(x))
+
+// Pick an iteration count that processes about total_bytes, at least min_iters
+static inline size_t
+bench_iters_for(size_t bytes_per_op, size_t total_bytes, size_t min_iters)
+{
+    size_t iters = bytes_per_op ? total_bytes / bytes_per_op : total_bytes;
+    return iters < min_iters ? min_iters : iters;
+}
+
+// Print one result line. Pass bytes_per_op = 0 for operations without a size.
+static inline void
+bench_report(const char *name, size_t bytes_per_op, size_t iters, uint64_t elapsed_ns)
+{
+    double ns_per_op = (double)elapsed_ns / (double)iters;
+    if (bytes_per_op == 0) {
+        printf("%-24s %12.2f ns/op\n", name, ns_per_op);
+        return;
+    }
+    double gb_per_s = ns_per_op > 0 ? (double)bytes_per_op / ns_per_op : 0.0;
+    printf("%-24s %10zu B %12.2f ns/op %8.2f GB/s\n", name, bytes_per_op, ns_per_op, gb_per_s);
+}
+
+// Hardware cache miss counter for the calling thread. Only on Linux, and
+// only where perf events are allowed, bench_misses_stop returns -1 otherwise.
+static inline int
+bench_misses_start(void)
+{
+#if defined(__linux__)
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.size           = sizeof(attr);
+    attr.config         = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+static inline long long
+bench_misses_stop(int fd)
+{
+#if defined(__linux__)
+    if (fd < 0) return -1;
+    long long count = -1;
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &count, sizeof(count)) != (ssize_t)sizeof(count)) count = -1;
+    close(fd);
+    return count;
+#else
+    (void)fd;
+    return -1;
+#endif
+}
+
+// bench_report plus cache misses per op, when they could be counted
+static inline void
+bench_report_misses(const char *name, size_t iters, uint64_t elapsed_ns, long long misses)
+{
+    double ns_per_op = (double)elapsed_ns / (double)iters;
+    if (misses < 0) {
+        printf("%-24s %12.2f ns/op %14s\n", name, ns_per_op, "misses n/a");
+        return;
+    }
+    printf("%-24s %12.2f ns/op %8.2f misses/op\n", name, ns_per_op, (double)misses / (double)iters);
+}
+
+#endif // BENCH_H_
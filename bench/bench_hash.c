@@ -0,0 +1,74 @@
+// Hash throughput across input lengths.
+//
+//   cc -O2 -o bench_hash bench/bench_hash.c && ./bench_hash
+//
+// fnv1a is the byte-at-a-time loop str_hash64 replaces.
+
+#include "bench.h"
+
+#define STRDEF static inline
+#define STR_IMPLEMENTATION
+#include "../str.h"
+
+#include <string.h>
+
+static uint64_t
+fnv1a(const char *p, size_t n)
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < n; ++i) {
+        h ^= (unsigned char)p[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+int
+main(void)
+{
+    static const size_t lens[] = { 4, 8, 16, 32, 64, 256, 1024, 4096, 65536, 1024 * 1024 };
+    const size_t max_len = 1024 * 1024;
+    const size_t volume  = 256u * 1024u * 1024u;
+
+    char *buf = (char *)malloc(max_len);
+    if (!buf) return 1;
+    for (size_t i = 0; i < max_len; ++i) buf[i] = (char)(i * 2654435761u >> 13);
+
+    for (size_t li = 0; li < sizeof(lens) / sizeof(lens[0]); ++li) {
+        size_t len = lens[li];
+        size_t iters = bench_iters_for(len, volume, 1000);
+        uint64_t t0;
+
+        t0 = bench_now_ns();
+        for (size_t i = 0; i < iters; ++i) BENCH_SINK(str_hash64_n(buf, len, i));
+        bench_report("str_hash64_n", len, iters, bench_now_ns() - t0);
+
+        t0 = bench_now_ns();
+        for (size_t i = 0; i < iters; ++i) BENCH_SINK(str_hash128_n(buf, len, i).hi);
+        bench_report("str_hash128_n", len, iters, bench_now_ns() - t0);
+
+        t0 = bench_now_ns();
+        for (size_t i = 0; i < iters; ++i) {
+            StrHasher h;
+            str_hasher_init(&h, i);
+            for (size_t off = 0; off < len; off += 4096) {
+                str_hasher_update(&h, buf + off, len - off < 4096 ? len - off : 4096);
+            }
+            BENCH_SINK(str_hasher_final64(&h));
+        }
+        bench_report("str_hasher (4 KB pieces)", len, iters, bench_now_ns() - t0);
+
+        t0 = bench_now_ns();
+        for (size_t i = 0; i < iters; ++i) BENCH_SINK(str_hash64_icase_n(buf, len, i));
+        bench_report("str_hash64_icase_n", len, iters, bench_now_ns() - t0);
+
+        t0 = bench_now_ns();
+        for (size_t i = 0; i < iters; ++i) BENCH_SINK(fnv1a(buf, len) ^ i);
+        bench_report("fnv1a", len, iters, bench_now_ns() - t0);
+
+        printf("\n");
+    }
+
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,114 @@
+// Growing one String to several GB: STR_LARGE_ALLOC against realloc.
+//
+//   cc -O2 -o bench_large bench/bench_large.c && ./bench_large [GB]
+//   cc -O2 -DSTR_LARGE_HUGEPAGES -o bench_large bench/bench_large.c
+//
+// Appends 64 KB pieces until the String holds GB gigabytes (default 2).
+// "realloc" is the libc allocator under the same growth policy; glibc
+// already moves its own mmapped chunks with mremap. "copying realloc" is
+// malloc, memcpy and free, which is what an allocator without that trick
+// does on every step, so it only runs at 1/32 of the size.
+
+#define _GNU_SOURCE // mremap
+#include "bench.h"
+
+#include <stdlib.h>
+
+#define STRDEF static inline
+#define STR_IMPLEMENTATION
+#define STR_LARGE_ALLOC
+#include "../str.h"
+
+#define PIECE (64u * 1024u)
+
+static char piece[PIECE];
+
+// The default growth policy, applied to a raw block
+static char *
+grow_raw(size_t total, bool copying)
+{
+    char  *p   = NULL;
+    size_t cap = 0, size = 0;
+    while (size < total) {
+        if (size + PIECE + 1 > cap) {
+            size_t new_cap = str_growth_next(NULL, cap, size + PIECE + 1);
+            char  *q;
+            if (copying) {
+                q = (char *)malloc(new_cap);
+                if (q && p) memcpy(q, p, size);
+                free(p);
+            } else {
+                q = (char *)realloc(p, new_cap);
+            }
+            if (!q) {
+                if (!copying) free(p);
+                return NULL;
+            }
+            p   = q;
+            cap = new_cap;
+        }
+        memcpy(p + size, piece, PIECE);
+        size += PIECE;
+    }
+    return p;
+}
+
+static void
+run_raw(const char *name, size_t total, bool copying)
+{
+    uint64_t t0 = bench_now_ns();
+    char *p = grow_raw(total, copying);
+    uint64_t t  = bench_now_ns() - t0;
+    if (!p) {
+        printf("%-24s out of memory\n", name);
+        return;
+    }
+    BENCH_SINK(p[total / 2]);
+    bench_report(name, PIECE, total / PIECE, t);
+    free(p);
+}
+
+static void
+run_str(size_t total)
+{
+    uint64_t t0  = bench_now_ns();
+    String   str = str_init();
+    while (str.size < total) {
+        if (!str_append_one_n(&str, piece, PIECE)) {
+            printf("%-24s out of memory\n", "STR_LARGE_ALLOC");
+            str_free(&str);
+            return;
+        }
+    }
+    uint64_t t = bench_now_ns() - t0;
+    BENCH_SINK(str.buffer[total / 2]);
+#if defined(STR_LARGE_HUGEPAGES)
+    bench_report("STR_LARGE_ALLOC + THP", PIECE, total / PIECE, t);
+#else
+    bench_report("STR_LARGE_ALLOC", PIECE, total / PIECE, t);
+#endif
+    t0 = bench_now_ns();
+    BENCH_SINK(str_shrink_to_fit(&str));
+    bench_report("shrink_to_fit", 0, 1, bench_now_ns() - t0);
+    str_free(&str);
+}
+
+int
+main(int argc, char **argv)
+{
+    double gb    = argc > 1 ? atof(argv[1]) : 2.0;
+    size_t total = (size_t)(gb * 1024 * 1024 * 1024) / PIECE * PIECE;
+    memset(piece, 'x', sizeof(piece));
+
+    // Copying is quadratic under linear growth, so it only runs at 1/32
+    size_t small = total / 32 / PIECE * PIECE;
+    printf("%zu MB in %u KB appends\n", small >> 20, PIECE >> 10);
+    run_str(small);
+    run_raw("realloc", small, false);
+    run_raw("copying realloc", small, true);
+
+    printf("\n%zu MB in %u KB appends\n", total >> 20, PIECE >> 10);
+    run_str(total);
+    run_raw("realloc", total, false);
+    return 0;
+}
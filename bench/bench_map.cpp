@@ -0,0 +1,85 @@
+// StrMap against std::unordered_map<std::string, void *>.
+//
+//   c++ -O2 -std=c++11 -o bench_map bench/bench_map.cpp && ./bench_map
+//
+// Keys are generated up front, so only insert and lookup are timed.
+
+#include "bench.h"
+
+#define STRDEF static inline
+#define STR_IMPLEMENTATION
+#include "../str.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Key {
+    const char *data;
+    size_t      size;
+};
+
+static void
+run(size_t n)
+{
+    String blob = str_init();
+    std::vector<Key> keys(n), misses(n);
+    std::vector<size_t> offsets(2 * n);
+    for (size_t i = 0; i < 2 * n; ++i) {
+        offsets[i] = blob.size;
+        if (!str_appendf(&blob, "tag/%zu/label-%zx", i, i * 2654435761u)) return;
+    }
+    for (size_t i = 0; i < 2 * n; ++i) {
+        size_t end = i + 1 < 2 * n ? offsets[i + 1] : blob.size;
+        Key k = { blob.buffer + offsets[i], end - offsets[i] };
+        if (i < n) keys[i] = k; else misses[i - n] = k;
+    }
+
+    printf("n = %zu\n", n);
+    uint64_t t0;
+
+    {
+        StrMap map = str_map_init();
+        t0 = bench_now_ns();
+        for (size_t i = 0; i < n; ++i) BENCH_SINK(str_map_put_n(&map, keys[i].data, keys[i].size, &keys[i]));
+        bench_report("StrMap insert", 0, n, bench_now_ns() - t0);
+
+        t0 = bench_now_ns();
+        for (size_t i = 0; i < n; ++i) BENCH_SINK((uintptr_t)str_map_find_n(&map, keys[i].data, keys[i].size)->value);
+        bench_report("StrMap find hit", 0, n, bench_now_ns() - t0);
+
+        t0 = bench_now_ns();
+        for (size_t i = 0; i < n; ++i) BENCH_SINK((uintptr_t)str_map_find_n(&map, misses[i].data, misses[i].size));
+        bench_report("StrMap find miss", 0, n, bench_now_ns() - t0);
+
+        str_map_free(&map);
+    }
+
+    {
+        std::unordered_map<std::string, void *> map;
+        t0 = bench_now_ns();
+        for (size_t i = 0; i < n; ++i) map[std::string(keys[i].data, keys[i].size)] = &keys[i];
+        bench_report("unordered_map insert", 0, n, bench_now_ns() - t0);
+
+        // A lookup by pointer and length has to build a std::string first
+        t0 = bench_now_ns();
+        for (size_t i = 0; i < n; ++i) BENCH_SINK((uintptr_t)map.find(std::string(keys[i].data, keys[i].size))->second);
+        bench_report("unordered_map find hit", 0, n, bench_now_ns() - t0);
+
+        t0 = bench_now_ns();
+        for (size_t i = 0; i < n; ++i) BENCH_SINK(map.find(std::string(misses[i].data, misses[i].size)) == map.end());
+        bench_report("unordered_map find miss", 0, n, bench_now_ns() - t0);
+    }
+
+    printf("\n");
+    str_free(&blob);
+}
+
+int
+main(void)
+{
+    run(1000);
+    run(100000);
+    run(1000000);
+    return 0;
+}
@@ -0,0 +1,136 @@
+// StrRef against String for sorting and a merge join.
+//
+//   cc -O2 -o bench_ref bench/bench_ref.c && ./bench_ref
+//
+// Each String owns its own heap block, like rows materialized one by one,
+// so every comparison of two Strings chases two pointers. StrRefs decide
+// most comparisons from their 16 bytes. Cache misses are read from perf
+// events on Linux when the kernel allows it.
+
+#include "bench.h"
+
+#define STRDEF static inline
+#define STR_IMPLEMENTATION
+#include "../str.h"
+
+static int
+cmp_str(const void *a, const void *b)
+{
+    return str_compare((const String *)a, (const String *)b);
+}
+
+static int
+cmp_ref(const void *a, const void *b)
+{
+    return str_ref_compare((const StrRef *)a, (const StrRef *)b);
+}
+
+static uint64_t
+next_rand(uint64_t *x)
+{
+    *x ^= *x << 13;
+    *x ^= *x >> 7;
+    *x ^= *x << 17;
+    return *x;
+}
+
+// Half short codes that fit inline, half longer names
+static bool
+fill(String *strs, size_t n, uint64_t seed)
+{
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t r = next_rand(&seed);
+        strs[i] = str_init();
+        bool ok = (r & 1) ? str_appendf(&strs[i], "%07llx", (unsigned long long)(r >> 8) % (n * 2))
+                          : str_appendf(&strs[i], "%05llx-customer-name", (unsigned long long)(r >> 8) % (n * 2));
+        if (!ok) return false;
+    }
+    return true;
+}
+
+static size_t
+join_strs(const String *a, size_t an, const String *b, size_t bn)
+{
+    size_t i = 0, j = 0, matches = 0;
+    while (i < an && j < bn) {
+        int c = str_compare(&a[i], &b[j]);
+        if (c < 0) i++;
+        else if (c > 0) j++;
+        else { matches++; i++; j++; }
+    }
+    return matches;
+}
+
+static size_t
+join_refs(const StrRef *a, size_t an, const StrRef *b, size_t bn)
+{
+    size_t i = 0, j = 0, matches = 0;
+    while (i < an && j < bn) {
+        int c = str_ref_compare(&a[i], &b[j]);
+        if (c < 0) i++;
+        else if (c > 0) j++;
+        else { matches++; i++; j++; }
+    }
+    return matches;
+}
+
+static void
+run(size_t n)
+{
+    String *left  = (String *)malloc(n * sizeof(String));
+    String *right = (String *)malloc(n * sizeof(String));
+    StrRef *lrefs = (StrRef *)malloc(n * sizeof(StrRef));
+    StrRef *rrefs = (StrRef *)malloc(n * sizeof(StrRef));
+    if (!left || !right || !lrefs || !rrefs) return;
+    if (!fill(left, n, 88172645463325252u) || !fill(right, n, 2463534242u)) return;
+    for (size_t i = 0; i < n; ++i) {
+        lrefs[i] = str_ref_str(&left[i]);
+        rrefs[i] = str_ref_str(&right[i]);
+    }
+    printf("n = %zu\n", n);
+
+    uint64_t t0;
+    int fd;
+
+    fd = bench_misses_start();
+    t0 = bench_now_ns();
+    qsort(left, n, sizeof(String), cmp_str);
+    bench_report_misses("sort String", n, bench_now_ns() - t0, bench_misses_stop(fd));
+    qsort(right, n, sizeof(String), cmp_str);
+
+    fd = bench_misses_start();
+    t0 = bench_now_ns();
+    qsort(lrefs, n, sizeof(StrRef), cmp_ref);
+    bench_report_misses("sort StrRef", n, bench_now_ns() - t0, bench_misses_stop(fd));
+    qsort(rrefs, n, sizeof(StrRef), cmp_ref);
+
+    size_t m1, m2;
+    fd = bench_misses_start();
+    t0 = bench_now_ns();
+    m1 = join_strs(left, n, right, n);
+    bench_report_misses("merge join String", 2 * n, bench_now_ns() - t0, bench_misses_stop(fd));
+
+    fd = bench_misses_start();
+    t0 = bench_now_ns();
+    m2 = join_refs(lrefs, n, rrefs, n);
+    bench_report_misses("merge join StrRef", 2 * n, bench_now_ns() - t0, bench_misses_stop(fd));
+    if (m1 != m2) printf("join mismatch: %zu vs %zu\n", m1, m2);
+
+    printf("\n");
+    for (size_t i = 0; i < n; ++i) {
+        str_free(&left[i]);
+        str_free(&right[i]);
+    }
+    free(left);
+    free(right);
+    free(lrefs);
+    free(rrefs);
+}
+
+int
+main(void)
+{
+    run(100000);
+    run(2000000);
+    return 0;
+}
@@ -0,0 +1,80 @@
+// str_sort against qsort with a str_compare callback.
+//
+//   cc -O2 -pthread -o bench_sort bench/bench_sort.c && ./bench_sort
+//
+// Keys look like log lines that share long prefixes, the case where a
+// comparison sort spends most of its time in memcmp on equal bytes.
+
+#include "bench.h"
+
+#define STRDEF static inline
+#define STR_IMPLEMENTATION
+#define STR_SORT_PARALLEL
+#include "../str.h"
+
+static int
+cmp_qsort(const void *a, const void *b)
+{
+    return str_compare((const String *)a, (const String *)b);
+}
+
+static void
+fill(String *strs, size_t n)
+{
+    uint64_t x = 88172645463325252u;
+    for (size_t i = 0; i < n; ++i) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        strs[i] = str_init();
+        if (!str_appendf(&strs[i], "2024-06-%02u host-%03u /api/v1/items/%llu",
+                         (unsigned)(x % 28) + 1, (unsigned)(x >> 8) % 200,
+                         (unsigned long long)(x >> 20) % 1000000)) {
+            return;
+        }
+    }
+}
+
+static void
+run(size_t n)
+{
+    String *strs = (String *)malloc(n * sizeof(String));
+    String *copy = (String *)malloc(n * sizeof(String));
+    if (!strs || !copy) return;
+    fill(strs, n);
+    printf("n = %zu\n", n);
+
+    uint64_t t0;
+    memcpy(copy, strs, n * sizeof(String));
+    t0 = bench_now_ns();
+    qsort(copy, n, sizeof(String), cmp_qsort);
+    bench_report("qsort", 0, n, bench_now_ns() - t0);
+
+    memcpy(copy, strs, n * sizeof(String));
+    t0 = bench_now_ns();
+    BENCH_SINK(str_sort(copy, n));
+    bench_report("str_sort", 0, n, bench_now_ns() - t0);
+
+    memcpy(copy, strs, n * sizeof(String));
+    t0 = bench_now_ns();
+    BENCH_SINK(str_sort_parallel(copy, n, 4));
+    bench_report("str_sort_parallel x4", 0, n, bench_now_ns() - t0);
+
+    StrVec vec = str_vec_init();
+    BENCH_SINK(str_vec_push_strs(&vec, strs, n));
+    t0 = bench_now_ns();
+    BENCH_SINK(str_vec_sort(&vec));
+    bench_report("str_vec_sort", 0, n, bench_now_ns() - t0);
+    str_vec_free(&vec);
+
+    printf("\n");
+    for (size_t i = 0; i < n; ++i) str_free(&strs[i]);
+    free(strs);
+    free(copy);
+}
+
+int
+main(void)
+{
+    run(10000);
+    run(1000000);
+    return 0;
+}
@@ -0,0 +1,607 @@
+// The core String operations against std::string and hand-written libc
+// code, under every StrGrowth policy.
+//
+//   c++ -O2 -std=c++17 -o bench_str bench/bench_str.cpp
+//   ./bench_str [--json] [--quick]
+//
+// Each line is one operation on one implementation: "str" is str.h under
+// the growth policy of the section, "std" is std::string, "libc" is malloc,
+// realloc and memcpy with doubling, memchr and memcmp for searches. Build
+// with -DSTR_LIN_THRESHOLD=... and friends to compare the growth macros,
+// their values are part of the output.
+//
+// allocs/op counts calls that hand out memory: STR_REALLOC for str.h and
+// libc, operator new for std::string. --json prints one JSON document on
+// stdout and nothing else, --quick shrinks the amount of work for CI.
+
+#include "bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static size_t bench_allocs; // allocations and reallocs, every contestant
+
+static void *
+count_realloc(void *p, size_t n)
+{
+    if (n) bench_allocs++;
+    return realloc(p, n);
+}
+
+#define STRDEF static inline
+#define STR_IMPLEMENTATION
+#define STR_REALLOC(p, n) count_realloc((p), (n))
+#define STR_FREE(p) free(p)
+#if defined(__GLIBC__)
+#include <malloc.h>
+#define STR_USABLE_SIZE(p) malloc_usable_size(p) // what str.h does with the libc allocator
+#endif
+#include "../str.h"
+
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+void *
+operator new(size_t n)
+{
+    bench_allocs++;
+    void *p = malloc(n ? n : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void
+operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+#if defined(__cpp_sized_deallocation)
+void
+operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+#endif
+
+struct Result {
+    const char *config;
+    const char *name;
+    const char *impl;
+    size_t      bytes_per_op;
+    double      ns_per_op;
+    double      allocs_per_op;
+};
+
+static std::vector<Result> results;
+static const char *config = "default";
+static bool json  = false;
+static bool quick = false;
+
+template <class F>
+static void
+measure(const char *name, const char *impl, size_t bytes_per_op, size_t iters, F op)
+{
+    if (quick) iters = iters / 16 + 1;
+    op(); // warm up
+    size_t   a0 = bench_allocs;
+    uint64_t t0 = bench_now_ns();
+    for (size_t i = 0; i < iters; ++i) op();
+    uint64_t ns = bench_now_ns() - t0;
+
+    Result r = { config, name, impl, bytes_per_op, (double)ns / (double)iters,
+                 (double)(bench_allocs - a0) / (double)iters };
+    results.push_back(r);
+    if (json) return;
+    double gb_per_s = r.ns_per_op > 0 ? (double)bytes_per_op / r.ns_per_op : 0.0;
+    printf("%-18s %-5s %10zu B %12.2f ns/op %8.2f GB/s %8.2f allocs/op\n",
+           name, impl, bytes_per_op, r.ns_per_op, gb_per_s, r.allocs_per_op);
+}
+
+//
+// The libc contestant
+//
+
+struct Raw {
+    char  *p;
+    size_t size, cap;
+};
+
+static bool
+raw_push(Raw *r, const char *data, size_t n)
+{
+    if (r->size + n + 1 > r->cap) {
+        size_t cap = r->cap ? r->cap : 64;
+        while (cap < r->size + n + 1) cap *= 2;
+        char *q = (char *)count_realloc(r->p, cap);
+        if (!q) return false;
+        r->p   = q;
+        r->cap = cap;
+    }
+    memcpy(r->p + r->size, data, n);
+    r->size += n;
+    r->p[r->size] = '\0';
+    return true;
+}
+
+static inline bool
+raw_push_char(Raw *r, char c)
+{
+    if (r->size + 2 > r->cap) return raw_push(r, &c, 1);
+    r->p[r->size++] = c;
+    r->p[r->size]   = '\0';
+    return true;
+}
+
+static size_t
+raw_find(const char *hay, size_t n, const char *needle, size_t m)
+{
+    const char *p = hay, *end = hay + n;
+    while ((size_t)(end - p) >= m) {
+        p = (const char *)memchr(p, needle[0], (size_t)(end - p) - m + 1);
+        if (!p) break;
+        if (memcmp(p, needle, m) == 0) return (size_t)(p - hay);
+        ++p;
+    }
+    return SIZE_MAX;
+}
+
+static size_t
+raw_rfind(const char *hay, size_t n, const char *needle, size_t m)
+{
+    for (size_t i = n - m + 1; m <= n && i-- > 0;) {
+        if (hay[i] == needle[0] && memcmp(hay + i, needle, m) == 0) return i;
+    }
+    return SIZE_MAX;
+}
+
+//
+// Benchmarks that grow a String, run under every policy
+//
+
+static void
+bench_appends(bool baselines)
+{
+    static char big[64 * 1024];
+    memset(big, 'x', sizeof(big));
+    static const char small[] = "0123456789abcdef";
+
+    measure("append_char", "str", 4096, 20000, [] {
+        String s = str_init();
+        bool ok = true;
+        for (int i = 0; i < 4096; ++i) ok &= str_append_char(&s, (char)i);
+        BENCH_SINK(ok);
+        str_free(&s);
+    });
+    if (baselines) {
+        measure("append_char", "std", 4096, 20000, [] {
+            std::string s;
+            for (int i = 0; i < 4096; ++i) s.push_back((char)i);
+            BENCH_SINK(s.size());
+        });
+        measure("append_char", "libc", 4096, 20000, [] {
+            Raw r = { NULL, 0, 0 };
+            bool ok = true;
+            for (int i = 0; i < 4096; ++i) ok &= raw_push_char(&r, (char)i);
+            BENCH_SINK(ok);
+            free(r.p);
+        });
+    }
+
+    measure("push_unchecked", "str", 4096, 20000, [] {
+        String s = str_init();
+        if (str_reserve(&s, 4096)) {
+            for (int i = 0; i < 4096; ++i) str_push_unchecked(&s, (char)i);
+        }
+        BENCH_SINK(s.size);
+        str_free(&s);
+    });
+
+    measure("append_small", "str", 4096, 40000, [] {
+        String s = str_init();
+        bool ok = true;
+        for (int i = 0; i < 256; ++i) ok &= str_append_one_n(&s, small, 16);
+        BENCH_SINK(ok);
+        str_free(&s);
+    });
+    if (baselines) {
+        measure("append_small", "std", 4096, 40000, [] {
+            std::string s;
+            for (int i = 0; i < 256; ++i) s.append(small, 16);
+            BENCH_SINK(s.size());
+        });
+        measure("append_small", "libc", 4096, 40000, [] {
+            Raw r = { NULL, 0, 0 };
+            bool ok = true;
+            for (int i = 0; i < 256; ++i) ok &= raw_push(&r, small, 16);
+            BENCH_SINK(ok);
+            free(r.p);
+        });
+    }
+
+    measure("append_large", "str", 64 * sizeof(big), 64, [] {
+        String s = str_init();
+        bool ok = true;
+        for (int i = 0; i < 64; ++i) ok &= str_append_one_n(&s, big, sizeof(big));
+        BENCH_SINK(ok);
+        str_free(&s);
+    });
+    if (baselines) {
+        measure("append_large", "std", 64 * sizeof(big), 64, [] {
+            std::string s;
+            for (int i = 0; i < 64; ++i) s.append(big, sizeof(big));
+            BENCH_SINK(s.size());
+        });
+        measure("append_large", "libc", 64 * sizeof(big), 64, [] {
+            Raw r = { NULL, 0, 0 };
+            bool ok = true;
+            for (int i = 0; i < 64; ++i) ok &= raw_push(&r, big, sizeof(big));
+            BENCH_SINK(ok);
+            free(r.p);
+        });
+    }
+
+    // About 13 bytes per call, 256 calls
+    measure("appendf", "str", 3300, 4000, [] {
+        String s = str_init();
+        bool ok = true;
+        for (unsigned i = 0; i < 256; ++i) ok &= str_appendf(&s, "%u:%s;", i * 7919u, "item");
+        BENCH_SINK(ok);
+        str_free(&s);
+    });
+    if (baselines) {
+        measure("appendf", "std", 3300, 4000, [] {
+            std::string s;
+            char tmp[64];
+            for (unsigned i = 0; i < 256; ++i) {
+                int n = snprintf(tmp, sizeof(tmp), "%u:%s;", i * 7919u, "item");
+                s.append(tmp, (size_t)n);
+            }
+            BENCH_SINK(s.size());
+        });
+        measure("appendf", "libc", 3300, 4000, [] {
+            Raw r = { NULL, 0, 0 };
+            bool ok = true;
+            char tmp[64];
+            for (unsigned i = 0; i < 256; ++i) {
+                int n = snprintf(tmp, sizeof(tmp), "%u:%s;", i * 7919u, "item");
+                ok &= raw_push(&r, tmp, (size_t)n);
+            }
+            BENCH_SINK(ok);
+            free(r.p);
+        });
+    }
+
+    // 256 words with a separator: one str_join against the loop it replaces
+    static const char *words[256];
+    static const char *pool[] = { "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel" };
+    for (int i = 0; i < 256; ++i) words[i] = pool[i % 8];
+    measure("join", "str", 2200, 40000, [] {
+        String s = str_init();
+        BENCH_SINK(str_join_cstrs(&s, words, 256, ", "));
+        str_free(&s);
+    });
+    measure("join_loop", "str", 2200, 40000, [] {
+        String s = str_init();
+        bool ok = true;
+        for (int i = 0; i < 256; ++i) {
+            if (i) ok &= str_append_one(&s, ", ");
+            ok &= str_append_one(&s, words[i]);
+        }
+        BENCH_SINK(ok);
+        str_free(&s);
+    });
+    if (baselines) {
+        measure("join", "std", 2200, 40000, [] {
+            std::string s;
+            for (int i = 0; i < 256; ++i) {
+                if (i) s += ", ";
+                s += words[i];
+            }
+            BENCH_SINK(s.size());
+        });
+        measure("join", "libc", 2200, 40000, [] {
+            size_t lens[256], total = 0;
+            for (int i = 0; i < 256; ++i) total += (lens[i] = strlen(words[i])) + (i ? 2 : 0);
+            char *p = (char *)count_realloc(NULL, total + 1), *d = p;
+            if (!p) return;
+            for (int i = 0; i < 256; ++i) {
+                if (i) { memcpy(d, ", ", 2); d += 2; }
+                memcpy(d, words[i], lens[i]);
+                d += lens[i];
+            }
+            *d = '\0';
+            BENCH_SINK(p[total / 2]);
+            free(p);
+        });
+    }
+
+    // The str_append macro with 8 pieces, 32 times
+    measure("append_va", "str", 1400, 40000, [] {
+        String s = str_init();
+        bool ok = true;
+        for (int i = 0; i < 32; ++i) ok &= str_append(&s, "GET ", "/api/v1/", "items", "/", "42", " HTTP/1.1", "\r\n", "");
+        BENCH_SINK(ok);
+        str_free(&s);
+    });
+
+    // 8 bytes in the middle of 4 KB and out again, two 2 KB moves
+    String base = str_init();
+    BENCH_SINK(str_append_repeat(&base, 'm', 4096));
+    measure("insert_erase", "str", 4096, 200000, [&base] {
+        BENCH_SINK(str_insert_one_n(&base, 2048, small, 8));
+        BENCH_SINK(str_erase(&base, 2048, 8));
+    });
+    str_free(&base);
+    if (baselines) {
+        std::string s(4096, 'm');
+        measure("insert_erase", "std", 4096, 200000, [&s] {
+            s.insert(2048, small, 8);
+            s.erase(2048, 8);
+        });
+        Raw r = { NULL, 0, 0 };
+        BENCH_SINK(raw_push(&r, s.data(), s.size()));
+        BENCH_SINK(raw_push(&r, small, 8));
+        r.size -= 8;
+        measure("insert_erase", "libc", 4096, 200000, [&r] {
+            memmove(r.p + 2048 + 8, r.p + 2048, r.size - 2048 + 1);
+            memcpy(r.p + 2048, small, 8);
+            memmove(r.p + 2048, r.p + 2048 + 8, r.size - 2048 + 1);
+        });
+        free(r.p);
+    }
+}
+
+//
+// Benchmarks that do not grow, run once
+//
+
+static std::string
+make_log(size_t size)
+{
+    std::string text = "BOOT ok\n";
+    uint64_t x = 88172645463325252u;
+    char line[128];
+    while (text.size() < size) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        int n = snprintf(line, sizeof(line), "2024-06-%02u host-%03u GET /api/v1/items/%llu 200\n",
+                         (unsigned)(x % 28) + 1, (unsigned)(x >> 8) % 200,
+                         (unsigned long long)(x >> 20) % 1000000);
+        text.append(line, (size_t)n);
+    }
+    text += "ERROR disk full\n";
+    return text;
+}
+
+static void
+bench_find(const char *name, const std::string &hay, const char *needle, bool reverse)
+{
+    String s = str_init();
+    BENCH_SINK(str_append_one_n(&s, hay.data(), hay.size()));
+    size_t m = strlen(needle);
+
+    if (reverse) {
+        measure(name, "str", hay.size(), 2000, [&] { BENCH_SINK(str_rfind_n(&s, needle, m)); });
+        measure(name, "std", hay.size(), 2000, [&] { BENCH_SINK(hay.rfind(needle, std::string::npos, m)); });
+        measure(name, "libc", hay.size(), 2000, [&] { BENCH_SINK(raw_rfind(hay.data(), hay.size(), needle, m)); });
+    } else {
+        measure(name, "str", hay.size(), 2000, [&] { BENCH_SINK(str_find_n(&s, needle, m)); });
+        measure(name, "std", hay.size(), 2000, [&] { BENCH_SINK(hay.find(needle, 0, m)); });
+        measure(name, "libc", hay.size(), 2000, [&] { BENCH_SINK(raw_find(hay.data(), hay.size(), needle, m)); });
+    }
+    str_free(&s);
+}
+
+static void
+bench_search(void)
+{
+    // Realistic: a log, the needle at the far end from where the search starts
+    std::string log = make_log(64 * 1024);
+    bench_find("find_log", log, "ERROR disk", false);
+    bench_find("rfind_log", log, "BOOT ok", true);
+
+    // Adversarial: every position matches all but the last byte of the needle
+    std::string as(64 * 1024, 'a');
+    std::string needle(31, 'a');
+    bench_find("find_adversarial", as, (needle + "b").c_str(), false);
+    bench_find("rfind_adversarial", as, ("b" + needle).c_str(), true);
+}
+
+static void
+bench_trim(void)
+{
+    std::string padded = std::string(16, ' ') + std::string(100, 'p') + std::string(16, ' ');
+    const char *src = padded.data();
+    size_t      n   = padded.size();
+
+    String s = str_init();
+    measure("trim", "str", n, 500000, [&] {
+        str_clear(&s);
+        BENCH_SINK(str_append_one_n(&s, src, n));
+        BENCH_SINK(str_trim(&s));
+    });
+    str_free(&s);
+
+    std::string t;
+    measure("trim", "std", n, 500000, [&] {
+        t.assign(src, n);
+        t.erase(0, t.find_first_not_of(" \t\n\r\f\v"));
+        t.erase(t.find_last_not_of(" \t\n\r\f\v") + 1);
+        BENCH_SINK(t.size());
+    });
+
+    Raw r = { NULL, 0, 0 };
+    measure("trim", "libc", n, 500000, [&] {
+        r.size = 0;
+        BENCH_SINK(raw_push(&r, src, n));
+        size_t b = 0, e = r.size;
+        while (b < e && (r.p[b] == ' ' || (r.p[b] >= '\t' && r.p[b] <= '\r'))) ++b;
+        while (e > b && (r.p[e - 1] == ' ' || (r.p[e - 1] >= '\t' && r.p[e - 1] <= '\r'))) --e;
+        memmove(r.p, r.p + b, e - b);
+        r.size = e - b;
+        r.p[r.size] = '\0';
+    });
+    free(r.p);
+}
+
+static void
+bench_files(void)
+{
+    const char *path = "bench_str.tmp";
+    const size_t size = 1024 * 1024;
+    String data = str_init();
+    BENCH_SINK(str_append_repeat(&data, 'f', size));
+
+    measure("write_file", "str", size, 256, [&] {
+        FILE *f = fopen(path, "wb");
+        if (!f) return;
+        BENCH_SINK(str_write_file(&data, f));
+        fclose(f);
+    });
+    measure("write_file", "std", size, 256, [&] {
+        std::ofstream f(path, std::ios::binary);
+        f.write(data.buffer, (std::streamsize)data.size);
+    });
+    measure("write_file", "libc", size, 256, [&] {
+        FILE *f = fopen(path, "wb");
+        if (!f) return;
+        BENCH_SINK(fwrite(data.buffer, 1, data.size, f));
+        fclose(f);
+    });
+
+    measure("read_file", "str", size, 256, [&] {
+        FILE *f = fopen(path, "rb");
+        if (!f) return;
+        String s = str_init();
+        BENCH_SINK(str_read_file(&s, f));
+        fclose(f);
+        str_free(&s);
+    });
+    measure("read_file", "std", size, 256, [&] {
+        std::ifstream f(path, std::ios::binary);
+        std::ostringstream ss;
+        ss << f.rdbuf();
+        BENCH_SINK(ss.str().size());
+    });
+    measure("read_file", "libc", size, 256, [&] {
+        FILE *f = fopen(path, "rb");
+        if (!f) return;
+        fseek(f, 0, SEEK_END);
+        long len = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        char *p = (char *)count_realloc(NULL, (size_t)len + 1);
+        if (p) BENCH_SINK(fread(p, 1, (size_t)len, f));
+        fclose(f);
+        free(p);
+    });
+
+    remove(path);
+    str_free(&data);
+}
+
+static void
+bench_clone_move(void)
+{
+    String src = str_init();
+    BENCH_SINK(str_append_repeat(&src, 'c', 1024));
+    std::string ssrc(1024, 'c');
+
+    measure("clone", "str", 1024, 500000, [&] {
+        String dst = { NULL, 0, 0 };
+        BENCH_SINK(str_clone(&src, &dst));
+        str_free(&dst);
+    });
+    measure("clone", "std", 1024, 500000, [&] {
+        std::string dst(ssrc);
+        BENCH_SINK(dst.size());
+    });
+    measure("clone", "libc", 1024, 500000, [&] {
+        char *p = (char *)count_realloc(NULL, src.size + 1);
+        if (p) memcpy(p, src.buffer, src.size + 1);
+        BENCH_SINK(p[0]);
+        free(p);
+    });
+
+    // Move out and back, so the source is usable again
+    measure("move", "str", 0, 2000000, [&] {
+        String tmp = str_move(&src);
+        str_free(&src);
+        src = str_move(&tmp);
+        str_free(&tmp);
+    });
+    measure("move", "std", 0, 2000000, [&] {
+        std::string tmp = std::move(ssrc);
+        ssrc = std::move(tmp);
+        BENCH_SINK(ssrc.size());
+    });
+    measure("move", "libc", 0, 2000000, [&] {
+        char *tmp = src.buffer;
+        src.buffer = NULL;
+        BENCH_SINK(tmp[0]);
+        src.buffer = tmp;
+    });
+    str_free(&src);
+}
+
+static void
+print_json(void)
+{
+    String out = str_init();
+    bool ok = str_appendf(&out, "{\n  \"build\": {\"start_size\": %zu, \"exp_growth_factor\": %zu, "
+                          "\"lin_threshold\": %zu, \"lin_growth_factor\": %zu},\n  \"results\": [\n",
+                          (size_t)STR_START_SIZE, (size_t)STR_EXP_GROWTH_FACTOR,
+                          (size_t)STR_LIN_THRESHOLD, (size_t)STR_LIN_GROWTH_FACTOR);
+    for (size_t i = 0; ok && i < results.size(); ++i) {
+        const Result &r = results[i];
+        ok = str_appendf(&out, "    {\"config\": \"%s\", \"name\": \"%s\", \"impl\": \"%s\", "
+                         "\"bytes_per_op\": %zu, \"ns_per_op\": %.3f, \"allocs_per_op\": %.3f}%s\n",
+                         r.config, r.name, r.impl, r.bytes_per_op, r.ns_per_op, r.allocs_per_op,
+                         i + 1 < results.size() ? "," : "");
+    }
+    ok = ok && str_append_one(&out, "  ]\n}\n");
+    if (ok) BENCH_SINK(str_write_file(&out, stdout));
+    str_free(&out);
+}
+
+int
+main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--json") == 0) json = true;
+        if (strcmp(argv[i], "--quick") == 0) quick = true;
+    }
+
+    static const struct {
+        const char   *name;
+        StrGrowthKind kind;
+    } policies[] = {
+        { "default",      STR_GROWTH_DEFAULT },
+        { "exponential",  STR_GROWTH_EXPONENTIAL },
+        { "golden",       STR_GROWTH_GOLDEN },
+        { "proportional", STR_GROWTH_PROPORTIONAL },
+        { "page",         STR_GROWTH_PAGE },
+    };
+    for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); ++i) {
+        StrGrowth policy = { policies[i].kind, 0, 0, 0 };
+        str_growth_set(&policy);
+        config = policies[i].name;
+        if (!json) printf("== growth %s\n", config);
+        bench_appends(i == 0);
+        if (!json) printf("\n");
+    }
+    str_growth_set(NULL);
+
+    config = "default";
+    if (!json) printf("== no growth\n");
+    bench_search();
+    bench_trim();
+    bench_files();
+    bench_clone_move();
+
+    if (json) print_json();
+    return 0;
+}
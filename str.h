@@ -24,15 +24,47 @@
  *
  *  Appending
  *    - str_append_one appends a NUL terminated cstr
- *    - str_append appends many cstr in one call
+ *    - str_append appends many cstr in one call. all of them are measured
+ *      first, so the String grows at most once
+ *    - str_join, str_join_slices and str_join_cstrs append an array of
+ *      String, StrSlice or cstr with an optional separator in between.
+ *      one pass for the total length, one grow, one copy per piece
  *    - str_append_one_n appends an arbitrary buffer of length n
  *    - str_append_char and str_append_repeat for single char and runs
  *    - str_append_str appends another String. Self append is supported
+ *    - str_spare hands out the writable bytes past size, grown to at least
+ *      a minimum, and str_commit makes the bytes written there content.
+ *      read(2), encoders and serializers fill a String without a temporary
+ *    - str_push_unchecked appends a char with no capacity check, for tight
+ *      loops after str_reserve or str_spare
  *
  *  Capacity
  *    - str_reserve(new_len) ensures room for new_len content bytes
  *      the trailing NUL is handled internally
  *    - str_shrink_to_fit sets capacity to size + 1
+ *    - growth follows the STR_*_GROWTH macros unless a StrGrowth policy is
+ *      set for the thread with str_growth_set: exponential, golden ratio,
+ *      1.5x, or 1.5x rounded to pages. str_growth_next gives the policy's
+ *      capacity for one String without changing the thread's policy
+ *    - capacity is rounded up to the allocator's usable size where it can
+ *      be asked (malloc_usable_size, malloc_size, _msize), so the slack the
+ *      allocator hands out anyway is used
+ *    - a StrSizeHint, usually a static at the call site, learns how big
+ *      the Strings built there end up. str_init_hinted starts a String at
+ *      that capacity, str_free_hinted or str_size_hint_record feed the final
+ *      size back. the estimate tracks about the 90th percentile and follows
+ *      drift, older sizes count less. str_size_hint_stats reports how often
+ *      the hint was big enough and how many bytes it overshot
+ *
+ *  Instrumentation
+ *    - with STR_STATS defined, String allocations, reallocs, bytes
+ *      allocated, growth slack and bytes shifted by insert, erase, replace
+ *      and the trims are counted per thread
+ *    - the core String functions become macros that record __FILE__ and
+ *      __LINE__ of the caller, so each count is charged to a call site.
+ *      work done inside other functions only shows in the totals
+ *    - str_stats_dump writes the totals and the busiest sites into a String
+ *    - without STR_STATS none of it exists and nothing is counted
  *
  *  Ownership helpers
  *    - str_strdup returns a new copy. caller must STR_FREE
@@ -48,13 +80,150 @@
  *    - str_equals compares two Strings
  *    - str_equals_cstr compares to a NUL terminated cstr
  *    - str_equals_n compares to a buffer of length n
+ *    - str_compare orders by unsigned bytes like memcmp, a prefix sorts first
+ *
+ *  Case
+ *    - str_to_lower and str_to_upper map ASCII letters in place and leave
+ *      every byte >= 0x80 alone, whatever the C locale says
+ *    - str_utf8_to_lower and str_utf8_to_upper also apply the simple
+ *      mappings of Latin-1, Latin Extended-A, Greek, Cyrillic and Armenian,
+ *      which all keep their UTF-8 length
+ *    - str_equals_icase, str_compare_icase and str_find_icase fold ASCII
+ *      case on the fly, a block at a time, without a lowered copy
+ *
+ *  Base64 and hex
+ *    - str_append_base64 and str_append_hex encode straight into a String,
+ *      str_decode_base64 and str_decode_hex append the decoded bytes. the
+ *      output size is known up front, so out grows at most once
+ *    - decoding is strict and reports the offset of the first bad
+ *      character. out is left as it was on error
+ *    - SSSE3/AVX2 kernels for base64 and SSE2/AVX2 for hex, scalar tails
+ *
+ *  Escaping
+ *    - str_append_escaped escapes for a JSON string, an HTML attribute
+ *      value, a C string literal or a CSV field. the bytes that need it are
+ *      found with the byte set scanners, the runs between them are copied
+ *      with memcpy, and out is sized with one reserve
+ *    - str_append_unescaped reverses each dialect, strictly, reporting
+ *      the offset of the first malformed escape
+ *
+ *  URLs
+ *    - str_append_url_encoded percent-encodes all but the RFC 3986
+ *      unreserved characters, with form set spaces become '+'
+ *    - str_url_decode_inplace decodes %XX (and '+' with form set) in place,
+ *      the result is never longer than the input
+ *    - str_query_next walks a query string pair by pair, decoding each key
+ *      and value in place and returning slices into the String. nothing is
+ *      allocated
+ *
+ *  Numbers
+ *    - str_parse_i64, str_parse_u64 and str_parse_f64 read a number from
+ *      the start of a String (or the _n variants from a buffer) and return
+ *      how many bytes it took, 0 if there was none or it did not fit.
+ *      They skip no whitespace and ignore the locale
+ *    - doubles are correctly rounded: "inf", "infinity" and "nan" are
+ *      accepted, out of range values become infinity or zero
+ *
+ *  Consumable buffers
+ *    - StrBuf is a String plus a read offset, for parsers that drop bytes
+ *      from the front as they go
+ *    - str_buf_consume, str_buf_ltrim and str_buf_erase at 0 only move the
+ *      offset. the dead prefix is reclaimed when it outgrows the live bytes,
+ *      or when an append needs the room
+ *
+ *  Builders
+ *    - StrBuilder collects output in a list of chunks that are never moved,
+ *      so building hundreds of MB does no realloc copies. chunks start at
+ *      4 KB and double up to STR_BUILDER_CHUNK_SIZE
+ *    - str_builder_tail hands out the last chunk as a String with room for
+ *      the next piece, so every str_append_* function can write into it
+ *    - str_builder_write_file writes the chunks with writev where stdio
+ *      exposes a file descriptor, str_builder_take copies them into one
+ *      String of exactly the right size
+ *
+ *  Byte sets
+ *    - StrByteSet is a compiled 256 bit set of byte values
+ *    - str_find_first_of, str_find_first_not_of, str_find_last_of,
+ *      str_find_last_not_of, str_span and str_cspan scan with it, using a
+ *      nibble lookup (pshufb) on x86 and a table test elsewhere
+ *    - trimming uses the ASCII whitespace set from str_byteset_space, so it
+ *      does not depend on the C locale
+ *
+ *  Translation
+ *    - StrTranslator holds a byte map plus a remove set and a squeeze set,
+ *      like tr -d and tr -s. str_translate applies all three in place in
+ *      one pass, so several cleanups cost one sweep over the bytes
+ *    - on x86 the map is looked up with pshufb, only for the rows of 16
+ *      bytes that are not identity, and blocks with nothing to drop are
+ *      stored whole
+ *
+ *  UTF-8
+ *    - str_utf8_valid checks a String and reports the offset of the first
+ *      invalid sequence. vectorized lookup table validation on x86 with an
+ *      ASCII fast path, a scalar state machine elsewhere
+ *    - str_utf8_length counts code points
+ *    - str_utf8_truncate cuts at a code point boundary looking at no more
+ *      than the last 3 bytes before the limit
+ *    - str_append_utf16/utf32 transcode UTF-8 and append the result to a
+ *      String, str_append_from_utf16/utf32 go the other way. input is
+ *      validated and measured first, so out grows once to the exact size
+ *      and is left untouched on error
+ *
+ *  Sorting
+ *    - str_sort sorts an array of String, str_vec_sort sorts a StrVec
+ *    - multikey quicksort over cached 8 byte prefixes, insertion sort for
+ *      small buckets. str_vec_sort also repacks the blob in sorted order
+ *    - str_sort_parallel is available when STR_SORT_PARALLEL is defined
+ *
+ *  Slices
+ *    - StrSlice is a non-owning pointer and length. it never owns memory
+ *    - str_slice, str_slice_n and str_slice_cstr make one
+ *
+ *  String refs
+ *    - StrRef is a 16 byte non-owning reference: 32 bit size, the first 4
+ *      bytes inline, then either the next 8 bytes (size <= 12) or a pointer
+ *    - strings up to 12 bytes live entirely in the ref and need no source
+ *    - str_ref_equals and str_ref_compare decide most pairs from the first
+ *      8 bytes of the ref without touching the string bytes
+ *    - sizes above UINT32_MAX are not representable and give an empty ref
+ *
+ *  Hashing
+ *    - str_hash64 and str_hash128 are fast seeded non-cryptographic hashes
+ *    - StrHasher consumes input in pieces with the same result as one call
+ *    - the _icase variants hash as if ASCII letters were lowercase
+ *    - results are stable across runs but not across byte orders
+ *
+ *  Interning
+ *    - StrInternPool maps every unique byte sequence to one canonical StrInterned
+ *    - handles stay valid until str_intern_pool_free and compare by pointer
+ *    - bytes are bump allocated in large blocks, no malloc per string
+ *    - str_intern_pool_stats reports memory usage and hit rate
  *
  *  Errors
  *    - functions return false or NULL on allocation failure or bad args
  *    - the String stays valid and NUL terminated on failure
  *
+ *  Maps
+ *    - StrMap maps byte string keys to void * values
+ *    - Swiss table layout: one control byte per slot, probed a group at a time
+ *    - keys are copied into an arena owned by the map, no malloc per key
+ *    - find by String, StrSlice or pointer and length without a temporary
+ *    - hashes are cached, so growing never rehashes key bytes
+ *
+ *  String vectors
+ *    - StrVec stores many strings in one byte blob plus an offset array
+ *    - str_vec_get returns a StrSlice into the blob, no copy
+ *    - removed elements leave dead bytes until str_vec_compact
+ *    - str_vec_write_file writes all elements with one fwrite when compact
+ *
+ *  CPU dispatch
+ *    - search and compare kernels pick SSE2, AVX2 or AVX-512BW at run time on
+ *      x86, so one binary runs on any fleet. other targets use portable code
+ *    - the CPU is probed once with cpuid. str_simd_level reports the result
+ *
  *  Thread safety
  *    - a String is not thread safe. do not share one instance across threads
+ *    - a StrInternPool may be shared. inserts lock one of STR_INTERN_SHARDS shards
  *
  *
  *  CUSTOMIZATION
@@ -72,6 +241,41 @@
  *    Override memory allocation.
  *    default uses realloc and free from stdlib
  *
+ *  STR_LARGE_ALLOC
+ *    Define to make STR_REALLOC and STR_FREE str_large_realloc and
+ *    str_large_free. blocks of STR_LARGE_THRESHOLD bytes and more live in
+ *    anonymous mappings that grow with mremap, so the kernel moves page
+ *    table entries instead of copying bytes, and shrinking gives pages
+ *    back. mremap needs Linux and _GNU_SOURCE, elsewhere a grow maps anew
+ *    and copies. no effect where there is no mmap
+ *
+ *  STR_LARGE_THRESHOLD
+ *    Size from which STR_LARGE_ALLOC maps blocks
+ *    default 4 * 1024 * 1024
+ *
+ *  STR_LARGE_HUGEPAGES
+ *    Define to madvise(MADV_HUGEPAGE) the mappings of STR_LARGE_ALLOC, for
+ *    fewer TLB misses on transparent huge page kernels
+ *
+ *  STR_USABLE_SIZE(ptr)
+ *    Usable bytes of a block from STR_REALLOC. Function like, e.g.
+ *    #define STR_USABLE_SIZE(ptr) my_usable_size(ptr)
+ *    default malloc_usable_size, malloc_size or _msize when STR_REALLOC is
+ *    not overridden and the platform has one
+ *
+ *  STR_NO_USABLE_SIZE
+ *    Define to keep capacities exactly as requested instead of rounding
+ *    them up with STR_USABLE_SIZE
+ *
+ *  STR_STATS
+ *    Define to count allocations and moved bytes and attribute them to
+ *    call sites, see Instrumentation above
+ *
+ *  STR_STATS_SITES
+ *    Call sites STR_STATS tracks per thread, later ones only count in the
+ *    totals
+ *    default 256
+ *
  *  STR_START_SIZE
  *    Initial capacity when first growing from empty.
  *    counts total bytes including NUL
@@ -89,6 +293,44 @@
  *    Linear growth step in bytes after the threshold.
  *    default 256 * 1024
  *
+ *  STR_BUF_COMPACT_MIN
+ *    Dead prefix in bytes a StrBuf tolerates before moving its live bytes
+ *    back to the start. it also has to exceed the live bytes
+ *    default 4096
+ *
+ *  STR_BUILDER_CHUNK_SIZE
+ *    Largest chunk a StrBuilder allocates. a single larger append gets a
+ *    chunk of its own size
+ *    default 1024 * 1024
+ *
+ *  STR_INTERN_SHARDS
+ *    Number of independently locked shards in a StrInternPool. power of two
+ *    default 16
+ *
+ *  STR_INTERN_BLOCK_SIZE
+ *    Largest block interned strings are bump allocated from. blocks start
+ *    at 4 KB and double up to this size
+ *    default 64 * 1024
+ *
+ *  STR_MAP_BLOCK_SIZE
+ *    Largest block StrMap keys are bump allocated from
+ *    default 64 * 1024
+ *
+ *  STR_INTERN_LOCK(lock_ptr) and STR_INTERN_UNLOCK(lock_ptr)
+ *    Override the per shard lock. lock_ptr is a volatile long * that starts at 0.
+ *    default is a spin lock on compiler atomics. define both empty when the
+ *    pool is only used from one thread
+ *
+ *  STR_SORT_PARALLEL
+ *    Define to add str_sort_parallel and str_vec_sort_parallel. Includes
+ *    <pthread.h>, or <windows.h> on Windows
+ *
+ *  STR_SIMD_LEVEL
+ *    Cap the instruction set used by the byte kernels, to test the fallbacks.
+ *    one of STR_SIMD_SCALAR, STR_SIMD_SSE2, STR_SIMD_SSE42, STR_SIMD_AVX2,
+ *    STR_SIMD_AVX512. STR_SIMD_SCALAR also drops the SSE2 StrMap groups
+ *    default is the best the CPU supports
+ *
  *  STR_NODISCARD
  *    Marks return values as must use when C++17 or newer.
  *    define STR_IGNORE_NODISCARD to disable
@@ -156,8 +398,20 @@
 #endif
 
 
+#if defined(STR_LARGE_ALLOC) && !defined(STR_REALLOC) && !defined(STR_FREE)
+#include <stdlib.h>
+#define STR_REALLOC(ptr, new_size) str_large_realloc((ptr), (new_size))
+#define STR_FREE(ptr) str_large_free((ptr))
+#define STR_LARGE_ALLOC_ 1
+#endif
+
 #if !defined(STR_REALLOC) && !defined(STR_FREE)
 #include <stdlib.h>
+#define STR_LIBC_ALLOC_ 1
+#endif
+
+#ifndef STR_LARGE_THRESHOLD
+#define STR_LARGE_THRESHOLD (4u * 1024u * 1024u)
 #endif
 
 #ifndef STR_REALLOC
@@ -170,6 +424,10 @@
 
 
 
+#ifndef STR_STATS_SITES
+#define STR_STATS_SITES 256
+#endif
+
 #ifndef STR_START_SIZE
 #define STR_START_SIZE 64u
 #endif
@@ -187,6 +445,46 @@
 #endif
 
 
+#ifndef STR_BUF_COMPACT_MIN
+#define STR_BUF_COMPACT_MIN 4096u
+#endif
+
+#ifndef STR_BUILDER_CHUNK_SIZE
+#define STR_BUILDER_CHUNK_SIZE (1024u * 1024u)
+#endif
+
+#ifndef STR_INTERN_SHARDS
+#define STR_INTERN_SHARDS 16u
+#endif
+
+#if (STR_INTERN_SHARDS & (STR_INTERN_SHARDS - 1)) != 0
+#error "STR_INTERN_SHARDS must be a power of two"
+#endif
+
+#ifndef STR_INTERN_BLOCK_SIZE
+#define STR_INTERN_BLOCK_SIZE (64u * 1024u)
+#endif
+
+#ifndef STR_MAP_BLOCK_SIZE
+#define STR_MAP_BLOCK_SIZE (64u * 1024u)
+#endif
+
+#if !defined(STR_INTERN_LOCK) || !defined(STR_INTERN_UNLOCK)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define STR_INTERN_LOCK(lock_ptr)   do { while (_InterlockedExchange((lock_ptr), 1)) { while (*(lock_ptr)) {} } } while (0)
+#define STR_INTERN_UNLOCK(lock_ptr) _InterlockedExchange((lock_ptr), 0)
+#elif defined(__GNUC__) || defined(__clang__)
+#define STR_INTERN_LOCK(lock_ptr)   do { while (__atomic_exchange_n((lock_ptr), 1, __ATOMIC_ACQUIRE)) { while (__atomic_load_n((lock_ptr), __ATOMIC_RELAXED)) {} } } while (0)
+#define STR_INTERN_UNLOCK(lock_ptr) __atomic_store_n((lock_ptr), 0, __ATOMIC_RELEASE)
+#else
+// No known atomics. The pool is then only safe to use from one thread.
+#define STR_INTERN_LOCK(lock_ptr)   ((void)(lock_ptr))
+#define STR_INTERN_UNLOCK(lock_ptr) ((void)(lock_ptr))
+#endif
+#endif
+
+
 
 #if defined(__cplusplus) &&  __cplusplus >= 201703L && !defined(STR_IGNORE_NODISCARD)
 #define STR_NODISCARD [[nodiscard]]
@@ -222,6 +520,7 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #ifdef __cplusplus
@@ -235,6 +534,11 @@ typedef struct {
     size_t size;     // number of content bytes, excluding terminating NUL
 } String;
 
+typedef struct {
+    const char *data; // not owned, not necessarily NUL-terminated
+    size_t      size;
+} StrSlice;
+
 
 
 //
@@ -290,6 +594,94 @@ STR_NODISCARD STRDEF bool str_shrink_to_fit(String *str) STR_NOEXCEPT;
 // Reserve space for at least new_len content bytes (excluding the trailing NUL)
 STR_NODISCARD STRDEF bool str_reserve(String *str, size_t new_len) STR_NOEXCEPT;
 
+typedef enum {
+    STR_GROWTH_DEFAULT,      // STR_EXP_GROWTH_FACTOR, then STR_LIN_GROWTH_FACTOR steps
+    STR_GROWTH_EXPONENTIAL,  // doubles, no linear phase
+    STR_GROWTH_GOLDEN,       // about 1.618x, lets a freed block be reused sooner
+    STR_GROWTH_PROPORTIONAL, // 1.5x, no linear phase
+    STR_GROWTH_PAGE          // 1.5x rounded up to 4 KB pages
+} StrGrowthKind;
+
+typedef struct {
+    StrGrowthKind kind;
+    size_t start;     // capacity when growing from nothing, 0 for STR_START_SIZE
+    size_t threshold; // STR_GROWTH_DEFAULT only, 0 for STR_LIN_THRESHOLD
+    size_t step;      // STR_GROWTH_DEFAULT only, 0 for STR_LIN_GROWTH_FACTOR
+} StrGrowth;
+
+// Growth policy for every String grown on the calling thread. Returns the
+// previous policy so a scope can put it back. STR_NULL restores the macros.
+STRDEF StrGrowth str_growth_set(const StrGrowth *policy) STR_NOEXCEPT;
+STR_NODISCARD STRDEF StrGrowth str_growth_get(STR_NO_PARAMS) STR_NOEXCEPT;
+
+// Capacity policy picks, growing from capacity until need bytes (including
+// the NUL) fit. For one String: str_reserve(s, str_growth_next(&p, s->capacity, n + 1) - 1)
+STR_NODISCARD STRDEF size_t str_growth_next(const StrGrowth *policy, size_t capacity, size_t need) STR_NOEXCEPT;
+
+#if defined(STR_LARGE_ALLOC_)
+// The allocator behind STR_LARGE_ALLOC, realloc and free semantics
+STR_NODISCARD STRDEF void *str_large_realloc(void *ptr, size_t size) STR_NOEXCEPT;
+STRDEF void str_large_free(void *ptr) STR_NOEXCEPT;
+#endif
+
+// Learned starting capacity for the Strings built at one call site.
+// Zero initialize, e.g. static StrSizeHint hint; not thread safe.
+typedef struct {
+    size_t estimate;  // capacity str_init_hinted allocates, including the NUL. 0 until the first record
+    size_t samples;   // Strings recorded
+    size_t fits;      // recorded Strings that fit in the estimate of their time
+    size_t overshoot; // bytes of estimate left unused by the Strings that fit
+} StrSizeHint;
+
+typedef struct {
+    size_t estimate;       // current estimate, including the NUL
+    size_t samples;        // Strings recorded
+    size_t fits;           // Strings that would not have grown past the estimate
+    double fit_rate;       // fits / samples, 0 when there were no samples
+    double mean_overshoot; // unused bytes per fitting String
+} StrSizeHintStats;
+
+// Empty String with hint->estimate bytes of capacity, or str_init() when
+// nothing was learned yet or hint is STR_NULL
+STR_NODISCARD STRDEF String str_init_hinted(StrSizeHint *hint) STR_NOEXCEPT;
+
+// Feed the final size of str into the hint. str_free_hinted records then frees
+STRDEF void str_size_hint_record(StrSizeHint *hint, const String *str) STR_NOEXCEPT;
+STRDEF void str_free_hinted(StrSizeHint *hint, String *str) STR_NOEXCEPT;
+
+STR_NODISCARD STRDEF StrSizeHintStats str_size_hint_stats(const StrSizeHint *hint) STR_NOEXCEPT;
+
+
+//
+// Instrumentation
+//
+
+#if defined(STR_STATS)
+typedef struct {
+    size_t allocs;          // buffers allocated from nothing
+    size_t reallocs;        // buffers grown or shrunk by STR_REALLOC
+    size_t bytes_allocated; // capacity asked for by those calls
+    size_t bytes_moved;     // bytes shifted by insert, erase, replace and trims
+    size_t slack;           // capacity handed out beyond what a grow needed
+} StrStats;
+
+// Totals for the calling thread
+STR_NODISCARD STRDEF StrStats str_stats_get(STR_NO_PARAMS) STR_NOEXCEPT;
+
+// Zero the totals and forget the call sites of the calling thread
+STRDEF void str_stats_reset(STR_NO_PARAMS) STR_NOEXCEPT;
+
+// Append a report to out: the totals, then one line per call site with
+// the most bytes allocated first
+STR_NODISCARD STRDEF bool str_stats_dump(String *out) STR_NOEXCEPT;
+
+// Used by the call site macros at the end of this header
+STRDEF void str_stats_enter_(const char *file, int line) STR_NOEXCEPT;
+STR_NODISCARD STRDEF bool str_stats_leave_(bool result) STR_NOEXCEPT;
+STR_NODISCARD STRDEF String str_stats_leave_str_(String result) STR_NOEXCEPT;
+STR_NODISCARD STRDEF char *str_stats_leave_ptr_(char *result) STR_NOEXCEPT;
+#endif
+
 
 //
 // Append
@@ -300,13 +692,32 @@ STR_NODISCARD STRDEF bool str_append_one_n(String *str, const char *cstr, size_t
 // Append one NUL-terminated string to string
 STR_NODISCARD STRDEF bool str_append_one(String *str, const char *cstr) STR_NOEXCEPT;
 
-// Append several NUL-terminated strings to string.
+// Append several NUL-terminated strings to string. Grows once, and on
+// failure nothing is appended.
 #define str_append(str_ptr, ...) str_append_((str_ptr), __VA_ARGS__, (const char *)STR_NULL)
 STR_NODISCARD STRDEF bool str_append_(String *str, const char *new_data1, ...) STR_NOEXCEPT;
 
 // Append one character to string
 STR_NODISCARD STRDEF bool str_append_char(String *str, char c) STR_NOEXCEPT;
 
+// Append one character without growing. The caller has made room, e.g.
+// with str_reserve: str->size + 1 < str->capacity
+static inline void
+str_push_unchecked(String *str, char c) STR_NOEXCEPT
+{
+    str->buffer[str->size++] = c;
+    str->buffer[str->size]   = '\0';
+}
+
+// Writable bytes past str->size, at least min_len of them, growing as
+// needed. *avail, if not STR_NULL, gets how many may be written. Returns
+// STR_NULL on failure. The pointer is valid until the String changes.
+STR_NODISCARD STRDEF char *str_spare(String *str, size_t min_len, size_t *avail) STR_NOEXCEPT;
+
+// Make n bytes written at str_spare content and restore the NUL. Returns
+// false if n exceeds the spare bytes
+STR_NODISCARD STRDEF bool str_commit(String *str, size_t n) STR_NOEXCEPT;
+
 // Append the same character n times
 STR_NODISCARD STRDEF bool str_append_repeat(String *str, char c, size_t n) STR_NOEXCEPT;
 
@@ -319,6 +730,13 @@ STR_NODISCARD STRDEF bool str_vappendf(String *str, const char *fmt, va_list arg
 // sprintf-style append
 STR_NODISCARD STRDEF bool str_appendf(String *str, const char *fmt, ...) STR_NOEXCEPT STR_FMT(printf, 2, 3);
 
+// Append n pieces to out with sep, if not STR_NULL, between each two.
+// out grows once. out may be one of strs. Slices and cstrs must not
+// point into out, and a STR_NULL cstr fails. On failure out is unchanged
+STR_NODISCARD STRDEF bool str_join(String *out, const String *strs, size_t n, const char *sep) STR_NOEXCEPT;
+STR_NODISCARD STRDEF bool str_join_slices(String *out, const StrSlice *slices, size_t n, const char *sep) STR_NOEXCEPT;
+STR_NODISCARD STRDEF bool str_join_cstrs(String *out, const char *const *cstrs, size_t n, const char *sep) STR_NOEXCEPT;
+
 
 //
 // Edits
@@ -362,6 +780,332 @@ STR_NODISCARD STRDEF bool str_equals(const String *a, const String *b) STR_NOEXC
 STR_NODISCARD STRDEF bool str_equals_cstr(const String *str, const char *cstr) STR_NOEXCEPT;
 STR_NODISCARD STRDEF bool str_equals_n(const String *str, const char *buf, size_t n) STR_NOEXCEPT;
 
+// Compare in unsigned byte order. Returns <0, 0 or >0 like memcmp.
+// A string sorts before any longer string it is a prefix of. STR_NULL
+// compares like an empty string.
+STR_NODISCARD STRDEF int str_compare(const String *a, const String *b) STR_NOEXCEPT;
+STR_NODISCARD STRDEF int str_compare_cstr(const String *str, const char *cstr) STR_NOEXCEPT;
+STR_NODISCARD STRDEF int str_compare_n(const String *str, const char *buf, size_t n) STR_NOEXCEPT;
+
+// Map ASCII letters to lower or upper case in place
+STR_NODISCARD STRDEF bool str_to_lower(String *str) STR_NOEXCEPT;
+STR_NODISCARD STRDEF bool str_to_upper(String *str) STR_NOEXCEPT;
+
+// Like str_equals and str_compare with ASCII letters folded to lower case
+STR_NODISCARD STRDEF bool str_equals_icase(const String *a, const String *b) STR_NOEXCEPT;
+STR_NODISCARD STRDEF int str_compare_icase(const String *a, const String *b) STR_NOEXCEPT;
+
+// Like str_find with ASCII letters matching either case
+STR_NODISCARD STRDEF size_t str_find_icase_n(const String *str, const char *needle, size_t nlen) STR_NOEXCEPT;
+STR_NODISCARD STRDEF size_t str_find_icase(const String *str, const char *needle) STR_NOEXCEPT;
+
+//
+// Byte sets
+//
+
+// Byte c is in the set when bit (c >> 4) & 7 of table[(c & 15) | (c >= 128 ? 16 : 0)]
+// is set. This is the layout the SIMD nibble lookup consumes directly.
+typedef struct {
+    unsigned char table[32];
+} StrByteSet;
+
+// Set of the given bytes. str_byteset_n takes embedded NULs.
+STR_NODISCARD STRDEF StrByteSet str_byteset_n(const char *bytes, size_t len) STR_NOEXCEPT;
+STR_NODISCARD STRDEF StrByteSet str_byteset(const char *bytes) STR_NOEXCEPT;
+// ASCII whitespace: space, \t, \n, \v, \f and \r
+STR_NODISCARD STRDEF StrByteSet str_byteset_space(STR_NO_PARAMS) STR_NOEXCEPT;
+STRDEF void str_byteset_add(StrByteSet *set, unsigned char c) STR_NOEXCEPT;
+STRDEF void str_byteset_invert(StrByteSet *set) STR_NOEXCEPT;
+STR_NODISCARD STRDEF bool str_byteset_contains(const StrByteSet *set, unsigned char c) STR_NOEXCEPT;
+
+// Position of the first/last byte that is (or is not) in set.
+// Returns SIZE_MAX if there is none.
+STR_NODISCARD STRDEF size_t str_find_first_of(const String *str, const StrByteSet *set) STR_NOEXCEPT;
+STR_NODISCARD STRDEF size_t str_find_first_not_of(const String *str, const StrByteSet *set) STR_NOEXCEPT;
+STR_NODISCARD STRDEF size_t str_find_last_of(const String *str, const StrByteSet *set) STR_NOEXCEPT;
+STR_NODISCARD STRDEF size_t str_find_last_not_of(const String *str, const StrByteSet *set) STR_NOEXCEPT;
+
+// Length of the leading run of bytes in set (str_span) or not in set
+// (str_cspan), like strspn and strcspn
+STR_NODISCARD STRDEF size_t str_span(const String *str, const StrByteSet *set) STR_NOEXCEPT;
+STR_NODISCARD STRDEF size_t str_cspan(const String *str, const StrByteSet *set) STR_NOEXCEPT;
+
+//
+// Translation
+//
+
+// Build with the str_translator_ functions, which keep rows in step with
+// map. Each input byte in remove is dropped, the others become map[c],
+// and an output byte in squeeze is dropped when it repeats the byte
+// written just before it.
+typedef struct {
+    unsigned char map[256];
+    StrByteSet remove;
+    StrByteSet squeeze;
+    uint16_t rows;      // bit h set when map[16 * h .. 16 * h + 15] is not identity
+    bool removes;
+    bool squeezes;
+} StrTranslator;
+
+// Identity map, nothing removed or squeezed
+STR_NODISCARD STRDEF StrTranslator str_translator_init(STR_NO_PARAMS) STR_NOEXCEPT;
+// Map from[i] to to[i]. Returns false, changing nothing, if the lengths differ.
+STR_NODISCARD STRDEF bool str_translator_map(StrTranslator *tr, const char *from, const char *to) STR_NOEXCEPT;
+// Map every byte in set to the byte to
+STRDEF void str_translator_map_set(StrTranslator *tr, const StrByteSet *set, unsigned char to) STR_NOEXCEPT;
+// Add set to the bytes removed or squeezed
+STRDEF void str_translator_remove(StrTranslator *tr, const StrByteSet *set) STR_NOEXCEPT;
+STRDEF void str_translator_squeeze(StrTranslator *tr, const StrByteSet *set) STR_NOEXCEPT;
+
+// Apply tr to str in place
+STR_NODISCARD STRDEF bool str_translate(String *str, const StrTranslator *tr) STR_NOEXCEPT;
+
+//
+// UTF-8
+//
+
+// True if the bytes are well formed UTF-8 (no overlongs, surrogates or
+// code points above U+10FFFF). Otherwise stores in *bad_offset, if given,
+// where the first invalid sequence starts.
+STR_NODISCARD STRDEF bool str_utf8_valid(const String *str, size_t *bad_offset) STR_NOEXCEPT;
+STR_NODISCARD STRDEF bool str_utf8_valid_n(const char *data, size_t len, size_t *bad_offset) STR_NOEXCEPT;
+
+// Number of code points. For invalid input this counts bytes that are not
+// continuation bytes.
+STR_NODISCARD STRDEF size_t str_utf8_length(const String *str) STR_NOEXCEPT;
+STR_NODISCARD STRDEF size_t str_utf8_length_n(const char *data, size_t len) STR_NOEXCEPT;
+
+// Shorten str to at most max_bytes without splitting a code point
+STR_NODISCARD STRDEF bool str_utf8_truncate(String *str, size_t max_bytes) STR_NOEXCEPT;
+
+// str_to_lower/upper plus the length preserving simple case mappings of
+// U+0080..U+07FF (Latin-1, Latin Extended-A, Greek, Cyrillic, Armenian).
+// Invalid sequences and other code points are left as they are.
+STR_NODISCARD STRDEF bool str_utf8_to_lower(String *str) STR_NOEXCEPT;
+STR_NODISCARD STRDEF bool str_utf8_to_upper(String *str) STR_NOEXCEPT;
+
+// Transcode UTF-8 to UTF-16 or UTF-32 in the given byte order and append
+// the bytes to out. On invalid input returns false, leaves out as it was
+// and stores in *bad_offset the byte offset of the bad sequence, or
+// SIZE_MAX if allocation failed.
+STR_NODISCARD STRDEF bool str_append_utf16(String *out, const char *utf8, size_t len, bool big_endian, size_t *bad_offset) STR_NOEXCEPT;
+STR_NODISCARD STRDEF bool str_append_utf32(String *out, const char *utf8, size_t len, bool big_endian, size_t *bad_offset) STR_NOEXCEPT;
+
+// Decode UTF-16 or UTF-32 bytes and append them to out as UTF-8. Errors
+// as above, the offset is in bytes of data: unpaired surrogates, code
+// points above U+10FFFF and a trailing partial unit are rejected.
+STR_NODISCARD STRDEF bool str_append_from_utf16(String *out, const void *data, size_t bytes, bool big_endian, size_t *bad_offset) STR_NOEXCEPT;
+STR_NODISCARD STRDEF bool str_append_from_utf32(String *out, const void *data, size_t bytes, bool big_endian, size_t *bad_offset) STR_NOEXCEPT;
+
+//
+// Base64 and hex
+//
+
+// Append data as base64. url selects the URL and filename safe alphabet
+// ('-' and '_') without padding, otherwise the standard one padded with '='.
+STR_NODISCARD STRDEF bool str_append_base64(String *out, const void *data, size_t len, bool url) STR_NOEXCEPT;
+
+// Decode base64 and append the bytes to out. Strict: no whitespace, the
+// standard alphabet must be padded, URL padding is optional and unused
+// trailing bits must be zero. On error returns false, leaves out as it
+// was and stores in *bad_offset the offset of the first bad character
+// (len if the input ends early), or SIZE_MAX if allocation failed.
+STR_NODISCARD STRDEF bool str_decode_base64(String *out, const char *src, size_t len, bool url, size_t *bad_offset) STR_NOEXCEPT;
+
+// Append data as two hex digits per byte, lower case unless upper
+STR_NODISCARD STRDEF bool str_append_hex(String *out, const void *data, size_t len, bool upper) STR_NOEXCEPT;
+
+// Decode hex digits of either case and append the bytes to out. Errors as
+// for str_decode_base64; an odd length is reported at the last digit.
+STR_NODISCARD STRDEF bool str_decode_hex(String *out, const char *src, size_t len, size_t *bad_offset) STR_NOEXCEPT;
+
+//
+// Escaping
+//
+
+typedef enum {
+    STR_ESCAPE_JSON,    // " \ and control bytes; \n style where JSON has one, else \u00XX
+    STR_ESCAPE_HTML,    // & < > " ' as entities, safe inside a quoted attribute value
+    STR_ESCAPE_C,       // C string literal body; control and non-ASCII bytes as \ooo
+    STR_ESCAPE_CSV      // RFC 4180 field: quoted, with "" for ", when it holds , " CR or LF
+} StrEscape;
+
+// Append data escaped for dialect. Surrounding quotes are not added,
+// except for a CSV field that needs them.
+STR_NODISCARD STRDEF bool str_append_escaped(String *out, const char *data, size_t len, StrEscape dialect) STR_NOEXCEPT;
+
+// Append the bytes data stands for. JSON also rejects raw quotes and
+// control bytes and unpaired \u surrogates; HTML takes the entities
+// above, &apos; and numeric ones. On error returns false, leaves out as it
+// was and stores in *bad_offset where the bad escape starts, or SIZE_MAX if
+// allocation failed.
+STR_NODISCARD STRDEF bool str_append_unescaped(String *out, const char *data, size_t len, StrEscape dialect, size_t *bad_offset) STR_NOEXCEPT;
+
+//
+// URLs
+//
+
+// Append data percent-encoded, keeping only A-Z a-z 0-9 - . _ ~. With form
+// set a space becomes '+', as in application/x-www-form-urlencoded.
+STR_NODISCARD STRDEF bool str_append_url_encoded(String *out, const char *data, size_t len, bool form) STR_NOEXCEPT;
+
+// Decode %XX sequences, and '+' to space with form set, in place. A '%'
+// without two hex digits after it fails, leaving str unchanged and storing
+// its offset in *bad_offset.
+STR_NODISCARD STRDEF bool str_url_decode_inplace(String *str, bool form, size_t *bad_offset) STR_NOEXCEPT;
+
+// Iterates the pairs of a query string such as "a=1&b=x%20y". Pairs are
+// decoded in place as they are reached (form rules, a malformed '%' is
+// kept as it is) and the slices point into the String, which must not
+// change while iterating. A leading '?' is skipped.
+typedef struct {
+    char *data;
+    size_t size;
+    size_t pos;
+} StrQueryIter;
+
+STR_NODISCARD STRDEF StrQueryIter str_query_iter(String *str) STR_NOEXCEPT;
+// Next pair, skipping empty ones. A key without '=' gets an empty value.
+// Returns false when there are no more.
+STR_NODISCARD STRDEF bool str_query_next(StrQueryIter *it, StrSlice *key, StrSlice *value) STR_NOEXCEPT;
+
+//
+// Numbers
+//
+
+// [+-]digits, decimal only. Returns the bytes consumed, or 0 with *value
+// untouched when there are no digits or the value does not fit.
+STR_NODISCARD STRDEF size_t str_parse_i64(const String *str, int64_t *value) STR_NOEXCEPT;
+STR_NODISCARD STRDEF size_t str_parse_i64_n(const char *data, size_t len, int64_t *value) STR_NOEXCEPT;
+// [+]digits
+STR_NODISCARD STRDEF size_t str_parse_u64(const String *str, uint64_t *value) STR_NOEXCEPT;
+STR_NODISCARD STRDEF size_t str_parse_u64_n(const char *data, size_t len, uint64_t *value) STR_NOEXCEPT;
+// [+-]digits[.digits][(e|E)[+-]digits], ".5" and "5." included, or inf,
+// infinity, nan in any case. Returns the bytes consumed, or 0.
+STR_NODISCARD STRDEF size_t str_parse_f64(const String *str, double *value) STR_NOEXCEPT;
+STR_NODISCARD STRDEF size_t str_parse_f64_n(const char *data, size_t len, double *value) STR_NOEXCEPT;
+
+//
+// Slices
+//
+
+// View of the whole string. Valid until the string is modified or freed.
+STR_NODISCARD STRDEF StrSlice str_slice(const String *str) STR_NOEXCEPT;
+STR_NODISCARD STRDEF StrSlice str_slice_n(const char *data, size_t len) STR_NOEXCEPT;
+STR_NODISCARD STRDEF StrSlice str_slice_cstr(const char *cstr) STR_NOEXCEPT;
+
+//
+// String refs
+//
+
+#define STR_REF_INLINE 12
+
+typedef struct {
+    uint32_t size;
+    char     prefix[4];       // first bytes, zero padded
+    union {
+        char        tail[8];  // bytes 4..11 when size <= STR_REF_INLINE, zero padded
+        const char *data;     // the whole string otherwise
+    } rest;
+} StrRef;
+
+// Make a ref. Strings longer than STR_REF_INLINE keep pointing at data,
+// which must outlive the ref.
+STR_NODISCARD STRDEF StrRef str_ref_n(const char *data, size_t len) STR_NOEXCEPT;
+STR_NODISCARD STRDEF StrRef str_ref_cstr(const char *cstr) STR_NOEXCEPT;
+STR_NODISCARD STRDEF StrRef str_ref_str(const String *str) STR_NOEXCEPT;
+STR_NODISCARD STRDEF StrRef str_ref_from_slice(StrSlice slice) STR_NOEXCEPT;
+
+// Bytes of the ref. For inline strings this points into *ref itself, so it
+// is only valid while the ref stays where it is.
+STR_NODISCARD STRDEF const char *str_ref_data(const StrRef *ref) STR_NOEXCEPT;
+STR_NODISCARD STRDEF StrSlice str_ref_slice(const StrRef *ref) STR_NOEXCEPT;
+
+// Append the bytes of ref to str
+STR_NODISCARD STRDEF bool str_append_ref(String *str, const StrRef *ref) STR_NOEXCEPT;
+
+// Same results as str_equals, str_compare and str_hash64_n on the bytes
+STR_NODISCARD STRDEF bool str_ref_equals(const StrRef *a, const StrRef *b) STR_NOEXCEPT;
+STR_NODISCARD STRDEF int str_ref_compare(const StrRef *a, const StrRef *b) STR_NOEXCEPT;
+STR_NODISCARD STRDEF uint64_t str_ref_hash(const StrRef *ref, uint64_t seed) STR_NOEXCEPT;
+
+//
+// Consumable buffers
+//
+
+typedef struct {
+    String str;  // live bytes are [head, str.size)
+    size_t head; // bytes consumed from the front
+} StrBuf;
+
+STR_NODISCARD STRDEF StrBuf str_buf_init(STR_NO_PARAMS) STR_NOEXCEPT;
+STRDEF void str_buf_free(StrBuf *buf) STR_NOEXCEPT;
+STRDEF void str_buf_clear(StrBuf *buf) STR_NOEXCEPT;
+
+// Live bytes, NUL terminated. Valid until the next call that modifies buf.
+STR_NODISCARD STRDEF const char *str_buf_data(const StrBuf *buf) STR_NOEXCEPT;
+STR_NODISCARD STRDEF size_t str_buf_size(const StrBuf *buf) STR_NOEXCEPT;
+STR_NODISCARD STRDEF StrSlice str_buf_slice(const StrBuf *buf) STR_NOEXCEPT;
+
+// Appends reuse the dead prefix before growing the allocation
+STR_NODISCARD STRDEF bool str_buf_append_n(StrBuf *buf, const char *data, size_t len) STR_NOEXCEPT;
+STR_NODISCARD STRDEF bool str_buf_append(StrBuf *buf, const char *cstr) STR_NOEXCEPT;
+// Room for new_len live bytes
+STR_NODISCARD STRDEF bool str_buf_reserve(StrBuf *buf, size_t new_len) STR_NOEXCEPT;
+
+// Drop n bytes from the front. Returns false if fewer than n are live.
+STR_NODISCARD STRDEF bool str_buf_consume(StrBuf *buf, size_t n) STR_NOEXCEPT;
+// Like str_erase. Moves whichever side of the range is shorter.
+STR_NODISCARD STRDEF bool str_buf_erase(StrBuf *buf, size_t pos, size_t len) STR_NOEXCEPT;
+STR_NODISCARD STRDEF bool str_buf_ltrim(StrBuf *buf) STR_NOEXCEPT;
+STR_NODISCARD STRDEF bool str_buf_rtrim(StrBuf *buf) STR_NOEXCEPT;
+STR_NODISCARD STRDEF bool str_buf_trim(StrBuf *buf) STR_NOEXCEPT;
+
+// Move the live bytes to the start of the allocation now
+STRDEF void str_buf_compact(StrBuf *buf) STR_NOEXCEPT;
+
+// Compact and hand the bytes over as a String. buf is left empty.
+STR_NODISCARD STRDEF String str_buf_take(StrBuf *buf) STR_NOEXCEPT;
+
+//
+// Builders
+//
+
+// Output built in chunks that stay where they are. Fields are internal.
+typedef struct {
+    String *chunks;     // filled chunks, the last one is appended to
+    size_t  count;      // chunks in use
+    size_t  slots;      // chunks allocated
+    size_t  sealed;     // bytes in all chunks but the last
+} StrBuilder;
+
+STR_NODISCARD STRDEF StrBuilder str_builder_init(STR_NO_PARAMS) STR_NOEXCEPT;
+STRDEF void str_builder_free(StrBuilder *b) STR_NOEXCEPT;
+STRDEF void str_builder_clear(StrBuilder *b) STR_NOEXCEPT;
+STR_NODISCARD STRDEF size_t str_builder_size(const StrBuilder *b) STR_NOEXCEPT;
+
+// The chunk to append to, with room for at least len more bytes. Any
+// str_append_* call works on it; writing more than len grows only this
+// chunk. Valid until the next call on b. STR_NULL on allocation failure.
+STR_NODISCARD STRDEF String *str_builder_tail(StrBuilder *b, size_t len) STR_NOEXCEPT;
+
+// Large appends are split so that no chunk has to grow
+STR_NODISCARD STRDEF bool str_builder_append_n(StrBuilder *b, const char *data, size_t len) STR_NOEXCEPT;
+STR_NODISCARD STRDEF bool str_builder_append(StrBuilder *b, const char *cstr) STR_NOEXCEPT;
+STR_NODISCARD STRDEF bool str_builder_append_str(StrBuilder *b, const String *str) STR_NOEXCEPT;
+STR_NODISCARD STRDEF bool str_builder_append_char(StrBuilder *b, char c) STR_NOEXCEPT;
+STR_NODISCARD STRDEF bool str_builder_vappendf(StrBuilder *b, const char *fmt, va_list args) STR_NOEXCEPT STR_FMT(printf, 2, 0);
+STR_NODISCARD STRDEF bool str_builder_appendf(StrBuilder *b, const char *fmt, ...) STR_NOEXCEPT STR_FMT(printf, 2, 3);
+
+// Write all chunks in order. Flushes f and uses writev on its descriptor
+// where available, one fwrite per chunk otherwise.
+STR_NODISCARD STRDEF bool str_builder_write_file(const StrBuilder *b, FILE *f) STR_NOEXCEPT;
+
+// Move the built bytes into *out, overwriting it without freeing, as one
+// allocation of exactly size + 1, and empty b. On allocation failure both
+// are left as they were.
+STR_NODISCARD STRDEF bool str_builder_take(StrBuilder *b, String *out) STR_NOEXCEPT;
+
 //
 // File IO
 //
@@ -370,6 +1114,278 @@ STR_NODISCARD STRDEF bool str_write_file(const String *str, FILE *f) STR_NOEXCEP
 STR_NODISCARD STRDEF bool str_read_file(String *str, FILE *f) STR_NOEXCEPT;
 
 
+//
+// Hashing
+//
+
+typedef struct {
+    uint64_t lo;
+    uint64_t hi;
+} StrHash128;
+
+// Incremental hasher state. Fields are internal.
+typedef struct {
+    uint64_t      seed;
+    uint64_t      see1;
+    uint64_t      see2;
+    size_t        total;      // bytes consumed so far
+    size_t        buffered;   // pending bytes in buffer[16..]
+    unsigned char buffer[64]; // last 16 consumed bytes, then up to 48 pending bytes
+} StrHasher;
+
+// Hash len bytes. Equal input and seed always give equal output.
+STR_NODISCARD STRDEF uint64_t   str_hash64_n(const char *data, size_t len, uint64_t seed) STR_NOEXCEPT;
+STR_NODISCARD STRDEF uint64_t   str_hash64(const String *str, uint64_t seed) STR_NOEXCEPT;
+STR_NODISCARD STRDEF StrHash128 str_hash128_n(const char *data, size_t len, uint64_t seed) STR_NOEXCEPT;
+STR_NODISCARD STRDEF StrHash128 str_hash128(const String *str, uint64_t seed) STR_NOEXCEPT;
+
+// Hash as if every ASCII letter was lowercase. "Key" and "KEY" hash alike.
+STR_NODISCARD STRDEF uint64_t   str_hash64_icase_n(const char *data, size_t len, uint64_t seed) STR_NOEXCEPT;
+STR_NODISCARD STRDEF uint64_t   str_hash64_icase(const String *str, uint64_t seed) STR_NOEXCEPT;
+STR_NODISCARD STRDEF StrHash128 str_hash128_icase_n(const char *data, size_t len, uint64_t seed) STR_NOEXCEPT;
+STR_NODISCARD STRDEF StrHash128 str_hash128_icase(const String *str, uint64_t seed) STR_NOEXCEPT;
+
+// Streaming hasher. Feeding the bytes in any number of pieces gives the same
+// result as str_hash64_n/str_hash128_n over all of them at once.
+STRDEF void str_hasher_init(StrHasher *h, uint64_t seed) STR_NOEXCEPT;
+STRDEF void str_hasher_update(StrHasher *h, const char *data, size_t len) STR_NOEXCEPT;
+STRDEF void str_hasher_update_str(StrHasher *h, const String *str) STR_NOEXCEPT;
+STRDEF void str_hasher_update_icase(StrHasher *h, const char *data, size_t len) STR_NOEXCEPT;
+STR_NODISCARD STRDEF uint64_t   str_hasher_final64(const StrHasher *h) STR_NOEXCEPT;
+STR_NODISCARD STRDEF StrHash128 str_hasher_final128(const StrHasher *h) STR_NOEXCEPT;
+
+
+//
+// Arena
+//
+
+// Bump allocator for many small immutable allocations that are freed
+// together. Used by StrInternPool and StrMap. Fields are internal.
+typedef struct {
+    void  *blocks;    // singly linked list of blocks, current block first
+    char  *cursor;    // next free byte in the current block
+    size_t remaining; // free bytes after cursor
+    size_t used;      // bytes handed out
+    size_t reserved;  // bytes allocated for blocks
+} StrArena;
+
+
+//
+// Maps
+//
+
+typedef struct {
+    uint64_t    hash;     // cached hash of the key
+    const char *key;      // NUL-terminated copy owned by the map
+    size_t      key_size; // number of key bytes, excluding NUL
+    void       *value;
+} StrMapEntry;
+
+// Open addressing hash map keyed by byte strings. Fields are internal.
+typedef struct {
+    unsigned char *ctrl;        // capacity + group width control bytes
+    StrMapEntry   *entries;     // capacity slots
+    size_t         capacity;    // 0 or a power of two
+    size_t         count;       // live entries
+    size_t         growth_left; // inserts into empty slots before the next resize
+    StrArena       keys;
+} StrMap;
+
+// Make an empty map. Does not allocate.
+STR_NODISCARD STRDEF StrMap str_map_init(STR_NO_PARAMS) STR_NOEXCEPT;
+
+// Free the table and all key copies
+STRDEF void str_map_free(StrMap *map) STR_NOEXCEPT;
+
+// Remove all entries. Keeps the table, releases the key copies.
+STRDEF void str_map_clear(StrMap *map) STR_NOEXCEPT;
+
+// Make room for count entries without further resizing
+STR_NODISCARD STRDEF bool str_map_reserve(StrMap *map, size_t count) STR_NOEXCEPT;
+
+// Find the entry for key. Returns STR_NULL if there is none.
+// The entry pointer is valid until the next insert or remove.
+STR_NODISCARD STRDEF StrMapEntry *str_map_find_n(const StrMap *map, const char *key, size_t len) STR_NOEXCEPT;
+STR_NODISCARD STRDEF StrMapEntry *str_map_find(const StrMap *map, const String *key) STR_NOEXCEPT;
+STR_NODISCARD STRDEF StrMapEntry *str_map_find_slice(const StrMap *map, StrSlice key) STR_NOEXCEPT;
+
+// Find the entry for key, inserting one with a STR_NULL value if there is none.
+// Sets *inserted if not STR_NULL. Returns STR_NULL on allocation failure.
+STR_NODISCARD STRDEF StrMapEntry *str_map_upsert_n(StrMap *map, const char *key, size_t len, bool *inserted) STR_NOEXCEPT;
+STR_NODISCARD STRDEF StrMapEntry *str_map_upsert(StrMap *map, const String *key, bool *inserted) STR_NOEXCEPT;
+
+// Set the value for key, inserting or overwriting
+STR_NODISCARD STRDEF bool str_map_put_n(StrMap *map, const char *key, size_t len, void *value) STR_NOEXCEPT;
+STR_NODISCARD STRDEF bool str_map_put(StrMap *map, const String *key, void *value) STR_NOEXCEPT;
+
+// Remove key. Returns false if it was not present.
+// The key copy is only released by str_map_clear or str_map_free.
+STRDEF bool str_map_remove_n(StrMap *map, const char *key, size_t len) STR_NOEXCEPT;
+STRDEF bool str_map_remove(StrMap *map, const String *key) STR_NOEXCEPT;
+
+// Iterate over all entries in unspecified order. Start with *iter = 0.
+// Returns STR_NULL when done.
+STR_NODISCARD STRDEF StrMapEntry *str_map_next(const StrMap *map, size_t *iter) STR_NOEXCEPT;
+
+
+//
+// Interning
+//
+
+// Canonical copy of an interned byte sequence. Owned by the pool.
+// Two handles from the same pool are equal iff the pointers are equal.
+typedef struct {
+    const char *data; // NUL-terminated, stable until the pool is freed
+    size_t      size; // number of bytes, excluding NUL
+    uint64_t    hash; // hash of the bytes, as used by the pool
+} StrInterned;
+
+typedef struct {
+    uint64_t           hash;
+    const StrInterned *entry; // STR_NULL for an empty slot
+} StrInternSlot;
+
+// One lock-striped part of a pool. Fields are internal.
+typedef struct {
+    volatile long  lock;
+    StrInternSlot *slots;      // open addressing table, power of two sized
+    size_t         slot_count;
+    size_t         count;      // number of interned strings
+    StrArena       arena;      // handles and string bytes
+    size_t         lookups;
+    size_t         hits;
+} StrInternShard;
+
+typedef struct {
+    union {
+        StrInternShard shard;
+        char           pad[128]; // keep shards on separate cache lines
+    } shards[STR_INTERN_SHARDS];
+} StrInternPool;
+
+typedef struct {
+    size_t count;          // unique strings in the pool
+    size_t bytes_used;     // bytes taken by handles and string data
+    size_t bytes_reserved; // bytes allocated by the pool in total
+    size_t lookups;        // calls to str_intern_n and friends
+    size_t hits;           // lookups that found an existing string
+    double hit_rate;       // hits / lookups, 0 when there were no lookups
+} StrInternStats;
+
+// Initialize an empty pool. Does not allocate.
+STRDEF void str_intern_pool_init(StrInternPool *pool) STR_NOEXCEPT;
+
+// Free all memory owned by the pool. Every handle from it becomes invalid.
+STRDEF void str_intern_pool_free(StrInternPool *pool) STR_NOEXCEPT;
+
+// Return the canonical handle for the bytes, inserting a copy if they are new.
+// Safe to call concurrently on the same pool. Returns STR_NULL on allocation failure.
+STR_NODISCARD STRDEF const StrInterned *str_intern_n(StrInternPool *pool, const char *data, size_t len) STR_NOEXCEPT;
+STR_NODISCARD STRDEF const StrInterned *str_intern(StrInternPool *pool, const char *cstr) STR_NOEXCEPT;
+STR_NODISCARD STRDEF const StrInterned *str_intern_str(StrInternPool *pool, const String *str) STR_NOEXCEPT;
+
+// Return the handle for the bytes if they were interned before, STR_NULL otherwise
+STR_NODISCARD STRDEF const StrInterned *str_intern_find_n(StrInternPool *pool, const char *data, size_t len) STR_NOEXCEPT;
+
+// Snapshot of the pool counters summed over all shards
+STR_NODISCARD STRDEF StrInternStats str_intern_pool_stats(StrInternPool *pool) STR_NOEXCEPT;
+
+
+//
+// String vectors
+//
+
+typedef struct {
+    size_t offset; // start of the element in StrVec.bytes
+    size_t size;
+} StrVecItem;
+
+// Many strings in one contiguous blob. Items are always in blob order.
+typedef struct {
+    char       *bytes;          // element bytes back to back, not NUL-separated
+    size_t      bytes_size;     // bytes in use, including dead ones
+    size_t      bytes_capacity;
+    StrVecItem *items;
+    size_t      count;          // number of elements
+    size_t      items_capacity;
+    size_t      dead;           // bytes of removed elements, reclaimed by str_vec_compact
+} StrVec;
+
+// Make an empty vector. Does not allocate.
+STR_NODISCARD STRDEF StrVec str_vec_init(STR_NO_PARAMS) STR_NOEXCEPT;
+STRDEF void str_vec_free(StrVec *vec) STR_NOEXCEPT;
+
+// Remove all elements without deallocating
+STRDEF void str_vec_clear(StrVec *vec) STR_NOEXCEPT;
+
+// Make room for count more elements holding bytes more bytes in total
+STR_NODISCARD STRDEF bool str_vec_reserve(StrVec *vec, size_t count, size_t bytes) STR_NOEXCEPT;
+
+// Append one element
+STR_NODISCARD STRDEF bool str_vec_push_n(StrVec *vec, const char *data, size_t len) STR_NOEXCEPT;
+STR_NODISCARD STRDEF bool str_vec_push(StrVec *vec, const char *cstr) STR_NOEXCEPT;
+STR_NODISCARD STRDEF bool str_vec_push_str(StrVec *vec, const String *str) STR_NOEXCEPT;
+
+// View of element i. Valid until the vector is modified.
+// Returns an empty slice if i is out of range.
+STR_NODISCARD STRDEF StrSlice str_vec_get(const StrVec *vec, size_t i) STR_NOEXCEPT;
+
+// Iterate in order. Start with *iter = 0. Returns false when done.
+STR_NODISCARD STRDEF bool str_vec_next(const StrVec *vec, size_t *iter, StrSlice *out) STR_NOEXCEPT;
+
+// Remove element i. Its bytes stay in the blob until str_vec_compact.
+STR_NODISCARD STRDEF bool str_vec_remove(StrVec *vec, size_t i) STR_NOEXCEPT;
+
+// Move live bytes together, dropping the bytes of removed elements.
+// Does not shrink the allocation.
+STRDEF void str_vec_compact(StrVec *vec) STR_NOEXCEPT;
+
+// Append n Strings, growing the blob and the item array once
+STR_NODISCARD STRDEF bool str_vec_push_strs(StrVec *vec, const String *strs, size_t n) STR_NOEXCEPT;
+
+// Copy every element into out[0 .. vec->count). Each out[i] is replaced by a
+// String of exactly the element's size. On failure the Strings filled so far
+// are freed.
+STR_NODISCARD STRDEF bool str_vec_to_strs(const StrVec *vec, String *out) STR_NOEXCEPT;
+
+// Write all elements back to back. One fwrite when there are no dead bytes.
+STR_NODISCARD STRDEF bool str_vec_write_file(const StrVec *vec, FILE *f) STR_NOEXCEPT;
+
+
+//
+// Sorting
+//
+
+// Sort strs in str_compare order. Not stable. Needs about 32 bytes of
+// scratch per element. Returns false on allocation failure, leaving strs as is.
+STR_NODISCARD STRDEF bool str_sort(String *strs, size_t n) STR_NOEXCEPT;
+
+// Sort the elements of vec and rewrite the blob in the new order, which
+// also drops dead bytes
+STR_NODISCARD STRDEF bool str_vec_sort(StrVec *vec) STR_NOEXCEPT;
+
+#ifdef STR_SORT_PARALLEL
+// Same result as str_sort, using up to threads threads for large inputs.
+// Inputs with many equal strings split less evenly.
+STR_NODISCARD STRDEF bool str_sort_parallel(String *strs, size_t n, unsigned threads) STR_NOEXCEPT;
+STR_NODISCARD STRDEF bool str_vec_sort_parallel(StrVec *vec, unsigned threads) STR_NOEXCEPT;
+#endif
+
+//
+// CPU features
+//
+
+#define STR_SIMD_SCALAR 0
+#define STR_SIMD_SSE2   1
+#define STR_SIMD_SSE42  2
+#define STR_SIMD_AVX2   3
+#define STR_SIMD_AVX512 4 // AVX-512BW
+
+// Instruction set the byte kernels dispatch to on this machine, after the
+// STR_SIMD_LEVEL cap
+STR_NODISCARD STRDEF int str_simd_level(STR_NO_PARAMS) STR_NOEXCEPT;
+
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -410,612 +1426,7147 @@ str_from_string_view(std::string_view sv);
 
 #ifdef STR_IMPLEMENTATION
 
-#include <ctype.h>
-#include <stdint.h>
+#include <float.h>
 #include <string.h>
 
-STRDEF String
-str_init(STR_NO_PARAMS) STR_NOEXCEPT
-{
-    String result = {STR_NULL, 0, 0};
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
-    char *p = (char *)STR_REALLOC(STR_NULL, 1);
-    if (p) {
-        p[0] = '\0';
-        result.buffer = p;
-        result.capacity = 1;
-        result.size = 0;
-    }
+#ifdef STR_SORT_PARALLEL
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#endif
 
-    return result;
-}
+// Capacity is rounded up to the block the allocator really handed out
+#if !defined(STR_USABLE_SIZE) && !defined(STR_NO_USABLE_SIZE) && defined(STR_LIBC_ALLOC_)
+#if defined(__GLIBC__)
+#include <malloc.h>
+#define STR_USABLE_SIZE(ptr) malloc_usable_size(ptr)
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#define STR_USABLE_SIZE(ptr) malloc_size(ptr)
+#elif defined(_MSC_VER)
+#include <malloc.h>
+#define STR_USABLE_SIZE(ptr) _msize(ptr)
+#endif
+#endif
 
-STRDEF bool
-str_clone(const String *src, String *dst) STR_NOEXCEPT
-{
+#if defined(STR_LARGE_ALLOC_) && (defined(__unix__) || defined(__APPLE__))
+#include <sys/mman.h>
+#include <unistd.h>
+#if defined(MAP_ANONYMOUS) || defined(MAP_ANON)
+#define STR_LARGE_MMAP_ 1
+#endif
+#endif
+
+#if defined(__cplusplus)
+#define STR_THREAD_LOCAL_ thread_local
+#elif defined(_MSC_VER)
+#define STR_THREAD_LOCAL_ __declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define STR_THREAD_LOCAL_ _Thread_local
+#else
+#define STR_THREAD_LOCAL_ __thread
+#endif
+
+// writev for StrBuilder, where stdio also declares fileno
+#if defined(__APPLE__) || (defined(__unix__) && defined(_POSIX_C_SOURCE))
+#define STR_WRITEV_ 1
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define STR_BIG_ENDIAN_ 1
+#endif
+
+#if defined(STR_SIMD_LEVEL) && STR_SIMD_LEVEL < STR_SIMD_SSE2
+// forced scalar
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STR_SSE2_ 1
+#include <emmintrin.h>
+#endif
+
+// Wider kernels are compiled for their own target and only called after the
+// CPU was checked, so the rest of the header needs no -m flags
+#if defined(STR_SIMD_LEVEL) && STR_SIMD_LEVEL < STR_SIMD_SSE42
+// nothing above SSE2
+#elif (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define STR_X86_DISPATCH_ 1
+#define STR_TARGET_(isa) __attribute__((target(isa)))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)) && !defined(_M_ARM64EC)
+#define STR_X86_DISPATCH_ 1
+#define STR_TARGET_(isa)
+#include <immintrin.h>
+#endif
+
+// Index of the lowest set bit. x must not be 0.
+static inline unsigned
+str_ctz64_(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned)__builtin_ctzll(x);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long i;
+    _BitScanForward64(&i, x);
+    return (unsigned)i;
+#else
+    unsigned n = 0;
+    while (!(x & 1)) { x >>= 1; ++n; }
+    return n;
+#endif
+}
+
+// Index of the highest set bit. x must not be 0.
+static inline unsigned
+str_msb64_(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 63u - (unsigned)__builtin_clzll(x);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long i;
+    _BitScanReverse64(&i, x);
+    return (unsigned)i;
+#else
+    unsigned n = 0;
+    while (x >>= 1) ++n;
+    return n;
+#endif
+}
+
+static inline unsigned
+str_popcount64_(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned)__builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (unsigned)((x * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+static inline uint64_t
+str_read64_(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t
+str_read32_(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t
+str_bswap64_(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_bswap64(x);
+#elif defined(_MSC_VER)
+    return _byteswap_uint64(x);
+#else
+    x = ((x & 0x00FF00FF00FF00FFull) << 8)  | ((x >> 8)  & 0x00FF00FF00FF00FFull);
+    x = ((x & 0x0000FFFF0000FFFFull) << 16) | ((x >> 16) & 0x0000FFFF0000FFFFull);
+    return (x << 32) | (x >> 32);
+#endif
+}
+
+// Up to 8 bytes as a big endian number, zero padded on the right, so that
+// comparing the numbers compares the bytes in memcmp order
+static inline uint64_t
+str_load_be64_(const unsigned char *p, size_t n)
+{
+    if (n >= 8) {
+#if defined(STR_BIG_ENDIAN_)
+        return str_read64_(p);
+#else
+        return str_bswap64_(str_read64_(p));
+#endif
+    }
+    uint64_t v = 0;
+    for (size_t i = 0; i < n; ++i) v |= (uint64_t)p[i] << (56 - 8 * i);
+    return v;
+}
+
+// Full 64x64 bit product, low half in *a and high half in *b
+static inline void
+str_mum_(uint64_t *a, uint64_t *b)
+{
+#if defined(__SIZEOF_INT128__) && (defined(__GNUC__) || defined(__clang__))
+    __extension__ typedef unsigned __int128 str_u128_;
+    str_u128_ r = (str_u128_)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    *a = _umul128(*a, *b, b);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32;
+    uint64_t la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t  = rl + (rm0 << 32);
+    uint64_t c  = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+//
+// Instrumentation
+//
+
+#if defined(STR_STATS)
+typedef struct {
+    const char *file;
+    int         line;
+    StrStats    stats;
+} StrStatsSite_;
+
+static STR_THREAD_LOCAL_ StrStats      str_stats_total_;
+static STR_THREAD_LOCAL_ StrStatsSite_ str_stats_sites_[STR_STATS_SITES];
+static STR_THREAD_LOCAL_ StrStats     *str_stats_site_; // STR_NULL outside a wrapped call
+
+static inline void
+str_stats_count_(size_t allocs, size_t reallocs, size_t bytes, size_t moved, size_t slack)
+{
+    StrStats *t = &str_stats_total_;
+    t->allocs += allocs; t->reallocs += reallocs; t->bytes_allocated += bytes;
+    t->bytes_moved += moved; t->slack += slack;
+    if (str_stats_site_) {
+        t = str_stats_site_;
+        t->allocs += allocs; t->reallocs += reallocs; t->bytes_allocated += bytes;
+        t->bytes_moved += moved; t->slack += slack;
+    }
+}
+
+#define STR_STATS_ALLOC_(bytes)   str_stats_count_(1, 0, (bytes), 0, 0)
+#define STR_STATS_REALLOC_(bytes) str_stats_count_(0, 1, (bytes), 0, 0)
+#define STR_STATS_MOVE_(bytes)    str_stats_count_(0, 0, 0, (bytes), 0)
+#define STR_STATS_SLACK_(bytes)   str_stats_count_(0, 0, 0, 0, (bytes))
+
+STRDEF void
+str_stats_enter_(const char *file, int line) STR_NOEXCEPT
+{
+    // File names are string literals, so the pointer identifies the file
+    size_t h = (size_t)(((uintptr_t)file >> 3) ^ ((uintptr_t)line * 0x9E3779B9u));
+    for (size_t i = 0; i < STR_STATS_SITES; ++i) {
+        StrStatsSite_ *site = &str_stats_sites_[(h + i) % STR_STATS_SITES];
+        if (!site->file) {
+            site->file = file;
+            site->line = line;
+        }
+        if (site->file == file && site->line == line) {
+            str_stats_site_ = &site->stats;
+            return;
+        }
+    }
+    str_stats_site_ = STR_NULL;
+}
+
+STRDEF bool
+str_stats_leave_(bool result) STR_NOEXCEPT
+{
+    str_stats_site_ = STR_NULL;
+    return result;
+}
+
+STRDEF String
+str_stats_leave_str_(String result) STR_NOEXCEPT
+{
+    str_stats_site_ = STR_NULL;
+    return result;
+}
+
+STRDEF char *
+str_stats_leave_ptr_(char *result) STR_NOEXCEPT
+{
+    str_stats_site_ = STR_NULL;
+    return result;
+}
+
+STRDEF StrStats
+str_stats_get(STR_NO_PARAMS) STR_NOEXCEPT
+{
+    return str_stats_total_;
+}
+
+STRDEF void
+str_stats_reset(STR_NO_PARAMS) STR_NOEXCEPT
+{
+    memset(&str_stats_total_, 0, sizeof(str_stats_total_));
+    memset(str_stats_sites_, 0, sizeof(str_stats_sites_));
+    str_stats_site_ = STR_NULL;
+}
+
+STRDEF bool
+str_stats_dump(String *out) STR_NOEXCEPT
+{
+    if (!out) return false;
+
+    // Snapshot first, the report itself allocates
+    StrStats total = str_stats_total_;
+    StrStatsSite_ sites[STR_STATS_SITES];
+    size_t count = 0;
+    for (size_t i = 0; i < STR_STATS_SITES; ++i) {
+        const StrStats *st = &str_stats_sites_[i].stats;
+        if (st->allocs || st->reallocs || st->bytes_moved) sites[count++] = str_stats_sites_[i];
+    }
+
+    bool ok = str_appendf(out, "allocs %zu, reallocs %zu, allocated %zu, moved %zu, slack %zu\n",
+                          total.allocs, total.reallocs, total.bytes_allocated,
+                          total.bytes_moved, total.slack);
+    for (size_t i = 0; ok && i < count; ++i) {
+        // Selection sort, the table is small and this is a report
+        size_t best = i;
+        for (size_t j = i + 1; j < count; ++j) {
+            if (sites[j].stats.bytes_allocated > sites[best].stats.bytes_allocated) best = j;
+        }
+        StrStatsSite_ tmp = sites[i];
+        sites[i] = sites[best];
+        sites[best] = tmp;
+
+        const StrStats *st = &sites[i].stats;
+        ok = str_appendf(out, "  %s:%d: allocs %zu, reallocs %zu, allocated %zu, moved %zu, slack %zu\n",
+                         sites[i].file, sites[i].line, st->allocs, st->reallocs,
+                         st->bytes_allocated, st->bytes_moved, st->slack);
+    }
+    return ok;
+}
+#else
+#define STR_STATS_ALLOC_(bytes)   ((void)0)
+#define STR_STATS_REALLOC_(bytes) ((void)0)
+#define STR_STATS_MOVE_(bytes)    ((void)0)
+#define STR_STATS_SLACK_(bytes)   ((void)0)
+#endif // STR_STATS
+
+//
+// CPU dispatch
+//
+
+static inline int
+str_simd_detect_(void)
+{
+    int level = STR_SIMD_SCALAR;
+#if defined(STR_X86_DISPATCH_) && defined(_MSC_VER) && !defined(__clang__)
+    int r[4];
+    __cpuid(r, 0);
+    int max_leaf = r[0];
+    __cpuid(r, 1);
+    bool osxsave = (r[2] & (1 << 27)) != 0;
+    if (r[3] & (1 << 26)) level = STR_SIMD_SSE2;
+    if (level && (r[2] & (1 << 20))) level = STR_SIMD_SSE42;
+    // AVX state has to be enabled by the OS too, not just present
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    if (level == STR_SIMD_SSE42 && max_leaf >= 7 && (r[2] & (1 << 28)) && (xcr0 & 0x6) == 0x6) {
+        __cpuidex(r, 7, 0);
+        if (r[1] & (1 << 5)) level = STR_SIMD_AVX2;
+        if (level == STR_SIMD_AVX2 && (r[1] & (1 << 16)) && (r[1] & (1 << 30)) && (xcr0 & 0xE6) == 0xE6) {
+            level = STR_SIMD_AVX512;
+        }
+    }
+#elif defined(STR_X86_DISPATCH_)
+    // libgcc and compiler-rt check the OS enabled state for AVX as well
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))   level = STR_SIMD_SSE2;
+    if (level && __builtin_cpu_supports("sse4.2")) level = STR_SIMD_SSE42;
+    if (level == STR_SIMD_SSE42 && __builtin_cpu_supports("avx2")) level = STR_SIMD_AVX2;
+    if (level == STR_SIMD_AVX2 && __builtin_cpu_supports("avx512bw")) level = STR_SIMD_AVX512;
+#elif defined(STR_SSE2_)
+    level = STR_SIMD_SSE2;
+#endif
+#if defined(STR_SIMD_LEVEL)
+    if (level > STR_SIMD_LEVEL) level = STR_SIMD_LEVEL;
+#endif
+    return level;
+}
+
+// Cached result of str_simd_detect_. Racing threads store the same value.
+static inline int
+str_simd_level_(void)
+{
+    static int cached = -1;
+#if defined(__GNUC__) || defined(__clang__)
+    int level = __atomic_load_n(&cached, __ATOMIC_RELAXED);
+    if (level < 0) {
+        level = str_simd_detect_();
+        __atomic_store_n(&cached, level, __ATOMIC_RELAXED);
+    }
+#else
+    int level = *(volatile int *)&cached;
+    if (level < 0) {
+        level = str_simd_detect_();
+        *(volatile int *)&cached = level;
+    }
+#endif
+    return level;
+}
+
+STRDEF int
+str_simd_level(STR_NO_PARAMS) STR_NOEXCEPT
+{
+    return str_simd_level_();
+}
+
+//
+// Byte kernels
+//
+// Each wide kernel handles whole vectors and returns where it stopped, the
+// portable code after it finishes the tail.
+//
+
+#if defined(STR_X86_DISPATCH_)
+// Length of the common prefix of a and b, in whole 32 byte blocks
+STR_TARGET_("avx2") static inline size_t
+str_mismatch_avx2_(const unsigned char *a, const unsigned char *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(const void *)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(const void *)(b + i));
+        uint32_t m = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+        if (m) return i + str_ctz64_(m);
+    }
+    return i;
+}
+
+STR_TARGET_("avx512f,avx512bw") static inline size_t
+str_mismatch_avx512_(const unsigned char *a, const unsigned char *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m512i x = _mm512_loadu_si512((const void *)(a + i));
+        __m512i y = _mm512_loadu_si512((const void *)(b + i));
+        uint64_t m = (uint64_t)_mm512_cmpneq_epi8_mask(x, y);
+        if (m) return i + str_ctz64_(m);
+    }
+    return i;
+}
+
+// First position i >= 0 where the needle's first and last bytes both match
+// and the middle compares equal. nlen >= 2. Stops at *pos when the next
+// block would read past hay + n.
+STR_TARGET_("avx2") static inline size_t
+str_find_avx2_(const char *hay, size_t n, const char *needle, size_t nlen, size_t *pos)
+{
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last  = _mm256_set1_epi8(needle[nlen - 1]);
+    size_t i = 0;
+    for (; i + nlen - 1 + 32 <= n; i += 32) {
+        __m256i b0 = _mm256_loadu_si256((const __m256i *)(const void *)(hay + i));
+        __m256i b1 = _mm256_loadu_si256((const __m256i *)(const void *)(hay + i + nlen - 1));
+        uint32_t m = (uint32_t)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(b0, first), _mm256_cmpeq_epi8(b1, last)));
+        while (m) {
+            size_t at = i + str_ctz64_(m);
+            if (memcmp(hay + at + 1, needle + 1, nlen - 2) == 0) return at;
+            m &= m - 1;
+        }
+    }
+    *pos = i;
+    return SIZE_MAX;
+}
+
+STR_TARGET_("avx512f,avx512bw") static inline size_t
+str_find_avx512_(const char *hay, size_t n, const char *needle, size_t nlen, size_t *pos)
+{
+    const __m512i first = _mm512_set1_epi8(needle[0]);
+    const __m512i last  = _mm512_set1_epi8(needle[nlen - 1]);
+    size_t i = 0;
+    for (; i + nlen - 1 + 64 <= n; i += 64) {
+        __m512i b0 = _mm512_loadu_si512((const void *)(hay + i));
+        __m512i b1 = _mm512_loadu_si512((const void *)(hay + i + nlen - 1));
+        uint64_t m = (uint64_t)(_mm512_cmpeq_epi8_mask(b0, first) & _mm512_cmpeq_epi8_mask(b1, last));
+        while (m) {
+            size_t at = i + str_ctz64_(m);
+            if (memcmp(hay + at + 1, needle + 1, nlen - 2) == 0) return at;
+            m &= m - 1;
+        }
+    }
+    *pos = i;
+    return SIZE_MAX;
+}
+#endif // STR_X86_DISPATCH_
+
+#if defined(STR_SSE2_)
+static inline size_t
+str_find_sse2_(const char *hay, size_t n, const char *needle, size_t nlen, size_t *pos)
+{
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last  = _mm_set1_epi8(needle[nlen - 1]);
+    size_t i = 0;
+    for (; i + nlen - 1 + 16 <= n; i += 16) {
+        __m128i b0 = _mm_loadu_si128((const __m128i *)(const void *)(hay + i));
+        __m128i b1 = _mm_loadu_si128((const __m128i *)(const void *)(hay + i + nlen - 1));
+        unsigned m = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(b0, first), _mm_cmpeq_epi8(b1, last)));
+        while (m) {
+            size_t at = i + str_ctz64_(m);
+            if (memcmp(hay + at + 1, needle + 1, nlen - 2) == 0) return at;
+            m &= m - 1;
+        }
+    }
+    *pos = i;
+    return SIZE_MAX;
+}
+#endif
+
+static inline bool
+str_byteset_has_(const StrByteSet *set, unsigned char c)
+{
+    return (set->table[(c & 15) | ((c >> 3) & 16)] >> ((c >> 4) & 7)) & 1;
+}
+
+// Byte set scans. want selects bytes in the set (true) or not in it. The
+// forward kernels return the first match or SIZE_MAX and store in *pos how
+// far they got. The reverse kernels store in *pos how many leading bytes
+// they left unscanned.
+//
+// Classification looks up the low nibble in table[0..15] (high nibble 0-7)
+// and table[16..31] (8-15). pshufb yields 0 for indices with bit 7 set,
+// which picks the right half without a blend. The high nibble selects
+// the bit.
+
+#if defined(STR_X86_DISPATCH_)
+STR_TARGET_("sse4.2") static inline unsigned
+str_set_match_sse42_(__m128i x, __m128i lo_tab, __m128i hi_tab, __m128i bits)
+{
+    __m128i idx = _mm_and_si128(x, _mm_set1_epi8((char)0x8F));
+    __m128i row = _mm_or_si128(_mm_shuffle_epi8(lo_tab, idx),
+                               _mm_shuffle_epi8(hi_tab, _mm_xor_si128(idx, _mm_set1_epi8((char)0x80))));
+    __m128i bit = _mm_shuffle_epi8(bits, _mm_and_si128(_mm_srli_epi16(x, 4), _mm_set1_epi8(0x0F)));
+    return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(row, bit), bit));
+}
+
+STR_TARGET_("sse4.2") static inline size_t
+str_set_scan_sse42_(const unsigned char *p, size_t n, const StrByteSet *set, bool want, bool reverse, size_t *pos)
+{
+    const __m128i lo_tab = _mm_loadu_si128((const __m128i *)(const void *)set->table);
+    const __m128i hi_tab = _mm_loadu_si128((const __m128i *)(const void *)(set->table + 16));
+    const __m128i bits   = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128);
+    const unsigned flip  = want ? 0 : 0xFFFFu;
+    if (!reverse) {
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(const void *)(p + i));
+            unsigned m = str_set_match_sse42_(x, lo_tab, hi_tab, bits) ^ flip;
+            if (m) return i + str_ctz64_(m);
+        }
+        *pos = i;
+    } else {
+        size_t i = n;
+        for (; i >= 16; i -= 16) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(const void *)(p + i - 16));
+            unsigned m = str_set_match_sse42_(x, lo_tab, hi_tab, bits) ^ flip;
+            if (m) return i - 16 + str_msb64_(m);
+        }
+        *pos = i;
+    }
+    return SIZE_MAX;
+}
+
+STR_TARGET_("avx2") static inline uint32_t
+str_set_match_avx2_(__m256i x, __m256i lo_tab, __m256i hi_tab, __m256i bits)
+{
+    __m256i idx = _mm256_and_si256(x, _mm256_set1_epi8((char)0x8F));
+    __m256i row = _mm256_or_si256(_mm256_shuffle_epi8(lo_tab, idx),
+                                  _mm256_shuffle_epi8(hi_tab, _mm256_xor_si256(idx, _mm256_set1_epi8((char)0x80))));
+    __m256i bit = _mm256_shuffle_epi8(bits, _mm256_and_si256(_mm256_srli_epi16(x, 4), _mm256_set1_epi8(0x0F)));
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(row, bit), bit));
+}
+
+STR_TARGET_("avx2") static inline size_t
+str_set_scan_avx2_(const unsigned char *p, size_t n, const StrByteSet *set, bool want, bool reverse, size_t *pos)
+{
+    // vpshufb looks up within each 128 bit lane, so both lanes get the tables
+    const __m256i lo_tab = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(const void *)set->table));
+    const __m256i hi_tab = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(const void *)(set->table + 16)));
+    const __m256i bits   = _mm256_broadcastsi128_si256(
+        _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128));
+    const uint32_t flip  = want ? 0 : 0xFFFFFFFFu;
+    if (!reverse) {
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(const void *)(p + i));
+            uint32_t m = str_set_match_avx2_(x, lo_tab, hi_tab, bits) ^ flip;
+            if (m) return i + str_ctz64_(m);
+        }
+        *pos = i;
+    } else {
+        size_t i = n;
+        for (; i >= 32; i -= 32) {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(const void *)(p + i - 32));
+            uint32_t m = str_set_match_avx2_(x, lo_tab, hi_tab, bits) ^ flip;
+            if (m) return i - 32 + str_msb64_(m);
+        }
+        *pos = i;
+    }
+    return SIZE_MAX;
+}
+
+STR_TARGET_("avx512f,avx512bw") static inline uint64_t
+str_set_match_avx512_(__m512i x, __m512i lo_tab, __m512i hi_tab, __m512i bits)
+{
+    __m512i idx = _mm512_and_si512(x, _mm512_set1_epi8((char)0x8F));
+    __m512i row = _mm512_or_si512(_mm512_shuffle_epi8(lo_tab, idx),
+                                  _mm512_shuffle_epi8(hi_tab, _mm512_xor_si512(idx, _mm512_set1_epi8((char)0x80))));
+    __m512i bit = _mm512_shuffle_epi8(bits, _mm512_and_si512(_mm512_srli_epi16(x, 4), _mm512_set1_epi8(0x0F)));
+    return (uint64_t)_mm512_test_epi8_mask(row, bit);
+}
+
+STR_TARGET_("avx512f,avx512bw") static inline size_t
+str_set_scan_avx512_(const unsigned char *p, size_t n, const StrByteSet *set, bool want, bool reverse, size_t *pos)
+{
+    // Tables repeated per lane through memory: GCC 12's _mm512_broadcast_i32x4
+    // trips -Wuninitialized in C++
+    unsigned char tabs[2][64];
+    for (int k = 0; k < 4; ++k) {
+        memcpy(tabs[0] + 16 * k, set->table, 16);
+        memcpy(tabs[1] + 16 * k, set->table + 16, 16);
+    }
+    const __m512i lo_tab = _mm512_loadu_si512((const void *)tabs[0]);
+    const __m512i hi_tab = _mm512_loadu_si512((const void *)tabs[1]);
+    const __m512i bits   = _mm512_set1_epi64((long long)0x8040201008040201ull);
+    const uint64_t flip  = want ? 0 : ~(uint64_t)0;
+    if (!reverse) {
+        size_t i = 0;
+        for (; i + 64 <= n; i += 64) {
+            uint64_t m = str_set_match_avx512_(_mm512_loadu_si512((const void *)(p + i)), lo_tab, hi_tab, bits) ^ flip;
+            if (m) return i + str_ctz64_(m);
+        }
+        *pos = i;
+    } else {
+        size_t i = n;
+        for (; i >= 64; i -= 64) {
+            uint64_t m = str_set_match_avx512_(_mm512_loadu_si512((const void *)(p + i - 64)), lo_tab, hi_tab, bits) ^ flip;
+            if (m) return i - 64 + str_msb64_(m);
+        }
+        *pos = i;
+    }
+    return SIZE_MAX;
+}
+#endif // STR_X86_DISPATCH_
+
+// First (or with reverse, last) index in p[0, n) whose membership in set
+// equals want, or SIZE_MAX
+static inline size_t
+str_set_scan_(const unsigned char *p, size_t n, const StrByteSet *set, bool want, bool reverse)
+{
+    // Trims and short tokens usually stop within a few bytes
+    size_t head = n < 8 ? n : 8;
+    for (size_t k = 0; k < head; ++k) {
+        size_t i = reverse ? n - 1 - k : k;
+        if (str_byteset_has_(set, p[i]) == want) return i;
+    }
+    size_t lo = reverse ? 0 : head, hi = reverse ? n - head : n;
+
+#if defined(STR_X86_DISPATCH_)
+    if (hi - lo >= 16) {
+        int level = str_simd_level_();
+        size_t pos = 0, at = SIZE_MAX;
+        if (level >= STR_SIMD_SSE42) {
+            if (level >= STR_SIMD_AVX512)    at = str_set_scan_avx512_(p + lo, hi - lo, set, want, reverse, &pos);
+            else if (level >= STR_SIMD_AVX2) at = str_set_scan_avx2_(p + lo, hi - lo, set, want, reverse, &pos);
+            else                             at = str_set_scan_sse42_(p + lo, hi - lo, set, want, reverse, &pos);
+            if (at != SIZE_MAX) return lo + at;
+            if (reverse) hi = lo + pos;
+            else         lo += pos;
+        }
+    }
+#endif
+
+    if (!reverse) {
+        for (size_t i = lo; i < hi; ++i) {
+            if (str_byteset_has_(set, p[i]) == want) return i;
+        }
+    } else {
+        for (size_t i = hi; i > lo; --i) {
+            if (str_byteset_has_(set, p[i - 1]) == want) return i - 1;
+        }
+    }
+    return SIZE_MAX;
+}
+
+// Membership of every byte as bit masks, one uint64_t per 64 bytes. For
+// callers that visit every match, where restarting a scan per match would
+// cost more than the matching itself.
+
+#if defined(STR_X86_DISPATCH_)
+STR_TARGET_("sse4.2") static inline void
+str_set_masks_sse42_(const unsigned char *p, size_t blocks, const StrByteSet *set, uint64_t *masks)
+{
+    const __m128i lo_tab = _mm_loadu_si128((const __m128i *)(const void *)set->table);
+    const __m128i hi_tab = _mm_loadu_si128((const __m128i *)(const void *)(set->table + 16));
+    const __m128i bits   = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128);
+    for (size_t b = 0; b < blocks; ++b, p += 64) {
+        uint64_t m = 0;
+        for (int k = 0; k < 4; ++k) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(const void *)(p + 16 * k));
+            m |= (uint64_t)str_set_match_sse42_(x, lo_tab, hi_tab, bits) << (16 * k);
+        }
+        masks[b] = m;
+    }
+}
+
+STR_TARGET_("avx2") static inline void
+str_set_masks_avx2_(const unsigned char *p, size_t blocks, const StrByteSet *set, uint64_t *masks)
+{
+    const __m256i lo_tab = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(const void *)set->table));
+    const __m256i hi_tab = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(const void *)(set->table + 16)));
+    const __m256i bits   = _mm256_broadcastsi128_si256(
+        _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128));
+    for (size_t b = 0; b < blocks; ++b, p += 64) {
+        uint64_t m0 = str_set_match_avx2_(_mm256_loadu_si256((const __m256i *)(const void *)p), lo_tab, hi_tab, bits);
+        uint64_t m1 = str_set_match_avx2_(_mm256_loadu_si256((const __m256i *)(const void *)(p + 32)), lo_tab, hi_tab, bits);
+        masks[b] = m0 | m1 << 32;
+    }
+}
+
+STR_TARGET_("avx512f,avx512bw") static inline void
+str_set_masks_avx512_(const unsigned char *p, size_t blocks, const StrByteSet *set, uint64_t *masks)
+{
+    unsigned char tabs[2][64];
+    for (int k = 0; k < 4; ++k) {
+        memcpy(tabs[0] + 16 * k, set->table, 16);
+        memcpy(tabs[1] + 16 * k, set->table + 16, 16);
+    }
+    const __m512i lo_tab = _mm512_loadu_si512((const void *)tabs[0]);
+    const __m512i hi_tab = _mm512_loadu_si512((const void *)tabs[1]);
+    const __m512i bits   = _mm512_set1_epi64((long long)0x8040201008040201ull);
+    for (size_t b = 0; b < blocks; ++b, p += 64) {
+        masks[b] = str_set_match_avx512_(_mm512_loadu_si512((const void *)p), lo_tab, hi_tab, bits);
+    }
+}
+#endif
+
+// Fills (n + 63) / 64 masks; bits past n are clear
+static inline void
+str_set_masks_(const unsigned char *p, size_t n, const StrByteSet *set, uint64_t *masks)
+{
+    size_t b = 0;
+#if defined(STR_X86_DISPATCH_)
+    size_t blocks = n / 64;
+    if (blocks) {
+        int level = str_simd_level_();
+        if (level >= STR_SIMD_SSE42) {
+            if (level >= STR_SIMD_AVX512)    str_set_masks_avx512_(p, blocks, set, masks);
+            else if (level >= STR_SIMD_AVX2) str_set_masks_avx2_(p, blocks, set, masks);
+            else                             str_set_masks_sse42_(p, blocks, set, masks);
+            b = blocks;
+        }
+    }
+#endif
+    for (; 64 * b < n; ++b) {
+        size_t end = n - 64 * b < 64 ? n - 64 * b : 64;
+        uint64_t m = 0;
+        for (size_t k = 0; k < end; ++k) m |= (uint64_t)str_byteset_has_(set, p[64 * b + k]) << k;
+        masks[b] = m;
+    }
+}
+
+// Translation kernels. The map is applied one row of 16 entries at a time:
+// pshufb looks up the low nibble and a compare on the high nibble picks
+// the lanes the row covers, so rows left as identity cost nothing. Blocks
+// with no removed or squeezed byte are stored whole. When only one of
+// the two drops bytes the block's mask is exact and gets packed; blocks
+// with both go through str_translate_emit_ byte by byte, since a removal
+// changes what the next byte is squeezed against. Output never runs ahead
+// of input, so storing in place only overwrites bytes already loaded.
+
+// Write y[0, w) minus the bytes flagged in drop and the squeezed repeats
+static inline size_t
+str_translate_emit_(unsigned char *out, size_t j, int *last, const unsigned char *y, size_t w,
+                    uint64_t drop, const StrTranslator *tr)
+{
+    int l = *last;
+    for (size_t k = 0; k < w; ++k) {
+        if ((drop >> k) & 1) continue;
+        unsigned char b = y[k];
+        if (b == l && str_byteset_has_(&tr->squeeze, b)) continue;
+        out[j++] = b;
+        l = b;
+    }
+    *last = l;
+    return j;
+}
+
+// Write y[0, w) minus the bytes flagged in drop, which already accounts
+// for squeezing. Branch free apart from skipping 8 byte groups with no drop.
+static inline size_t
+str_translate_pack_(unsigned char *out, size_t j, int *last, const unsigned char *y, size_t w, uint64_t drop)
+{
+    size_t start = j;
+    for (size_t k = 0; k < w; k += 8) {
+        unsigned group = (unsigned)(drop >> k) & 0xFF;
+        if (!group) {
+            memmove(out + j, y + k, 8);
+            j += 8;
+            continue;
+        }
+        for (size_t b = 0; b < 8; ++b) {
+            out[j] = y[k + b];
+            j += ((group >> b) & 1) ^ 1;
+        }
+    }
+    if (j > start) *last = out[j - 1];
+    return j;
+}
+
+#if defined(STR_X86_DISPATCH_)
+STR_TARGET_("sse4.2") static inline __m128i
+str_translate_map_sse42_(__m128i x, const StrTranslator *tr)
+{
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), _mm_set1_epi8(0x0F));
+    __m128i lo = _mm_and_si128(x, _mm_set1_epi8(0x0F));
+    for (unsigned rows = tr->rows; rows; rows &= rows - 1) {
+        unsigned h = (unsigned)str_ctz64_(rows);
+        __m128i row = _mm_loadu_si128((const __m128i *)(const void *)(tr->map + 16 * h));
+        x = _mm_blendv_epi8(x, _mm_shuffle_epi8(row, lo), _mm_cmpeq_epi8(hi, _mm_set1_epi8((char)h)));
+    }
+    return x;
+}
+
+// Translate whole blocks of p[0, n), returns the bytes consumed and stores
+// in *out how many were written
+STR_TARGET_("sse4.2") static inline size_t
+str_translate_sse42_(unsigned char *p, size_t n, const StrTranslator *tr, size_t *out, int *last)
+{
+    const __m128i rm_lo = _mm_loadu_si128((const __m128i *)(const void *)tr->remove.table);
+    const __m128i rm_hi = _mm_loadu_si128((const __m128i *)(const void *)(tr->remove.table + 16));
+    const __m128i sq_lo = _mm_loadu_si128((const __m128i *)(const void *)tr->squeeze.table);
+    const __m128i sq_hi = _mm_loadu_si128((const __m128i *)(const void *)(tr->squeeze.table + 16));
+    const __m128i bits  = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128);
+    size_t i = 0, j = *out;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(const void *)(p + i));
+        __m128i y = tr->rows ? str_translate_map_sse42_(x, tr) : x;
+        unsigned removed = tr->removes ? str_set_match_sse42_(x, rm_lo, rm_hi, bits) : 0;
+        unsigned drop = removed;
+        if (tr->squeezes && !drop) {
+            // Compare with the byte before; with nothing removed that is the
+            // previous output byte
+            __m128i prev = _mm_alignr_epi8(y, _mm_set1_epi8((char)*last), 15);
+            drop = str_set_match_sse42_(y, sq_lo, sq_hi, bits) & (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(y, prev));
+            if (*last < 0) drop &= ~1u;
+        }
+        if (!drop) {
+            _mm_storeu_si128((__m128i *)(void *)(p + j), y);
+            j += 16;
+            *last = p[j - 1];
+        } else {
+            unsigned char tmp[16];
+            _mm_storeu_si128((__m128i *)(void *)tmp, y);
+            if (removed && tr->squeezes) j = str_translate_emit_(p, j, last, tmp, 16, removed, tr);
+            else                         j = str_translate_pack_(p, j, last, tmp, 16, drop);
+        }
+    }
+    *out = j;
+    return i;
+}
+
+STR_TARGET_("avx2") static inline __m256i
+str_translate_map_avx2_(__m256i x, const StrTranslator *tr)
+{
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), _mm256_set1_epi8(0x0F));
+    __m256i lo = _mm256_and_si256(x, _mm256_set1_epi8(0x0F));
+    for (unsigned rows = tr->rows; rows; rows &= rows - 1) {
+        unsigned h = (unsigned)str_ctz64_(rows);
+        __m256i row = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(const void *)(tr->map + 16 * h)));
+        x = _mm256_blendv_epi8(x, _mm256_shuffle_epi8(row, lo), _mm256_cmpeq_epi8(hi, _mm256_set1_epi8((char)h)));
+    }
+    return x;
+}
+
+STR_TARGET_("avx2") static inline size_t
+str_translate_avx2_(unsigned char *p, size_t n, const StrTranslator *tr, size_t *out, int *last)
+{
+    const __m256i rm_lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(const void *)tr->remove.table));
+    const __m256i rm_hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(const void *)(tr->remove.table + 16)));
+    const __m256i sq_lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(const void *)tr->squeeze.table));
+    const __m256i sq_hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(const void *)(tr->squeeze.table + 16)));
+    const __m256i bits  = _mm256_broadcastsi128_si256(
+        _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128));
+    size_t i = 0, j = *out;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(const void *)(p + i));
+        __m256i y = tr->rows ? str_translate_map_avx2_(x, tr) : x;
+        uint32_t removed = tr->removes ? str_set_match_avx2_(x, rm_lo, rm_hi, bits) : 0;
+        uint32_t drop = removed;
+        if (tr->squeezes && !drop) {
+            // alignr works within 128 bit lanes, so the low lane takes its
+            // previous byte from the carried one and the high lane from y
+            __m256i carry = _mm256_permute2x128_si256(_mm256_set1_epi8((char)*last), y, 0x21);
+            __m256i prev = _mm256_alignr_epi8(y, carry, 15);
+            drop = str_set_match_avx2_(y, sq_lo, sq_hi, bits) & (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(y, prev));
+            if (*last < 0) drop &= ~1u;
+        }
+        if (!drop) {
+            _mm256_storeu_si256((__m256i *)(void *)(p + j), y);
+            j += 32;
+            *last = p[j - 1];
+        } else {
+            unsigned char tmp[32];
+            _mm256_storeu_si256((__m256i *)(void *)tmp, y);
+            if (removed && tr->squeezes) j = str_translate_emit_(p, j, last, tmp, 32, removed, tr);
+            else                         j = str_translate_pack_(p, j, last, tmp, 32, drop);
+        }
+    }
+    *out = j;
+    return i;
+}
+#endif // STR_X86_DISPATCH_
+
+// UTF-8 validation after Keiser and Lemire, "Validating UTF-8 In Less Than
+// One Instruction Per Byte". Three nibble lookups on each byte and the one
+// before it flag every two byte error pattern; a saturating subtract on the
+// bytes 2 and 3 back checks the continuation counts of 3 and 4 byte
+// sequences. The kernels only say which block failed, the scalar scan then
+// finds the exact offset.
+
+#define STR_U8_TOO_SHORT_  (1 << 0)
+#define STR_U8_TOO_LONG_   (1 << 1)
+#define STR_U8_OVERLONG_3_ (1 << 2)
+#define STR_U8_TOO_LARGE_  (1 << 3)
+#define STR_U8_SURROGATE_  (1 << 4)
+#define STR_U8_OVERLONG_2_ (1 << 5)
+#define STR_U8_TOO_LARGE_1000_ (1 << 6)
+#define STR_U8_OVERLONG_4_ (1 << 6)
+#define STR_U8_TWO_CONTS_  (1 << 7)
+#define STR_U8_CARRY_      (STR_U8_TOO_SHORT_ | STR_U8_TOO_LONG_ | STR_U8_TWO_CONTS_)
+
+// Indexed by the high nibble of the previous byte
+static const unsigned char str_u8_byte1_high_[16] = {
+    STR_U8_TOO_LONG_, STR_U8_TOO_LONG_, STR_U8_TOO_LONG_, STR_U8_TOO_LONG_,
+    STR_U8_TOO_LONG_, STR_U8_TOO_LONG_, STR_U8_TOO_LONG_, STR_U8_TOO_LONG_,
+    STR_U8_TWO_CONTS_, STR_U8_TWO_CONTS_, STR_U8_TWO_CONTS_, STR_U8_TWO_CONTS_,
+    STR_U8_TOO_SHORT_ | STR_U8_OVERLONG_2_,
+    STR_U8_TOO_SHORT_,
+    STR_U8_TOO_SHORT_ | STR_U8_OVERLONG_3_ | STR_U8_SURROGATE_,
+    STR_U8_TOO_SHORT_ | STR_U8_TOO_LARGE_ | STR_U8_TOO_LARGE_1000_ | STR_U8_OVERLONG_4_,
+};
+
+// Indexed by the low nibble of the previous byte
+static const unsigned char str_u8_byte1_low_[16] = {
+    STR_U8_CARRY_ | STR_U8_OVERLONG_3_ | STR_U8_OVERLONG_2_ | STR_U8_OVERLONG_4_,
+    STR_U8_CARRY_ | STR_U8_OVERLONG_2_,
+    STR_U8_CARRY_,
+    STR_U8_CARRY_,
+    STR_U8_CARRY_ | STR_U8_TOO_LARGE_,
+    STR_U8_CARRY_ | STR_U8_TOO_LARGE_ | STR_U8_TOO_LARGE_1000_,
+    STR_U8_CARRY_ | STR_U8_TOO_LARGE_ | STR_U8_TOO_LARGE_1000_,
+    STR_U8_CARRY_ | STR_U8_TOO_LARGE_ | STR_U8_TOO_LARGE_1000_,
+    STR_U8_CARRY_ | STR_U8_TOO_LARGE_ | STR_U8_TOO_LARGE_1000_,
+    STR_U8_CARRY_ | STR_U8_TOO_LARGE_ | STR_U8_TOO_LARGE_1000_,
+    STR_U8_CARRY_ | STR_U8_TOO_LARGE_ | STR_U8_TOO_LARGE_1000_,
+    STR_U8_CARRY_ | STR_U8_TOO_LARGE_ | STR_U8_TOO_LARGE_1000_,
+    STR_U8_CARRY_ | STR_U8_TOO_LARGE_ | STR_U8_TOO_LARGE_1000_,
+    STR_U8_CARRY_ | STR_U8_TOO_LARGE_ | STR_U8_TOO_LARGE_1000_ | STR_U8_SURROGATE_,
+    STR_U8_CARRY_ | STR_U8_TOO_LARGE_ | STR_U8_TOO_LARGE_1000_,
+    STR_U8_CARRY_ | STR_U8_TOO_LARGE_ | STR_U8_TOO_LARGE_1000_,
+};
+
+// Indexed by the high nibble of the current byte
+static const unsigned char str_u8_byte2_high_[16] = {
+    STR_U8_TOO_SHORT_, STR_U8_TOO_SHORT_, STR_U8_TOO_SHORT_, STR_U8_TOO_SHORT_,
+    STR_U8_TOO_SHORT_, STR_U8_TOO_SHORT_, STR_U8_TOO_SHORT_, STR_U8_TOO_SHORT_,
+    STR_U8_TOO_LONG_ | STR_U8_OVERLONG_2_ | STR_U8_TWO_CONTS_ | STR_U8_OVERLONG_3_ | STR_U8_TOO_LARGE_1000_ | STR_U8_OVERLONG_4_,
+    STR_U8_TOO_LONG_ | STR_U8_OVERLONG_2_ | STR_U8_TWO_CONTS_ | STR_U8_OVERLONG_3_ | STR_U8_TOO_LARGE_,
+    STR_U8_TOO_LONG_ | STR_U8_OVERLONG_2_ | STR_U8_TWO_CONTS_ | STR_U8_SURROGATE_ | STR_U8_TOO_LARGE_,
+    STR_U8_TOO_LONG_ | STR_U8_OVERLONG_2_ | STR_U8_TWO_CONTS_ | STR_U8_SURROGATE_ | STR_U8_TOO_LARGE_,
+    STR_U8_TOO_SHORT_, STR_U8_TOO_SHORT_, STR_U8_TOO_SHORT_, STR_U8_TOO_SHORT_,
+};
+
+// A block ending in one of these is an unfinished sequence: the last byte
+// a lead of any length, the one before a 3 or 4 byte lead, the one before
+// that a 4 byte lead
+static const unsigned char str_u8_incomplete_[32] = {
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0xEF, 0xDF, 0xBF,
+};
+
+// Start of the first invalid sequence at or after from, or SIZE_MAX.
+// from must be at a sequence boundary.
+static inline size_t
+str_utf8_scan_scalar_(const unsigned char *p, size_t n, size_t from)
+{
+    size_t i = from;
+    while (i < n) {
+        if (i + 8 <= n && (str_read64_(p + i) & 0x8080808080808080ull) == 0) {
+            i += 8;
+            continue;
+        }
+        unsigned char c = p[i];
+        if (c < 0x80) {
+            i++;
+            continue;
+        }
+        size_t len;
+        unsigned char lo = 0x80, hi = 0xBF; // range of the second byte
+        if (c >= 0xC2 && c <= 0xDF) {
+            len = 2;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            len = 3;
+            if (c == 0xE0) lo = 0xA0;      // overlong
+            else if (c == 0xED) hi = 0x9F; // surrogates
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            len = 4;
+            if (c == 0xF0) lo = 0x90;      // overlong
+            else if (c == 0xF4) hi = 0x8F; // above U+10FFFF
+        } else {
+            return i;
+        }
+        if (n - i < len) return i;
+        if (p[i + 1] < lo || p[i + 1] > hi) return i;
+        for (size_t k = 2; k < len; ++k) {
+            if ((p[i + k] & 0xC0) != 0x80) return i;
+        }
+        i += len;
+    }
+    return SIZE_MAX;
+}
+
+#if defined(STR_X86_DISPATCH_)
+STR_TARGET_("sse4.2") static inline __m128i
+str_utf8_block_sse42_(__m128i input, __m128i prev_input)
+{
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    __m128i prev1 = _mm_alignr_epi8(input, prev_input, 15);
+    __m128i b1h = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(const void *)str_u8_byte1_high_),
+                                   _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble));
+    __m128i b1l = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(const void *)str_u8_byte1_low_),
+                                   _mm_and_si128(prev1, nibble));
+    __m128i b2h = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(const void *)str_u8_byte2_high_),
+                                   _mm_and_si128(_mm_srli_epi16(input, 4), nibble));
+    __m128i special = _mm_and_si128(_mm_and_si128(b1h, b1l), b2h);
+
+    __m128i prev2 = _mm_alignr_epi8(input, prev_input, 14);
+    __m128i prev3 = _mm_alignr_epi8(input, prev_input, 13);
+    __m128i third  = _mm_subs_epu8(prev2, _mm_set1_epi8((char)(0xE0 - 0x80)));
+    __m128i fourth = _mm_subs_epu8(prev3, _mm_set1_epi8((char)(0xF0 - 0x80)));
+    __m128i must23 = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8((char)0x80));
+    return _mm_xor_si128(must23, special);
+}
+
+// False if the block starting at *bad_block holds or completes an error
+STR_TARGET_("sse4.2") static inline bool
+str_utf8_check_sse42_(const unsigned char *p, size_t n, size_t *bad_block)
+{
+    const __m128i incomplete_max = _mm_loadu_si128((const __m128i *)(const void *)(str_u8_incomplete_ + 16));
+    __m128i error = _mm_setzero_si128(), prev = _mm_setzero_si128(), prev_incomplete = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m128i in[4];
+        for (int k = 0; k < 4; ++k) in[k] = _mm_loadu_si128((const __m128i *)(const void *)(p + i + 16 * k));
+        __m128i any = _mm_or_si128(_mm_or_si128(in[0], in[1]), _mm_or_si128(in[2], in[3]));
+        if (_mm_movemask_epi8(any) == 0) {
+            error = _mm_or_si128(error, prev_incomplete);
+            prev_incomplete = _mm_setzero_si128();
+        } else {
+            for (int k = 0; k < 4; ++k) {
+                error = _mm_or_si128(error, str_utf8_block_sse42_(in[k], k ? in[k - 1] : prev));
+            }
+            prev_incomplete = _mm_subs_epu8(in[3], incomplete_max);
+        }
+        prev = in[3];
+        if (!_mm_testz_si128(error, error)) {
+            *bad_block = i;
+            return false;
+        }
+    }
+    // The rest, zero padded. Zeros are ASCII, so an unfinished sequence at
+    // the end shows up as too short in the block check.
+    for (; ; i += 16) {
+        unsigned char tail[16] = {0};
+        size_t rest = n > i ? n - i : 0;
+        memcpy(tail, p + i, rest < 16 ? rest : 16);
+        __m128i in = _mm_loadu_si128((const __m128i *)(const void *)tail);
+        error = _mm_or_si128(error, str_utf8_block_sse42_(in, prev));
+        prev = in;
+        if (!_mm_testz_si128(error, error)) {
+            *bad_block = i;
+            return false;
+        }
+        if (rest < 16) break;
+    }
+    return true;
+}
+
+STR_TARGET_("avx2") static inline __m256i
+str_utf8_prev_avx2_(__m256i input, __m256i prev_input, int k)
+{
+    // Bytes k back across the lane boundary: pair the low lane of input with
+    // the high lane of prev_input, then shift per lane
+    __m256i shifted = _mm256_permute2x128_si256(prev_input, input, 0x21);
+    switch (k) {
+    case 1:  return _mm256_alignr_epi8(input, shifted, 15);
+    case 2:  return _mm256_alignr_epi8(input, shifted, 14);
+    default: return _mm256_alignr_epi8(input, shifted, 13);
+    }
+}
+
+STR_TARGET_("avx2") static inline __m256i
+str_utf8_block_avx2_(__m256i input, __m256i prev_input)
+{
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i t1h = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(const void *)str_u8_byte1_high_));
+    const __m256i t1l = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(const void *)str_u8_byte1_low_));
+    const __m256i t2h = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(const void *)str_u8_byte2_high_));
+    __m256i prev1 = str_utf8_prev_avx2_(input, prev_input, 1);
+    __m256i b1h = _mm256_shuffle_epi8(t1h, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+    __m256i b1l = _mm256_shuffle_epi8(t1l, _mm256_and_si256(prev1, nibble));
+    __m256i b2h = _mm256_shuffle_epi8(t2h, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+    __m256i special = _mm256_and_si256(_mm256_and_si256(b1h, b1l), b2h);
+
+    __m256i third  = _mm256_subs_epu8(str_utf8_prev_avx2_(input, prev_input, 2), _mm256_set1_epi8((char)(0xE0 - 0x80)));
+    __m256i fourth = _mm256_subs_epu8(str_utf8_prev_avx2_(input, prev_input, 3), _mm256_set1_epi8((char)(0xF0 - 0x80)));
+    __m256i must23 = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char)0x80));
+    return _mm256_xor_si256(must23, special);
+}
+
+STR_TARGET_("avx2") static inline bool
+str_utf8_check_avx2_(const unsigned char *p, size_t n, size_t *bad_block)
+{
+    const __m256i incomplete_max = _mm256_loadu_si256((const __m256i *)(const void *)str_u8_incomplete_);
+    __m256i error = _mm256_setzero_si256(), prev = _mm256_setzero_si256(), prev_incomplete = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m256i in0 = _mm256_loadu_si256((const __m256i *)(const void *)(p + i));
+        __m256i in1 = _mm256_loadu_si256((const __m256i *)(const void *)(p + i + 32));
+        if (_mm256_movemask_epi8(_mm256_or_si256(in0, in1)) == 0) {
+            error = _mm256_or_si256(error, prev_incomplete);
+            prev_incomplete = _mm256_setzero_si256();
+        } else {
+            error = _mm256_or_si256(error, str_utf8_block_avx2_(in0, prev));
+            error = _mm256_or_si256(error, str_utf8_block_avx2_(in1, in0));
+            prev_incomplete = _mm256_subs_epu8(in1, incomplete_max);
+        }
+        prev = in1;
+        if (!_mm256_testz_si256(error, error)) {
+            *bad_block = i;
+            return false;
+        }
+    }
+    for (; ; i += 32) {
+        unsigned char tail[32] = {0};
+        size_t rest = n > i ? n - i : 0;
+        memcpy(tail, p + i, rest < 32 ? rest : 32);
+        __m256i in = _mm256_loadu_si256((const __m256i *)(const void *)tail);
+        error = _mm256_or_si256(error, str_utf8_block_avx2_(in, prev));
+        prev = in;
+        if (!_mm256_testz_si256(error, error)) {
+            *bad_block = i;
+            return false;
+        }
+        if (rest < 32) break;
+    }
+    return true;
+}
+
+// Non-continuation bytes in whole 32 byte blocks, *pos is where it stopped
+STR_TARGET_("avx2") static inline size_t
+str_utf8_count_avx2_(const unsigned char *p, size_t n, size_t *pos)
+{
+    const __m256i cont_max = _mm256_set1_epi8((char)0xBF); // continuations are -128..-65 signed
+    size_t count = 0, i = 0;
+    while (i + 32 <= n) {
+        // Byte lanes count to at most 255 before they are summed up
+        __m256i acc = _mm256_setzero_si256();
+        for (int k = 0; k < 255 && i + 32 <= n; ++k, i += 32) {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(const void *)(p + i));
+            acc = _mm256_sub_epi8(acc, _mm256_cmpgt_epi8(x, cont_max));
+        }
+        uint64_t sums[4];
+        _mm256_storeu_si256((__m256i *)(void *)sums, _mm256_sad_epu8(acc, _mm256_setzero_si256()));
+        count += (size_t)(sums[0] + sums[1] + sums[2] + sums[3]);
+    }
+    *pos = i;
+    return count;
+}
+#endif // STR_X86_DISPATCH_
+
+#if defined(STR_SSE2_)
+static inline size_t
+str_utf8_count_sse2_(const unsigned char *p, size_t n, size_t *pos)
+{
+    const __m128i cont_max = _mm_set1_epi8((char)0xBF);
+    size_t count = 0, i = 0;
+    while (i + 16 <= n) {
+        __m128i acc = _mm_setzero_si128();
+        for (int k = 0; k < 255 && i + 16 <= n; ++k, i += 16) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(const void *)(p + i));
+            acc = _mm_sub_epi8(acc, _mm_cmpgt_epi8(x, cont_max));
+        }
+        uint64_t sums[2];
+        _mm_storeu_si128((__m128i *)(void *)sums, _mm_sad_epu8(acc, _mm_setzero_si128()));
+        count += (size_t)(sums[0] + sums[1]);
+    }
+    *pos = i;
+    return count;
+}
+#endif
+
+// Offset of the first invalid sequence, or SIZE_MAX
+static inline size_t
+str_utf8_find_invalid_(const unsigned char *p, size_t n)
+{
+#if defined(STR_X86_DISPATCH_)
+    if (n >= 64) {
+        int level = str_simd_level_();
+        size_t bad = 0;
+        bool ok = true;
+        if (level >= STR_SIMD_AVX2)       ok = str_utf8_check_avx2_(p, n, &bad);
+        else if (level >= STR_SIMD_SSE42) ok = str_utf8_check_sse42_(p, n, &bad);
+        else                              return str_utf8_scan_scalar_(p, n, 0);
+        if (ok) return SIZE_MAX;
+
+        // Everything before the block was fine, except maybe a sequence
+        // starting in its last 3 bytes. Rescan from that sequence's lead.
+        size_t from = bad;
+        for (size_t k = 1; k <= 3 && k <= bad; ++k) {
+            unsigned char c = p[bad - k];
+            if ((c & 0xC0) != 0x80) {
+                if (c >= 0xC0) from = bad - k;
+                break;
+            }
+        }
+        return str_utf8_scan_scalar_(p, n, from);
+    }
+#endif
+    return str_utf8_scan_scalar_(p, n, 0);
+}
+
+// First occurrence of needle in hay[0, n), or SIZE_MAX. 1 <= nlen <= n.
+static inline size_t
+str_find_bytes_(const char *hay, size_t n, const char *needle, size_t nlen)
+{
+    if (nlen == 1) {
+        const char *p = (const char *)memchr(hay, needle[0], n);
+        return p ? (size_t)(p - hay) : SIZE_MAX;
+    }
+
+    size_t i = 0;
+#if defined(STR_X86_DISPATCH_)
+    if (n >= 64) {
+        int level = str_simd_level_();
+        size_t at = SIZE_MAX;
+        if (level >= STR_SIMD_AVX512)    at = str_find_avx512_(hay, n, needle, nlen, &i);
+        else if (level >= STR_SIMD_AVX2) at = str_find_avx2_(hay, n, needle, nlen, &i);
+        if (at != SIZE_MAX) return at;
+    }
+#endif
+#if defined(STR_SSE2_)
+    if (i == 0) {
+        size_t at = str_find_sse2_(hay, n, needle, nlen, &i);
+        if (at != SIZE_MAX) return at;
+    }
+#endif
+
+    // memchr for the first byte, then check the rest
+    size_t last = n - nlen;
+    while (i <= last) {
+        const char *p = (const char *)memchr(hay + i, needle[0], last - i + 1);
+        if (!p) break;
+        i = (size_t)(p - hay);
+        if (memcmp(p + 1, needle + 1, nlen - 1) == 0) return i;
+        i++;
+    }
+    return SIZE_MAX;
+}
+
+// Index of the first differing byte of a and b, or n if the first n match
+static inline size_t
+str_mismatch_(const unsigned char *a, const unsigned char *b, size_t n)
+{
+    size_t i = 0;
+#if defined(STR_X86_DISPATCH_)
+    if (n >= 64) {
+        int level = str_simd_level_();
+        if (level >= STR_SIMD_AVX512)    i = str_mismatch_avx512_(a, b, n);
+        else if (level >= STR_SIMD_AVX2) i = str_mismatch_avx2_(a, b, n);
+        if (i < n && a[i] != b[i]) return i;
+    }
+#endif
+#if defined(STR_SSE2_)
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(const void *)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *)(const void *)(b + i));
+        unsigned m = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) ^ 0xFFFFu;
+        if (m) return i + str_ctz64_(m);
+    }
+#endif
+#if !defined(STR_BIG_ENDIAN_)
+    for (; i + 8 <= n; i += 8) {
+        uint64_t x = str_read64_(a + i) ^ str_read64_(b + i);
+        if (x) return i + (str_ctz64_(x) >> 3);
+    }
+#endif
+    for (; i < n; ++i) {
+        if (a[i] != b[i]) return i;
+    }
+    return n;
+}
+
+static inline int
+str_compare_bytes_(const char *a, size_t an, const char *b, size_t bn)
+{
+    size_t n = an < bn ? an : bn;
+    size_t i = n ? str_mismatch_((const unsigned char *)a, (const unsigned char *)b, n) : 0;
+    if (i < n) return (unsigned char)a[i] < (unsigned char)b[i] ? -1 : 1;
+    return an < bn ? -1 : an > bn ? 1 : 0;
+}
+
+//
+// ASCII case
+//
+// Bytes in [lo, lo + 26) get bit 0x20 flipped: lo = 'A' lowers, lo = 'a'
+// uppers. The case-insensitive scans fold both sides with lo = 'A' in
+// registers and never write.
+//
+
+static inline unsigned char
+str_fold_(unsigned char c)
+{
+    return (unsigned char)((unsigned)(c - 'A') < 26u ? c ^ 0x20 : c);
+}
+
+// Eight bytes at once. Only the low 7 bits take part in the adds, so no
+// carry crosses a byte, and bytes with the high bit set are masked out.
+static inline uint64_t
+str_case_flip64_(uint64_t x, unsigned char lo)
+{
+    const uint64_t ones = 0x0101010101010101ull, high = 0x8080808080808080ull;
+    uint64_t low7 = x & ~high;
+    uint64_t ge = low7 + ones * (uint64_t)(0x80 - lo);
+    uint64_t gt = low7 + ones * (uint64_t)(0x80 - lo - 26);
+    return x ^ ((ge & ~gt & ~x & high) >> 2);
+}
+
+#if defined(STR_SSE2_)
+// Signed compare after moving lo to -128, so the range test is one cmplt
+static inline __m128i
+str_case_flip_sse2_(__m128i x, unsigned char lo)
+{
+    __m128i t = _mm_add_epi8(x, _mm_set1_epi8((char)(0x80 - lo)));
+    __m128i in = _mm_cmplt_epi8(t, _mm_set1_epi8((char)(-128 + 26)));
+    return _mm_xor_si128(x, _mm_and_si128(in, _mm_set1_epi8(0x20)));
+}
+#endif
+
+#if defined(STR_X86_DISPATCH_)
+STR_TARGET_("avx2") static inline __m256i
+str_case_flip_avx2_(__m256i x, unsigned char lo)
+{
+    __m256i t = _mm256_add_epi8(x, _mm256_set1_epi8((char)(0x80 - lo)));
+    __m256i in = _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(-128 + 26)), t);
+    return _mm256_xor_si256(x, _mm256_and_si256(in, _mm256_set1_epi8(0x20)));
+}
+
+STR_TARGET_("avx512f,avx512bw") static inline __m512i
+str_case_flip_avx512_(__m512i x, unsigned char lo)
+{
+    __mmask64 in = _mm512_cmplt_epu8_mask(_mm512_sub_epi8(x, _mm512_set1_epi8((char)lo)), _mm512_set1_epi8(26));
+    return _mm512_mask_blend_epi8(in, x, _mm512_xor_si512(x, _mm512_set1_epi8(0x20)));
+}
+#endif
+
+#if defined(STR_X86_DISPATCH_)
+// In place over whole vectors, returns the bytes done
+STR_TARGET_("avx2") static inline size_t
+str_case_apply_avx2_(unsigned char *p, size_t n, unsigned char lo)
+{
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(const void *)(p + i));
+        _mm256_storeu_si256((__m256i *)(void *)(p + i), str_case_flip_avx2_(x, lo));
+    }
+    return i;
+}
+
+STR_TARGET_("avx512f,avx512bw") static inline size_t
+str_case_apply_avx512_(unsigned char *p, size_t n, unsigned char lo)
+{
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m512i x = _mm512_loadu_si512((const void *)(p + i));
+        _mm512_storeu_si512((void *)(p + i), str_case_flip_avx512_(x, lo));
+    }
+    return i;
+}
+
+// Index of the first byte that differs after folding, in whole vectors
+STR_TARGET_("avx2") static inline size_t
+str_mismatch_icase_avx2_(const unsigned char *a, const unsigned char *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = str_case_flip_avx2_(_mm256_loadu_si256((const __m256i *)(const void *)(a + i)), 'A');
+        __m256i y = str_case_flip_avx2_(_mm256_loadu_si256((const __m256i *)(const void *)(b + i)), 'A');
+        uint32_t m = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+        if (m) return i + str_ctz64_(m);
+    }
+    return i;
+}
+
+STR_TARGET_("avx512f,avx512bw") static inline size_t
+str_mismatch_icase_avx512_(const unsigned char *a, const unsigned char *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m512i x = str_case_flip_avx512_(_mm512_loadu_si512((const void *)(a + i)), 'A');
+        __m512i y = str_case_flip_avx512_(_mm512_loadu_si512((const void *)(b + i)), 'A');
+        uint64_t m = (uint64_t)_mm512_cmpneq_epi8_mask(x, y);
+        if (m) return i + str_ctz64_(m);
+    }
+    return i;
+}
+#endif
+
+// Flip the case of ASCII letters in [lo, lo + 26)
+static inline void
+str_case_apply_(unsigned char *p, size_t n, unsigned char lo)
+{
+    size_t i = 0;
+#if defined(STR_X86_DISPATCH_)
+    if (n >= 64) {
+        int level = str_simd_level_();
+        if (level >= STR_SIMD_AVX512)    i = str_case_apply_avx512_(p, n, lo);
+        else if (level >= STR_SIMD_AVX2) i = str_case_apply_avx2_(p, n, lo);
+    }
+#endif
+#if defined(STR_SSE2_)
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(const void *)(p + i));
+        _mm_storeu_si128((__m128i *)(void *)(p + i), str_case_flip_sse2_(x, lo));
+    }
+#endif
+    for (; i + 8 <= n; i += 8) {
+        uint64_t x = str_case_flip64_(str_read64_(p + i), lo);
+        memcpy(p + i, &x, 8);
+    }
+    for (; i < n; ++i) {
+        if ((unsigned)(p[i] - lo) < 26u) p[i] ^= 0x20;
+    }
+}
+
+// str_mismatch_ with ASCII case folded
+static inline size_t
+str_mismatch_icase_(const unsigned char *a, const unsigned char *b, size_t n)
+{
+    size_t i = 0;
+#if defined(STR_X86_DISPATCH_)
+    if (n >= 64) {
+        int level = str_simd_level_();
+        if (level >= STR_SIMD_AVX512)    i = str_mismatch_icase_avx512_(a, b, n);
+        else if (level >= STR_SIMD_AVX2) i = str_mismatch_icase_avx2_(a, b, n);
+        if (i < n && str_fold_(a[i]) != str_fold_(b[i])) return i;
+    }
+#endif
+#if defined(STR_SSE2_)
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = str_case_flip_sse2_(_mm_loadu_si128((const __m128i *)(const void *)(a + i)), 'A');
+        __m128i y = str_case_flip_sse2_(_mm_loadu_si128((const __m128i *)(const void *)(b + i)), 'A');
+        unsigned m = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) ^ 0xFFFFu;
+        if (m) return i + str_ctz64_(m);
+    }
+#endif
+#if !defined(STR_BIG_ENDIAN_)
+    for (; i + 8 <= n; i += 8) {
+        uint64_t x = str_case_flip64_(str_read64_(a + i), 'A') ^ str_case_flip64_(str_read64_(b + i), 'A');
+        if (x) return i + (str_ctz64_(x) >> 3);
+    }
+#endif
+    for (; i < n; ++i) {
+        if (str_fold_(a[i]) != str_fold_(b[i])) return i;
+    }
+    return n;
+}
+
+#if defined(STR_X86_DISPATCH_)
+// Same filter as str_find_avx2_ on folded blocks, from *pos on
+STR_TARGET_("avx2") static inline size_t
+str_find_icase_avx2_(const unsigned char *hay, size_t n, const unsigned char *needle, size_t nlen, size_t *pos)
+{
+    const __m256i first = _mm256_set1_epi8((char)str_fold_(needle[0]));
+    const __m256i last  = _mm256_set1_epi8((char)str_fold_(needle[nlen - 1]));
+    size_t i = *pos;
+    for (; i + nlen - 1 + 32 <= n; i += 32) {
+        __m256i b0 = str_case_flip_avx2_(_mm256_loadu_si256((const __m256i *)(const void *)(hay + i)), 'A');
+        __m256i b1 = str_case_flip_avx2_(_mm256_loadu_si256((const __m256i *)(const void *)(hay + i + nlen - 1)), 'A');
+        uint32_t m = (uint32_t)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(b0, first), _mm256_cmpeq_epi8(b1, last)));
+        while (m) {
+            size_t at = i + str_ctz64_(m);
+            if (str_mismatch_icase_(hay + at + 1, needle + 1, nlen - 1) == nlen - 1) return at;
+            m &= m - 1;
+        }
+    }
+    *pos = i;
+    return SIZE_MAX;
+}
+
+STR_TARGET_("avx512f,avx512bw") static inline size_t
+str_find_icase_avx512_(const unsigned char *hay, size_t n, const unsigned char *needle, size_t nlen, size_t *pos)
+{
+    const __m512i first = _mm512_set1_epi8((char)str_fold_(needle[0]));
+    const __m512i last  = _mm512_set1_epi8((char)str_fold_(needle[nlen - 1]));
+    size_t i = *pos;
+    for (; i + nlen - 1 + 64 <= n; i += 64) {
+        __m512i b0 = str_case_flip_avx512_(_mm512_loadu_si512((const void *)(hay + i)), 'A');
+        __m512i b1 = str_case_flip_avx512_(_mm512_loadu_si512((const void *)(hay + i + nlen - 1)), 'A');
+        uint64_t m = (uint64_t)(_mm512_cmpeq_epi8_mask(b0, first) & _mm512_cmpeq_epi8_mask(b1, last));
+        while (m) {
+            size_t at = i + str_ctz64_(m);
+            if (str_mismatch_icase_(hay + at + 1, needle + 1, nlen - 1) == nlen - 1) return at;
+            m &= m - 1;
+        }
+    }
+    *pos = i;
+    return SIZE_MAX;
+}
+#endif
+
+// First case-insensitive occurrence of needle in hay[0, n), or SIZE_MAX.
+// 1 <= nlen <= n.
+static inline size_t
+str_find_icase_bytes_(const unsigned char *hay, size_t n, const unsigned char *needle, size_t nlen)
+{
+    size_t i = 0;
+#if defined(STR_X86_DISPATCH_)
+    if (n >= 64) {
+        int level = str_simd_level_();
+        size_t at = SIZE_MAX;
+        if (level >= STR_SIMD_AVX512)    at = str_find_icase_avx512_(hay, n, needle, nlen, &i);
+        else if (level >= STR_SIMD_AVX2) at = str_find_icase_avx2_(hay, n, needle, nlen, &i);
+        if (at != SIZE_MAX) return at;
+    }
+#endif
+#if defined(STR_SSE2_)
+    {
+        const __m128i first = _mm_set1_epi8((char)str_fold_(needle[0]));
+        const __m128i last  = _mm_set1_epi8((char)str_fold_(needle[nlen - 1]));
+        for (; i + nlen - 1 + 16 <= n; i += 16) {
+            __m128i b0 = str_case_flip_sse2_(_mm_loadu_si128((const __m128i *)(const void *)(hay + i)), 'A');
+            __m128i b1 = str_case_flip_sse2_(_mm_loadu_si128((const __m128i *)(const void *)(hay + i + nlen - 1)), 'A');
+            unsigned m = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(b0, first), _mm_cmpeq_epi8(b1, last)));
+            while (m) {
+                size_t at = i + str_ctz64_(m);
+                if (str_mismatch_icase_(hay + at + 1, needle + 1, nlen - 1) == nlen - 1) return at;
+                m &= m - 1;
+            }
+        }
+    }
+#endif
+    unsigned char first = str_fold_(needle[0]);
+    for (; i + nlen <= n; ++i) {
+        if (str_fold_(hay[i]) == first && str_mismatch_icase_(hay + i + 1, needle + 1, nlen - 1) == nlen - 1) {
+            return i;
+        }
+    }
+    return SIZE_MAX;
+}
+
+STRDEF String
+str_init(STR_NO_PARAMS) STR_NOEXCEPT
+{
+    String result = {STR_NULL, 0, 0};
+
+    char *p = (char *)STR_REALLOC(STR_NULL, 1);
+    if (p) {
+        STR_STATS_ALLOC_(1);
+        p[0] = '\0';
+        result.buffer = p;
+        result.capacity = 1;
+        result.size = 0;
+    }
+
+    return result;
+}
+
+STRDEF bool
+str_clone(const String *src, String *dst) STR_NOEXCEPT
+{
     if (src == dst) return true;
 
-    if (!dst) return false;
+    if (!dst) return false;
+
+    str_clear(dst);
+
+    if (!src) return true;
+    if (src->size == 0) return true;
+
+    if (!str_reserve(dst, src->size)) return false;
+    memcpy(dst->buffer, src->buffer, src->size + 1); // include '\0'
+    dst->size = src->size;
+    return true;
+}
+
+STRDEF String
+str_move(String *from) STR_NOEXCEPT
+{
+    if (!from) {
+        return str_init();
+    }
+
+    String result = *from;
+
+    *from = str_init();
+    return result;
+}
+
+STRDEF void
+str_clear(String *str) STR_NOEXCEPT
+{
+    if (!str) return;
+
+    str->size = 0;
+
+    if (str->buffer) {
+        str->buffer[0] = '\0';
+    } else {
+        char *p = (char *)STR_REALLOC(STR_NULL, 1);
+        if (p) {
+            STR_STATS_ALLOC_(1);
+            p[0] = '\0';
+            str->buffer = p;
+            str->capacity = 1;
+            str->size = 0;
+        }
+    }
+}
+
+STRDEF void
+str_free(String *str) STR_NOEXCEPT
+{
+    if (!str) return;
+
+    STR_FREE(str->buffer);
+    str->buffer   = STR_NULL;
+    str->capacity = 0;
+    str->size     = 0;
+}
+
+STRDEF char *
+str_strdup(const String *str, size_t *out_len) STR_NOEXCEPT
+{
+    size_t len = (str && str->buffer) ? str->size : 0;
+
+    if (len + 1 < len) return STR_NULL; // Overflow protection
+
+    char *buf = (char *)STR_REALLOC(STR_NULL, len + 1);
+    if (!buf) return STR_NULL;
+    STR_STATS_ALLOC_(len + 1);
+
+    if (len) memcpy(buf, str->buffer, len);
+    buf[len] = '\0';
+
+    if (out_len) *out_len = len;
+    return buf;
+}
+
+STRDEF char *
+str_release(String *str, size_t *out_len) STR_NOEXCEPT
+{
+    if (!str) return STR_NULL;
+
+    if (!str->buffer) {
+        char *z = (char *)STR_REALLOC(STR_NULL, 1);
+        if (!z) return STR_NULL;
+        STR_STATS_ALLOC_(1);
+        z[0] = '\0';
+        if (out_len) *out_len = 0;
+        return z;
+    }
+
+    str->buffer[str->size] = '\0';
+
+    if (out_len) *out_len = str->size;
+    char *result = str->buffer;
+
+    str->buffer   = STR_NULL;
+    str->capacity = 0;
+    str->size     = 0;
+
+    return result;
+}
+
+STRDEF char *
+str_shrink_and_release(String *str, size_t *out_len) STR_NOEXCEPT
+{
+    if (!str) return STR_NULL;
+
+    if (!str->buffer) {
+        char *z = (char *)STR_REALLOC(STR_NULL, 1);
+        if (!z) return STR_NULL;
+        STR_STATS_ALLOC_(1);
+        z[0] = '\0';
+        if (out_len) *out_len = 0;
+        return z;
+    }
+
+    size_t need = str->size + 1;
+    if (need < str->size) return STR_NULL; // Overflow protection
+
+    void *p = STR_REALLOC(str->buffer, need);
+    if (p) {
+        STR_STATS_REALLOC_(need);
+        str->buffer   = (char *)p;
+        str->capacity = need;
+        str->buffer[str->size] = '\0';
+    } else {
+        str->buffer[str->size] = '\0';
+    }
+
+    if (out_len) *out_len = str->size;
+    char *result = str->buffer;
+
+    str->buffer   = STR_NULL;
+    str->capacity = 0;
+    str->size     = 0;
+
+    return result;
+}
+
+STRDEF bool
+str_shrink_to_fit(String *str) STR_NOEXCEPT
+{
+    if (!str) return false;
+    if (!str->buffer) return true;
+
+    if (str->capacity == str->size + 1) {
+        str->buffer[str->size] = '\0';
+        return true;
+    }
+
+    size_t need = str->size + 1;
+    if (need < str->size) return false; // Overflow protection
+
+    void *p = STR_REALLOC(str->buffer, need);
+    if (!p) return false;
+    STR_STATS_REALLOC_(need);
+
+    str->buffer   = (char *)p;
+    str->capacity = need;
+    str->buffer[str->size] = '\0';
+    return true;
+}
+
+static inline bool
+str_would_overflow_(size_t a, size_t b)
+{
+    return b > SIZE_MAX - a;
+}
+
+//
+// Large blocks
+//
+// With STR_LARGE_ALLOC every block starts with a 16 byte header. mapped is
+// the length of the anonymous mapping, or 0 for a malloc block, so free
+// and realloc know which way a block was made.
+//
+
+#if defined(STR_LARGE_ALLOC_)
+
+typedef struct {
+    size_t mapped; // bytes mapped including the header, 0 when malloc'd
+    size_t size;   // bytes asked for, excluding the header
+} StrLargeHeader_;
+
+// The rest of the last page is capacity too
+static inline size_t
+str_large_usable_(const void *ptr)
+{
+    const StrLargeHeader_ *h = (const StrLargeHeader_ *)ptr - 1;
+    return h->mapped ? h->mapped - sizeof(StrLargeHeader_) : h->size;
+}
+
+#if defined(STR_LARGE_MMAP_)
+#if !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+static inline size_t
+str_large_page_(void)
+{
+    static size_t page;
+    if (!page) page = (size_t)sysconf(_SC_PAGESIZE);
+    return page;
+}
+
+static inline void *
+str_large_map_(size_t len)
+{
+    void *p = mmap(STR_NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return p == MAP_FAILED ? STR_NULL : p;
+}
+#endif
+
+STRDEF void *
+str_large_realloc(void *ptr, size_t size) STR_NOEXCEPT
+{
+    const size_t hdr = sizeof(StrLargeHeader_);
+    if (size > SIZE_MAX / 2) return STR_NULL; // Overflow protection
+    StrLargeHeader_ *old = ptr ? (StrLargeHeader_ *)ptr - 1 : STR_NULL;
+    StrLargeHeader_ *h;
+
+#if defined(STR_LARGE_MMAP_)
+    // Callers may use the whole usable size, so that is what moves
+    size_t keep = old && str_large_usable_(ptr) < size ? str_large_usable_(ptr) : size;
+    // Mapped blocks stay mapped down to half the threshold, so a String
+    // hovering around it does not bounce between the two kinds
+    if (hdr + size >= STR_LARGE_THRESHOLD || (old && old->mapped && hdr + size >= STR_LARGE_THRESHOLD / 2)) {
+        size_t page = str_large_page_();
+        size_t len = (hdr + size + page - 1) & ~(page - 1);
+        if (old && old->mapped) {
+            if (len == old->mapped) {
+                h = old;
+            } else {
+#if defined(MREMAP_MAYMOVE)
+                void *p = mremap(old, old->mapped, len, MREMAP_MAYMOVE);
+                if (p == MAP_FAILED) return STR_NULL;
+                h = (StrLargeHeader_ *)p;
+#else
+                if (len < old->mapped) {
+                    munmap((char *)old + len, old->mapped - len);
+                    h = old;
+                } else {
+                    h = (StrLargeHeader_ *)str_large_map_(len);
+                    if (!h) return STR_NULL;
+                    memcpy(h, old, hdr + keep);
+                    munmap(old, old->mapped);
+                }
+#endif
+            }
+        } else {
+            h = (StrLargeHeader_ *)str_large_map_(len);
+            if (!h) return STR_NULL;
+            if (old) {
+                memcpy(h + 1, old + 1, keep);
+                free(old);
+            }
+        }
+#if defined(STR_LARGE_HUGEPAGES) && defined(MADV_HUGEPAGE)
+        madvise(h, len, MADV_HUGEPAGE);
+#endif
+        h->mapped = len;
+        h->size   = size;
+        return h + 1;
+    }
+
+    if (old && old->mapped) {
+        h = (StrLargeHeader_ *)malloc(hdr + size);
+        if (!h) return STR_NULL;
+        memcpy(h + 1, old + 1, keep);
+        munmap(old, old->mapped);
+        h->mapped = 0;
+        h->size   = size;
+        return h + 1;
+    }
+#endif
+
+    h = (StrLargeHeader_ *)realloc(old, hdr + size);
+    if (!h) return STR_NULL;
+    h->mapped = 0;
+    h->size   = size;
+    return h + 1;
+}
+
+STRDEF void
+str_large_free(void *ptr) STR_NOEXCEPT
+{
+    if (!ptr) return;
+    StrLargeHeader_ *h = (StrLargeHeader_ *)ptr - 1;
+#if defined(STR_LARGE_MMAP_)
+    if (h->mapped) {
+        munmap(h, h->mapped);
+        return;
+    }
+#endif
+    free(h);
+}
+
+#if !defined(STR_USABLE_SIZE) && !defined(STR_NO_USABLE_SIZE)
+#define STR_USABLE_SIZE(ptr) str_large_usable_(ptr)
+#endif
+
+#endif // STR_LARGE_ALLOC_
+
+//
+// Growth policies
+//
+
+static STR_THREAD_LOCAL_ StrGrowth str_growth_ = {STR_GROWTH_DEFAULT, 0, 0, 0};
+
+STRDEF StrGrowth
+str_growth_set(const StrGrowth *policy) STR_NOEXCEPT
+{
+    StrGrowth prev = str_growth_;
+    if (policy) {
+        str_growth_ = *policy;
+    } else {
+        str_growth_.kind      = STR_GROWTH_DEFAULT;
+        str_growth_.start     = 0;
+        str_growth_.threshold = 0;
+        str_growth_.step      = 0;
+    }
+    return prev;
+}
+
+STRDEF StrGrowth
+str_growth_get(STR_NO_PARAMS) STR_NOEXCEPT
+{
+    return str_growth_;
+}
+
+// cap plus cap * num / 1024, at least cap + 1, saturating
+static inline size_t
+str_grow_by_(size_t cap, size_t num)
+{
+    size_t add = (cap >> 10) * num + (((cap & 1023) * num) >> 10);
+    if (add == 0) add = 1;
+    return str_would_overflow_(cap, add) ? SIZE_MAX : cap + add; // Overflow protection
+}
+
+STRDEF size_t
+str_growth_next(const StrGrowth *policy, size_t capacity, size_t need) STR_NOEXCEPT
+{
+    StrGrowthKind kind = policy ? policy->kind : STR_GROWTH_DEFAULT;
+    size_t start = policy && policy->start ? policy->start : STR_START_SIZE;
+    size_t cap = capacity ? capacity : (start > 1 ? start : 1);
+
+    switch (kind) {
+    case STR_GROWTH_EXPONENTIAL:
+        while (cap < need) cap = str_grow_by_(cap, 1024);
+        break;
+    case STR_GROWTH_GOLDEN:
+        while (cap < need) cap = str_grow_by_(cap, 633);
+        break;
+    case STR_GROWTH_PROPORTIONAL:
+        while (cap < need) cap = str_grow_by_(cap, 512);
+        break;
+    case STR_GROWTH_PAGE:
+        while (cap < need) cap = str_grow_by_(cap, 512);
+        if (cap > SIZE_MAX - 4095) return SIZE_MAX; // Overflow protection
+        cap = (cap + 4095) & ~(size_t)4095;
+        break;
+    case STR_GROWTH_DEFAULT:
+    default: {
+        size_t threshold = policy && policy->threshold ? policy->threshold : STR_LIN_THRESHOLD;
+        size_t step = policy && policy->step ? policy->step : STR_LIN_GROWTH_FACTOR;
+
+        // Exponential growth until threshold
+        while (cap < need && cap < threshold) {
+            if (cap > SIZE_MAX / STR_EXP_GROWTH_FACTOR) { cap = SIZE_MAX; break; } // Overflow protection
+            cap *= STR_EXP_GROWTH_FACTOR;
+        }
+
+        // Linear growth after threshold
+        while (cap < need) {
+            if (cap > SIZE_MAX - step) { cap = SIZE_MAX; break; } // Overflow protection
+            cap += step;
+        }
+        break;
+    }
+    }
+    return cap;
+}
+
+static inline bool
+str_grow_to_fit_(String *str, size_t n) STR_NOEXCEPT
+{
+    if (!str) return false;
+
+    size_t np1 = n + 1; // 'n plus 1' to account for trailing NUL-terminator
+    if (np1 < n) return false; // Overflow protection
+
+    if (str->buffer && np1 <= str->capacity) {
+        return true;
+    }
+
+    size_t new_cap = str_growth_next(&str_growth_, str->capacity, np1);
+
+    void *new_buffer = STR_REALLOC(str->buffer, new_cap);
+    if (!new_buffer) {
+        return false;
+    }
+
+#if defined(STR_USABLE_SIZE) && !defined(STR_NO_USABLE_SIZE)
+    size_t usable = (size_t)STR_USABLE_SIZE(new_buffer);
+    if (usable > new_cap) new_cap = usable;
+#endif
+
+    if (str->buffer) {
+        STR_STATS_REALLOC_(new_cap);
+    } else {
+        STR_STATS_ALLOC_(new_cap);
+    }
+    STR_STATS_SLACK_(new_cap - np1);
+
+    str->buffer = (char *)new_buffer;
+    str->capacity = new_cap;
+
+    str->buffer[str->size] = '\0';
+
+    return true;
+}
+
+STRDEF bool
+str_reserve(String *str, size_t new_len) STR_NOEXCEPT
+{
+    if (!str) return false;
+    if (!str_grow_to_fit_(str, new_len)) return false;
+    str->buffer[str->size] = '\0';
+    return true;
+}
+
+STRDEF bool
+str_append_one_n(String *str, const char *cstr, size_t len) STR_NOEXCEPT
+{
+    if (!str || (!cstr && len)) return false;
+
+    if (str_would_overflow_(str->size, len)) return false;
+    if (!str_grow_to_fit_(str, str->size + len)) return false;
+
+    if (len) memcpy(str->buffer + str->size, cstr, len);
+    str->size += len;
+    str->buffer[str->size] = '\0';
+
+    return true;
+}
+
+STRDEF bool
+str_append_one(String *str, const char *cstr) STR_NOEXCEPT
+{
+    if (!str || !cstr) return false;
+    size_t len = strlen(cstr);
+    return str_append_one_n(str, cstr, len);
+}
+
+STRDEF bool
+str_append_(String *str, const char *new_data1, ...) STR_NOEXCEPT
+{
+    if (!str) return false;
+
+    // Measure everything first so str grows once. The first lengths are
+    // kept for the copy, any beyond those are measured again
+    size_t lens[16];
+    size_t total = 0, count = 0;
+    bool ok = true;
+
+    va_list args;
+    va_start(args, new_data1);
+    for (const char *data = new_data1; data != STR_NULL; data = va_arg(args, const char *)) {
+        size_t len = strlen(data);
+        if (count < 16) lens[count] = len;
+        count++;
+        if (str_would_overflow_(total, len)) ok = false; // Overflow protection
+        else total += len;
+    }
+    va_end(args);
+
+    if (!ok || str_would_overflow_(str->size, total)) return false;
+    if (!str_grow_to_fit_(str, str->size + total)) return false;
+
+    va_start(args, new_data1);
+    size_t i = 0;
+    for (const char *data = new_data1; data != STR_NULL; data = va_arg(args, const char *), ++i) {
+        size_t len = i < 16 ? lens[i] : strlen(data);
+        memcpy(str->buffer + str->size, data, len);
+        str->size += len;
+    }
+    va_end(args);
+
+    str->buffer[str->size] = '\0';
+    return true;
+}
+
+STRDEF bool
+str_append_char(String *str, char c) STR_NOEXCEPT
+{
+    if (!str) return false;
+    if (str_would_overflow_(str->size, 1)) return false;
+    if (!str_grow_to_fit_(str, str->size + 1)) return false;
+    str->buffer[str->size++] = c;
+    str->buffer[str->size] = '\0';
+    return true;
+}
+
+STRDEF char *
+str_spare(String *str, size_t min_len, size_t *avail) STR_NOEXCEPT
+{
+    if (avail) *avail = 0;
+    if (!str) return STR_NULL;
+
+    if (str_would_overflow_(str->size, min_len)) return STR_NULL;
+    if (!str_grow_to_fit_(str, str->size + min_len)) return STR_NULL;
+
+    if (avail) *avail = str->capacity - str->size - 1;
+    return str->buffer + str->size;
+}
+
+STRDEF bool
+str_commit(String *str, size_t n) STR_NOEXCEPT
+{
+    if (!str) return false;
+    if (!str->buffer) return n == 0;
+    if (n > str->capacity - str->size - 1) return false;
+
+    str->size += n;
+    str->buffer[str->size] = '\0';
+    return true;
+}
+
+STRDEF bool
+str_append_repeat(String *str, char c, size_t n) STR_NOEXCEPT
+{
+    if (!str) return false;
+    if (n == 0) return true;
+    if (str_would_overflow_(str->size, n)) return false;
+    if (!str_grow_to_fit_(str, str->size + n)) return false;
+
+    memset(str->buffer + str->size, (unsigned char)c, n);
+    str->size += n;
+    str->buffer[str->size] = '\0';
+    return true;
+}
+
+STRDEF bool
+str_append_str(String *str, const String *app) STR_NOEXCEPT
+{
+    if (!str) return false;
+    if (!app || app->size == 0) return true;
+
+    if (str == app) {
+        size_t len = str->size;
+        if (!str_grow_to_fit_(str, str->size + len)) return false;
+        // source and destination are the same allocation, so use memmove
+        memmove(str->buffer + str->size, str->buffer, len);
+        str->size += len;
+        str->buffer[str->size] = '\0';
+        return true;
+    }
+
+    return str_append_one_n(str, app->buffer, app->size);
+}
+
+STRDEF bool
+str_vappendf(String *str, const char *fmt, va_list args) STR_NOEXCEPT
+{
+    if (!str || !fmt) return false;
+
+    va_list ap;
+    va_copy(ap, args);
+    int need = vsnprintf(STR_NULL, 0, fmt, ap);
+    va_end(ap);
+    if (need < 0) return false;
+
+    if (!str_grow_to_fit_(str, str->size + (size_t)need)) return false;
+
+    va_copy(ap, args);
+    vsnprintf(str->buffer + str->size, (size_t)need + 1, fmt, ap);
+    va_end(ap);
+
+    str->size += (size_t)need;
+    str->buffer[str->size] = '\0';
+    return true;
+}
+
+STRDEF bool
+str_appendf(String *str, const char *fmt, ...) STR_NOEXCEPT
+{
+    if (!str || !fmt) return false;
+    va_list args;
+    va_start(args, fmt);
+    bool ok = str_vappendf(str, fmt, args);
+    va_end(args);
+    return ok;
+}
+
+typedef enum { STR_JOIN_STRS_, STR_JOIN_SLICES_, STR_JOIN_CSTRS_ } StrJoinKind_;
+
+static inline StrSlice
+str_join_piece_(const void *items, size_t i, StrJoinKind_ kind)
+{
+    StrSlice piece;
+    if (kind == STR_JOIN_STRS_) {
+        const String *str = (const String *)items + i;
+        piece.data = str->buffer;
+        piece.size = str->buffer ? str->size : 0;
+    } else if (kind == STR_JOIN_SLICES_) {
+        piece = ((const StrSlice *)items)[i];
+    } else {
+        piece.data = ((const char *const *)items)[i];
+        piece.size = piece.data ? strlen(piece.data) : 0;
+    }
+    return piece;
+}
+
+static inline bool
+str_join_(String *out, const void *items, size_t n, const char *sep, StrJoinKind_ kind)
+{
+    if (!out || (!items && n)) return false;
+
+    size_t slen = sep ? strlen(sep) : 0;
+    size_t orig = out->size;
+
+    // One pass for the total, so out grows once
+    size_t total = 0;
+    for (size_t i = 0; i < n; ++i) {
+        StrSlice piece = str_join_piece_(items, i, kind);
+        if (!piece.data && (piece.size || kind == STR_JOIN_CSTRS_)) return false;
+        if (str_would_overflow_(total, piece.size)) return false; // Overflow protection
+        total += piece.size;
+        if (i + 1 < n) {
+            if (str_would_overflow_(total, slen)) return false; // Overflow protection
+            total += slen;
+        }
+    }
+    if (str_would_overflow_(orig, total)) return false;
+    if (!str_grow_to_fit_(out, orig + total)) return false;
+
+    char *dst = out->buffer + orig;
+    for (size_t i = 0; i < n; ++i) {
+        StrSlice piece;
+        if (kind == STR_JOIN_STRS_ && (const String *)items + i == out) {
+            // out itself: its old bytes are still in place at the front
+            piece.data = out->buffer;
+            piece.size = orig;
+        } else {
+            piece = str_join_piece_(items, i, kind);
+        }
+        if (piece.size) memcpy(dst, piece.data, piece.size);
+        dst += piece.size;
+        if (slen && i + 1 < n) {
+            memcpy(dst, sep, slen);
+            dst += slen;
+        }
+    }
+
+    out->size = orig + total;
+    out->buffer[out->size] = '\0';
+    return true;
+}
+
+STRDEF bool
+str_join(String *out, const String *strs, size_t n, const char *sep) STR_NOEXCEPT
+{
+    return str_join_(out, strs, n, sep, STR_JOIN_STRS_);
+}
+
+STRDEF bool
+str_join_slices(String *out, const StrSlice *slices, size_t n, const char *sep) STR_NOEXCEPT
+{
+    return str_join_(out, slices, n, sep, STR_JOIN_SLICES_);
+}
+
+STRDEF bool
+str_join_cstrs(String *out, const char *const *cstrs, size_t n, const char *sep) STR_NOEXCEPT
+{
+    return str_join_(out, cstrs, n, sep, STR_JOIN_CSTRS_);
+}
+
+STRDEF bool
+str_insert_one_n(String *str, size_t pos, const char *cstr, size_t len) STR_NOEXCEPT
+{
+    if (!str) return false;
+    if (pos > str->size) return false;
+    if (!cstr && len) return false;
+    if (len == 0) return true;
+
+    if (str_would_overflow_(str->size, len)) return false;
+    if (!str_grow_to_fit_(str, str->size + len)) return false;
+
+    size_t tail = str->size - pos;
+    memmove(str->buffer + pos + len, str->buffer + pos, tail);
+    STR_STATS_MOVE_(tail);
+    if (len) memcpy(str->buffer + pos, cstr, len);
+
+    str->size += len;
+    str->buffer[str->size] = '\0';
+    return true;
+}
+
+STRDEF bool
+str_insert_one(String *str, size_t pos, const char *cstr) STR_NOEXCEPT
+{
+    if (!str || !cstr) return false;
+    size_t len = strlen(cstr);
+    return str_insert_one_n(str, pos, cstr, len);
+}
+
+STRDEF bool
+str_erase(String *str, size_t pos, size_t len) STR_NOEXCEPT
+{
+    if (!str) return false;
+    if (pos > str->size) return false;
+    if (len == 0) return true;
+
+    size_t remain = str->size - pos;
+    if (len > remain) len = remain;
+
+    size_t end  = pos + len;
+    size_t tail = str->size - end;
+
+    if (tail) memmove(str->buffer + pos, str->buffer + end, tail);
+    STR_STATS_MOVE_(tail);
+
+    str->size -= len;
+    str->buffer[str->size] = '\0';
+    return true;
+}
+
+STRDEF bool
+str_replace_one_n(String *str, size_t pos, size_t len, const char *cstr, size_t slen) STR_NOEXCEPT
+{
+    if (!str) return false;
+    if (pos > str->size) return false;
+    if (!cstr && slen) return false;
+
+    // Calculate target end after erase
+    size_t end = pos + len;
+    if (end > str->size) end = str->size;
+    size_t cut = end - pos;
+
+    // Resize to new total size
+    size_t tmp = str->size - cut;
+    if (str_would_overflow_(tmp, slen)) return false;
+    size_t new_size = tmp + slen;
+    if (!str_grow_to_fit_(str, new_size)) return false;
+
+    // Move tail to its new position if needed
+    size_t old_tail = str->size - end;
+    if (old_tail && (slen != cut)) {
+        memmove(str->buffer + pos + slen, str->buffer + end, old_tail);
+        STR_STATS_MOVE_(old_tail);
+    }
+
+    if (slen) memcpy(str->buffer + pos, cstr, slen);
+
+    str->size = new_size;
+    str->buffer[str->size] = '\0';
+    return true;
+}
+
+STRDEF bool
+str_replace_one(String *str, size_t pos, size_t len, const char *cstr) STR_NOEXCEPT
+{
+    if (!str) return false;
+    size_t slen = strlen(cstr);
+    return str_replace_one_n(str, pos, len, cstr, slen);
+}
+
+STRDEF bool
+str_back(const String *str, char *out_char) STR_NOEXCEPT
+{
+    if (!str || str->size == 0) return false;
+    if (out_char) *out_char = str->buffer[str->size - 1];
+    return true;
+}
+
+STRDEF bool
+str_pop_back(String *str, char *out_char) STR_NOEXCEPT
+{
+    if (!str || str->size == 0) return false;
+    if (out_char) *out_char = str->buffer[str->size - 1];
+    str->size -= 1;
+    str->buffer[str->size] = '\0';
+    return true;
+}
+
+STRDEF bool
+str_ltrim(String *str) STR_NOEXCEPT
+{
+    if (!str || str->size == 0) return true;
+
+    StrByteSet space = str_byteset_space();
+    size_t i = str_span(str, &space);
+
+    if (i == 0) return true;
+    size_t remain = str->size - i;
+    memmove(str->buffer, str->buffer + i, remain);
+    STR_STATS_MOVE_(remain);
+    str->size = remain;
+    str->buffer[str->size] = '\0';
+    return true;
+}
+
+STRDEF bool
+str_rtrim(String *str) STR_NOEXCEPT
+{
+    if (!str || str->size == 0) return true;
+
+    StrByteSet space = str_byteset_space();
+    size_t i = str_find_last_not_of(str, &space) + 1; // SIZE_MAX + 1 wraps to 0
+
+    if (i == str->size) return true;
+    str->size = i;
+    str->buffer[str->size] = '\0';
+    return true;
+}
+
+STRDEF bool
+str_trim(String *str) STR_NOEXCEPT
+{
+    if (!str) return false;
+    bool ok = str_rtrim(str);
+    if (!ok) return false;
+    return str_ltrim(str);
+}
+
+STRDEF StrByteSet
+str_byteset_n(const char *bytes, size_t len) STR_NOEXCEPT
+{
+    StrByteSet set;
+    memset(&set, 0, sizeof(set));
+    if (!bytes) return set;
+    for (size_t i = 0; i < len; ++i) str_byteset_add(&set, (unsigned char)bytes[i]);
+    return set;
+}
+
+STRDEF StrByteSet
+str_byteset(const char *bytes) STR_NOEXCEPT
+{
+    return str_byteset_n(bytes, bytes ? strlen(bytes) : 0);
+}
+
+STRDEF StrByteSet
+str_byteset_space(STR_NO_PARAMS) STR_NOEXCEPT
+{
+    // ' ' is row 0 bit 2, '\t' to '\r' are rows 9-13 bit 0
+    static const StrByteSet space = {{4, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1}};
+    return space;
+}
+
+STRDEF void
+str_byteset_add(StrByteSet *set, unsigned char c) STR_NOEXCEPT
+{
+    if (!set) return;
+    set->table[(c & 15) | ((c >> 3) & 16)] |= (unsigned char)(1u << ((c >> 4) & 7));
+}
+
+STRDEF void
+str_byteset_invert(StrByteSet *set) STR_NOEXCEPT
+{
+    if (!set) return;
+    for (size_t i = 0; i < sizeof(set->table); ++i) set->table[i] = (unsigned char)~set->table[i];
+}
+
+STRDEF bool
+str_byteset_contains(const StrByteSet *set, unsigned char c) STR_NOEXCEPT
+{
+    return set && str_byteset_has_(set, c);
+}
+
+STRDEF size_t
+str_find_first_of(const String *str, const StrByteSet *set) STR_NOEXCEPT
+{
+    if (!str || !str->buffer || !set || str->size == 0) return SIZE_MAX;
+    return str_set_scan_((const unsigned char *)str->buffer, str->size, set, true, false);
+}
+
+STRDEF size_t
+str_find_first_not_of(const String *str, const StrByteSet *set) STR_NOEXCEPT
+{
+    if (!str || !str->buffer || !set || str->size == 0) return SIZE_MAX;
+    return str_set_scan_((const unsigned char *)str->buffer, str->size, set, false, false);
+}
+
+STRDEF size_t
+str_find_last_of(const String *str, const StrByteSet *set) STR_NOEXCEPT
+{
+    if (!str || !str->buffer || !set || str->size == 0) return SIZE_MAX;
+    return str_set_scan_((const unsigned char *)str->buffer, str->size, set, true, true);
+}
+
+STRDEF size_t
+str_find_last_not_of(const String *str, const StrByteSet *set) STR_NOEXCEPT
+{
+    if (!str || !str->buffer || !set || str->size == 0) return SIZE_MAX;
+    return str_set_scan_((const unsigned char *)str->buffer, str->size, set, false, true);
+}
+
+STRDEF size_t
+str_span(const String *str, const StrByteSet *set) STR_NOEXCEPT
+{
+    size_t i = str_find_first_not_of(str, set);
+    return i == SIZE_MAX ? (str && set ? str->size : 0) : i;
+}
+
+STRDEF size_t
+str_cspan(const String *str, const StrByteSet *set) STR_NOEXCEPT
+{
+    size_t i = str_find_first_of(str, set);
+    return i == SIZE_MAX ? (str ? str->size : 0) : i;
+}
+
+STRDEF StrTranslator
+str_translator_init(STR_NO_PARAMS) STR_NOEXCEPT
+{
+    StrTranslator tr;
+    memset(&tr, 0, sizeof(tr));
+    for (int c = 0; c < 256; ++c) tr.map[c] = (unsigned char)c;
+    return tr;
+}
+
+static inline void
+str_translator_set_(StrTranslator *tr, unsigned char from, unsigned char to)
+{
+    tr->map[from] = to;
+    uint16_t bit = (uint16_t)(1u << (from >> 4));
+    tr->rows = (uint16_t)(tr->rows & ~bit);
+    for (int k = 0; k < 16; ++k) {
+        int c = (from & 0xF0) | k;
+        if (tr->map[c] != c) tr->rows |= bit;
+    }
+}
+
+STRDEF bool
+str_translator_map(StrTranslator *tr, const char *from, const char *to) STR_NOEXCEPT
+{
+    if (!tr || !from || !to) return false;
+    size_t n = strlen(from);
+    if (strlen(to) != n) return false;
+    for (size_t i = 0; i < n; ++i) str_translator_set_(tr, (unsigned char)from[i], (unsigned char)to[i]);
+    return true;
+}
+
+STRDEF void
+str_translator_map_set(StrTranslator *tr, const StrByteSet *set, unsigned char to) STR_NOEXCEPT
+{
+    if (!tr || !set) return;
+    for (int c = 0; c < 256; ++c) {
+        if (str_byteset_has_(set, (unsigned char)c)) str_translator_set_(tr, (unsigned char)c, to);
+    }
+}
+
+STRDEF void
+str_translator_remove(StrTranslator *tr, const StrByteSet *set) STR_NOEXCEPT
+{
+    if (!tr || !set) return;
+    for (size_t i = 0; i < sizeof(set->table); ++i) {
+        tr->remove.table[i] |= set->table[i];
+        if (tr->remove.table[i]) tr->removes = true;
+    }
+}
+
+STRDEF void
+str_translator_squeeze(StrTranslator *tr, const StrByteSet *set) STR_NOEXCEPT
+{
+    if (!tr || !set) return;
+    for (size_t i = 0; i < sizeof(set->table); ++i) {
+        tr->squeeze.table[i] |= set->table[i];
+        if (tr->squeeze.table[i]) tr->squeezes = true;
+    }
+}
+
+STRDEF bool
+str_translate(String *str, const StrTranslator *tr) STR_NOEXCEPT
+{
+    if (!str || !tr) return false;
+    if (str->size == 0 || (!tr->rows && !tr->removes && !tr->squeezes)) return true;
+
+    unsigned char *p = (unsigned char *)str->buffer;
+    size_t n = str->size, i = 0, j = 0;
+    int last = -1;
+#if defined(STR_X86_DISPATCH_)
+    if (n >= 16) {
+        int level = str_simd_level_();
+        if (level >= STR_SIMD_AVX2)       i = str_translate_avx2_(p, n, tr, &j, &last);
+        else if (level >= STR_SIMD_SSE42) i = str_translate_sse42_(p, n, tr, &j, &last);
+    }
+#endif
+    for (; i < n; ++i) {
+        unsigned char c = p[i];
+        if (tr->removes && str_byteset_has_(&tr->remove, c)) continue;
+        unsigned char b = tr->map[c];
+        if (b == last && str_byteset_has_(&tr->squeeze, b)) continue;
+        p[j++] = b;
+        last = b;
+    }
+    str->size = j;
+    str->buffer[j] = '\0';
+    return true;
+}
+
+STRDEF bool
+str_utf8_valid_n(const char *data, size_t len, size_t *bad_offset) STR_NOEXCEPT
+{
+    if (!data && len) return false;
+    size_t bad = len ? str_utf8_find_invalid_((const unsigned char *)data, len) : SIZE_MAX;
+    if (bad == SIZE_MAX) return true;
+    if (bad_offset) *bad_offset = bad;
+    return false;
+}
+
+STRDEF bool
+str_utf8_valid(const String *str, size_t *bad_offset) STR_NOEXCEPT
+{
+    if (!str) return false;
+    return str_utf8_valid_n(str->buffer, str->size, bad_offset);
+}
+
+STRDEF size_t
+str_utf8_length_n(const char *data, size_t len) STR_NOEXCEPT
+{
+    if (!data) return 0;
+    const unsigned char *p = (const unsigned char *)data;
+    size_t count = 0, i = 0;
+#if defined(STR_X86_DISPATCH_)
+    if (len >= 64 && str_simd_level_() >= STR_SIMD_AVX2) count = str_utf8_count_avx2_(p, len, &i);
+#endif
+#if defined(STR_SSE2_)
+    if (i == 0) count = str_utf8_count_sse2_(p, len, &i);
+#endif
+    // A continuation byte has bit 7 set and bit 6 clear
+    for (; i + 8 <= len; i += 8) {
+        uint64_t x = str_read64_(p + i);
+        count += 8 - str_popcount64_(x & ~(x << 1) & 0x8080808080808080ull);
+    }
+    for (; i < len; ++i) count += (p[i] & 0xC0) != 0x80;
+    return count;
+}
+
+STRDEF size_t
+str_utf8_length(const String *str) STR_NOEXCEPT
+{
+    if (!str) return 0;
+    return str_utf8_length_n(str->buffer, str->size);
+}
+
+STRDEF bool
+str_utf8_truncate(String *str, size_t max_bytes) STR_NOEXCEPT
+{
+    if (!str) return false;
+    if (str->size <= max_bytes) return true;
+
+    // Back off continuation bytes to the lead of the code point the limit
+    // falls into. A sequence is at most 4 bytes.
+    size_t cut = max_bytes;
+    for (int k = 0; k < 3 && cut > 0 && ((unsigned char)str->buffer[cut] & 0xC0) == 0x80; ++k) cut--;
+    if (((unsigned char)str->buffer[cut] & 0xC0) == 0x80) cut = max_bytes; // not UTF-8, cut at the limit
+
+    str->size = cut;
+    str->buffer[cut] = '\0';
+    return true;
+}
+
+// Simple lower case mapping within U+0080..U+07FF, cp itself when there is none
+static inline uint32_t
+str_lower_cp_(uint32_t cp)
+{
+    if (cp >= 0xC0 && cp <= 0xDE && cp != 0xD7) return cp + 0x20;
+    if (cp < 0x100) return cp;
+    if (cp < 0x180) {
+        // Latin Extended-A pairs, upper case first. U+0130, U+0131, U+0138,
+        // U+0149 and U+017F have no mapping that keeps the length.
+        if (cp == 0x178) return 0xFF;
+        if ((cp <= 0x12F || (cp >= 0x132 && cp <= 0x137) || (cp >= 0x14A && cp <= 0x177)) && !(cp & 1)) return cp + 1;
+        if (((cp >= 0x139 && cp <= 0x148) || (cp >= 0x179 && cp <= 0x17E)) && (cp & 1)) return cp + 1;
+        return cp;
+    }
+    if (cp == 0x386) return 0x3AC;
+    if (cp >= 0x388 && cp <= 0x38A) return cp + 0x25;
+    if (cp == 0x38C) return 0x3CC;
+    if (cp == 0x38E || cp == 0x38F) return cp + 0x3F;
+    if (cp >= 0x391 && cp <= 0x3AB && cp != 0x3A2) return cp + 0x20;
+    if (cp >= 0x400 && cp <= 0x40F) return cp + 0x50;
+    if (cp >= 0x410 && cp <= 0x42F) return cp + 0x20;
+    if (((cp >= 0x460 && cp <= 0x481) || (cp >= 0x48A && cp <= 0x4BF) || (cp >= 0x4D0 && cp <= 0x52F)) && !(cp & 1)) return cp + 1;
+    if (cp == 0x4C0) return 0x4CF;
+    if (cp >= 0x4C1 && cp <= 0x4CE && (cp & 1)) return cp + 1;
+    if (cp >= 0x531 && cp <= 0x556) return cp + 0x30;
+    return cp;
+}
+
+// Inverse of str_lower_cp_, plus U+00B5 MICRO SIGN and U+03C2 final sigma
+static inline uint32_t
+str_upper_cp_(uint32_t cp)
+{
+    if (cp >= 0xE0 && cp <= 0xFE && cp != 0xF7) return cp - 0x20;
+    if (cp == 0xFF) return 0x178;
+    if (cp == 0xB5) return 0x39C;
+    if (cp < 0x100) return cp;
+    if (cp < 0x180) {
+        if ((cp <= 0x12F || (cp >= 0x133 && cp <= 0x137) || (cp >= 0x14B && cp <= 0x177)) && (cp & 1)) return cp - 1;
+        if (((cp >= 0x13A && cp <= 0x148) || (cp >= 0x17A && cp <= 0x17E)) && !(cp & 1)) return cp - 1;
+        return cp;
+    }
+    if (cp == 0x3AC) return 0x386;
+    if (cp >= 0x3AD && cp <= 0x3AF) return cp - 0x25;
+    if (cp == 0x3CC) return 0x38C;
+    if (cp == 0x3CD || cp == 0x3CE) return cp - 0x3F;
+    if (cp == 0x3C2) return 0x3A3;
+    if (cp >= 0x3B1 && cp <= 0x3CB) return cp - 0x20;
+    if (cp >= 0x430 && cp <= 0x44F) return cp - 0x20;
+    if (cp >= 0x450 && cp <= 0x45F) return cp - 0x50;
+    if (((cp >= 0x461 && cp <= 0x481) || (cp >= 0x48B && cp <= 0x4BF) || (cp >= 0x4D1 && cp <= 0x52F)) && (cp & 1)) return cp - 1;
+    if (cp == 0x4CF) return 0x4C0;
+    if (cp >= 0x4C2 && cp <= 0x4CE && !(cp & 1)) return cp - 1;
+    if (cp >= 0x561 && cp <= 0x586) return cp - 0x30;
+    return cp;
+}
+
+// ASCII through the vector kernels, then a pass over the 2 byte sequences.
+// Bytes of longer sequences never look like a 2 byte lead, so they are
+// skipped one at a time without decoding.
+static inline bool
+str_utf8_case_(String *str, bool upper)
+{
+    if (!str) return false;
+    unsigned char *p = (unsigned char *)str->buffer;
+    size_t n = str->size;
+    if (n == 0) return true;
+
+    str_case_apply_(p, n, upper ? 'a' : 'A');
+    for (size_t i = 0; i + 1 < n; ) {
+        if (i + 8 <= n && (str_read64_(p + i) & 0x8080808080808080ull) == 0) {
+            i += 8;
+            continue;
+        }
+        if (p[i] >= 0xC2 && p[i] <= 0xDF && (p[i + 1] & 0xC0) == 0x80) {
+            uint32_t cp = (uint32_t)(p[i] & 0x1F) << 6 | (p[i + 1] & 0x3F);
+            cp = upper ? str_upper_cp_(cp) : str_lower_cp_(cp);
+            p[i] = (unsigned char)(0xC0 | (cp >> 6));
+            p[i + 1] = (unsigned char)(0x80 | (cp & 0x3F));
+            i += 2;
+        } else {
+            i++;
+        }
+    }
+    return true;
+}
+
+STRDEF bool
+str_utf8_to_lower(String *str) STR_NOEXCEPT
+{
+    return str_utf8_case_(str, false);
+}
+
+STRDEF bool
+str_utf8_to_upper(String *str) STR_NOEXCEPT
+{
+    return str_utf8_case_(str, true);
+}
+
+//
+// Size hints
+//
+
+STRDEF String
+str_init_hinted(StrSizeHint *hint) STR_NOEXCEPT
+{
+    if (!hint || hint->estimate <= 1) return str_init();
+
+    String result = {STR_NULL, 0, 0};
+    char *p = (char *)STR_REALLOC(STR_NULL, hint->estimate);
+    if (!p) return str_init();
+    STR_STATS_ALLOC_(hint->estimate);
+
+    p[0] = '\0';
+    result.buffer   = p;
+    result.capacity = hint->estimate;
+#if defined(STR_USABLE_SIZE) && !defined(STR_NO_USABLE_SIZE)
+    size_t usable = (size_t)STR_USABLE_SIZE(p);
+    if (usable > result.capacity) result.capacity = usable;
+#endif
+    return result;
+}
+
+// Stochastic quantile estimate: a sample above moves the estimate up by 9
+// steps, one below moves it down by 1, so it settles where 1 in 10 samples
+// lands above it. Steps are relative, so it converges from any start in a
+// few dozen samples and old samples fade out geometrically.
+STRDEF void
+str_size_hint_record(StrSizeHint *hint, const String *str) STR_NOEXCEPT
+{
+    if (!hint || !str) return;
+
+    size_t need = str->size + 1;
+    if (need < str->size) need = SIZE_MAX; // Overflow protection
+
+    hint->samples += 1;
+    if (hint->estimate == 0) {
+        hint->estimate = need;
+        return;
+    }
+
+    size_t step = hint->estimate >> 7;
+    if (step == 0) step = 1;
+    if (need <= hint->estimate) {
+        hint->fits      += 1;
+        hint->overshoot += hint->estimate - need;
+        if (hint->estimate - step >= 1) hint->estimate -= step;
+    } else if (step > SIZE_MAX / 9 || str_would_overflow_(hint->estimate, 9 * step)) { // Overflow protection
+        hint->estimate = SIZE_MAX;
+    } else {
+        hint->estimate += 9 * step;
+    }
+}
+
+STRDEF void
+str_free_hinted(StrSizeHint *hint, String *str) STR_NOEXCEPT
+{
+    str_size_hint_record(hint, str);
+    str_free(str);
+}
+
+STRDEF StrSizeHintStats
+str_size_hint_stats(const StrSizeHint *hint) STR_NOEXCEPT
+{
+    StrSizeHintStats stats;
+    memset(&stats, 0, sizeof(stats));
+    if (!hint) return stats;
+
+    stats.estimate       = hint->estimate;
+    stats.samples        = hint->samples;
+    stats.fits           = hint->fits;
+    stats.fit_rate       = hint->samples ? (double)hint->fits / (double)hint->samples : 0.0;
+    stats.mean_overshoot = hint->fits ? (double)hint->overshoot / (double)hint->fits : 0.0;
+    return stats;
+}
+
+//
+// Transcoding
+//
+// Every direction measures first: UTF-8 input is validated and its
+// code points counted, UTF-16/32 input is checked while adding up the
+// UTF-8 length. The write pass then runs on known good input into
+// memory reserved once. ASCII blocks, and blocks made only of 2 byte
+// sequences, are converted 16 bytes at a time.
+//
+
+static inline void
+str_put16_(unsigned char *o, uint32_t u, bool be)
+{
+    o[be ? 1 : 0] = (unsigned char)u;
+    o[be ? 0 : 1] = (unsigned char)(u >> 8);
+}
+
+static inline void
+str_put32_(unsigned char *o, uint32_t u, bool be)
+{
+    for (int k = 0; k < 4; ++k) o[be ? 3 - k : k] = (unsigned char)(u >> (8 * k));
+}
+
+static inline uint32_t
+str_get16_(const unsigned char *p, bool be)
+{
+    return be ? ((uint32_t)p[0] << 8 | p[1]) : ((uint32_t)p[1] << 8 | p[0]);
+}
+
+static inline uint32_t
+str_get32_(const unsigned char *p, bool be)
+{
+    uint32_t u = 0;
+    for (int k = 0; k < 4; ++k) u |= (uint32_t)p[be ? 3 - k : k] << (8 * k);
+    return u;
+}
+
+// Decode one code point from valid UTF-8, returns its length
+static inline size_t
+str_utf8_decode_(const unsigned char *p, uint32_t *cp)
+{
+    unsigned char c = p[0];
+    if (c < 0x80) {
+        *cp = c;
+        return 1;
+    }
+    if (c < 0xE0) {
+        *cp = (uint32_t)(c & 0x1F) << 6 | (p[1] & 0x3F);
+        return 2;
+    }
+    if (c < 0xF0) {
+        *cp = (uint32_t)(c & 0x0F) << 12 | (uint32_t)(p[1] & 0x3F) << 6 | (p[2] & 0x3F);
+        return 3;
+    }
+    *cp = (uint32_t)(c & 0x07) << 18 | (uint32_t)(p[1] & 0x3F) << 12 | (uint32_t)(p[2] & 0x3F) << 6 | (p[3] & 0x3F);
+    return 4;
+}
+
+// Encode cp as UTF-8, returns the length
+static inline size_t
+str_utf8_encode_(unsigned char *o, uint32_t cp)
+{
+    if (cp < 0x80) {
+        o[0] = (unsigned char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        o[0] = (unsigned char)(0xC0 | (cp >> 6));
+        o[1] = (unsigned char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        o[0] = (unsigned char)(0xE0 | (cp >> 12));
+        o[1] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+        o[2] = (unsigned char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    o[0] = (unsigned char)(0xF0 | (cp >> 18));
+    o[1] = (unsigned char)(0x80 | ((cp >> 12) & 0x3F));
+    o[2] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+    o[3] = (unsigned char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+// Number of 4 byte lead bytes, which become surrogate pairs in UTF-16
+static inline size_t
+str_utf8_count_fours_(const unsigned char *p, size_t n)
+{
+    size_t count = 0, i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t x = str_read64_(p + i);
+        count += str_popcount64_(x & (x << 1) & (x << 2) & (x << 3) & 0x8080808080808080ull);
+    }
+    for (; i < n; ++i) count += p[i] >= 0xF0;
+    return count;
+}
+
+#if defined(STR_SSE2_)
+// Store 8 code units held in the 16 bit lanes of u, as UTF-16 or UTF-32
+static inline unsigned char *
+str_store_units_sse2_(unsigned char *o, __m128i u, unsigned width, bool be)
+{
+    if (be) u = _mm_or_si128(_mm_slli_epi16(u, 8), _mm_srli_epi16(u, 8));
+    if (width == 2) {
+        _mm_storeu_si128((__m128i *)(void *)o, u);
+        return o + 16;
+    }
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = be ? _mm_unpacklo_epi16(zero, u) : _mm_unpacklo_epi16(u, zero);
+    __m128i hi = be ? _mm_unpackhi_epi16(zero, u) : _mm_unpackhi_epi16(u, zero);
+    _mm_storeu_si128((__m128i *)(void *)o, lo);
+    _mm_storeu_si128((__m128i *)(void *)(o + 16), hi);
+    return o + 32;
+}
+#endif
+
+// Write valid UTF-8 p[0, n) as width byte units
+static inline unsigned char *
+str_utf8_to_units_(const unsigned char *p, size_t n, unsigned char *o, unsigned width, bool be)
+{
+    size_t i = 0;
+    while (i < n) {
+#if defined(STR_SSE2_)
+        if (i + 16 <= n) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(const void *)(p + i));
+            if (_mm_movemask_epi8(x) == 0) {
+                const __m128i zero = _mm_setzero_si128();
+                o = str_store_units_sse2_(o, _mm_unpacklo_epi8(x, zero), width, be);
+                o = str_store_units_sse2_(o, _mm_unpackhi_epi8(x, zero), width, be);
+                i += 16;
+                continue;
+            }
+            // Eight 2 byte sequences: 110xxxxx 10xxxxxx in every 16 bit lane
+            __m128i shape = _mm_and_si128(x, _mm_set1_epi16((short)0xC0E0));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(shape, _mm_set1_epi16((short)0x80C0))) == 0xFFFF) {
+                __m128i lead = _mm_slli_epi16(_mm_and_si128(x, _mm_set1_epi16(0x1F)), 6);
+                __m128i cont = _mm_and_si128(_mm_srli_epi16(x, 8), _mm_set1_epi16(0x3F));
+                o = str_store_units_sse2_(o, _mm_or_si128(lead, cont), width, be);
+                i += 16;
+                continue;
+            }
+        }
+#endif
+        uint32_t cp;
+        i += str_utf8_decode_(p + i, &cp);
+        if (width == 4) {
+            str_put32_(o, cp, be);
+            o += 4;
+        } else if (cp < 0x10000) {
+            str_put16_(o, cp, be);
+            o += 2;
+        } else {
+            cp -= 0x10000;
+            str_put16_(o, 0xD800 | (cp >> 10), be);
+            str_put16_(o + 2, 0xDC00 | (cp & 0x3FF), be);
+            o += 4;
+        }
+    }
+    return o;
+}
+
+static inline bool
+str_append_units_(String *out, const char *utf8, size_t len, unsigned width, bool be, size_t *bad_offset)
+{
+    if (!out || (!utf8 && len)) return false;
+    if (len == 0) return true;
+
+    const unsigned char *p = (const unsigned char *)utf8;
+    size_t bad = str_utf8_find_invalid_(p, len);
+    if (bad != SIZE_MAX) {
+        if (bad_offset) *bad_offset = bad;
+        return false;
+    }
+
+    size_t units = str_utf8_length_n(utf8, len);
+    if (width == 2) units += str_utf8_count_fours_(p, len);
+    if (units > (SIZE_MAX - out->size - 1) / width || !str_reserve(out, out->size + units * width)) { // Overflow protection
+        if (bad_offset) *bad_offset = SIZE_MAX;
+        return false;
+    }
+
+    unsigned char *o = (unsigned char *)out->buffer + out->size;
+    unsigned char *end = str_utf8_to_units_(p, len, o, width, be);
+    out->size += (size_t)(end - o);
+    out->buffer[out->size] = '\0';
+    return true;
+}
+
+STRDEF bool
+str_append_utf16(String *out, const char *utf8, size_t len, bool big_endian, size_t *bad_offset) STR_NOEXCEPT
+{
+    return str_append_units_(out, utf8, len, 2, big_endian, bad_offset);
+}
+
+STRDEF bool
+str_append_utf32(String *out, const char *utf8, size_t len, bool big_endian, size_t *bad_offset) STR_NOEXCEPT
+{
+    return str_append_units_(out, utf8, len, 4, big_endian, bad_offset);
+}
+
+#if defined(STR_SSE2_)
+// Load 8 UTF-16 units into 16 bit lanes in host order
+static inline __m128i
+str_load_utf16_sse2_(const unsigned char *p, bool be)
+{
+    __m128i u = _mm_loadu_si128((const __m128i *)(const void *)p);
+    return be ? _mm_or_si128(_mm_slli_epi16(u, 8), _mm_srli_epi16(u, 8)) : u;
+}
+#endif
+
+// UTF-8 length of UTF-16 input, or SIZE_MAX with the unit at fault in *bad
+static inline size_t
+str_utf16_measure_(const unsigned char *p, size_t units, bool be, size_t *bad)
+{
+    size_t total = 0, i = 0;
+    while (i < units) {
+#if defined(STR_SSE2_)
+        if (i + 8 <= units) {
+            __m128i u = str_load_utf16_sse2_(p + 2 * i, be);
+            __m128i surrogate = _mm_cmpeq_epi16(_mm_and_si128(u, _mm_set1_epi16((short)0xF800)), _mm_set1_epi16((short)0xD800));
+            if (_mm_movemask_epi8(surrogate) == 0) {
+                const __m128i zero = _mm_setzero_si128();
+                // one byte each, plus one from 0x80 up, plus one from 0x800 up
+                unsigned ascii  = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(u, _mm_set1_epi16((short)0xFF80)), zero));
+                unsigned small  = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(u, _mm_set1_epi16((short)0xF800)), zero));
+                total += 8 + (16 - str_popcount64_(ascii)) / 2 + (16 - str_popcount64_(small)) / 2;
+                i += 8;
+                continue;
+            }
+        }
+#endif
+        uint32_t u = str_get16_(p + 2 * i, be);
+        if (u < 0x80) {
+            total += 1;
+        } else if (u < 0x800) {
+            total += 2;
+        } else if ((u & 0xF800) != 0xD800) {
+            total += 3;
+        } else if (u <= 0xDBFF && i + 1 < units && (str_get16_(p + 2 * i + 2, be) & 0xFC00) == 0xDC00) {
+            total += 4;
+            i++;
+        } else {
+            *bad = i;
+            return SIZE_MAX;
+        }
+        i++;
+    }
+    return total;
+}
+
+// Write valid UTF-16 as UTF-8
+static inline unsigned char *
+str_utf16_to_utf8_(const unsigned char *p, size_t units, bool be, unsigned char *o)
+{
+    size_t i = 0;
+    while (i < units) {
+#if defined(STR_SSE2_)
+        if (i + 8 <= units) {
+            __m128i u = str_load_utf16_sse2_(p + 2 * i, be);
+            const __m128i zero = _mm_setzero_si128();
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(u, _mm_set1_epi16((short)0xFF80)), zero)) == 0xFFFF) {
+                _mm_storel_epi64((__m128i *)(void *)o, _mm_packus_epi16(u, u));
+                o += 8;
+                i += 8;
+                continue;
+            }
+            // All in 0x80..0x7FF: lead in the low byte of each lane, continuation in the high
+            __m128i two = _mm_cmpeq_epi16(_mm_and_si128(u, _mm_set1_epi16((short)0xF800)), zero);
+            __m128i one = _mm_cmpeq_epi16(_mm_and_si128(u, _mm_set1_epi16((short)0xFF80)), zero);
+            if (_mm_movemask_epi8(_mm_andnot_si128(one, two)) == 0xFFFF) {
+                __m128i lead = _mm_or_si128(_mm_srli_epi16(u, 6), _mm_set1_epi16(0xC0));
+                __m128i cont = _mm_slli_epi16(_mm_or_si128(_mm_and_si128(u, _mm_set1_epi16(0x3F)), _mm_set1_epi16(0x80)), 8);
+                _mm_storeu_si128((__m128i *)(void *)o, _mm_or_si128(lead, cont));
+                o += 16;
+                i += 8;
+                continue;
+            }
+        }
+#endif
+        uint32_t cp = str_get16_(p + 2 * i, be);
+        i++;
+        if ((cp & 0xFC00) == 0xD800) {
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (str_get16_(p + 2 * i, be) - 0xDC00);
+            i++;
+        }
+        o += str_utf8_encode_(o, cp);
+    }
+    return o;
+}
+
+STRDEF bool
+str_append_from_utf16(String *out, const void *data, size_t bytes, bool big_endian, size_t *bad_offset) STR_NOEXCEPT
+{
+    if (!out || (!data && bytes)) return false;
+    const unsigned char *p = (const unsigned char *)data;
+    size_t units = bytes / 2, bad = 0;
+
+    size_t total = str_utf16_measure_(p, units, big_endian, &bad);
+    if (total == SIZE_MAX || bytes % 2) {
+        if (bad_offset) *bad_offset = total == SIZE_MAX ? 2 * bad : bytes - 1;
+        return false;
+    }
+    if (str_would_overflow_(out->size, total) || !str_reserve(out, out->size + total)) { // Overflow protection
+        if (bad_offset) *bad_offset = SIZE_MAX;
+        return false;
+    }
+    if (total == 0) return true;
+
+    unsigned char *o = (unsigned char *)out->buffer + out->size;
+    out->size += (size_t)(str_utf16_to_utf8_(p, units, big_endian, o) - o);
+    out->buffer[out->size] = '\0';
+    return true;
+}
+
+STRDEF bool
+str_append_from_utf32(String *out, const void *data, size_t bytes, bool big_endian, size_t *bad_offset) STR_NOEXCEPT
+{
+    if (!out || (!data && bytes)) return false;
+    const unsigned char *p = (const unsigned char *)data;
+    size_t units = bytes / 4, total = 0;
+
+    for (size_t i = 0; i < units; ++i) {
+        uint32_t cp = str_get32_(p + 4 * i, big_endian);
+        if (cp > 0x10FFFF || (cp & 0xFFFFF800u) == 0xD800) {
+            if (bad_offset) *bad_offset = 4 * i;
+            return false;
+        }
+        total += 1 + (cp >= 0x80) + (cp >= 0x800) + (cp >= 0x10000);
+    }
+    if (bytes % 4) {
+        if (bad_offset) *bad_offset = 4 * units;
+        return false;
+    }
+    if (str_would_overflow_(out->size, total) || !str_reserve(out, out->size + total)) { // Overflow protection
+        if (bad_offset) *bad_offset = SIZE_MAX;
+        return false;
+    }
+
+    unsigned char *o = (unsigned char *)out->buffer + out->size;
+    size_t i = 0;
+#if defined(STR_SSE2_)
+    // 16 ASCII code points at a time, narrowed with saturating packs
+    for (; i + 16 <= units; ) {
+        __m128i v[4];
+        for (int k = 0; k < 4; ++k) {
+            v[k] = _mm_loadu_si128((const __m128i *)(const void *)(p + 4 * i + 16 * k));
+            if (big_endian) {
+                v[k] = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(v[k], 24), _mm_srli_epi32(v[k], 24)),
+                                    _mm_or_si128(_mm_and_si128(_mm_slli_epi32(v[k], 8), _mm_set1_epi32(0xFF0000)),
+                                                 _mm_and_si128(_mm_srli_epi32(v[k], 8), _mm_set1_epi32(0xFF00))));
+            }
+        }
+        __m128i any = _mm_or_si128(_mm_or_si128(v[0], v[1]), _mm_or_si128(v[2], v[3]));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(any, _mm_set1_epi32(~0x7F)), _mm_setzero_si128())) != 0xFFFF) {
+            // Not all ASCII, do these one by one
+            for (int k = 0; k < 16; ++k, ++i) o += str_utf8_encode_(o, str_get32_(p + 4 * i, big_endian));
+            continue;
+        }
+        __m128i w = _mm_packus_epi16(_mm_packs_epi32(v[0], v[1]), _mm_packs_epi32(v[2], v[3]));
+        _mm_storeu_si128((__m128i *)(void *)o, w);
+        o += 16;
+        i += 16;
+    }
+#endif
+    for (; i < units; ++i) o += str_utf8_encode_(o, str_get32_(p + 4 * i, big_endian));
+    out->size += total;
+    out->buffer[out->size] = '\0';
+    return true;
+}
+
+//
+// Base64 and hex
+//
+// Base64 follows Mula and Lemire, "Faster Base64 Encoding and Decoding
+// Using AVX2 Instructions": encoding spreads each 3 bytes over a 32 bit
+// lane with pshufb and cuts out the 6 bit fields with multiplies, decoding
+// merges the fields back with maddubs/madd. Characters are classified with
+// range compares, which handles both alphabets with the same code. A
+// kernel stops at the first block holding a bad character and the scalar
+// loop after it finds the exact offset.
+//
+
+static const char str_b64_std_[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char str_b64_url_[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// 6 bit value of a base64 character, or -1
+static inline int
+str_b64_value_(unsigned char c, bool url)
+{
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == (url ? '-' : '+')) return 62;
+    if (c == (url ? '_' : '/')) return 63;
+    return -1;
+}
+
+// Value of a hex digit, or -1
+static inline int
+str_hex_value_(unsigned char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+#if defined(STR_SSE2_)
+// 0xFF in lanes holding a byte in [lo, lo + n)
+static inline __m128i
+str_range_sse2_(__m128i x, unsigned char lo, int n)
+{
+    __m128i t = _mm_add_epi8(x, _mm_set1_epi8((char)(0x80 - lo)));
+    return _mm_cmplt_epi8(t, _mm_set1_epi8((char)(-128 + n)));
+}
+
+static inline __m128i
+str_hex_digits_sse2_(__m128i nibbles, bool upper)
+{
+    __m128i letter = _mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9));
+    __m128i digits = _mm_add_epi8(nibbles, _mm_set1_epi8('0'));
+    return _mm_add_epi8(digits, _mm_and_si128(letter, _mm_set1_epi8((char)((upper ? 'A' : 'a') - '0' - 10))));
+}
+
+// Nibble values of 16 hex digits, with a mask of the bad ones in *bad
+static inline __m128i
+str_hex_values_sse2_(__m128i x, unsigned *bad)
+{
+    __m128i digit = str_range_sse2_(x, '0', 10);
+    __m128i lower = _mm_or_si128(x, _mm_set1_epi8(0x20));
+    __m128i alpha = str_range_sse2_(lower, 'a', 6);
+    __m128i v = _mm_or_si128(_mm_and_si128(digit, _mm_sub_epi8(x, _mm_set1_epi8('0'))),
+                             _mm_and_si128(alpha, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+    *bad = (unsigned)_mm_movemask_epi8(_mm_or_si128(digit, alpha)) ^ 0xFFFFu;
+    return v;
+}
+
+// Pairs of nibbles (high digit first) to bytes, in 16 bit lanes
+static inline __m128i
+str_hex_pairs_sse2_(__m128i v)
+{
+    return _mm_or_si128(_mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi16(0xFF)), 4), _mm_srli_epi16(v, 8));
+}
+#endif
+
+#if defined(STR_X86_DISPATCH_)
+// str_range_sse2_ for the kernels below, which may be built without SSE2
+// being on for the rest of the file
+STR_TARGET_("sse4.2") static inline __m128i
+str_range_sse42_(__m128i x, unsigned char lo, int n)
+{
+    __m128i t = _mm_add_epi8(x, _mm_set1_epi8((char)(0x80 - lo)));
+    return _mm_cmplt_epi8(t, _mm_set1_epi8((char)(-128 + n)));
+}
+
+// ASCII for 16 values in 0..63: one pshufb picks the offset to add from
+// which range the value falls in
+STR_TARGET_("sse4.2") static inline __m128i
+str_b64_chars_sse42_(__m128i idx, bool url)
+{
+    __m128i r = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+    r = _mm_or_si128(r, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), idx), _mm_set1_epi8(13)));
+    const __m128i shift = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                        '0' - 52, '0' - 52, '0' - 52, '0' - 52, (char)((url ? '-' : '+') - 62),
+                                        (char)((url ? '_' : '/') - 63), 'A', 0, 0);
+    return _mm_add_epi8(_mm_shuffle_epi8(shift, r), idx);
+}
+
+// Consumes whole 12 byte groups while 16 bytes can be read, returns the
+// bytes consumed; 16 characters are written per group
+STR_TARGET_("sse4.2") static inline size_t
+str_b64_encode_sse42_(const unsigned char *src, size_t len, char *dst, bool url)
+{
+    size_t i = 0;
+    for (; i + 16 <= len; i += 12, dst += 16) {
+        __m128i in = _mm_loadu_si128((const __m128i *)(const void *)(src + i));
+        in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+        __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+        __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+        _mm_storeu_si128((__m128i *)(void *)dst, str_b64_chars_sse42_(_mm_or_si128(t0, t1), url));
+    }
+    return i;
+}
+
+// Values of 16 base64 characters, with a mask of the bad ones in *bad
+STR_TARGET_("sse4.2") static inline __m128i
+str_b64_values_sse42_(__m128i x, bool url, unsigned *bad)
+{
+    __m128i upper = str_range_sse42_(x, 'A', 26);
+    __m128i lower = str_range_sse42_(x, 'a', 26);
+    __m128i digit = str_range_sse42_(x, '0', 10);
+    __m128i c62 = _mm_cmpeq_epi8(x, _mm_set1_epi8(url ? '-' : '+'));
+    __m128i c63 = _mm_cmpeq_epi8(x, _mm_set1_epi8(url ? '_' : '/'));
+    __m128i v = _mm_and_si128(upper, _mm_sub_epi8(x, _mm_set1_epi8('A')));
+    v = _mm_or_si128(v, _mm_and_si128(lower, _mm_sub_epi8(x, _mm_set1_epi8('a' - 26))));
+    v = _mm_or_si128(v, _mm_and_si128(digit, _mm_add_epi8(x, _mm_set1_epi8(52 - '0'))));
+    v = _mm_or_si128(v, _mm_and_si128(c62, _mm_set1_epi8(62)));
+    v = _mm_or_si128(v, _mm_and_si128(c63, _mm_set1_epi8(63)));
+    __m128i ok = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(c62, c63)));
+    *bad = (unsigned)_mm_movemask_epi8(ok) ^ 0xFFFFu;
+    return v;
+}
+
+// Decodes whole 16 character blocks into 12 bytes each, stopping before
+// a block with a bad character. Returns the characters consumed.
+STR_TARGET_("sse4.2") static inline size_t
+str_b64_decode_sse42_(const unsigned char *src, size_t len, unsigned char *dst, bool url)
+{
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16, dst += 12) {
+        unsigned bad;
+        __m128i v = str_b64_values_sse42_(_mm_loadu_si128((const __m128i *)(const void *)(src + i)), url, &bad);
+        if (bad) break;
+        v = _mm_madd_epi16(_mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140)), _mm_set1_epi32(0x00011000));
+        v = _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        unsigned char tmp[16];
+        _mm_storeu_si128((__m128i *)(void *)tmp, v);
+        memcpy(dst, tmp, 12);
+    }
+    return i;
+}
+
+STR_TARGET_("avx2") static inline __m256i
+str_range_avx2_(__m256i x, unsigned char lo, int n)
+{
+    __m256i t = _mm256_add_epi8(x, _mm256_set1_epi8((char)(0x80 - lo)));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(-128 + n)), t);
+}
+
+// 24 bytes per step, the two 12 byte groups in separate lanes
+STR_TARGET_("avx2") static inline size_t
+str_b64_encode_avx2_(const unsigned char *src, size_t len, char *dst, bool url)
+{
+    const __m256i shuf = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                          1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m256i shift = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '0' - 52, (char)((url ? '-' : '+') - 62),
+                                           (char)((url ? '_' : '/') - 63), 'A', 0, 0,
+                                           'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '0' - 52, (char)((url ? '-' : '+') - 62),
+                                           (char)((url ? '_' : '/') - 63), 'A', 0, 0);
+    size_t i = 0;
+    for (; i + 28 <= len; i += 24, dst += 32) {
+        __m128i lo = _mm_loadu_si128((const __m128i *)(const void *)(src + i));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(const void *)(src + i + 12));
+        __m256i in = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1), shuf);
+        __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00)), _mm256_set1_epi32(0x04000040));
+        __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0)), _mm256_set1_epi32(0x01000010));
+        __m256i idx = _mm256_or_si256(t0, t1);
+        __m256i r = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+        r = _mm256_or_si256(r, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx), _mm256_set1_epi8(13)));
+        _mm256_storeu_si256((__m256i *)(void *)dst, _mm256_add_epi8(_mm256_shuffle_epi8(shift, r), idx));
+    }
+    return i;
+}
+
+STR_TARGET_("avx2") static inline size_t
+str_b64_decode_avx2_(const unsigned char *src, size_t len, unsigned char *dst, bool url)
+{
+    const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                          2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32, dst += 24) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(const void *)(src + i));
+        __m256i upper = str_range_avx2_(x, 'A', 26);
+        __m256i lower = str_range_avx2_(x, 'a', 26);
+        __m256i digit = str_range_avx2_(x, '0', 10);
+        __m256i c62 = _mm256_cmpeq_epi8(x, _mm256_set1_epi8(url ? '-' : '+'));
+        __m256i c63 = _mm256_cmpeq_epi8(x, _mm256_set1_epi8(url ? '_' : '/'));
+        __m256i ok = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(digit, _mm256_or_si256(c62, c63)));
+        if ((uint32_t)_mm256_movemask_epi8(ok) != 0xFFFFFFFFu) break;
+        __m256i v = _mm256_and_si256(upper, _mm256_sub_epi8(x, _mm256_set1_epi8('A')));
+        v = _mm256_or_si256(v, _mm256_and_si256(lower, _mm256_sub_epi8(x, _mm256_set1_epi8('a' - 26))));
+        v = _mm256_or_si256(v, _mm256_and_si256(digit, _mm256_add_epi8(x, _mm256_set1_epi8(52 - '0'))));
+        v = _mm256_or_si256(v, _mm256_and_si256(c62, _mm256_set1_epi8(62)));
+        v = _mm256_or_si256(v, _mm256_and_si256(c63, _mm256_set1_epi8(63)));
+        v = _mm256_madd_epi16(_mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140)), _mm256_set1_epi32(0x00011000));
+        // 12 bytes at the bottom of each lane, then the lanes moved together
+        v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, pack), _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+        unsigned char tmp[32];
+        _mm256_storeu_si256((__m256i *)(void *)tmp, v);
+        memcpy(dst, tmp, 24);
+    }
+    return i;
+}
+
+STR_TARGET_("avx2") static inline size_t
+str_hex_encode_avx2_(const unsigned char *src, size_t len, char *dst, bool upper)
+{
+    const __m256i adjust = _mm256_set1_epi8((char)((upper ? 'A' : 'a') - '0' - 10));
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32, dst += 64) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(const void *)(src + i));
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), _mm256_set1_epi8(0x0F));
+        __m256i lo = _mm256_and_si256(x, _mm256_set1_epi8(0x0F));
+        hi = _mm256_add_epi8(_mm256_add_epi8(hi, _mm256_set1_epi8('0')), _mm256_and_si256(_mm256_cmpgt_epi8(hi, _mm256_set1_epi8(9)), adjust));
+        lo = _mm256_add_epi8(_mm256_add_epi8(lo, _mm256_set1_epi8('0')), _mm256_and_si256(_mm256_cmpgt_epi8(lo, _mm256_set1_epi8(9)), adjust));
+        // unpack works per lane: reorder the four 16 byte results
+        __m256i a = _mm256_unpacklo_epi8(hi, lo), b = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256((__m256i *)(void *)dst, _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256((__m256i *)(void *)(dst + 32), _mm256_permute2x128_si256(a, b, 0x31));
+    }
+    return i;
+}
+
+STR_TARGET_("avx2") static inline size_t
+str_hex_decode_avx2_(const unsigned char *src, size_t len, unsigned char *dst)
+{
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64, dst += 32) {
+        __m256i v[2];
+        uint32_t good = 0xFFFFFFFFu;
+        for (int k = 0; k < 2; ++k) {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(const void *)(src + i + 32 * k));
+            __m256i digit = str_range_avx2_(x, '0', 10);
+            __m256i lower = _mm256_or_si256(x, _mm256_set1_epi8(0x20));
+            __m256i alpha = str_range_avx2_(lower, 'a', 6);
+            good &= (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(digit, alpha));
+            __m256i n = _mm256_or_si256(_mm256_and_si256(digit, _mm256_sub_epi8(x, _mm256_set1_epi8('0'))),
+                                        _mm256_and_si256(alpha, _mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10))));
+            v[k] = _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(n, _mm256_set1_epi16(0xFF)), 4), _mm256_srli_epi16(n, 8));
+        }
+        if (good != 0xFFFFFFFFu) break;
+        // packus interleaves the lanes of its inputs
+        __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(v[0], v[1]), 0xD8);
+        _mm256_storeu_si256((__m256i *)(void *)dst, bytes);
+    }
+    return i;
+}
+#endif // STR_X86_DISPATCH_
+
+STRDEF bool
+str_append_base64(String *out, const void *data, size_t len, bool url) STR_NOEXCEPT
+{
+    if (!out || (!data && len)) return false;
+    if (len / 3 >= (SIZE_MAX - out->size - 5) / 4) return false; // Overflow protection
+    size_t rest = len % 3;
+    size_t total = len / 3 * 4 + (rest ? (url ? rest + 1 : 4) : 0);
+    if (!str_reserve(out, out->size + total)) return false;
+    if (len == 0) return true;
+
+    const unsigned char *src = (const unsigned char *)data;
+    const char *alphabet = url ? str_b64_url_ : str_b64_std_;
+    char *dst = out->buffer + out->size;
+    size_t i = 0;
+#if defined(STR_X86_DISPATCH_)
+    if (len >= 16) {
+        int level = str_simd_level_();
+        if (level >= STR_SIMD_AVX2) i = str_b64_encode_avx2_(src, len, dst, url);
+        if (level >= STR_SIMD_SSE42) i += str_b64_encode_sse42_(src + i, len - i, dst + i / 3 * 4, url);
+    }
+#endif
+    for (dst += i / 3 * 4; i + 3 <= len; i += 3, dst += 4) {
+        uint32_t v = (uint32_t)src[i] << 16 | (uint32_t)src[i + 1] << 8 | src[i + 2];
+        dst[0] = alphabet[v >> 18];
+        dst[1] = alphabet[(v >> 12) & 63];
+        dst[2] = alphabet[(v >> 6) & 63];
+        dst[3] = alphabet[v & 63];
+    }
+    if (rest) {
+        uint32_t v = (uint32_t)src[i] << 16 | (rest == 2 ? (uint32_t)src[i + 1] << 8 : 0);
+        *dst++ = alphabet[v >> 18];
+        *dst++ = alphabet[(v >> 12) & 63];
+        if (rest == 2) *dst++ = alphabet[(v >> 6) & 63];
+        else if (!url) *dst++ = '=';
+        if (!url) *dst++ = '=';
+    }
+    out->size += total;
+    out->buffer[out->size] = '\0';
+    return true;
+}
+
+STRDEF bool
+str_decode_base64(String *out, const char *src, size_t len, bool url, size_t *bad_offset) STR_NOEXCEPT
+{
+    if (!out || (!src && len)) return false;
+
+    // Up to two '=' at the end; anything else is checked as data
+    size_t data = len, pad = 0;
+    while (pad < 2 && data && src[data - 1] == '=') data--, pad++;
+    size_t total = data / 4 * 3 + (data % 4 ? data % 4 - 1 : 0);
+    if (!str_reserve(out, out->size + total)) {
+        if (bad_offset) *bad_offset = SIZE_MAX;
+        return false;
+    }
+
+    const unsigned char *p = (const unsigned char *)src;
+    unsigned char *dst = (unsigned char *)out->buffer + out->size;
+    size_t i = 0, bad = SIZE_MAX;
+#if defined(STR_X86_DISPATCH_)
+    if (data >= 16) {
+        int level = str_simd_level_();
+        if (level >= STR_SIMD_AVX2) i = str_b64_decode_avx2_(p, data, dst, url);
+        if (level >= STR_SIMD_SSE42) i += str_b64_decode_sse42_(p + i, data - i, dst + i / 4 * 3, url);
+    }
+#endif
+    dst += i / 4 * 3;
+    uint32_t acc = 0;
+    for (; i < data; ++i) {
+        int v = str_b64_value_(p[i], url);
+        if (v < 0) {
+            bad = i;
+            break;
+        }
+        acc = acc << 6 | (uint32_t)v;
+        if (i % 4 == 3) {
+            *dst++ = (unsigned char)(acc >> 16);
+            *dst++ = (unsigned char)(acc >> 8);
+            *dst++ = (unsigned char)acc;
+            acc = 0;
+        }
+    }
+
+    if (bad == SIZE_MAX) {
+        size_t tail = data % 4;
+        if (tail == 1) {
+            bad = data - 1;                    // one character holds no whole byte
+        } else if ((!url || pad) && len % 4) {
+            bad = len;                         // padding missing or short
+        } else if (pad && (tail == 0 || tail + pad != 4)) {
+            bad = data;                        // padding after a whole quantum
+        } else if (tail && (acc & ((1u << (2 * (4 - tail))) - 1))) {
+            bad = data - 1;                    // unused bits must be zero
+        }
+    }
+    if (bad != SIZE_MAX) {
+        out->buffer[out->size] = '\0';
+        if (bad_offset) *bad_offset = bad;
+        return false;
+    }
+    if (data % 4 == 2) {
+        *dst++ = (unsigned char)(acc >> 4);
+    } else if (data % 4 == 3) {
+        *dst++ = (unsigned char)(acc >> 10);
+        *dst++ = (unsigned char)(acc >> 2);
+    }
+    out->size += total;
+    out->buffer[out->size] = '\0';
+    return true;
+}
+
+STRDEF bool
+str_append_hex(String *out, const void *data, size_t len, bool upper) STR_NOEXCEPT
+{
+    if (!out || (!data && len)) return false;
+    if (len > (SIZE_MAX - out->size - 1) / 2) return false; // Overflow protection
+    if (!str_reserve(out, out->size + 2 * len)) return false;
+
+    const unsigned char *src = (const unsigned char *)data;
+    char *dst = out->buffer + out->size;
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    size_t i = 0;
+#if defined(STR_X86_DISPATCH_)
+    if (len >= 32 && str_simd_level_() >= STR_SIMD_AVX2) i = str_hex_encode_avx2_(src, len, dst, upper);
+#endif
+#if defined(STR_SSE2_)
+    for (; i + 16 <= len; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(const void *)(src + i));
+        __m128i hi = str_hex_digits_sse2_(_mm_and_si128(_mm_srli_epi16(x, 4), _mm_set1_epi8(0x0F)), upper);
+        __m128i lo = str_hex_digits_sse2_(_mm_and_si128(x, _mm_set1_epi8(0x0F)), upper);
+        _mm_storeu_si128((__m128i *)(void *)(dst + 2 * i), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *)(void *)(dst + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+#endif
+    for (; i < len; ++i) {
+        dst[2 * i] = digits[src[i] >> 4];
+        dst[2 * i + 1] = digits[src[i] & 15];
+    }
+    out->size += 2 * len;
+    out->buffer[out->size] = '\0';
+    return true;
+}
+
+STRDEF bool
+str_decode_hex(String *out, const char *src, size_t len, size_t *bad_offset) STR_NOEXCEPT
+{
+    if (!out || (!src && len)) return false;
+    if (!str_reserve(out, out->size + len / 2)) {
+        if (bad_offset) *bad_offset = SIZE_MAX;
+        return false;
+    }
+
+    const unsigned char *p = (const unsigned char *)src;
+    unsigned char *dst = (unsigned char *)out->buffer + out->size;
+    size_t i = 0, bad = SIZE_MAX;
+#if defined(STR_X86_DISPATCH_)
+    if (len >= 64 && str_simd_level_() >= STR_SIMD_AVX2) i = str_hex_decode_avx2_(p, len, dst);
+#endif
+#if defined(STR_SSE2_)
+    for (; i + 32 <= len; i += 32) {
+        unsigned bad_a, bad_b;
+        __m128i a = str_hex_values_sse2_(_mm_loadu_si128((const __m128i *)(const void *)(p + i)), &bad_a);
+        __m128i b = str_hex_values_sse2_(_mm_loadu_si128((const __m128i *)(const void *)(p + i + 16)), &bad_b);
+        if (bad_a | bad_b) break;
+        _mm_storeu_si128((__m128i *)(void *)(dst + i / 2), _mm_packus_epi16(str_hex_pairs_sse2_(a), str_hex_pairs_sse2_(b)));
+    }
+#endif
+    for (; i < len; ++i) {
+        int v = str_hex_value_(p[i]);
+        if (v < 0) {
+            bad = i;
+            break;
+        }
+        if (i % 2) dst[i / 2] = (unsigned char)(dst[i / 2] | v);
+        else if (i + 1 < len) dst[i / 2] = (unsigned char)(v << 4);
+    }
+    if (bad == SIZE_MAX && len % 2) bad = len - 1;
+    if (bad != SIZE_MAX) {
+        out->buffer[out->size] = '\0';
+        if (bad_offset) *bad_offset = bad;
+        return false;
+    }
+    out->size += len / 2;
+    out->buffer[out->size] = '\0';
+    return true;
+}
+
+//
+// Escaping
+//
+// Escaping classifies 4 KiB at a time into bit masks with the byte set
+// kernels, then walks the set bits: once to measure, once to write into
+// memory reserved once, copying the clean runs between escapes whole.
+// Unescaping jumps from one special byte to the next (memchr where there
+// is only one) and, since no dialect's unescaped form is longer than its
+// input, reserves len up front.
+//
+
+// Bytes each dialect escapes, in the StrByteSet layout
+static const StrByteSet str_escape_sets_[] = {
+    {{3, 3, 7, 3, 3, 3, 3, 3, 3, 3, 3, 3, 35, 3, 3, 3}},                 // 0x00-0x1F " backslash
+    {{0, 0, 4, 0, 0, 0, 4, 4, 0, 0, 0, 0, 8, 0, 8}},                     // & < > " '
+    {{3, 3, 7, 3, 3, 3, 3, 7, 3, 3, 3, 3, 35, 3, 3, 131,                 // 0x00-0x1F " ' backslash
+      255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}}, // 0x7F-0xFF
+    {{0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 1, 0, 4, 1}},                        // , " CR LF
+};
+
+// Write the escape for c into buf, which has room for 6 bytes. Returns
+// its length.
+static inline size_t
+str_escape_byte_(StrEscape dialect, unsigned char c, char *buf)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char *named = STR_NULL;
+    switch (dialect) {
+    case STR_ESCAPE_JSON:
+        switch (c) {
+        case '"':  named = "\\\""; break;
+        case '\\': named = "\\\\"; break;
+        case '\b': named = "\\b"; break;
+        case '\f': named = "\\f"; break;
+        case '\n': named = "\\n"; break;
+        case '\r': named = "\\r"; break;
+        case '\t': named = "\\t"; break;
+        default:
+            memcpy(buf, "\\u00", 4);
+            buf[4] = hex[c >> 4];
+            buf[5] = hex[c & 15];
+            return 6;
+        }
+        break;
+    case STR_ESCAPE_HTML:
+        switch (c) {
+        case '&': named = "&amp;"; break;
+        case '<': named = "&lt;"; break;
+        case '>': named = "&gt;"; break;
+        case '"': named = "&quot;"; break;
+        default:  named = "&#39;"; break;
+        }
+        break;
+    case STR_ESCAPE_C:
+        switch (c) {
+        case '"':  named = "\\\""; break;
+        case '\'': named = "\\'"; break;
+        case '\\': named = "\\\\"; break;
+        case '\a': named = "\\a"; break;
+        case '\b': named = "\\b"; break;
+        case '\f': named = "\\f"; break;
+        case '\n': named = "\\n"; break;
+        case '\r': named = "\\r"; break;
+        case '\t': named = "\\t"; break;
+        case '\v': named = "\\v"; break;
+        default:
+            // Always three digits, so a following digit is not taken in
+            buf[0] = '\\';
+            buf[1] = (char)('0' + (c >> 6));
+            buf[2] = (char)('0' + ((c >> 3) & 7));
+            buf[3] = (char)('0' + (c & 7));
+            return 4;
+        }
+        break;
+    case STR_ESCAPE_CSV:
+        if (c != '"') {
+            buf[0] = (char)c;
+            return 1;
+        }
+        named = "\"\"";
+        break;
+    }
+    size_t n = strlen(named);
+    memcpy(buf, named, n);
+    return n;
+}
+
+STRDEF bool
+str_append_escaped(String *out, const char *data, size_t len, StrEscape dialect) STR_NOEXCEPT
+{
+    if (!out || (!data && len) || (unsigned)dialect > (unsigned)STR_ESCAPE_CSV) return false;
+    if (len > SIZE_MAX / 8) return false; // Overflow protection
+    const StrByteSet *set = &str_escape_sets_[dialect];
+    const unsigned char *p = (const unsigned char *)data;
+    uint64_t masks[64];
+    char piece[8];
+
+    // Measure: the input plus what each escape adds
+    size_t total = len, found = 0;
+    for (size_t chunk = 0; chunk < len; chunk += 64 * 64) {
+        size_t n = len - chunk < 64 * 64 ? len - chunk : 64 * 64;
+        str_set_masks_(p + chunk, n, set, masks);
+        for (size_t b = 0; 64 * b < n; ++b) {
+            for (uint64_t m = masks[b]; m; m &= m - 1) {
+                total += str_escape_byte_(dialect, p[chunk + 64 * b + str_ctz64_(m)], piece) - 1;
+                found++;
+            }
+        }
+    }
+    bool quote = dialect == STR_ESCAPE_CSV && found;
+    if (quote) total += 2;
+    if (str_would_overflow_(out->size, total) || !str_reserve(out, out->size + total)) return false; // Overflow protection
+    if (total == 0) return true;
+
+    char *dst = out->buffer + out->size;
+    if (quote) *dst++ = '"';
+    if (!found) {
+        memcpy(dst, p, len);
+        dst += len;
+    }
+    for (size_t chunk = 0; found && chunk < len; chunk += 64 * 64) {
+        size_t n = len - chunk < 64 * 64 ? len - chunk : 64 * 64;
+        str_set_masks_(p + chunk, n, set, masks);
+        size_t i = chunk;
+        for (size_t b = 0; 64 * b < n; ++b) {
+            for (uint64_t m = masks[b]; m; m &= m - 1) {
+                size_t at = chunk + 64 * b + str_ctz64_(m);
+                memcpy(dst, p + i, at - i);
+                dst += at - i;
+                dst += str_escape_byte_(dialect, p[at], dst);
+                i = at + 1;
+            }
+        }
+        memcpy(dst, p + i, chunk + n - i);
+        dst += chunk + n - i;
+    }
+    if (quote) *dst++ = '"';
+    out->size += total;
+    out->buffer[out->size] = '\0';
+    return true;
+}
+
+// Four hex digits at p, if there are
+static inline bool
+str_hex4_(const unsigned char *p, size_t avail, uint32_t *value)
+{
+    if (avail < 4) return false;
+    uint32_t v = 0;
+    for (int k = 0; k < 4; ++k) {
+        int d = str_hex_value_(p[k]);
+        if (d < 0) return false;
+        v = v << 4 | (uint32_t)d;
+    }
+    *value = v;
+    return true;
+}
+
+// Each unescaper writes through *out and returns the offset of the first
+// bad escape, or SIZE_MAX
+
+static inline size_t
+str_unescape_json_(const unsigned char *p, size_t len, unsigned char **out)
+{
+    unsigned char *dst = *out;
+    size_t i = 0;
+    while (i < len) {
+        size_t at = str_set_scan_(p + i, len - i, &str_escape_sets_[STR_ESCAPE_JSON], true, false);
+        size_t run = at == SIZE_MAX ? len - i : at;
+        memcpy(dst, p + i, run);
+        dst += run;
+        i += run;
+        if (i == len) break;
+        // A raw quote or control byte, or a backslash ending the input
+        if (p[i] != '\\' || i + 1 == len) return i;
+
+        unsigned char c = p[i + 1];
+        if (c == 'u') {
+            uint32_t cp, low;
+            if (!str_hex4_(p + i + 2, len - i - 2, &cp)) return i;
+            size_t used = 6;
+            if (cp >= 0xD800 && cp <= 0xDBFF) {
+                if (len - i < 12 || p[i + 6] != '\\' || p[i + 7] != 'u' || !str_hex4_(p + i + 8, 4, &low) ||
+                    low < 0xDC00 || low > 0xDFFF) {
+                    return i;
+                }
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                used = 12;
+            } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                return i;
+            }
+            dst += str_utf8_encode_(dst, cp);
+            i += used;
+            continue;
+        }
+        switch (c) {
+        case '"': case '\\': case '/': *dst++ = c; break;
+        case 'b': *dst++ = '\b'; break;
+        case 'f': *dst++ = '\f'; break;
+        case 'n': *dst++ = '\n'; break;
+        case 'r': *dst++ = '\r'; break;
+        case 't': *dst++ = '\t'; break;
+        default:  return i;
+        }
+        i += 2;
+    }
+    *out = dst;
+    return SIZE_MAX;
+}
+
+static inline size_t
+str_unescape_html_(const unsigned char *p, size_t len, unsigned char **out)
+{
+    unsigned char *dst = *out;
+    size_t i = 0;
+    while (i < len) {
+        const unsigned char *amp = (const unsigned char *)memchr(p + i, '&', len - i);
+        size_t run = amp ? (size_t)(amp - (p + i)) : len - i;
+        memcpy(dst, p + i, run);
+        dst += run;
+        i += run;
+        if (i == len) break;
+
+        // The longest accepted entity is &#1114111; or &#x10FFFF;
+        size_t limit = len - i < 11 ? len - i : 11, semi = 1;
+        while (semi < limit && p[i + semi] != ';') semi++;
+        if (semi == limit) return i;
+        const char *name = (const char *)p + i + 1;
+        size_t n = semi - 1;
+
+        if (n == 3 && memcmp(name, "amp", 3) == 0)       *dst++ = '&';
+        else if (n == 2 && memcmp(name, "lt", 2) == 0)   *dst++ = '<';
+        else if (n == 2 && memcmp(name, "gt", 2) == 0)   *dst++ = '>';
+        else if (n == 4 && memcmp(name, "quot", 4) == 0) *dst++ = '"';
+        else if (n == 4 && memcmp(name, "apos", 4) == 0) *dst++ = '\'';
+        else if (n >= 2 && name[0] == '#') {
+            bool hex = name[1] == 'x' || name[1] == 'X';
+            size_t k = hex ? 2 : 1;
+            if (k == n) return i;
+            uint32_t cp = 0;
+            for (; k < n; ++k) {
+                int d = hex ? str_hex_value_((unsigned char)name[k])
+                            : (name[k] >= '0' && name[k] <= '9' ? name[k] - '0' : -1);
+                if (d < 0) return i;
+                cp = cp * (hex ? 16u : 10u) + (uint32_t)d;
+            }
+            if (cp == 0 || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) return i;
+            dst += str_utf8_encode_(dst, cp);
+        } else {
+            return i;
+        }
+        i += semi + 1;
+    }
+    *out = dst;
+    return SIZE_MAX;
+}
+
+static inline size_t
+str_unescape_c_(const unsigned char *p, size_t len, unsigned char **out)
+{
+    unsigned char *dst = *out;
+    size_t i = 0;
+    while (i < len) {
+        const unsigned char *bs = (const unsigned char *)memchr(p + i, '\\', len - i);
+        size_t run = bs ? (size_t)(bs - (p + i)) : len - i;
+        memcpy(dst, p + i, run);
+        dst += run;
+        i += run;
+        if (i == len) break;
+        if (i + 1 == len) return i;
+
+        unsigned char c = p[i + 1];
+        size_t k = i + 1;
+        if (c >= '0' && c <= '7') {
+            unsigned v = 0;
+            for (; k < len && k < i + 4 && p[k] >= '0' && p[k] <= '7'; ++k) v = v * 8 + (unsigned)(p[k] - '0');
+            if (v > 0xFF) return i;
+            *dst++ = (unsigned char)v;
+            i = k;
+            continue;
+        }
+        if (c == 'x') {
+            unsigned v = 0;
+            int d;
+            for (k = i + 2; k < len && (d = str_hex_value_(p[k])) >= 0; ++k) {
+                v = v * 16 + (unsigned)d;
+                if (v > 0xFF) return i;
+            }
+            if (k == i + 2) return i;
+            *dst++ = (unsigned char)v;
+            i = k;
+            continue;
+        }
+        switch (c) {
+        case '"': case '\'': case '\\': case '?': *dst++ = c; break;
+        case 'a': *dst++ = '\a'; break;
+        case 'b': *dst++ = '\b'; break;
+        case 'f': *dst++ = '\f'; break;
+        case 'n': *dst++ = '\n'; break;
+        case 'r': *dst++ = '\r'; break;
+        case 't': *dst++ = '\t'; break;
+        case 'v': *dst++ = '\v'; break;
+        default:  return i;
+        }
+        i += 2;
+    }
+    *out = dst;
+    return SIZE_MAX;
+}
+
+static inline size_t
+str_unescape_csv_(const unsigned char *p, size_t len, unsigned char **out)
+{
+    unsigned char *dst = *out;
+    if (len == 0 || p[0] != '"') {
+        // Unquoted: a quote has no business here
+        const unsigned char *q = len ? (const unsigned char *)memchr(p, '"', len) : STR_NULL;
+        if (q) return (size_t)(q - p);
+        if (len) memcpy(dst, p, len);
+        *out = dst + len;
+        return SIZE_MAX;
+    }
+    if (len < 2 || p[len - 1] != '"') return len;
+    size_t i = 1, end = len - 1;
+    while (i < end) {
+        const unsigned char *q = (const unsigned char *)memchr(p + i, '"', end - i);
+        size_t run = q ? (size_t)(q - (p + i)) : end - i;
+        memcpy(dst, p + i, run);
+        dst += run;
+        i += run;
+        if (i == end) break;
+        if (i + 1 == end || p[i + 1] != '"') return i;
+        *dst++ = '"';
+        i += 2;
+    }
+    *out = dst;
+    return SIZE_MAX;
+}
+
+STRDEF bool
+str_append_unescaped(String *out, const char *data, size_t len, StrEscape dialect, size_t *bad_offset) STR_NOEXCEPT
+{
+    if (!out || (!data && len) || (unsigned)dialect > (unsigned)STR_ESCAPE_CSV) return false;
+    if (str_would_overflow_(out->size, len) || !str_reserve(out, out->size + len)) { // Overflow protection
+        if (bad_offset) *bad_offset = SIZE_MAX;
+        return false;
+    }
+
+    const unsigned char *p = (const unsigned char *)data;
+    unsigned char *start = (unsigned char *)out->buffer + out->size, *dst = start;
+    size_t bad = SIZE_MAX;
+    switch (dialect) {
+    case STR_ESCAPE_JSON: bad = str_unescape_json_(p, len, &dst); break;
+    case STR_ESCAPE_HTML: bad = str_unescape_html_(p, len, &dst); break;
+    case STR_ESCAPE_C:    bad = str_unescape_c_(p, len, &dst); break;
+    case STR_ESCAPE_CSV:  bad = str_unescape_csv_(p, len, &dst); break;
+    }
+    if (bad != SIZE_MAX) {
+        out->buffer[out->size] = '\0';
+        if (bad_offset) *bad_offset = bad;
+        return false;
+    }
+    out->size += (size_t)(dst - start);
+    out->buffer[out->size] = '\0';
+    return true;
+}
+
+//
+// URLs
+//
+
+// Everything but A-Z a-z 0-9 - . _ ~, and the two bytes decoding acts on
+static const StrByteSet str_url_reserved_ = {{87, 7, 7, 7, 7, 7, 7, 7, 7, 7, 15, 175, 175, 171, 43, 143,
+                                              255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}};
+static const StrByteSet str_url_decode_set_ = {{0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 4}}; // % +
+
+STRDEF bool
+str_append_url_encoded(String *out, const char *data, size_t len, bool form) STR_NOEXCEPT
+{
+    if (!out || (!data && len)) return false;
+    if (len > SIZE_MAX / 4) return false; // Overflow protection
+    const unsigned char *p = (const unsigned char *)data;
+    uint64_t masks[64];
+
+    size_t total = len;
+    for (size_t chunk = 0; chunk < len; chunk += 64 * 64) {
+        size_t n = len - chunk < 64 * 64 ? len - chunk : 64 * 64;
+        str_set_masks_(p + chunk, n, &str_url_reserved_, masks);
+        for (size_t b = 0; 64 * b < n; ++b) {
+            for (uint64_t m = masks[b]; m; m &= m - 1) {
+                total += form && p[chunk + 64 * b + str_ctz64_(m)] == ' ' ? 0 : 2;
+            }
+        }
+    }
+    if (str_would_overflow_(out->size, total) || !str_reserve(out, out->size + total)) return false; // Overflow protection
+    if (len == 0) return true;
+
+    char *dst = out->buffer + out->size;
+    if (total == len && !form) {
+        memcpy(dst, p, len);
+    } else {
+        for (size_t chunk = 0; chunk < len; chunk += 64 * 64) {
+            size_t n = len - chunk < 64 * 64 ? len - chunk : 64 * 64;
+            str_set_masks_(p + chunk, n, &str_url_reserved_, masks);
+            size_t i = chunk;
+            for (size_t b = 0; 64 * b < n; ++b) {
+                for (uint64_t m = masks[b]; m; m &= m - 1) {
+                    size_t at = chunk + 64 * b + str_ctz64_(m);
+                    memcpy(dst, p + i, at - i);
+                    dst += at - i;
+                    if (form && p[at] == ' ') {
+                        *dst++ = '+';
+                    } else {
+                        dst[0] = '%';
+                        dst[1] = "0123456789ABCDEF"[p[at] >> 4];
+                        dst[2] = "0123456789ABCDEF"[p[at] & 15];
+                        dst += 3;
+                    }
+                    i = at + 1;
+                }
+            }
+            memcpy(dst, p + i, chunk + n - i);
+            dst += chunk + n - i;
+        }
+    }
+    out->size += total;
+    out->buffer[out->size] = '\0';
+    return true;
+}
+
+// Decode p[0, n) in place and return the new length. A '%' without two hex
+// digits is copied as it is.
+static inline size_t
+str_url_decode_span_(char *p, size_t n, bool form)
+{
+    const unsigned char *u = (const unsigned char *)p;
+    size_t i = 0, j = 0;
+    while (i < n) {
+        size_t run = n - i;
+        if (form) {
+            size_t at = str_set_scan_(u + i, n - i, &str_url_decode_set_, true, false);
+            if (at != SIZE_MAX) run = at;
+        } else {
+            const char *pct = (const char *)memchr(p + i, '%', n - i);
+            if (pct) run = (size_t)(pct - (p + i));
+        }
+        if (j != i) memmove(p + j, p + i, run);
+        i += run;
+        j += run;
+        if (i == n) break;
+        if (p[i] == '+') {
+            p[j++] = ' ';
+            i++;
+            continue;
+        }
+        int hi = i + 2 < n ? str_hex_value_(u[i + 1]) : -1;
+        int lo = hi >= 0 ? str_hex_value_(u[i + 2]) : -1;
+        if (lo < 0) {
+            p[j++] = p[i++];
+            continue;
+        }
+        p[j++] = (char)(hi << 4 | lo);
+        i += 3;
+    }
+    return j;
+}
+
+STRDEF bool
+str_url_decode_inplace(String *str, bool form, size_t *bad_offset) STR_NOEXCEPT
+{
+    if (!str) return false;
+    if (str->size == 0) return true;
+
+    // Check every '%' first, so a failure leaves str as it was
+    const char *p = str->buffer, *end = str->buffer + str->size;
+    while ((p = (const char *)memchr(p, '%', (size_t)(end - p))) != STR_NULL) {
+        if (end - p < 3 || str_hex_value_((unsigned char)p[1]) < 0 || str_hex_value_((unsigned char)p[2]) < 0) {
+            if (bad_offset) *bad_offset = (size_t)(p - str->buffer);
+            return false;
+        }
+        p += 3;
+    }
+
+    str->size = str_url_decode_span_(str->buffer, str->size, form);
+    str->buffer[str->size] = '\0';
+    return true;
+}
+
+STRDEF StrQueryIter
+str_query_iter(String *str) STR_NOEXCEPT
+{
+    StrQueryIter it = {STR_NULL, 0, 0};
+    if (str && str->buffer) {
+        it.data = str->buffer;
+        it.size = str->size;
+        if (it.size && it.data[0] == '?') it.pos = 1;
+    }
+    return it;
+}
+
+STRDEF bool
+str_query_next(StrQueryIter *it, StrSlice *key, StrSlice *value) STR_NOEXCEPT
+{
+    if (!it || !it->data) return false;
+    while (it->pos < it->size) {
+        char *start = it->data + it->pos;
+        size_t left = it->size - it->pos;
+        const char *amp = (const char *)memchr(start, '&', left);
+        size_t n = amp ? (size_t)(amp - start) : left;
+        it->pos += n + (amp ? 1 : 0);
+        if (n == 0) continue;
+
+        const char *eq = (const char *)memchr(start, '=', n);
+        size_t klen = eq ? (size_t)(eq - start) : n;
+        char *val = start + klen + (eq ? 1 : 0);
+        size_t vlen = eq ? n - klen - 1 : 0;
+        klen = str_url_decode_span_(start, klen, true);
+        vlen = str_url_decode_span_(val, vlen, true);
+        if (key) *key = str_slice_n(start, klen);
+        if (value) *value = str_slice_n(vlen ? val : "", vlen);
+        return true;
+    }
+    return false;
+}
+
+//
+// Numbers
+//
+
+// Eight ASCII digits in one little endian word, tested and combined
+// without a loop. The first digit is in the low byte.
+static inline uint64_t
+str_read_le64_(const unsigned char *p)
+{
+#if defined(STR_BIG_ENDIAN_)
+    return str_bswap64_(str_read64_(p));
+#else
+    return str_read64_(p);
+#endif
+}
+
+static inline bool
+str_eight_digits_(uint64_t v)
+{
+    return (((v + 0x4646464646464646ull) | (v - 0x3030303030303030ull)) & 0x8080808080808080ull) == 0;
+}
+
+static inline uint64_t
+str_eight_value_(uint64_t v)
+{
+    v -= 0x3030303030303030ull;
+    v = v * 10 + (v >> 8);
+    v = ((v & 0x000000FF000000FFull) * (100 + (1000000ull << 32)) +
+         ((v >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32))) >> 32;
+    return (uint32_t)v;
+}
+
+// Add the leading digits of p[0, n) to *acc and return how many there
+// were. *acc wraps once there are more than 19.
+static inline size_t
+str_parse_digits_(const unsigned char *p, size_t n, uint64_t *acc)
+{
+    uint64_t v = *acc;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w = str_read_le64_(p + i);
+        if (!str_eight_digits_(w)) break;
+        v = v * 100000000u + str_eight_value_(w);
+    }
+    for (; i < n && (unsigned)(p[i] - '0') < 10u; ++i) v = v * 10 + (unsigned)(p[i] - '0');
+    *acc = v;
+    return i;
+}
+
+static inline size_t
+str_parse_u64_(const unsigned char *p, size_t n, uint64_t *value)
+{
+    size_t i = 0;
+    while (i < n && p[i] == '0') ++i;
+    uint64_t v = 0;
+    size_t nd = str_parse_digits_(p + i, n - i, &v);
+    if (i + nd == 0) return 0;
+    // Twenty digits may still fit, the largest value decides
+    if (nd > 20 || (nd == 20 && memcmp(p + i, "18446744073709551615", 20) > 0)) return 0;
+    *value = v;
+    return i + nd;
+}
+
+STRDEF size_t
+str_parse_u64_n(const char *data, size_t len, uint64_t *value) STR_NOEXCEPT
+{
+    if (!data || !value) return 0;
+    const unsigned char *p = (const unsigned char *)data;
+    size_t sign = len && p[0] == '+';
+    size_t used = str_parse_u64_(p + sign, len - sign, value);
+    return used ? sign + used : 0;
+}
+
+STRDEF size_t
+str_parse_u64(const String *str, uint64_t *value) STR_NOEXCEPT
+{
+    return str ? str_parse_u64_n(str->buffer, str->size, value) : 0;
+}
+
+STRDEF size_t
+str_parse_i64_n(const char *data, size_t len, int64_t *value) STR_NOEXCEPT
+{
+    if (!data || !value) return 0;
+    const unsigned char *p = (const unsigned char *)data;
+    size_t sign = len && (p[0] == '+' || p[0] == '-');
+    bool neg = sign && p[0] == '-';
+    uint64_t mag;
+    size_t used = str_parse_u64_(p + sign, len - sign, &mag);
+    if (!used || mag > (uint64_t)INT64_MAX + neg) return 0;
+    *value = neg && mag ? -(int64_t)(mag - 1) - 1 : (int64_t)mag;
+    return sign + used;
+}
+
+STRDEF size_t
+str_parse_i64(const String *str, int64_t *value) STR_NOEXCEPT
+{
+    return str ? str_parse_i64_n(str->buffer, str->size, value) : 0;
+}
+
+// 10^e for e in [-348, 347] as {high, low} 128-bit mantissas with the top
+// bit set, rounded down
+static const uint64_t str_pow10_128_[696][2] = {
+    {0xfa8fd5a0081c0288ull, 0x1732c869cd60e453ull}, {0x9c99e58405118195ull, 0x0e7fbd42205c8eb4ull},
+    {0xc3c05ee50655e1faull, 0x521fac92a873b261ull}, {0xf4b0769e47eb5a78ull, 0xe6a797b752909ef9ull},
+    {0x98ee4a22ecf3188bull, 0x9028bed2939a635cull}, {0xbf29dcaba82fdeaeull, 0x7432ee873880fc33ull},
+    {0xeef453d6923bd65aull, 0x113faa2906a13b3full}, {0x9558b4661b6565f8ull, 0x4ac7ca59a424c507ull},
+    {0xbaaee17fa23ebf76ull, 0x5d79bcf00d2df649ull}, {0xe95a99df8ace6f53ull, 0xf4d82c2c107973dcull},
+    {0x91d8a02bb6c10594ull, 0x79071b9b8a4be869ull}, {0xb64ec836a47146f9ull, 0x9748e2826cdee284ull},
+    {0xe3e27a444d8d98b7ull, 0xfd1b1b2308169b25ull}, {0x8e6d8c6ab0787f72ull, 0xfe30f0f5e50e20f7ull},
+    {0xb208ef855c969f4full, 0xbdbd2d335e51a935ull}, {0xde8b2b66b3bc4723ull, 0xad2c788035e61382ull},
+    {0x8b16fb203055ac76ull, 0x4c3bcb5021afcc31ull}, {0xaddcb9e83c6b1793ull, 0xdf4abe242a1bbf3dull},
+    {0xd953e8624b85dd78ull, 0xd71d6dad34a2af0dull}, {0x87d4713d6f33aa6bull, 0x8672648c40e5ad68ull},
+    {0xa9c98d8ccb009506ull, 0x680efdaf511f18c2ull}, {0xd43bf0effdc0ba48ull, 0x0212bd1b2566def2ull},
+    {0x84a57695fe98746dull, 0x014bb630f7604b57ull}, {0xa5ced43b7e3e9188ull, 0x419ea3bd35385e2dull},
+    {0xcf42894a5dce35eaull, 0x52064cac828675b9ull}, {0x818995ce7aa0e1b2ull, 0x7343efebd1940993ull},
+    {0xa1ebfb4219491a1full, 0x1014ebe6c5f90bf8ull}, {0xca66fa129f9b60a6ull, 0xd41a26e077774ef6ull},
+    {0xfd00b897478238d0ull, 0x8920b098955522b4ull}, {0x9e20735e8cb16382ull, 0x55b46e5f5d5535b0ull},
+    {0xc5a890362fddbc62ull, 0xeb2189f734aa831dull}, {0xf712b443bbd52b7bull, 0xa5e9ec7501d523e4ull},
+    {0x9a6bb0aa55653b2dull, 0x47b233c92125366eull}, {0xc1069cd4eabe89f8ull, 0x999ec0bb696e840aull},
+    {0xf148440a256e2c76ull, 0xc00670ea43ca250dull}, {0x96cd2a865764dbcaull, 0x380406926a5e5728ull},
+    {0xbc807527ed3e12bcull, 0xc605083704f5ecf2ull}, {0xeba09271e88d976bull, 0xf7864a44c633682eull},
+    {0x93445b8731587ea3ull, 0x7ab3ee6afbe0211dull}, {0xb8157268fdae9e4cull, 0x5960ea05bad82964ull},
+    {0xe61acf033d1a45dfull, 0x6fb92487298e33bdull}, {0x8fd0c16206306babull, 0xa5d3b6d479f8e056ull},
+    {0xb3c4f1ba87bc8696ull, 0x8f48a4899877186cull}, {0xe0b62e2929aba83cull, 0x331acdabfe94de87ull},
+    {0x8c71dcd9ba0b4925ull, 0x9ff0c08b7f1d0b14ull}, {0xaf8e5410288e1b6full, 0x07ecf0ae5ee44dd9ull},
+    {0xdb71e91432b1a24aull, 0xc9e82cd9f69d6150ull}, {0x892731ac9faf056eull, 0xbe311c083a225cd2ull},
+    {0xab70fe17c79ac6caull, 0x6dbd630a48aaf406ull}, {0xd64d3d9db981787dull, 0x092cbbccdad5b108ull},
+    {0x85f0468293f0eb4eull, 0x25bbf56008c58ea5ull}, {0xa76c582338ed2621ull, 0xaf2af2b80af6f24eull},
+    {0xd1476e2c07286faaull, 0x1af5af660db4aee1ull}, {0x82cca4db847945caull, 0x50d98d9fc890ed4dull},
+    {0xa37fce126597973cull, 0xe50ff107bab528a0ull}, {0xcc5fc196fefd7d0cull, 0x1e53ed49a96272c8ull},
+    {0xff77b1fcbebcdc4full, 0x25e8e89c13bb0f7aull}, {0x9faacf3df73609b1ull, 0x77b191618c54e9acull},
+    {0xc795830d75038c1dull, 0xd59df5b9ef6a2417ull}, {0xf97ae3d0d2446f25ull, 0x4b0573286b44ad1dull},
+    {0x9becce62836ac577ull, 0x4ee367f9430aec32ull}, {0xc2e801fb244576d5ull, 0x229c41f793cda73full},
+    {0xf3a20279ed56d48aull, 0x6b43527578c1110full}, {0x9845418c345644d6ull, 0x830a13896b78aaa9ull},
+    {0xbe5691ef416bd60cull, 0x23cc986bc656d553ull}, {0xedec366b11c6cb8full, 0x2cbfbe86b7ec8aa8ull},
+    {0x94b3a202eb1c3f39ull, 0x7bf7d71432f3d6a9ull}, {0xb9e08a83a5e34f07ull, 0xdaf5ccd93fb0cc53ull},
+    {0xe858ad248f5c22c9ull, 0xd1b3400f8f9cff68ull}, {0x91376c36d99995beull, 0x23100809b9c21fa1ull},
+    {0xb58547448ffffb2dull, 0xabd40a0c2832a78aull}, {0xe2e69915b3fff9f9ull, 0x16c90c8f323f516cull},
+    {0x8dd01fad907ffc3bull, 0xae3da7d97f6792e3ull}, {0xb1442798f49ffb4aull, 0x99cd11cfdf41779cull},
+    {0xdd95317f31c7fa1dull, 0x40405643d711d583ull}, {0x8a7d3eef7f1cfc52ull, 0x482835ea666b2572ull},
+    {0xad1c8eab5ee43b66ull, 0xda3243650005eecfull}, {0xd863b256369d4a40ull, 0x90bed43e40076a82ull},
+    {0x873e4f75e2224e68ull, 0x5a7744a6e804a291ull}, {0xa90de3535aaae202ull, 0x711515d0a205cb36ull},
+    {0xd3515c2831559a83ull, 0x0d5a5b44ca873e03ull}, {0x8412d9991ed58091ull, 0xe858790afe9486c2ull},
+    {0xa5178fff668ae0b6ull, 0x626e974dbe39a872ull}, {0xce5d73ff402d98e3ull, 0xfb0a3d212dc8128full},
+    {0x80fa687f881c7f8eull, 0x7ce66634bc9d0b99ull}, {0xa139029f6a239f72ull, 0x1c1fffc1ebc44e80ull},
+    {0xc987434744ac874eull, 0xa327ffb266b56220ull}, {0xfbe9141915d7a922ull, 0x4bf1ff9f0062baa8ull},
+    {0x9d71ac8fada6c9b5ull, 0x6f773fc3603db4a9ull}, {0xc4ce17b399107c22ull, 0xcb550fb4384d21d3ull},
+    {0xf6019da07f549b2bull, 0x7e2a53a146606a48ull}, {0x99c102844f94e0fbull, 0x2eda7444cbfc426dull},
+    {0xc0314325637a1939ull, 0xfa911155fefb5308ull}, {0xf03d93eebc589f88ull, 0x793555ab7eba27caull},
+    {0x96267c7535b763b5ull, 0x4bc1558b2f3458deull}, {0xbbb01b9283253ca2ull, 0x9eb1aaedfb016f16ull},
+    {0xea9c227723ee8bcbull, 0x465e15a979c1cadcull}, {0x92a1958a7675175full, 0x0bfacd89ec191ec9ull},
+    {0xb749faed14125d36ull, 0xcef980ec671f667bull}, {0xe51c79a85916f484ull, 0x82b7e12780e7401aull},
+    {0x8f31cc0937ae58d2ull, 0xd1b2ecb8b0908810ull}, {0xb2fe3f0b8599ef07ull, 0x861fa7e6dcb4aa15ull},
+    {0xdfbdcece67006ac9ull, 0x67a791e093e1d49aull}, {0x8bd6a141006042bdull, 0xe0c8bb2c5c6d24e0ull},
+    {0xaecc49914078536dull, 0x58fae9f773886e18ull}, {0xda7f5bf590966848ull, 0xaf39a475506a899eull},
+    {0x888f99797a5e012dull, 0x6d8406c952429603ull}, {0xaab37fd7d8f58178ull, 0xc8e5087ba6d33b83ull},
+    {0xd5605fcdcf32e1d6ull, 0xfb1e4a9a90880a64ull}, {0x855c3be0a17fcd26ull, 0x5cf2eea09a55067full},
+    {0xa6b34ad8c9dfc06full, 0xf42faa48c0ea481eull}, {0xd0601d8efc57b08bull, 0xf13b94daf124da26ull},
+    {0x823c12795db6ce57ull, 0x76c53d08d6b70858ull}, {0xa2cb1717b52481edull, 0x54768c4b0c64ca6eull},
+    {0xcb7ddcdda26da268ull, 0xa9942f5dcf7dfd09ull}, {0xfe5d54150b090b02ull, 0xd3f93b35435d7c4cull},
+    {0x9efa548d26e5a6e1ull, 0xc47bc5014a1a6dafull}, {0xc6b8e9b0709f109aull, 0x359ab6419ca1091bull},
+    {0xf867241c8cc6d4c0ull, 0xc30163d203c94b62ull}, {0x9b407691d7fc44f8ull, 0x79e0de63425dcf1dull},
+    {0xc21094364dfb5636ull, 0x985915fc12f542e4ull}, {0xf294b943e17a2bc4ull, 0x3e6f5b7b17b2939dull},
+    {0x979cf3ca6cec5b5aull, 0xa705992ceecf9c42ull}, {0xbd8430bd08277231ull, 0x50c6ff782a838353ull},
+    {0xece53cec4a314ebdull, 0xa4f8bf5635246428ull}, {0x940f4613ae5ed136ull, 0x871b7795e136be99ull},
+    {0xb913179899f68584ull, 0x28e2557b59846e3full}, {0xe757dd7ec07426e5ull, 0x331aeada2fe589cfull},
+    {0x9096ea6f3848984full, 0x3ff0d2c85def7621ull}, {0xb4bca50b065abe63ull, 0x0fed077a756b53a9ull},
+    {0xe1ebce4dc7f16dfbull, 0xd3e8495912c62894ull}, {0x8d3360f09cf6e4bdull, 0x64712dd7abbbd95cull},
+    {0xb080392cc4349decull, 0xbd8d794d96aacfb3ull}, {0xdca04777f541c567ull, 0xecf0d7a0fc5583a0ull},
+    {0x89e42caaf9491b60ull, 0xf41686c49db57244ull}, {0xac5d37d5b79b6239ull, 0x311c2875c522ced5ull},
+    {0xd77485cb25823ac7ull, 0x7d633293366b828bull}, {0x86a8d39ef77164bcull, 0xae5dff9c02033197ull},
+    {0xa8530886b54dbdebull, 0xd9f57f830283fdfcull}, {0xd267caa862a12d66ull, 0xd072df63c324fd7bull},
+    {0x8380dea93da4bc60ull, 0x4247cb9e59f71e6dull}, {0xa46116538d0deb78ull, 0x52d9be85f074e608ull},
+    {0xcd795be870516656ull, 0x67902e276c921f8bull}, {0x806bd9714632dff6ull, 0x00ba1cd8a3db53b6ull},
+    {0xa086cfcd97bf97f3ull, 0x80e8a40eccd228a4ull}, {0xc8a883c0fdaf7df0ull, 0x6122cd128006b2cdull},
+    {0xfad2a4b13d1b5d6cull, 0x796b805720085f81ull}, {0x9cc3a6eec6311a63ull, 0xcbe3303674053bb0ull},
+    {0xc3f490aa77bd60fcull, 0xbedbfc4411068a9cull}, {0xf4f1b4d515acb93bull, 0xee92fb5515482d44ull},
+    {0x991711052d8bf3c5ull, 0x751bdd152d4d1c4aull}, {0xbf5cd54678eef0b6ull, 0xd262d45a78a0635dull},
+    {0xef340a98172aace4ull, 0x86fb897116c87c34ull}, {0x9580869f0e7aac0eull, 0xd45d35e6ae3d4da0ull},
+    {0xbae0a846d2195712ull, 0x8974836059cca109ull}, {0xe998d258869facd7ull, 0x2bd1a438703fc94bull},
+    {0x91ff83775423cc06ull, 0x7b6306a34627ddcfull}, {0xb67f6455292cbf08ull, 0x1a3bc84c17b1d542ull},
+    {0xe41f3d6a7377eecaull, 0x20caba5f1d9e4a93ull}, {0x8e938662882af53eull, 0x547eb47b7282ee9cull},
+    {0xb23867fb2a35b28dull, 0xe99e619a4f23aa43ull}, {0xdec681f9f4c31f31ull, 0x6405fa00e2ec94d4ull},
+    {0x8b3c113c38f9f37eull, 0xde83bc408dd3dd04ull}, {0xae0b158b4738705eull, 0x9624ab50b148d445ull},
+    {0xd98ddaee19068c76ull, 0x3badd624dd9b0957ull}, {0x87f8a8d4cfa417c9ull, 0xe54ca5d70a80e5d6ull},
+    {0xa9f6d30a038d1dbcull, 0x5e9fcf4ccd211f4cull}, {0xd47487cc8470652bull, 0x7647c3200069671full},
+    {0x84c8d4dfd2c63f3bull, 0x29ecd9f40041e073ull}, {0xa5fb0a17c777cf09ull, 0xf468107100525890ull},
+    {0xcf79cc9db955c2ccull, 0x7182148d4066eeb4ull}, {0x81ac1fe293d599bfull, 0xc6f14cd848405530ull},
+    {0xa21727db38cb002full, 0xb8ada00e5a506a7cull}, {0xca9cf1d206fdc03bull, 0xa6d90811f0e4851cull},
+    {0xfd442e4688bd304aull, 0x908f4a166d1da663ull}, {0x9e4a9cec15763e2eull, 0x9a598e4e043287feull},
+    {0xc5dd44271ad3cdbaull, 0x40eff1e1853f29fdull}, {0xf7549530e188c128ull, 0xd12bee59e68ef47cull},
+    {0x9a94dd3e8cf578b9ull, 0x82bb74f8301958ceull}, {0xc13a148e3032d6e7ull, 0xe36a52363c1faf01ull},
+    {0xf18899b1bc3f8ca1ull, 0xdc44e6c3cb279ac1ull}, {0x96f5600f15a7b7e5ull, 0x29ab103a5ef8c0b9ull},
+    {0xbcb2b812db11a5deull, 0x7415d448f6b6f0e7ull}, {0xebdf661791d60f56ull, 0x111b495b3464ad21ull},
+    {0x936b9fcebb25c995ull, 0xcab10dd900beec34ull}, {0xb84687c269ef3bfbull, 0x3d5d514f40eea742ull},
+    {0xe65829b3046b0afaull, 0x0cb4a5a3112a5112ull}, {0x8ff71a0fe2c2e6dcull, 0x47f0e785eaba72abull},
+    {0xb3f4e093db73a093ull, 0x59ed216765690f56ull}, {0xe0f218b8d25088b8ull, 0x306869c13ec3532cull},
+    {0x8c974f7383725573ull, 0x1e414218c73a13fbull}, {0xafbd2350644eeacfull, 0xe5d1929ef90898faull},
+    {0xdbac6c247d62a583ull, 0xdf45f746b74abf39ull}, {0x894bc396ce5da772ull, 0x6b8bba8c328eb783ull},
+    {0xab9eb47c81f5114full, 0x066ea92f3f326564ull}, {0xd686619ba27255a2ull, 0xc80a537b0efefebdull},
+    {0x8613fd0145877585ull, 0xbd06742ce95f5f36ull}, {0xa798fc4196e952e7ull, 0x2c48113823b73704ull},
+    {0xd17f3b51fca3a7a0ull, 0xf75a15862ca504c5ull}, {0x82ef85133de648c4ull, 0x9a984d73dbe722fbull},
+    {0xa3ab66580d5fdaf5ull, 0xc13e60d0d2e0ebbaull}, {0xcc963fee10b7d1b3ull, 0x318df905079926a8ull},
+    {0xffbbcfe994e5c61full, 0xfdf17746497f7052ull}, {0x9fd561f1fd0f9bd3ull, 0xfeb6ea8bedefa633ull},
+    {0xc7caba6e7c5382c8ull, 0xfe64a52ee96b8fc0ull}, {0xf9bd690a1b68637bull, 0x3dfdce7aa3c673b0ull},
+    {0x9c1661a651213e2dull, 0x06bea10ca65c084eull}, {0xc31bfa0fe5698db8ull, 0x486e494fcff30a62ull},
+    {0xf3e2f893dec3f126ull, 0x5a89dba3c3efccfaull}, {0x986ddb5c6b3a76b7ull, 0xf89629465a75e01cull},
+    {0xbe89523386091465ull, 0xf6bbb397f1135823ull}, {0xee2ba6c0678b597full, 0x746aa07ded582e2cull},
+    {0x94db483840b717efull, 0xa8c2a44eb4571cdcull}, {0xba121a4650e4ddebull, 0x92f34d62616ce413ull},
+    {0xe896a0d7e51e1566ull, 0x77b020baf9c81d17ull}, {0x915e2486ef32cd60ull, 0x0ace1474dc1d122eull},
+    {0xb5b5ada8aaff80b8ull, 0x0d819992132456baull}, {0xe3231912d5bf60e6ull, 0x10e1fff697ed6c69ull},
+    {0x8df5efabc5979c8full, 0xca8d3ffa1ef463c1ull}, {0xb1736b96b6fd83b3ull, 0xbd308ff8a6b17cb2ull},
+    {0xddd0467c64bce4a0ull, 0xac7cb3f6d05ddbdeull}, {0x8aa22c0dbef60ee4ull, 0x6bcdf07a423aa96bull},
+    {0xad4ab7112eb3929dull, 0x86c16c98d2c953c6ull}, {0xd89d64d57a607744ull, 0xe871c7bf077ba8b7ull},
+    {0x87625f056c7c4a8bull, 0x11471cd764ad4972ull}, {0xa93af6c6c79b5d2dull, 0xd598e40d3dd89bcfull},
+    {0xd389b47879823479ull, 0x4aff1d108d4ec2c3ull}, {0x843610cb4bf160cbull, 0xcedf722a585139baull},
+    {0xa54394fe1eedb8feull, 0xc2974eb4ee658828ull}, {0xce947a3da6a9273eull, 0x733d226229feea32ull},
+    {0x811ccc668829b887ull, 0x0806357d5a3f525full}, {0xa163ff802a3426a8ull, 0xca07c2dcb0cf26f7ull},
+    {0xc9bcff6034c13052ull, 0xfc89b393dd02f0b5ull}, {0xfc2c3f3841f17c67ull, 0xbbac2078d443ace2ull},
+    {0x9d9ba7832936edc0ull, 0xd54b944b84aa4c0dull}, {0xc5029163f384a931ull, 0x0a9e795e65d4df11ull},
+    {0xf64335bcf065d37dull, 0x4d4617b5ff4a16d5ull}, {0x99ea0196163fa42eull, 0x504bced1bf8e4e45ull},
+    {0xc06481fb9bcf8d39ull, 0xe45ec2862f71e1d6ull}, {0xf07da27a82c37088ull, 0x5d767327bb4e5a4cull},
+    {0x964e858c91ba2655ull, 0x3a6a07f8d510f86full}, {0xbbe226efb628afeaull, 0x890489f70a55368bull},
+    {0xeadab0aba3b2dbe5ull, 0x2b45ac74ccea842eull}, {0x92c8ae6b464fc96full, 0x3b0b8bc90012929dull},
+    {0xb77ada0617e3bbcbull, 0x09ce6ebb40173744ull}, {0xe55990879ddcaabdull, 0xcc420a6a101d0515ull},
+    {0x8f57fa54c2a9eab6ull, 0x9fa946824a12232dull}, {0xb32df8e9f3546564ull, 0x47939822dc96abf9ull},
+    {0xdff9772470297ebdull, 0x59787e2b93bc56f7ull}, {0x8bfbea76c619ef36ull, 0x57eb4edb3c55b65aull},
+    {0xaefae51477a06b03ull, 0xede622920b6b23f1ull}, {0xdab99e59958885c4ull, 0xe95fab368e45ecedull},
+    {0x88b402f7fd75539bull, 0x11dbcb0218ebb414ull}, {0xaae103b5fcd2a881ull, 0xd652bdc29f26a119ull},
+    {0xd59944a37c0752a2ull, 0x4be76d3346f0495full}, {0x857fcae62d8493a5ull, 0x6f70a4400c562ddbull},
+    {0xa6dfbd9fb8e5b88eull, 0xcb4ccd500f6bb952ull}, {0xd097ad07a71f26b2ull, 0x7e2000a41346a7a7ull},
+    {0x825ecc24c873782full, 0x8ed400668c0c28c8ull}, {0xa2f67f2dfa90563bull, 0x728900802f0f32faull},
+    {0xcbb41ef979346bcaull, 0x4f2b40a03ad2ffb9ull}, {0xfea126b7d78186bcull, 0xe2f610c84987bfa8ull},
+    {0x9f24b832e6b0f436ull, 0x0dd9ca7d2df4d7c9ull}, {0xc6ede63fa05d3143ull, 0x91503d1c79720dbbull},
+    {0xf8a95fcf88747d94ull, 0x75a44c6397ce912aull}, {0x9b69dbe1b548ce7cull, 0xc986afbe3ee11abaull},
+    {0xc24452da229b021bull, 0xfbe85badce996168ull}, {0xf2d56790ab41c2a2ull, 0xfae27299423fb9c3ull},
+    {0x97c560ba6b0919a5ull, 0xdccd879fc967d41aull}, {0xbdb6b8e905cb600full, 0x5400e987bbc1c920ull},
+    {0xed246723473e3813ull, 0x290123e9aab23b68ull}, {0x9436c0760c86e30bull, 0xf9a0b6720aaf6521ull},
+    {0xb94470938fa89bceull, 0xf808e40e8d5b3e69ull}, {0xe7958cb87392c2c2ull, 0xb60b1d1230b20e04ull},
+    {0x90bd77f3483bb9b9ull, 0xb1c6f22b5e6f48c2ull}, {0xb4ecd5f01a4aa828ull, 0x1e38aeb6360b1af3ull},
+    {0xe2280b6c20dd5232ull, 0x25c6da63c38de1b0ull}, {0x8d590723948a535full, 0x579c487e5a38ad0eull},
+    {0xb0af48ec79ace837ull, 0x2d835a9df0c6d851ull}, {0xdcdb1b2798182244ull, 0xf8e431456cf88e65ull},
+    {0x8a08f0f8bf0f156bull, 0x1b8e9ecb641b58ffull}, {0xac8b2d36eed2dac5ull, 0xe272467e3d222f3full},
+    {0xd7adf884aa879177ull, 0x5b0ed81dcc6abb0full}, {0x86ccbb52ea94baeaull, 0x98e947129fc2b4e9ull},
+    {0xa87fea27a539e9a5ull, 0x3f2398d747b36224ull}, {0xd29fe4b18e88640eull, 0x8eec7f0d19a03aadull},
+    {0x83a3eeeef9153e89ull, 0x1953cf68300424acull}, {0xa48ceaaab75a8e2bull, 0x5fa8c3423c052dd7ull},
+    {0xcdb02555653131b6ull, 0x3792f412cb06794dull}, {0x808e17555f3ebf11ull, 0xe2bbd88bbee40bd0ull},
+    {0xa0b19d2ab70e6ed6ull, 0x5b6aceaeae9d0ec4ull}, {0xc8de047564d20a8bull, 0xf245825a5a445275ull},
+    {0xfb158592be068d2eull, 0xeed6e2f0f0d56712ull}, {0x9ced737bb6c4183dull, 0x55464dd69685606bull},
+    {0xc428d05aa4751e4cull, 0xaa97e14c3c26b886ull}, {0xf53304714d9265dfull, 0xd53dd99f4b3066a8ull},
+    {0x993fe2c6d07b7fabull, 0xe546a8038efe4029ull}, {0xbf8fdb78849a5f96ull, 0xde98520472bdd033ull},
+    {0xef73d256a5c0f77cull, 0x963e66858f6d4440ull}, {0x95a8637627989aadull, 0xdde7001379a44aa8ull},
+    {0xbb127c53b17ec159ull, 0x5560c018580d5d52ull}, {0xe9d71b689dde71afull, 0xaab8f01e6e10b4a6ull},
+    {0x9226712162ab070dull, 0xcab3961304ca70e8ull}, {0xb6b00d69bb55c8d1ull, 0x3d607b97c5fd0d22ull},
+    {0xe45c10c42a2b3b05ull, 0x8cb89a7db77c506aull}, {0x8eb98a7a9a5b04e3ull, 0x77f3608e92adb242ull},
+    {0xb267ed1940f1c61cull, 0x55f038b237591ed3ull}, {0xdf01e85f912e37a3ull, 0x6b6c46dec52f6688ull},
+    {0x8b61313bbabce2c6ull, 0x2323ac4b3b3da015ull}, {0xae397d8aa96c1b77ull, 0xabec975e0a0d081aull},
+    {0xd9c7dced53c72255ull, 0x96e7bd358c904a21ull}, {0x881cea14545c7575ull, 0x7e50d64177da2e54ull},
+    {0xaa242499697392d2ull, 0xdde50bd1d5d0b9e9ull}, {0xd4ad2dbfc3d07787ull, 0x955e4ec64b44e864ull},
+    {0x84ec3c97da624ab4ull, 0xbd5af13bef0b113eull}, {0xa6274bbdd0fadd61ull, 0xecb1ad8aeacdd58eull},
+    {0xcfb11ead453994baull, 0x67de18eda5814af2ull}, {0x81ceb32c4b43fcf4ull, 0x80eacf948770ced7ull},
+    {0xa2425ff75e14fc31ull, 0xa1258379a94d028dull}, {0xcad2f7f5359a3b3eull, 0x096ee45813a04330ull},
+    {0xfd87b5f28300ca0dull, 0x8bca9d6e188853fcull}, {0x9e74d1b791e07e48ull, 0x775ea264cf55347dull},
+    {0xc612062576589ddaull, 0x95364afe032a819dull}, {0xf79687aed3eec551ull, 0x3a83ddbd83f52204ull},
+    {0x9abe14cd44753b52ull, 0xc4926a9672793542ull}, {0xc16d9a0095928a27ull, 0x75b7053c0f178293ull},
+    {0xf1c90080baf72cb1ull, 0x5324c68b12dd6338ull}, {0x971da05074da7beeull, 0xd3f6fc16ebca5e03ull},
+    {0xbce5086492111aeaull, 0x88f4bb1ca6bcf584ull}, {0xec1e4a7db69561a5ull, 0x2b31e9e3d06c32e5ull},
+    {0x9392ee8e921d5d07ull, 0x3aff322e62439fcfull}, {0xb877aa3236a4b449ull, 0x09befeb9fad487c2ull},
+    {0xe69594bec44de15bull, 0x4c2ebe687989a9b3ull}, {0x901d7cf73ab0acd9ull, 0x0f9d37014bf60a10ull},
+    {0xb424dc35095cd80full, 0x538484c19ef38c94ull}, {0xe12e13424bb40e13ull, 0x2865a5f206b06fb9ull},
+    {0x8cbccc096f5088cbull, 0xf93f87b7442e45d3ull}, {0xafebff0bcb24aafeull, 0xf78f69a51539d748ull},
+    {0xdbe6fecebdedd5beull, 0xb573440e5a884d1bull}, {0x89705f4136b4a597ull, 0x31680a88f8953030ull},
+    {0xabcc77118461cefcull, 0xfdc20d2b36ba7c3dull}, {0xd6bf94d5e57a42bcull, 0x3d32907604691b4cull},
+    {0x8637bd05af6c69b5ull, 0xa63f9a49c2c1b10full}, {0xa7c5ac471b478423ull, 0x0fcf80dc33721d53ull},
+    {0xd1b71758e219652bull, 0xd3c36113404ea4a8ull}, {0x83126e978d4fdf3bull, 0x645a1cac083126e9ull},
+    {0xa3d70a3d70a3d70aull, 0x3d70a3d70a3d70a3ull}, {0xccccccccccccccccull, 0xccccccccccccccccull},
+    {0x8000000000000000ull, 0x0000000000000000ull}, {0xa000000000000000ull, 0x0000000000000000ull},
+    {0xc800000000000000ull, 0x0000000000000000ull}, {0xfa00000000000000ull, 0x0000000000000000ull},
+    {0x9c40000000000000ull, 0x0000000000000000ull}, {0xc350000000000000ull, 0x0000000000000000ull},
+    {0xf424000000000000ull, 0x0000000000000000ull}, {0x9896800000000000ull, 0x0000000000000000ull},
+    {0xbebc200000000000ull, 0x0000000000000000ull}, {0xee6b280000000000ull, 0x0000000000000000ull},
+    {0x9502f90000000000ull, 0x0000000000000000ull}, {0xba43b74000000000ull, 0x0000000000000000ull},
+    {0xe8d4a51000000000ull, 0x0000000000000000ull}, {0x9184e72a00000000ull, 0x0000000000000000ull},
+    {0xb5e620f480000000ull, 0x0000000000000000ull}, {0xe35fa931a0000000ull, 0x0000000000000000ull},
+    {0x8e1bc9bf04000000ull, 0x0000000000000000ull}, {0xb1a2bc2ec5000000ull, 0x0000000000000000ull},
+    {0xde0b6b3a76400000ull, 0x0000000000000000ull}, {0x8ac7230489e80000ull, 0x0000000000000000ull},
+    {0xad78ebc5ac620000ull, 0x0000000000000000ull}, {0xd8d726b7177a8000ull, 0x0000000000000000ull},
+    {0x878678326eac9000ull, 0x0000000000000000ull}, {0xa968163f0a57b400ull, 0x0000000000000000ull},
+    {0xd3c21bcecceda100ull, 0x0000000000000000ull}, {0x84595161401484a0ull, 0x0000000000000000ull},
+    {0xa56fa5b99019a5c8ull, 0x0000000000000000ull}, {0xcecb8f27f4200f3aull, 0x0000000000000000ull},
+    {0x813f3978f8940984ull, 0x4000000000000000ull}, {0xa18f07d736b90be5ull, 0x5000000000000000ull},
+    {0xc9f2c9cd04674edeull, 0xa400000000000000ull}, {0xfc6f7c4045812296ull, 0x4d00000000000000ull},
+    {0x9dc5ada82b70b59dull, 0xf020000000000000ull}, {0xc5371912364ce305ull, 0x6c28000000000000ull},
+    {0xf684df56c3e01bc6ull, 0xc732000000000000ull}, {0x9a130b963a6c115cull, 0x3c7f400000000000ull},
+    {0xc097ce7bc90715b3ull, 0x4b9f100000000000ull}, {0xf0bdc21abb48db20ull, 0x1e86d40000000000ull},
+    {0x96769950b50d88f4ull, 0x1314448000000000ull}, {0xbc143fa4e250eb31ull, 0x17d955a000000000ull},
+    {0xeb194f8e1ae525fdull, 0x5dcfab0800000000ull}, {0x92efd1b8d0cf37beull, 0x5aa1cae500000000ull},
+    {0xb7abc627050305adull, 0xf14a3d9e40000000ull}, {0xe596b7b0c643c719ull, 0x6d9ccd05d0000000ull},
+    {0x8f7e32ce7bea5c6full, 0xe4820023a2000000ull}, {0xb35dbf821ae4f38bull, 0xdda2802c8a800000ull},
+    {0xe0352f62a19e306eull, 0xd50b2037ad200000ull}, {0x8c213d9da502de45ull, 0x4526f422cc340000ull},
+    {0xaf298d050e4395d6ull, 0x9670b12b7f410000ull}, {0xdaf3f04651d47b4cull, 0x3c0cdd765f114000ull},
+    {0x88d8762bf324cd0full, 0xa5880a69fb6ac800ull}, {0xab0e93b6efee0053ull, 0x8eea0d047a457a00ull},
+    {0xd5d238a4abe98068ull, 0x72a4904598d6d880ull}, {0x85a36366eb71f041ull, 0x47a6da2b7f864750ull},
+    {0xa70c3c40a64e6c51ull, 0x999090b65f67d924ull}, {0xd0cf4b50cfe20765ull, 0xfff4b4e3f741cf6dull},
+    {0x82818f1281ed449full, 0xbff8f10e7a8921a4ull}, {0xa321f2d7226895c7ull, 0xaff72d52192b6a0dull},
+    {0xcbea6f8ceb02bb39ull, 0x9bf4f8a69f764490ull}, {0xfee50b7025c36a08ull, 0x02f236d04753d5b4ull},
+    {0x9f4f2726179a2245ull, 0x01d762422c946590ull}, {0xc722f0ef9d80aad6ull, 0x424d3ad2b7b97ef5ull},
+    {0xf8ebad2b84e0d58bull, 0xd2e0898765a7deb2ull}, {0x9b934c3b330c8577ull, 0x63cc55f49f88eb2full},
+    {0xc2781f49ffcfa6d5ull, 0x3cbf6b71c76b25fbull}, {0xf316271c7fc3908aull, 0x8bef464e3945ef7aull},
+    {0x97edd871cfda3a56ull, 0x97758bf0e3cbb5acull}, {0xbde94e8e43d0c8ecull, 0x3d52eeed1cbea317ull},
+    {0xed63a231d4c4fb27ull, 0x4ca7aaa863ee4bddull}, {0x945e455f24fb1cf8ull, 0x8fe8caa93e74ef6aull},
+    {0xb975d6b6ee39e436ull, 0xb3e2fd538e122b44ull}, {0xe7d34c64a9c85d44ull, 0x60dbbca87196b616ull},
+    {0x90e40fbeea1d3a4aull, 0xbc8955e946fe31cdull}, {0xb51d13aea4a488ddull, 0x6babab6398bdbe41ull},
+    {0xe264589a4dcdab14ull, 0xc696963c7eed2dd1ull}, {0x8d7eb76070a08aecull, 0xfc1e1de5cf543ca2ull},
+    {0xb0de65388cc8ada8ull, 0x3b25a55f43294bcbull}, {0xdd15fe86affad912ull, 0x49ef0eb713f39ebeull},
+    {0x8a2dbf142dfcc7abull, 0x6e3569326c784337ull}, {0xacb92ed9397bf996ull, 0x49c2c37f07965404ull},
+    {0xd7e77a8f87daf7fbull, 0xdc33745ec97be906ull}, {0x86f0ac99b4e8dafdull, 0x69a028bb3ded71a3ull},
+    {0xa8acd7c0222311bcull, 0xc40832ea0d68ce0cull}, {0xd2d80db02aabd62bull, 0xf50a3fa490c30190ull},
+    {0x83c7088e1aab65dbull, 0x792667c6da79e0faull}, {0xa4b8cab1a1563f52ull, 0x577001b891185938ull},
+    {0xcde6fd5e09abcf26ull, 0xed4c0226b55e6f86ull}, {0x80b05e5ac60b6178ull, 0x544f8158315b05b4ull},
+    {0xa0dc75f1778e39d6ull, 0x696361ae3db1c721ull}, {0xc913936dd571c84cull, 0x03bc3a19cd1e38e9ull},
+    {0xfb5878494ace3a5full, 0x04ab48a04065c723ull}, {0x9d174b2dcec0e47bull, 0x62eb0d64283f9c76ull},
+    {0xc45d1df942711d9aull, 0x3ba5d0bd324f8394ull}, {0xf5746577930d6500ull, 0xca8f44ec7ee36479ull},
+    {0x9968bf6abbe85f20ull, 0x7e998b13cf4e1ecbull}, {0xbfc2ef456ae276e8ull, 0x9e3fedd8c321a67eull},
+    {0xefb3ab16c59b14a2ull, 0xc5cfe94ef3ea101eull}, {0x95d04aee3b80ece5ull, 0xbba1f1d158724a12ull},
+    {0xbb445da9ca61281full, 0x2a8a6e45ae8edc97ull}, {0xea1575143cf97226ull, 0xf52d09d71a3293bdull},
+    {0x924d692ca61be758ull, 0x593c2626705f9c56ull}, {0xb6e0c377cfa2e12eull, 0x6f8b2fb00c77836cull},
+    {0xe498f455c38b997aull, 0x0b6dfb9c0f956447ull}, {0x8edf98b59a373fecull, 0x4724bd4189bd5eacull},
+    {0xb2977ee300c50fe7ull, 0x58edec91ec2cb657ull}, {0xdf3d5e9bc0f653e1ull, 0x2f2967b66737e3edull},
+    {0x8b865b215899f46cull, 0xbd79e0d20082ee74ull}, {0xae67f1e9aec07187ull, 0xecd8590680a3aa11ull},
+    {0xda01ee641a708de9ull, 0xe80e6f4820cc9495ull}, {0x884134fe908658b2ull, 0x3109058d147fdcddull},
+    {0xaa51823e34a7eedeull, 0xbd4b46f0599fd415ull}, {0xd4e5e2cdc1d1ea96ull, 0x6c9e18ac7007c91aull},
+    {0x850fadc09923329eull, 0x03e2cf6bc604ddb0ull}, {0xa6539930bf6bff45ull, 0x84db8346b786151cull},
+    {0xcfe87f7cef46ff16ull, 0xe612641865679a63ull}, {0x81f14fae158c5f6eull, 0x4fcb7e8f3f60c07eull},
+    {0xa26da3999aef7749ull, 0xe3be5e330f38f09dull}, {0xcb090c8001ab551cull, 0x5cadf5bfd3072cc5ull},
+    {0xfdcb4fa002162a63ull, 0x73d9732fc7c8f7f6ull}, {0x9e9f11c4014dda7eull, 0x2867e7fddcdd9afaull},
+    {0xc646d63501a1511dull, 0xb281e1fd541501b8ull}, {0xf7d88bc24209a565ull, 0x1f225a7ca91a4226ull},
+    {0x9ae757596946075full, 0x3375788de9b06958ull}, {0xc1a12d2fc3978937ull, 0x0052d6b1641c83aeull},
+    {0xf209787bb47d6b84ull, 0xc0678c5dbd23a49aull}, {0x9745eb4d50ce6332ull, 0xf840b7ba963646e0ull},
+    {0xbd176620a501fbffull, 0xb650e5a93bc3d898ull}, {0xec5d3fa8ce427affull, 0xa3e51f138ab4cebeull},
+    {0x93ba47c980e98cdfull, 0xc66f336c36b10137ull}, {0xb8a8d9bbe123f017ull, 0xb80b0047445d4184ull},
+    {0xe6d3102ad96cec1dull, 0xa60dc059157491e5ull}, {0x9043ea1ac7e41392ull, 0x87c89837ad68db2full},
+    {0xb454e4a179dd1877ull, 0x29babe4598c311fbull}, {0xe16a1dc9d8545e94ull, 0xf4296dd6fef3d67aull},
+    {0x8ce2529e2734bb1dull, 0x1899e4a65f58660cull}, {0xb01ae745b101e9e4ull, 0x5ec05dcff72e7f8full},
+    {0xdc21a1171d42645dull, 0x76707543f4fa1f73ull}, {0x899504ae72497ebaull, 0x6a06494a791c53a8ull},
+    {0xabfa45da0edbde69ull, 0x0487db9d17636892ull}, {0xd6f8d7509292d603ull, 0x45a9d2845d3c42b6ull},
+    {0x865b86925b9bc5c2ull, 0x0b8a2392ba45a9b2ull}, {0xa7f26836f282b732ull, 0x8e6cac7768d7141eull},
+    {0xd1ef0244af2364ffull, 0x3207d795430cd926ull}, {0x8335616aed761f1full, 0x7f44e6bd49e807b8ull},
+    {0xa402b9c5a8d3a6e7ull, 0x5f16206c9c6209a6ull}, {0xcd036837130890a1ull, 0x36dba887c37a8c0full},
+    {0x802221226be55a64ull, 0xc2494954da2c9789ull}, {0xa02aa96b06deb0fdull, 0xf2db9baa10b7bd6cull},
+    {0xc83553c5c8965d3dull, 0x6f92829494e5acc7ull}, {0xfa42a8b73abbf48cull, 0xcb772339ba1f17f9ull},
+    {0x9c69a97284b578d7ull, 0xff2a760414536efbull}, {0xc38413cf25e2d70dull, 0xfef5138519684abaull},
+    {0xf46518c2ef5b8cd1ull, 0x7eb258665fc25d69ull}, {0x98bf2f79d5993802ull, 0xef2f773ffbd97a61ull},
+    {0xbeeefb584aff8603ull, 0xaafb550ffacfd8faull}, {0xeeaaba2e5dbf6784ull, 0x95ba2a53f983cf38ull},
+    {0x952ab45cfa97a0b2ull, 0xdd945a747bf26183ull}, {0xba756174393d88dfull, 0x94f971119aeef9e4ull},
+    {0xe912b9d1478ceb17ull, 0x7a37cd5601aab85dull}, {0x91abb422ccb812eeull, 0xac62e055c10ab33aull},
+    {0xb616a12b7fe617aaull, 0x577b986b314d6009ull}, {0xe39c49765fdf9d94ull, 0xed5a7e85fda0b80bull},
+    {0x8e41ade9fbebc27dull, 0x14588f13be847307ull}, {0xb1d219647ae6b31cull, 0x596eb2d8ae258fc8ull},
+    {0xde469fbd99a05fe3ull, 0x6fca5f8ed9aef3bbull}, {0x8aec23d680043beeull, 0x25de7bb9480d5854ull},
+    {0xada72ccc20054ae9ull, 0xaf561aa79a10ae6aull}, {0xd910f7ff28069da4ull, 0x1b2ba1518094da04ull},
+    {0x87aa9aff79042286ull, 0x90fb44d2f05d0842ull}, {0xa99541bf57452b28ull, 0x353a1607ac744a53ull},
+    {0xd3fa922f2d1675f2ull, 0x42889b8997915ce8ull}, {0x847c9b5d7c2e09b7ull, 0x69956135febada11ull},
+    {0xa59bc234db398c25ull, 0x43fab9837e699095ull}, {0xcf02b2c21207ef2eull, 0x94f967e45e03f4bbull},
+    {0x8161afb94b44f57dull, 0x1d1be0eebac278f5ull}, {0xa1ba1ba79e1632dcull, 0x6462d92a69731732ull},
+    {0xca28a291859bbf93ull, 0x7d7b8f7503cfdcfeull}, {0xfcb2cb35e702af78ull, 0x5cda735244c3d43eull},
+    {0x9defbf01b061adabull, 0x3a0888136afa64a7ull}, {0xc56baec21c7a1916ull, 0x088aaa1845b8fdd0ull},
+    {0xf6c69a72a3989f5bull, 0x8aad549e57273d45ull}, {0x9a3c2087a63f6399ull, 0x36ac54e2f678864bull},
+    {0xc0cb28a98fcf3c7full, 0x84576a1bb416a7ddull}, {0xf0fdf2d3f3c30b9full, 0x656d44a2a11c51d5ull},
+    {0x969eb7c47859e743ull, 0x9f644ae5a4b1b325ull}, {0xbc4665b596706114ull, 0x873d5d9f0dde1feeull},
+    {0xeb57ff22fc0c7959ull, 0xa90cb506d155a7eaull}, {0x9316ff75dd87cbd8ull, 0x09a7f12442d588f2ull},
+    {0xb7dcbf5354e9beceull, 0x0c11ed6d538aeb2full}, {0xe5d3ef282a242e81ull, 0x8f1668c8a86da5faull},
+    {0x8fa475791a569d10ull, 0xf96e017d694487bcull}, {0xb38d92d760ec4455ull, 0x37c981dcc395a9acull},
+    {0xe070f78d3927556aull, 0x85bbe253f47b1417ull}, {0x8c469ab843b89562ull, 0x93956d7478ccec8eull},
+    {0xaf58416654a6babbull, 0x387ac8d1970027b2ull}, {0xdb2e51bfe9d0696aull, 0x06997b05fcc0319eull},
+    {0x88fcf317f22241e2ull, 0x441fece3bdf81f03ull}, {0xab3c2fddeeaad25aull, 0xd527e81cad7626c3ull},
+    {0xd60b3bd56a5586f1ull, 0x8a71e223d8d3b074ull}, {0x85c7056562757456ull, 0xf6872d5667844e49ull},
+    {0xa738c6bebb12d16cull, 0xb428f8ac016561dbull}, {0xd106f86e69d785c7ull, 0xe13336d701beba52ull},
+    {0x82a45b450226b39cull, 0xecc0024661173473ull}, {0xa34d721642b06084ull, 0x27f002d7f95d0190ull},
+    {0xcc20ce9bd35c78a5ull, 0x31ec038df7b441f4ull}, {0xff290242c83396ceull, 0x7e67047175a15271ull},
+    {0x9f79a169bd203e41ull, 0x0f0062c6e984d386ull}, {0xc75809c42c684dd1ull, 0x52c07b78a3e60868ull},
+    {0xf92e0c3537826145ull, 0xa7709a56ccdf8a82ull}, {0x9bbcc7a142b17ccbull, 0x88a66076400bb691ull},
+    {0xc2abf989935ddbfeull, 0x6acff893d00ea435ull}, {0xf356f7ebf83552feull, 0x0583f6b8c4124d43ull},
+    {0x98165af37b2153deull, 0xc3727a337a8b704aull}, {0xbe1bf1b059e9a8d6ull, 0x744f18c0592e4c5cull},
+    {0xeda2ee1c7064130cull, 0x1162def06f79df73ull}, {0x9485d4d1c63e8be7ull, 0x8addcb5645ac2ba8ull},
+    {0xb9a74a0637ce2ee1ull, 0x6d953e2bd7173692ull}, {0xe8111c87c5c1ba99ull, 0xc8fa8db6ccdd0437ull},
+    {0x910ab1d4db9914a0ull, 0x1d9c9892400a22a2ull}, {0xb54d5e4a127f59c8ull, 0x2503beb6d00cab4bull},
+    {0xe2a0b5dc971f303aull, 0x2e44ae64840fd61dull}, {0x8da471a9de737e24ull, 0x5ceaecfed289e5d2ull},
+    {0xb10d8e1456105dadull, 0x7425a83e872c5f47ull}, {0xdd50f1996b947518ull, 0xd12f124e28f77719ull},
+    {0x8a5296ffe33cc92full, 0x82bd6b70d99aaa6full}, {0xace73cbfdc0bfb7bull, 0x636cc64d1001550bull},
+    {0xd8210befd30efa5aull, 0x3c47f7e05401aa4eull}, {0x8714a775e3e95c78ull, 0x65acfaec34810a71ull},
+    {0xa8d9d1535ce3b396ull, 0x7f1839a741a14d0dull}, {0xd31045a8341ca07cull, 0x1ede48111209a050ull},
+    {0x83ea2b892091e44dull, 0x934aed0aab460432ull}, {0xa4e4b66b68b65d60ull, 0xf81da84d5617853full},
+    {0xce1de40642e3f4b9ull, 0x36251260ab9d668eull}, {0x80d2ae83e9ce78f3ull, 0xc1d72b7c6b426019ull},
+    {0xa1075a24e4421730ull, 0xb24cf65b8612f81full}, {0xc94930ae1d529cfcull, 0xdee033f26797b627ull},
+    {0xfb9b7cd9a4a7443cull, 0x169840ef017da3b1ull}, {0x9d412e0806e88aa5ull, 0x8e1f289560ee864eull},
+    {0xc491798a08a2ad4eull, 0xf1a6f2bab92a27e2ull}, {0xf5b5d7ec8acb58a2ull, 0xae10af696774b1dbull},
+    {0x9991a6f3d6bf1765ull, 0xacca6da1e0a8ef29ull}, {0xbff610b0cc6edd3full, 0x17fd090a58d32af3ull},
+    {0xeff394dcff8a948eull, 0xddfc4b4cef07f5b0ull}, {0x95f83d0a1fb69cd9ull, 0x4abdaf101564f98eull},
+    {0xbb764c4ca7a4440full, 0x9d6d1ad41abe37f1ull}, {0xea53df5fd18d5513ull, 0x84c86189216dc5edull},
+    {0x92746b9be2f8552cull, 0x32fd3cf5b4e49bb4ull}, {0xb7118682dbb66a77ull, 0x3fbc8c33221dc2a1ull},
+    {0xe4d5e82392a40515ull, 0x0fabaf3feaa5334aull}, {0x8f05b1163ba6832dull, 0x29cb4d87f2a7400eull},
+    {0xb2c71d5bca9023f8ull, 0x743e20e9ef511012ull}, {0xdf78e4b2bd342cf6ull, 0x914da9246b255416ull},
+    {0x8bab8eefb6409c1aull, 0x1ad089b6c2f7548eull}, {0xae9672aba3d0c320ull, 0xa184ac2473b529b1ull},
+    {0xda3c0f568cc4f3e8ull, 0xc9e5d72d90a2741eull}, {0x8865899617fb1871ull, 0x7e2fa67c7a658892ull},
+    {0xaa7eebfb9df9de8dull, 0xddbb901b98feeab7ull}, {0xd51ea6fa85785631ull, 0x552a74227f3ea565ull},
+    {0x8533285c936b35deull, 0xd53a88958f87275full}, {0xa67ff273b8460356ull, 0x8a892abaf368f137ull},
+    {0xd01fef10a657842cull, 0x2d2b7569b0432d85ull}, {0x8213f56a67f6b29bull, 0x9c3b29620e29fc73ull},
+    {0xa298f2c501f45f42ull, 0x8349f3ba91b47b8full}, {0xcb3f2f7642717713ull, 0x241c70a936219a73ull},
+    {0xfe0efb53d30dd4d7ull, 0xed238cd383aa0110ull}, {0x9ec95d1463e8a506ull, 0xf4363804324a40aaull},
+    {0xc67bb4597ce2ce48ull, 0xb143c6053edcd0d5ull}, {0xf81aa16fdc1b81daull, 0xdd94b7868e94050aull},
+    {0x9b10a4e5e9913128ull, 0xca7cf2b4191c8326ull}, {0xc1d4ce1f63f57d72ull, 0xfd1c2f611f63a3f0ull},
+    {0xf24a01a73cf2dccfull, 0xbc633b39673c8cecull}, {0x976e41088617ca01ull, 0xd5be0503e085d813ull},
+    {0xbd49d14aa79dbc82ull, 0x4b2d8644d8a74e18ull}, {0xec9c459d51852ba2ull, 0xddf8e7d60ed1219eull},
+    {0x93e1ab8252f33b45ull, 0xcabb90e5c942b503ull}, {0xb8da1662e7b00a17ull, 0x3d6a751f3b936243ull},
+    {0xe7109bfba19c0c9dull, 0x0cc512670a783ad4ull}, {0x906a617d450187e2ull, 0x27fb2b80668b24c5ull},
+    {0xb484f9dc9641e9daull, 0xb1f9f660802dedf6ull}, {0xe1a63853bbd26451ull, 0x5e7873f8a0396973ull},
+    {0x8d07e33455637eb2ull, 0xdb0b487b6423e1e8ull}, {0xb049dc016abc5e5full, 0x91ce1a9a3d2cda62ull},
+    {0xdc5c5301c56b75f7ull, 0x7641a140cc7810fbull}, {0x89b9b3e11b6329baull, 0xa9e904c87fcb0a9dull},
+    {0xac2820d9623bf429ull, 0x546345fa9fbdcd44ull}, {0xd732290fbacaf133ull, 0xa97c177947ad4095ull},
+    {0x867f59a9d4bed6c0ull, 0x49ed8eabcccc485dull}, {0xa81f301449ee8c70ull, 0x5c68f256bfff5a74ull},
+    {0xd226fc195c6a2f8cull, 0x73832eec6fff3111ull}, {0x83585d8fd9c25db7ull, 0xc831fd53c5ff7eabull},
+    {0xa42e74f3d032f525ull, 0xba3e7ca8b77f5e55ull}, {0xcd3a1230c43fb26full, 0x28ce1bd2e55f35ebull},
+    {0x80444b5e7aa7cf85ull, 0x7980d163cf5b81b3ull}, {0xa0555e361951c366ull, 0xd7e105bcc332621full},
+    {0xc86ab5c39fa63440ull, 0x8dd9472bf3fefaa7ull}, {0xfa856334878fc150ull, 0xb14f98f6f0feb951ull},
+    {0x9c935e00d4b9d8d2ull, 0x6ed1bf9a569f33d3ull}, {0xc3b8358109e84f07ull, 0x0a862f80ec4700c8ull},
+    {0xf4a642e14c6262c8ull, 0xcd27bb612758c0faull}, {0x98e7e9cccfbd7dbdull, 0x8038d51cb897789cull},
+    {0xbf21e44003acdd2cull, 0xe0470a63e6bd56c3ull}, {0xeeea5d5004981478ull, 0x1858ccfce06cac74ull},
+    {0x95527a5202df0ccbull, 0x0f37801e0c43ebc8ull}, {0xbaa718e68396cffdull, 0xd30560258f54e6baull},
+    {0xe950df20247c83fdull, 0x47c6b82ef32a2069ull}, {0x91d28b7416cdd27eull, 0x4cdc331d57fa5441ull},
+    {0xb6472e511c81471dull, 0xe0133fe4adf8e952ull}, {0xe3d8f9e563a198e5ull, 0x58180fddd97723a6ull},
+    {0x8e679c2f5e44ff8full, 0x570f09eaa7ea7648ull}, {0xb201833b35d63f73ull, 0x2cd2cc6551e513daull},
+    {0xde81e40a034bcf4full, 0xf8077f7ea65e58d1ull}, {0x8b112e86420f6191ull, 0xfb04afaf27faf782ull},
+    {0xadd57a27d29339f6ull, 0x79c5db9af1f9b563ull}, {0xd94ad8b1c7380874ull, 0x18375281ae7822bcull},
+    {0x87cec76f1c830548ull, 0x8f2293910d0b15b5ull}, {0xa9c2794ae3a3c69aull, 0xb2eb3875504ddb22ull},
+    {0xd433179d9c8cb841ull, 0x5fa60692a46151ebull}, {0x849feec281d7f328ull, 0xdbc7c41ba6bcd333ull},
+    {0xa5c7ea73224deff3ull, 0x12b9b522906c0800ull}, {0xcf39e50feae16befull, 0xd768226b34870a00ull},
+    {0x81842f29f2cce375ull, 0xe6a1158300d46640ull}, {0xa1e53af46f801c53ull, 0x60495ae3c1097fd0ull},
+    {0xca5e89b18b602368ull, 0x385bb19cb14bdfc4ull}, {0xfcf62c1dee382c42ull, 0x46729e03dd9ed7b5ull},
+    {0x9e19db92b4e31ba9ull, 0x6c07a2c26a8346d1ull}, {0xc5a05277621be293ull, 0xc7098b7305241885ull},
+    {0xf70867153aa2db38ull, 0xb8cbee4fc66d1ea7ull}, {0x9a65406d44a5c903ull, 0x737f74f1dc043328ull},
+    {0xc0fe908895cf3b44ull, 0x505f522e53053ff2ull}, {0xf13e34aabb430a15ull, 0x647726b9e7c68fefull},
+    {0x96c6e0eab509e64dull, 0x5eca783430dc19f5ull}, {0xbc789925624c5fe0ull, 0xb67d16413d132072ull},
+    {0xeb96bf6ebadf77d8ull, 0xe41c5bd18c57e88full}, {0x933e37a534cbaae7ull, 0x8e91b962f7b6f159ull},
+    {0xb80dc58e81fe95a1ull, 0x723627bbb5a4adb0ull}, {0xe61136f2227e3b09ull, 0xcec3b1aaa30dd91cull},
+    {0x8fcac257558ee4e6ull, 0x213a4f0aa5e8a7b1ull}, {0xb3bd72ed2af29e1full, 0xa988e2cd4f62d19dull},
+    {0xe0accfa875af45a7ull, 0x93eb1b80a33b8605ull}, {0x8c6c01c9498d8b88ull, 0xbc72f130660533c3ull},
+    {0xaf87023b9bf0ee6aull, 0xeb8fad7c7f8680b4ull}, {0xdb68c2ca82ed2a05ull, 0xa67398db9f6820e1ull},
+    {0x892179be91d43a43ull, 0x88083f8943a1148cull}, {0xab69d82e364948d4ull, 0x6a0a4f6b948959b0ull},
+    {0xd6444e39c3db9b09ull, 0x848ce34679abb01cull}, {0x85eab0e41a6940e5ull, 0xf2d80e0c0c0b4e11ull},
+    {0xa7655d1d2103911full, 0x6f8e118f0f0e2195ull}, {0xd13eb46469447567ull, 0x4b7195f2d2d1a9fbull},
+};
+
+static const double str_pow10_f64_[23] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// The Eisel-Lemire algorithm: man * 10^e10 rounded to nearest even, as
+// positive double bits. Fails on the rare inputs where the 128-bit product
+// cannot decide the rounding, and on subnormal or infinite results.
+static inline bool
+str_eisel_lemire_(uint64_t man, int64_t e10, uint64_t *bits)
+{
+    if (e10 < -348 || e10 > 347) return false;
+    unsigned clz = 63u - str_msb64_(man);
+    man <<= clz;
+    // floor(e10 * log2(10)), offset so the shifted value is never negative
+    uint64_t exp2 = (uint64_t)(((217706 * e10 + 1200 * 65536) >> 16) - 1200 + 64 + 1023) - clz;
+
+    uint64_t lo = man, hi = str_pow10_128_[e10 + 348][0];
+    str_mum_(&lo, &hi);
+    if ((hi & 0x1FF) == 0x1FF && lo + man < man) {
+        uint64_t ylo = man, yhi = str_pow10_128_[e10 + 348][1];
+        str_mum_(&ylo, &yhi);
+        uint64_t mlo = lo + yhi, mhi = hi + (mlo < lo);
+        if ((mhi & 0x1FF) == 0x1FF && mlo + 1 == 0 && ylo + man < man) return false;
+        hi = mhi;
+        lo = mlo;
+    }
+
+    uint64_t msb = hi >> 63;
+    uint64_t mant = hi >> (msb + 9);
+    exp2 -= 1 ^ msb;
+    if (lo == 0 && (hi & 0x1FF) == 0 && (mant & 3) == 1) return false; // halfway
+    mant += mant & 1;
+    mant >>= 1;
+    if (mant >> 53) {
+        mant >>= 1;
+        exp2 += 1;
+    }
+    if (exp2 - 1 >= 0x7FF - 1) return false;
+    *bits = exp2 << 52 | (mant & 0x000FFFFFFFFFFFFFull);
+    return true;
+}
+
+// Exact fallback: the digits as a decimal, shifted by powers of two until
+// the binary exponent and 53 rounded bits can be read off. 800 digits are
+// enough to decide every halfway case.
+#define STR_DECIMAL_DIGITS_ 800
+
+typedef struct {
+    unsigned char d[STR_DECIMAL_DIGITS_]; // digit values, value is 0.d * 10^dp
+    int nd;
+    int dp;
+    bool trunc;                           // nonzero digits were dropped
+} StrDecimal_;
+
+static void
+str_decimal_trim_(StrDecimal_ *a)
+{
+    while (a->nd > 0 && a->d[a->nd - 1] == 0) a->nd--;
+    if (a->nd == 0) a->dp = 0;
+}
+
+static void
+str_decimal_lshift_(StrDecimal_ *a, unsigned k)
+{
+    // At most 19 new digits for k <= 60, written from the back
+    unsigned char tmp[STR_DECIMAL_DIGITS_ + 20];
+    int w = a->nd + 20;
+    uint64_t n = 0;
+    for (int r = a->nd - 1; r >= 0; --r) {
+        n += (uint64_t)a->d[r] << k;
+        uint64_t q = n / 10;
+        tmp[--w] = (unsigned char)(n - 10 * q);
+        n = q;
+    }
+    for (; n; n /= 10) tmp[--w] = (unsigned char)(n % 10);
+    int delta = 20 - w;
+    int nd = a->nd + delta;
+    if (nd > STR_DECIMAL_DIGITS_) {
+        for (int j = STR_DECIMAL_DIGITS_; j < nd; ++j) a->trunc |= tmp[w + j] != 0;
+        nd = STR_DECIMAL_DIGITS_;
+    }
+    memcpy(a->d, tmp + w, (size_t)nd);
+    a->nd = nd;
+    a->dp += delta;
+    str_decimal_trim_(a);
+}
+
+static void
+str_decimal_rshift_(StrDecimal_ *a, unsigned k)
+{
+    int r = 0, w = 0;
+    uint64_t n = 0;
+    for (; (n >> k) == 0; ++r) {
+        if (r >= a->nd) {
+            if (n == 0) {
+                a->nd = 0;
+                a->dp = 0;
+                return;
+            }
+            for (; (n >> k) == 0; ++r) n *= 10;
+            break;
+        }
+        n = n * 10 + a->d[r];
+    }
+    a->dp -= r - 1;
+    uint64_t mask = ((uint64_t)1 << k) - 1;
+    for (; r < a->nd; ++r) {
+        a->d[w++] = (unsigned char)(n >> k);
+        n = (n & mask) * 10 + a->d[r];
+    }
+    for (; n > 0; n = (n & mask) * 10) {
+        if (w < STR_DECIMAL_DIGITS_) a->d[w++] = (unsigned char)(n >> k);
+        else if (n >> k) a->trunc = true;
+    }
+    a->nd = w;
+    str_decimal_trim_(a);
+}
+
+static void
+str_decimal_shift_(StrDecimal_ *a, int k)
+{
+    if (a->nd == 0) return;
+    for (; k > 60; k -= 60) str_decimal_lshift_(a, 60);
+    for (; k < -60; k += 60) str_decimal_rshift_(a, 60);
+    if (k > 0) str_decimal_lshift_(a, (unsigned)k);
+    else if (k < 0) str_decimal_rshift_(a, (unsigned)-k);
+}
+
+static uint64_t
+str_decimal_rounded_(const StrDecimal_ *a)
+{
+    if (a->dp > 20) return UINT64_MAX;
+    uint64_t n = 0;
+    int i = 0;
+    for (; i < a->dp && i < a->nd; ++i) n = n * 10 + a->d[i];
+    for (; i < a->dp; ++i) n *= 10;
+    if (a->dp >= 0 && a->dp < a->nd) {
+        // Exactly half rounds to even, unless digits were dropped
+        bool half = a->d[a->dp] == 5 && a->dp + 1 == a->nd;
+        if (half ? a->trunc || (a->dp > 0 && (a->d[a->dp - 1] & 1)) : a->d[a->dp] >= 5) n++;
+    }
+    return n;
+}
+
+// p[0, n) holds digits and at most one '.', exp10 is the exponent after it
+static uint64_t
+str_decimal_bits_(const unsigned char *p, size_t n, int64_t exp10)
+{
+    static const int powtab[9] = {1, 3, 6, 9, 13, 16, 19, 23, 26};
+    StrDecimal_ a;
+    a.nd = 0;
+    a.dp = 0;
+    a.trunc = false;
+    bool dot = false;
+    int seen = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (p[i] == '.') {
+            a.dp = seen;
+            dot = true;
+        } else if (p[i] == '0' && seen == 0) {
+            a.dp--; // leading zero
+        } else {
+            if (a.nd < STR_DECIMAL_DIGITS_) a.d[a.nd++] = (unsigned char)(p[i] - '0');
+            else if (p[i] != '0') a.trunc = true;
+            seen++;
+        }
+    }
+    if (!dot) a.dp = seen;
+    str_decimal_trim_(&a);
+    if (a.nd == 0) return 0;
+    int64_t dp = a.dp + exp10;
+    if (dp > 310) return 0x7FF0000000000000ull;
+    if (dp < -330) return 0;
+    a.dp = (int)dp;
+
+    // Scale into [0.5, 1) and count the powers of two
+    int exp = 0;
+    while (a.dp > 0) {
+        int k = a.dp >= 9 ? 27 : powtab[a.dp];
+        str_decimal_shift_(&a, -k);
+        exp += k;
+    }
+    while (a.dp < 0 || (a.dp == 0 && a.d[0] < 5)) {
+        int k = -a.dp >= 9 ? 27 : powtab[-a.dp];
+        str_decimal_shift_(&a, k);
+        exp -= k;
+    }
+    exp--; // [0.5, 1) to [1, 2)
+    if (exp < -1022) {
+        str_decimal_shift_(&a, exp + 1022);
+        exp = -1022;
+    }
+    if (exp + 1023 >= 0x7FF) return 0x7FF0000000000000ull;
+
+    str_decimal_shift_(&a, 53);
+    uint64_t mant = str_decimal_rounded_(&a);
+    if (mant == (uint64_t)2 << 52) {
+        mant >>= 1;
+        if (++exp + 1023 >= 0x7FF) return 0x7FF0000000000000ull;
+    }
+    if (!(mant & ((uint64_t)1 << 52))) exp = -1023; // subnormal
+    return (mant & 0x000FFFFFFFFFFFFFull) | (uint64_t)(exp + 1023) << 52;
+}
+
+STRDEF size_t
+str_parse_f64_n(const char *data, size_t len, double *value) STR_NOEXCEPT
+{
+    if (!data || !value) return 0;
+    const unsigned char *p = (const unsigned char *)data;
+    size_t i = 0;
+    bool neg = false;
+    uint64_t bits;
+    if (len && (p[0] == '+' || p[0] == '-')) neg = p[i++] == '-';
+
+    if (i < len && (str_fold_(p[i]) == 'i' || str_fold_(p[i]) == 'n')) {
+        static const char *const words[3] = {"infinity", "inf", "nan"};
+        for (int k = 0; k < 3; ++k) {
+            size_t wl = strlen(words[k]);
+            if (len - i >= wl && str_mismatch_icase_(p + i, (const unsigned char *)words[k], wl) == wl) {
+                bits = k < 2 ? 0x7FF0000000000000ull : 0x7FF8000000000000ull;
+                bits |= (uint64_t)neg << 63;
+                memcpy(value, &bits, sizeof(bits));
+                return i + wl;
+            }
+        }
+        return 0;
+    }
+
+    size_t start = i;
+    uint64_t w = 0;
+    size_t nint = str_parse_digits_(p + i, len - i, &w), nfrac = 0;
+    i += nint;
+    if (i < len && p[i] == '.') {
+        nfrac = str_parse_digits_(p + i + 1, len - i - 1, &w);
+        if (nint + nfrac) i += 1 + nfrac;
+    }
+    if (nint + nfrac == 0) return 0;
+    size_t mant_end = i;
+
+    int64_t exp10 = 0;
+    if (i < len && (p[i] == 'e' || p[i] == 'E')) {
+        size_t j = i + 1;
+        bool eneg = false;
+        if (j < len && (p[j] == '+' || p[j] == '-')) eneg = p[j++] == '-';
+        if (j < len && (unsigned)(p[j] - '0') < 10u) {
+            for (; j < len && (unsigned)(p[j] - '0') < 10u; ++j) {
+                if (exp10 < 100000000) exp10 = exp10 * 10 + (p[j] - '0');
+            }
+            if (eneg) exp10 = -exp10;
+            i = j;
+        }
+    }
+
+    // Past 19 significant digits keep the first 19 and remember the rest
+    int64_t e10 = exp10 - (int64_t)nfrac;
+    bool truncated = false;
+    if (nint + nfrac > 19) {
+        const unsigned char *q = p + start;
+        size_t zeros = 0;
+        for (; q < p + mant_end && (*q == '0' || *q == '.'); ++q) zeros += *q == '0';
+        if (nint + nfrac - zeros > 19) {
+            w = 0;
+            for (int taken = 0; taken < 19; ++q) {
+                if (*q == '.') continue;
+                w = w * 10 + (unsigned)(*q - '0');
+                taken++;
+            }
+            e10 += (int64_t)(nint + nfrac - zeros - 19);
+            truncated = true;
+        }
+    }
+
+    bool done = false;
+    if (w == 0) {
+        bits = 0;
+        done = true;
+    }
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+    // Both operands exact, so one rounding: the correctly rounded result
+    else if (!truncated && w <= (uint64_t)1 << 53 && e10 >= -22 && e10 <= 22) {
+        double d = (double)w;
+        d = e10 < 0 ? d / str_pow10_f64_[-e10] : d * str_pow10_f64_[e10];
+        memcpy(&bits, &d, sizeof(bits));
+        done = true;
+    }
+#endif
+    else if (str_eisel_lemire_(w, e10, &bits)) {
+        // The dropped digits lie between w and w + 1, both must agree
+        uint64_t up;
+        done = !truncated || (str_eisel_lemire_(w + 1, e10, &up) && up == bits);
+    }
+    if (!done) bits = str_decimal_bits_(p + start, mant_end - start, exp10);
+
+    bits |= (uint64_t)neg << 63;
+    memcpy(value, &bits, sizeof(bits));
+    return i;
+}
+
+STRDEF size_t
+str_parse_f64(const String *str, double *value) STR_NOEXCEPT
+{
+    return str ? str_parse_f64_n(str->buffer, str->size, value) : 0;
+}
+
+STRDEF size_t
+str_find_n(const String *str, const char *needle, size_t nlen) STR_NOEXCEPT
+{
+    if (!str || !str->buffer) return SIZE_MAX;
+    if (!needle) return SIZE_MAX;
+    if (nlen == 0) return 0;
+    if (str->size == 0 || nlen > str->size) return SIZE_MAX;
+
+    return str_find_bytes_(str->buffer, str->size, needle, nlen);
+}
+
+STRDEF size_t
+str_find(const String *str, const char *needle) STR_NOEXCEPT
+{
+    if (!needle) return SIZE_MAX;
+    return str_find_n(str, needle, strlen(needle));
+}
+
+STRDEF size_t
+str_rfind_n(const String *str, const char *needle, size_t nlen) STR_NOEXCEPT
+{
+    if (!str || !str->buffer) return SIZE_MAX;
+    if (!needle) return SIZE_MAX;
+    if (nlen == 0) return str->size;
+    if (str->size == 0 || nlen > str->size) return SIZE_MAX;
+
+    const char *hay = str->buffer;
+    for (size_t i = str->size - nlen + 1; i-- > 0; ) {
+        if (hay[i] == needle[0] && memcmp(hay + i, needle, nlen) == 0) {
+            return i;
+        }
+        if (i == 0) break;
+    }
+    return SIZE_MAX;
+}
+
+STRDEF size_t
+str_rfind(const String *str, const char *needle) STR_NOEXCEPT
+{
+    if (!needle) return SIZE_MAX;
+    return str_rfind_n(str, needle, strlen(needle));
+}
+
+STRDEF bool
+str_equals(const String *a, const String *b) STR_NOEXCEPT
+{
+    if (a == b) return true;
+    if (!a || !b) return false;
+    if (a->size != b->size) return false;
+    if (a->size == 0) return true;
+    return memcmp(a->buffer, b->buffer, a->size) == 0;
+}
+
+STRDEF bool
+str_equals_cstr(const String *str, const char *cstr) STR_NOEXCEPT
+{
+    if (!str || !cstr) return false;
+    size_t len = strlen(cstr);
+    return str_equals_n(str, cstr, len);
+}
+
+STRDEF bool
+str_equals_n(const String *str, const char *buf, size_t n) STR_NOEXCEPT
+{
+    if (!str || !buf) return false;
+    if (str->size != n) return false;
+    if (n == 0) return true;
+    return memcmp(str->buffer, buf, n) == 0;
+}
+
+STRDEF int
+str_compare(const String *a, const String *b) STR_NOEXCEPT
+{
+    if (a == b) return 0;
+    return str_compare_bytes_(a ? a->buffer : STR_NULL, a ? a->size : 0,
+                              b ? b->buffer : STR_NULL, b ? b->size : 0);
+}
+
+STRDEF int
+str_compare_cstr(const String *str, const char *cstr) STR_NOEXCEPT
+{
+    return str_compare_n(str, cstr, cstr ? strlen(cstr) : 0);
+}
+
+STRDEF int
+str_compare_n(const String *str, const char *buf, size_t n) STR_NOEXCEPT
+{
+    if (!buf) n = 0;
+    return str_compare_bytes_(str ? str->buffer : STR_NULL, str ? str->size : 0, buf, n);
+}
+
+STRDEF bool
+str_to_lower(String *str) STR_NOEXCEPT
+{
+    if (!str) return false;
+    if (str->size) str_case_apply_((unsigned char *)str->buffer, str->size, 'A');
+    return true;
+}
+
+STRDEF bool
+str_to_upper(String *str) STR_NOEXCEPT
+{
+    if (!str) return false;
+    if (str->size) str_case_apply_((unsigned char *)str->buffer, str->size, 'a');
+    return true;
+}
+
+STRDEF bool
+str_equals_icase(const String *a, const String *b) STR_NOEXCEPT
+{
+    if (a == b) return true;
+    if (!a || !b) return false;
+    if (a->size != b->size) return false;
+    if (a->size == 0) return true;
+    return str_mismatch_icase_((const unsigned char *)a->buffer, (const unsigned char *)b->buffer, a->size) == a->size;
+}
+
+STRDEF int
+str_compare_icase(const String *a, const String *b) STR_NOEXCEPT
+{
+    if (a == b) return 0;
+    size_t an = a ? a->size : 0, bn = b ? b->size : 0;
+    size_t n = an < bn ? an : bn;
+    if (n) {
+        const unsigned char *x = (const unsigned char *)a->buffer, *y = (const unsigned char *)b->buffer;
+        size_t i = str_mismatch_icase_(x, y, n);
+        if (i < n) return str_fold_(x[i]) < str_fold_(y[i]) ? -1 : 1;
+    }
+    return an < bn ? -1 : an > bn ? 1 : 0;
+}
+
+STRDEF size_t
+str_find_icase_n(const String *str, const char *needle, size_t nlen) STR_NOEXCEPT
+{
+    if (!str || !str->buffer) return SIZE_MAX;
+    if (!needle) return SIZE_MAX;
+    if (nlen == 0) return 0;
+    if (str->size == 0 || nlen > str->size) return SIZE_MAX;
+
+    return str_find_icase_bytes_((const unsigned char *)str->buffer, str->size, (const unsigned char *)needle, nlen);
+}
+
+STRDEF size_t
+str_find_icase(const String *str, const char *needle) STR_NOEXCEPT
+{
+    if (!needle) return SIZE_MAX;
+    return str_find_icase_n(str, needle, strlen(needle));
+}
+
+STRDEF StrSlice
+str_slice(const String *str) STR_NOEXCEPT
+{
+    StrSlice result = {"", 0};
+    if (str && str->buffer) {
+        result.data = str->buffer;
+        result.size = str->size;
+    }
+    return result;
+}
+
+STRDEF StrSlice
+str_slice_n(const char *data, size_t len) STR_NOEXCEPT
+{
+    StrSlice result = {"", 0};
+    if (data) {
+        result.data = data;
+        result.size = len;
+    }
+    return result;
+}
+
+STRDEF StrSlice
+str_slice_cstr(const char *cstr) STR_NOEXCEPT
+{
+    if (!cstr) return str_slice_n(STR_NULL, 0);
+    return str_slice_n(cstr, strlen(cstr));
+}
+
+// str_ref_data relies on tail following prefix directly
+typedef char str_ref_layout_check_[(offsetof(StrRef, rest) == 8 && sizeof(StrRef) == 16) ? 1 : -1];
+
+STRDEF StrRef
+str_ref_n(const char *data, size_t len) STR_NOEXCEPT
+{
+    StrRef ref;
+    memset(&ref, 0, sizeof(ref));
+    if (!data || len > UINT32_MAX) return ref;
+
+    ref.size = (uint32_t)len;
+    memcpy(ref.prefix, data, len < 4 ? len : 4);
+    if (len <= STR_REF_INLINE) {
+        if (len > 4) memcpy(ref.rest.tail, data + 4, len - 4);
+    } else {
+        ref.rest.data = data;
+    }
+    return ref;
+}
+
+STRDEF StrRef
+str_ref_cstr(const char *cstr) STR_NOEXCEPT
+{
+    return str_ref_n(cstr, cstr ? strlen(cstr) : 0);
+}
+
+STRDEF StrRef
+str_ref_str(const String *str) STR_NOEXCEPT
+{
+    StrSlice s = str_slice(str);
+    return str_ref_n(s.data, s.size);
+}
+
+STRDEF StrRef
+str_ref_from_slice(StrSlice slice) STR_NOEXCEPT
+{
+    return str_ref_n(slice.data, slice.size);
+}
+
+STRDEF const char *
+str_ref_data(const StrRef *ref) STR_NOEXCEPT
+{
+    if (!ref) return "";
+    // prefix and tail are adjacent, so inline strings read straight through
+    if (ref->size <= STR_REF_INLINE) return (const char *)ref + offsetof(StrRef, prefix);
+    return ref->rest.data;
+}
+
+STRDEF StrSlice
+str_ref_slice(const StrRef *ref) STR_NOEXCEPT
+{
+    return str_slice_n(str_ref_data(ref), ref ? ref->size : 0);
+}
+
+STRDEF bool
+str_append_ref(String *str, const StrRef *ref) STR_NOEXCEPT
+{
+    if (!str || !ref) return false;
+    return str_append_one_n(str, str_ref_data(ref), ref->size);
+}
+
+STRDEF bool
+str_ref_equals(const StrRef *a, const StrRef *b) STR_NOEXCEPT
+{
+    if (!a || !b) return a == b;
+    // Size and prefix in one 8 byte compare
+    if (memcmp(a, b, 8) != 0) return false;
+    if (a->size <= STR_REF_INLINE) return memcmp(a->rest.tail, b->rest.tail, 8) == 0;
+    if (a->rest.data == b->rest.data) return true;
+    return memcmp(a->rest.data + 4, b->rest.data + 4, a->size - 4) == 0;
+}
+
+STRDEF int
+str_ref_compare(const StrRef *a, const StrRef *b) STR_NOEXCEPT
+{
+    static const StrRef empty = {0, {0, 0, 0, 0}, {{0, 0, 0, 0, 0, 0, 0, 0}}};
+    if (!a) a = &empty;
+    if (!b) b = &empty;
+
+    // Zero padding sorts like the end of the string, except against real
+    // NUL bytes, which the size tiebreak below takes care of
+    int c = memcmp(a->prefix, b->prefix, 4);
+    if (c != 0) return c;
+    if (a->size <= 4 || b->size <= 4) {
+        return a->size < b->size ? -1 : a->size > b->size ? 1 : 0;
+    }
+    if (a->size <= STR_REF_INLINE && b->size <= STR_REF_INLINE) {
+        c = memcmp(a->rest.tail, b->rest.tail, 8);
+        if (c != 0) return c;
+        return a->size < b->size ? -1 : a->size > b->size ? 1 : 0;
+    }
+    const char *ad = str_ref_data(a), *bd = str_ref_data(b);
+    return str_compare_bytes_(ad + 4, a->size - 4, bd + 4, b->size - 4);
+}
+
+STRDEF uint64_t
+str_ref_hash(const StrRef *ref, uint64_t seed) STR_NOEXCEPT
+{
+    StrSlice s = str_ref_slice(ref);
+    return str_hash64_n(s.data, s.size, seed);
+}
+
+STRDEF StrBuf
+str_buf_init(STR_NO_PARAMS) STR_NOEXCEPT
+{
+    StrBuf buf;
+    buf.str  = str_init();
+    buf.head = 0;
+    return buf;
+}
+
+STRDEF void
+str_buf_free(StrBuf *buf) STR_NOEXCEPT
+{
+    if (!buf) return;
+    str_free(&buf->str);
+    buf->head = 0;
+}
+
+STRDEF void
+str_buf_clear(StrBuf *buf) STR_NOEXCEPT
+{
+    if (!buf) return;
+    str_clear(&buf->str);
+    buf->head = 0;
+}
+
+STRDEF const char *
+str_buf_data(const StrBuf *buf) STR_NOEXCEPT
+{
+    if (!buf || !buf->str.buffer) return "";
+    return buf->str.buffer + buf->head;
+}
+
+STRDEF size_t
+str_buf_size(const StrBuf *buf) STR_NOEXCEPT
+{
+    return buf ? buf->str.size - buf->head : 0;
+}
+
+STRDEF StrSlice
+str_buf_slice(const StrBuf *buf) STR_NOEXCEPT
+{
+    return str_slice_n(str_buf_data(buf), str_buf_size(buf));
+}
+
+STRDEF void
+str_buf_compact(StrBuf *buf) STR_NOEXCEPT
+{
+    if (!buf || buf->head == 0) return;
+    size_t live = buf->str.size - buf->head;
+    memmove(buf->str.buffer, buf->str.buffer + buf->head, live + 1); // with the NUL
+    buf->str.size = live;
+    buf->head = 0;
+}
+
+// Called after the head moved forward
+static inline void
+str_buf_after_consume_(StrBuf *buf)
+{
+    size_t live = buf->str.size - buf->head;
+    if (live == 0) {
+        // Everything consumed, restart at the front for free
+        buf->str.size = 0;
+        buf->head = 0;
+        buf->str.buffer[0] = '\0';
+    } else if (buf->head >= STR_BUF_COMPACT_MIN && buf->head > live) {
+        // Moving fewer bytes than were consumed keeps consumption amortized O(1)
+        str_buf_compact(buf);
+    }
+}
+
+STRDEF bool
+str_buf_reserve(StrBuf *buf, size_t new_len) STR_NOEXCEPT
+{
+    if (!buf) return false;
+    // Reuse the dead prefix before asking for more memory
+    if (str_would_overflow_(buf->head, new_len) || buf->head + new_len >= buf->str.capacity) {
+        str_buf_compact(buf);
+    }
+    return str_reserve(&buf->str, buf->head + new_len);
+}
+
+STRDEF bool
+str_buf_append_n(StrBuf *buf, const char *data, size_t len) STR_NOEXCEPT
+{
+    if (!buf || (!data && len)) return false;
+    if (str_would_overflow_(buf->str.size, len)) return false; // Overflow protection
+    if (buf->str.size + len >= buf->str.capacity) str_buf_compact(buf);
+    return str_append_one_n(&buf->str, data, len);
+}
+
+STRDEF bool
+str_buf_append(StrBuf *buf, const char *cstr) STR_NOEXCEPT
+{
+    if (!cstr) return false;
+    return str_buf_append_n(buf, cstr, strlen(cstr));
+}
+
+STRDEF bool
+str_buf_consume(StrBuf *buf, size_t n) STR_NOEXCEPT
+{
+    if (!buf || n > buf->str.size - buf->head) return false;
+    if (n == 0) return true;
+    buf->head += n;
+    str_buf_after_consume_(buf);
+    return true;
+}
+
+STRDEF bool
+str_buf_erase(StrBuf *buf, size_t pos, size_t len) STR_NOEXCEPT
+{
+    if (!buf) return false;
+    size_t live = buf->str.size - buf->head;
+    if (pos > live) return false;
+    if (len > live - pos) len = live - pos;
+    if (len == 0) return true;
+
+    size_t tail = live - pos - len;
+    if (pos <= tail) {
+        // Shift the bytes before the range forward over it
+        char *front = buf->str.buffer + buf->head;
+        if (pos) memmove(front + len, front, pos);
+        buf->head += len;
+        str_buf_after_consume_(buf);
+        return true;
+    }
+    return str_erase(&buf->str, buf->head + pos, len);
+}
+
+STRDEF bool
+str_buf_ltrim(StrBuf *buf) STR_NOEXCEPT
+{
+    if (!buf) return false;
+    StrByteSet space = str_byteset_space();
+    size_t live = buf->str.size - buf->head;
+    if (live == 0) return true;
+    size_t i = str_set_scan_((const unsigned char *)buf->str.buffer + buf->head, live, &space, false, false);
+    return str_buf_consume(buf, i == SIZE_MAX ? live : i);
+}
+
+STRDEF bool
+str_buf_rtrim(StrBuf *buf) STR_NOEXCEPT
+{
+    if (!buf) return false;
+    StrByteSet space = str_byteset_space();
+    size_t live = buf->str.size - buf->head;
+    if (live == 0) return true;
+    size_t i = str_set_scan_((const unsigned char *)buf->str.buffer + buf->head, live, &space, false, true);
+    size_t keep = i == SIZE_MAX ? 0 : i + 1;
+    if (keep == 0) {
+        return str_buf_consume(buf, live);
+    }
+    buf->str.size = buf->head + keep;
+    buf->str.buffer[buf->str.size] = '\0';
+    return true;
+}
 
-    str_clear(dst);
+STRDEF bool
+str_buf_trim(StrBuf *buf) STR_NOEXCEPT
+{
+    if (!str_buf_rtrim(buf)) return false;
+    return str_buf_ltrim(buf);
+}
 
-    if (!src) return true;
-    if (src->size == 0) return true;
+STRDEF String
+str_buf_take(StrBuf *buf) STR_NOEXCEPT
+{
+    if (!buf) return str_init();
+    str_buf_compact(buf);
+    buf->head = 0;
+    return str_move(&buf->str);
+}
 
-    if (!str_reserve(dst, src->size)) return false;
-    memcpy(dst->buffer, src->buffer, src->size + 1); // include '\0'
-    dst->size = src->size;
+//
+// Builders
+//
+
+STRDEF StrBuilder
+str_builder_init(STR_NO_PARAMS) STR_NOEXCEPT
+{
+    StrBuilder b;
+    b.chunks = STR_NULL;
+    b.count  = 0;
+    b.slots  = 0;
+    b.sealed = 0;
+    return b;
+}
+
+STRDEF void
+str_builder_free(StrBuilder *b) STR_NOEXCEPT
+{
+    if (!b) return;
+    for (size_t i = 0; i < b->count; ++i) str_free(&b->chunks[i]);
+    STR_FREE(b->chunks);
+    *b = str_builder_init();
+}
+
+STRDEF void
+str_builder_clear(StrBuilder *b) STR_NOEXCEPT
+{
+    if (!b) return;
+    // Keep the first chunk, it is the one a small build fills again
+    for (size_t i = 1; i < b->count; ++i) str_free(&b->chunks[i]);
+    if (b->count) {
+        str_clear(&b->chunks[0]);
+        b->count = 1;
+    }
+    b->sealed = 0;
+}
+
+STRDEF size_t
+str_builder_size(const StrBuilder *b) STR_NOEXCEPT
+{
+    if (!b) return 0;
+    return b->count ? b->sealed + b->chunks[b->count - 1].size : 0;
+}
+
+STRDEF String *
+str_builder_tail(StrBuilder *b, size_t len) STR_NOEXCEPT
+{
+    if (!b) return STR_NULL;
+    if (b->count) {
+        String *tail = &b->chunks[b->count - 1];
+        if (tail->capacity - tail->size > len) return tail;
+        if (tail->size == 0) return str_reserve(tail, len) ? tail : STR_NULL;
+    }
+    if (len == SIZE_MAX) return STR_NULL; // Overflow protection
+
+    if (b->count == b->slots) {
+        size_t slots = b->slots ? 2 * b->slots : 8;
+        if (slots > SIZE_MAX / sizeof(String)) return STR_NULL; // Overflow protection
+        String *chunks = (String *)STR_REALLOC(b->chunks, slots * sizeof(String));
+        if (!chunks) return STR_NULL;
+        b->chunks = chunks;
+        b->slots  = slots;
+    }
+
+    // Chunks double from 4 KB, so small outputs stay small
+    size_t cap = b->count ? b->chunks[b->count - 1].capacity : 2048;
+    cap = cap < STR_BUILDER_CHUNK_SIZE / 2 ? 2 * cap : STR_BUILDER_CHUNK_SIZE;
+    if (cap < len + 1) cap = len + 1;
+    char *p = (char *)STR_REALLOC(STR_NULL, cap);
+    if (!p) return STR_NULL;
+    p[0] = '\0';
+
+    if (b->count) b->sealed += b->chunks[b->count - 1].size;
+    String *tail = &b->chunks[b->count++];
+    tail->buffer   = p;
+    tail->capacity = cap;
+    tail->size     = 0;
+    return tail;
+}
+
+STRDEF bool
+str_builder_append_n(StrBuilder *b, const char *data, size_t len) STR_NOEXCEPT
+{
+    if (!b || (!data && len)) return false;
+    while (len) {
+        // Top up the last chunk first, then open a new one for the rest
+        String *tail = b->count ? &b->chunks[b->count - 1] : STR_NULL;
+        size_t room = tail ? tail->capacity - tail->size - 1 : 0;
+        if (room == 0) {
+            tail = str_builder_tail(b, len < STR_BUILDER_CHUNK_SIZE ? len : STR_BUILDER_CHUNK_SIZE - 1);
+            if (!tail) return false;
+            room = tail->capacity - tail->size - 1;
+        }
+        size_t n = len < room ? len : room;
+        memcpy(tail->buffer + tail->size, data, n);
+        tail->size += n;
+        tail->buffer[tail->size] = '\0';
+        data += n;
+        len -= n;
+    }
     return true;
 }
 
-STRDEF String
-str_move(String *from) STR_NOEXCEPT
+STRDEF bool
+str_builder_append(StrBuilder *b, const char *cstr) STR_NOEXCEPT
 {
-    if (!from) {
-        return str_init();
+    if (!b || !cstr) return false;
+    return str_builder_append_n(b, cstr, strlen(cstr));
+}
+
+STRDEF bool
+str_builder_append_str(StrBuilder *b, const String *str) STR_NOEXCEPT
+{
+    if (!b) return false;
+    if (!str || str->size == 0) return true;
+    return str_builder_append_n(b, str->buffer, str->size);
+}
+
+STRDEF bool
+str_builder_append_char(StrBuilder *b, char c) STR_NOEXCEPT
+{
+    String *tail = str_builder_tail(b, 1);
+    if (!tail) return false;
+    tail->buffer[tail->size++] = c;
+    tail->buffer[tail->size] = '\0';
+    return true;
+}
+
+STRDEF bool
+str_builder_vappendf(StrBuilder *b, const char *fmt, va_list args) STR_NOEXCEPT
+{
+    if (!b || !fmt) return false;
+
+    va_list ap;
+    va_copy(ap, args);
+    int need = vsnprintf(STR_NULL, 0, fmt, ap);
+    va_end(ap);
+    if (need < 0) return false;
+
+    String *tail = str_builder_tail(b, (size_t)need);
+    if (!tail) return false;
+
+    va_copy(ap, args);
+    vsnprintf(tail->buffer + tail->size, (size_t)need + 1, fmt, ap);
+    va_end(ap);
+
+    tail->size += (size_t)need;
+    return true;
+}
+
+STRDEF bool
+str_builder_appendf(StrBuilder *b, const char *fmt, ...) STR_NOEXCEPT
+{
+    if (!b || !fmt) return false;
+    va_list args;
+    va_start(args, fmt);
+    bool ok = str_builder_vappendf(b, fmt, args);
+    va_end(args);
+    return ok;
+}
+
+STRDEF bool
+str_builder_write_file(const StrBuilder *b, FILE *f) STR_NOEXCEPT
+{
+    if (!b || !f) return false;
+#if defined(STR_WRITEV_)
+    int fd = fileno(f);
+    if (fd >= 0 && b->count > 1) {
+        if (fflush(f) != 0) return false;
+        struct iovec iov[64];
+        size_t next = 0;
+        while (next < b->count) {
+            int n = 0;
+            for (; n < 64 && next < b->count; ++next) {
+                if (b->chunks[next].size == 0) continue;
+                iov[n].iov_base = b->chunks[next].buffer;
+                iov[n].iov_len  = b->chunks[next].size;
+                n++;
+            }
+            // Short writes resume inside the iovec that was cut
+            struct iovec *v = iov;
+            while (n > 0) {
+                ssize_t w = writev(fd, v, n);
+                if (w < 0) return false;
+                size_t left = (size_t)w;
+                while (n > 0 && left >= v->iov_len) {
+                    left -= v->iov_len;
+                    v++;
+                    n--;
+                }
+                if (n > 0) {
+                    v->iov_base = (char *)v->iov_base + left;
+                    v->iov_len -= left;
+                }
+            }
+        }
+        return true;
+    }
+#endif
+    for (size_t i = 0; i < b->count; ++i) {
+        if (!str_write_file(&b->chunks[i], f)) return false;
+    }
+    return true;
+}
+
+STRDEF bool
+str_builder_take(StrBuilder *b, String *out) STR_NOEXCEPT
+{
+    if (!b || !out) return false;
+    size_t size = str_builder_size(b);
+
+    if (b->count == 1) {
+        // One chunk already holds everything, trim it in place
+        String only = b->chunks[0];
+        if (!str_shrink_to_fit(&only)) return false;
+        *out = only;
+        STR_FREE(b->chunks);
+        *b = str_builder_init();
+        return true;
     }
 
-    String result = *from;
+    char *p = (char *)STR_REALLOC(STR_NULL, size + 1);
+    if (!p) return false;
+    char *dst = p;
+    for (size_t i = 0; i < b->count; ++i) {
+        if (b->chunks[i].size) memcpy(dst, b->chunks[i].buffer, b->chunks[i].size);
+        dst += b->chunks[i].size;
+    }
+    *dst = '\0';
+    str_builder_free(b);
+    out->buffer   = p;
+    out->capacity = size + 1;
+    out->size     = size;
+    return true;
+}
 
-    *from = str_init();
-    return result;
+STRDEF bool
+str_write_file(const String *str, FILE *f) STR_NOEXCEPT
+{
+    if (!str || !f) return false;
+    if (str->size == 0) return true;
+    size_t n = fwrite(str->buffer, 1, str->size, f);
+    return n == str->size;
 }
 
-STRDEF void
-str_clear(String *str) STR_NOEXCEPT
+STRDEF bool
+str_read_file(String *str, FILE *f) STR_NOEXCEPT
 {
-    if (!str) return;
+    if (!str || !f) return false;
 
-    str->size = 0;
+    // The first chunk goes through the stack so a small file leaves a small
+    // buffer. Past it, read straight into the spare capacity, asking for
+    // twice as much each time up to 32 KB
+    char chunk[4096];
+    size_t r = fread(chunk, 1, sizeof(chunk), f);
+    if (!str_append_one_n(str, chunk, r)) return false;
+    if (r < sizeof(chunk)) {
+        if (feof(f)) return true;
+        if (ferror(f)) return false;
+    }
 
-    if (str->buffer) {
-        str->buffer[0] = '\0';
+    for (size_t want = sizeof(chunk);;) {
+        if (want < 32768) want *= 2;
+        size_t avail;
+        char *p = str_spare(str, want, &avail);
+        if (!p) return false;
+        r = fread(p, 1, avail, f);
+        if (!str_commit(str, r)) return false;
+        if (r < avail) {
+            if (feof(f)) break;
+            if (ferror(f)) return false;
+        }
+    }
+    return true;
+}
+
+
+//
+// Hashing
+//
+// wyhash style: 64x64->128 bit multiply-and-fold over 16 byte reads, with
+// three independent lanes over 48 byte stripes for long inputs.
+//
+
+#define STR_HASH_S0_ 0x2d358dccaa6c78a5ull
+#define STR_HASH_S1_ 0x8bb84b93962eacc9ull
+#define STR_HASH_S2_ 0x4b33a62ed433d4a3ull
+#define STR_HASH_S3_ 0x4d5a2da51de1aa47ull
+
+static inline uint64_t
+str_mix_(uint64_t a, uint64_t b)
+{
+    str_mum_(&a, &b);
+    return a ^ b;
+}
+
+static inline char
+str_ascii_lower_(char c)
+{
+    return (unsigned char)(c - 'A') < 26u ? (char)(c + ('a' - 'A')) : c;
+}
+
+// Lowercase the ASCII letters in 8 bytes at once. Bytes >= 0x80 are kept.
+static inline uint64_t
+str_ascii_lower64_(uint64_t w)
+{
+    const uint64_t ones = 0x0101010101010101ull;
+    const uint64_t high = 0x8080808080808080ull;
+    uint64_t low7 = w & ~high;
+    uint64_t ge_a = low7 + ones * (0x80 - 'A');
+    uint64_t gt_z = low7 + ones * (0x80 - 'Z' - 1);
+    uint64_t upper = ge_a & ~gt_z & ~w & high;
+    return w | (upper >> 2);
+}
+
+static inline uint64_t
+str_hash_init_seed_(uint64_t seed)
+{
+    return seed ^ str_mix_(seed ^ STR_HASH_S0_, STR_HASH_S1_);
+}
+
+// Consume 48 byte stripes while more than 48 bytes remain
+static inline void
+str_hash_stripes_(const unsigned char **pp, size_t *ip, uint64_t *seed, uint64_t *see1, uint64_t *see2)
+{
+    const unsigned char *p = *pp;
+    size_t i = *ip;
+    uint64_t s = *seed, s1 = *see1, s2 = *see2;
+    while (i > 48) {
+        s  = str_mix_(str_read64_(p)      ^ STR_HASH_S1_, str_read64_(p + 8)  ^ s);
+        s1 = str_mix_(str_read64_(p + 16) ^ STR_HASH_S2_, str_read64_(p + 24) ^ s1);
+        s2 = str_mix_(str_read64_(p + 32) ^ STR_HASH_S3_, str_read64_(p + 40) ^ s2);
+        p += 48;
+        i -= 48;
+    }
+    *pp = p;
+    *ip = i;
+    *seed = s;
+    *see1 = s1;
+    *see2 = s2;
+}
+
+// Hash the last i bytes at p of a len byte input. When len > 48 the stripes
+// are done, i is at most 48 and the 16 bytes before p must be readable.
+static inline StrHash128
+str_hash_finish_(const unsigned char *p, size_t i, size_t len, uint64_t seed, uint64_t see1, uint64_t see2)
+{
+    uint64_t a, b, lanes = 0;
+
+    if (len > 48) {
+        seed ^= see1 ^ see2;
+        lanes = see1 ^ ((see2 << 32) | (see2 >> 32));
+    }
+
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (str_read32_(p) << 32) | str_read32_(p + ((len >> 3) << 2));
+            b = (str_read32_(p + len - 4) << 32) | str_read32_(p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
     } else {
-        char *p = (char *)STR_REALLOC(STR_NULL, 1);
-        if (p) {
-            p[0] = '\0';
-            str->buffer = p;
-            str->capacity = 1;
-            str->size = 0;
+        while (i > 16) {
+            seed = str_mix_(str_read64_(p) ^ STR_HASH_S1_, str_read64_(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
         }
+        a = str_read64_(p + i - 16);
+        b = str_read64_(p + i - 8);
+    }
+
+    a ^= STR_HASH_S1_;
+    b ^= seed;
+    str_mum_(&a, &b);
+
+    StrHash128 result;
+    result.lo = str_mix_(a ^ STR_HASH_S0_ ^ (uint64_t)len, b ^ STR_HASH_S1_);
+    result.hi = str_mix_(a ^ STR_HASH_S2_ ^ (uint64_t)len, b ^ STR_HASH_S3_ ^ lanes);
+    return result;
+}
+
+static inline StrHash128
+str_hash_impl_(const char *data, size_t len, uint64_t seed)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    size_t i = len;
+
+    seed = str_hash_init_seed_(seed);
+    uint64_t see1 = seed, see2 = seed;
+    if (len > 48) str_hash_stripes_(&p, &i, &seed, &see1, &see2);
+    return str_hash_finish_(p, i, len, seed, see1, see2);
+}
+
+STRDEF uint64_t
+str_hash64_n(const char *data, size_t len, uint64_t seed) STR_NOEXCEPT
+{
+    if (!data) len = 0;
+    return str_hash_impl_(data, len, seed).lo;
+}
+
+STRDEF uint64_t
+str_hash64(const String *str, uint64_t seed) STR_NOEXCEPT
+{
+    if (!str) return str_hash64_n(STR_NULL, 0, seed);
+    return str_hash64_n(str->buffer, str->size, seed);
+}
+
+STRDEF StrHash128
+str_hash128_n(const char *data, size_t len, uint64_t seed) STR_NOEXCEPT
+{
+    if (!data) len = 0;
+    return str_hash_impl_(data, len, seed);
+}
+
+STRDEF StrHash128
+str_hash128(const String *str, uint64_t seed) STR_NOEXCEPT
+{
+    if (!str) return str_hash128_n(STR_NULL, 0, seed);
+    return str_hash128_n(str->buffer, str->size, seed);
+}
+
+STRDEF StrHash128
+str_hash128_icase_n(const char *data, size_t len, uint64_t seed) STR_NOEXCEPT
+{
+    StrHasher h;
+    str_hasher_init(&h, seed);
+    str_hasher_update_icase(&h, data, len);
+    return str_hasher_final128(&h);
+}
+
+STRDEF StrHash128
+str_hash128_icase(const String *str, uint64_t seed) STR_NOEXCEPT
+{
+    if (!str) return str_hash128_icase_n(STR_NULL, 0, seed);
+    return str_hash128_icase_n(str->buffer, str->size, seed);
+}
+
+STRDEF uint64_t
+str_hash64_icase_n(const char *data, size_t len, uint64_t seed) STR_NOEXCEPT
+{
+    return str_hash128_icase_n(data, len, seed).lo;
+}
+
+STRDEF uint64_t
+str_hash64_icase(const String *str, uint64_t seed) STR_NOEXCEPT
+{
+    return str_hash128_icase(str, seed).lo;
+}
+
+STRDEF void
+str_hasher_init(StrHasher *h, uint64_t seed) STR_NOEXCEPT
+{
+    if (!h) return;
+    h->total    = 0;
+    h->buffered = 0;
+    h->seed = str_hash_init_seed_(seed);
+    h->see1 = h->seed;
+    h->see2 = h->seed;
+}
+
+// A stripe is only consumed once at least one byte is known to follow it,
+// so that the final 1..48 bytes always go through str_hash_finish_ like
+// they do for a one-shot hash.
+STRDEF void
+str_hasher_update(StrHasher *h, const char *data, size_t len) STR_NOEXCEPT
+{
+    if (!h || !data || len == 0) return;
+
+    const unsigned char *p = (const unsigned char *)data;
+    h->total += len;
+
+    if (h->buffered + len <= 48) {
+        memcpy(h->buffer + 16 + h->buffered, p, len);
+        h->buffered += len;
+        return;
+    }
+
+    if (h->buffered) {
+        size_t take = 48 - h->buffered;
+        memcpy(h->buffer + 16 + h->buffered, p, take);
+        p += take;
+        len -= take;
+
+        const unsigned char *q = h->buffer + 16;
+        size_t i = 49; // a full stripe plus the byte known to follow it
+        str_hash_stripes_(&q, &i, &h->seed, &h->see1, &h->see2);
+        memcpy(h->buffer, h->buffer + 48, 16);
+        h->buffered = 0;
+    }
+
+    if (len > 48) {
+        str_hash_stripes_(&p, &len, &h->seed, &h->see1, &h->see2);
+        memcpy(h->buffer, p - 16, 16);
     }
+
+    memcpy(h->buffer + 16, p, len);
+    h->buffered = len;
 }
 
 STRDEF void
-str_free(String *str) STR_NOEXCEPT
+str_hasher_update_str(StrHasher *h, const String *str) STR_NOEXCEPT
 {
     if (!str) return;
+    str_hasher_update(h, str->buffer, str->size);
+}
 
-    STR_FREE(str->buffer);
-    str->buffer   = STR_NULL;
-    str->capacity = 0;
-    str->size     = 0;
+STRDEF void
+str_hasher_update_icase(StrHasher *h, const char *data, size_t len) STR_NOEXCEPT
+{
+    if (!h || !data) return;
+
+    char chunk[256];
+    while (len) {
+        size_t n = len < sizeof(chunk) ? len : sizeof(chunk);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            uint64_t w = str_read64_((const unsigned char *)data + i);
+            w = str_ascii_lower64_(w);
+            memcpy(chunk + i, &w, sizeof(w));
+        }
+        for (; i < n; ++i) chunk[i] = str_ascii_lower_(data[i]);
+        str_hasher_update(h, chunk, n);
+        data += n;
+        len  -= n;
+    }
+}
+
+STRDEF StrHash128
+str_hasher_final128(const StrHasher *h) STR_NOEXCEPT
+{
+    if (!h) return str_hash128_n(STR_NULL, 0, 0);
+    return str_hash_finish_(h->buffer + 16, h->buffered, h->total, h->seed, h->see1, h->see2);
+}
+
+STRDEF uint64_t
+str_hasher_final64(const StrHasher *h) STR_NOEXCEPT
+{
+    return str_hasher_final128(h).lo;
+}
+
+
+//
+// Arena
+//
+
+typedef struct StrArenaBlock_ {
+    struct StrArenaBlock_ *next;
+    size_t                 size; // total bytes including this header
+} StrArenaBlock_;
+
+#define STR_ARENA_ALIGN_(n) (((n) + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1))
+
+static inline void
+str_arena_free_(StrArena *arena)
+{
+    StrArenaBlock_ *block = (StrArenaBlock_ *)arena->blocks;
+    while (block) {
+        StrArenaBlock_ *next = block->next;
+        STR_FREE(block);
+        block = next;
+    }
+    memset(arena, 0, sizeof(*arena));
+}
+
+// Bump allocate n bytes, 8 byte aligned. Blocks double in size up to
+// max_block. Allocations too large to share a block get a block of their
+// own, linked behind the current one so it keeps serving small requests.
+static inline char *
+str_arena_alloc_(StrArena *arena, size_t n, size_t max_block)
+{
+    const size_t header = STR_ARENA_ALIGN_(sizeof(StrArenaBlock_));
+    size_t aligned = STR_ARENA_ALIGN_(n);
+    if (aligned < n) return STR_NULL; // Overflow protection
+    n = aligned;
+
+    if (n <= arena->remaining) {
+        char *p = arena->cursor;
+        arena->cursor += n;
+        arena->remaining -= n;
+        arena->used += n;
+        return p;
+    }
+
+    size_t block_size = arena->reserved < 4096 ? 4096 : arena->reserved;
+    if (block_size > max_block) block_size = max_block;
+
+    bool dedicated = n > block_size / 4;
+    size_t size = dedicated ? n : block_size;
+    if (str_would_overflow_(size, header)) return STR_NULL;
+    size += header;
+
+    StrArenaBlock_ *block = (StrArenaBlock_ *)STR_REALLOC(STR_NULL, size);
+    if (!block) return STR_NULL;
+    block->size = size;
+
+    char *p = (char *)block + header;
+    StrArenaBlock_ *head = (StrArenaBlock_ *)arena->blocks;
+    if (dedicated && head) {
+        block->next = head->next;
+        head->next  = block;
+    } else {
+        block->next      = head;
+        arena->blocks    = block;
+        arena->cursor    = p + n;
+        arena->remaining = size - header - n;
+    }
+
+    arena->reserved += size;
+    arena->used += n;
+    return p;
+}
+
+
+//
+// Interning
+//
+
+STRDEF void
+str_intern_pool_init(StrInternPool *pool) STR_NOEXCEPT
+{
+    if (!pool) return;
+    memset(pool, 0, sizeof(*pool));
 }
 
-STRDEF char *
-str_strdup(const String *str, size_t *out_len) STR_NOEXCEPT
+STRDEF void
+str_intern_pool_free(StrInternPool *pool) STR_NOEXCEPT
 {
-    size_t len = (str && str->buffer) ? str->size : 0;
+    if (!pool) return;
 
-    if (len + 1 < len) return STR_NULL; // Overflow protection
+    for (size_t i = 0; i < STR_INTERN_SHARDS; ++i) {
+        StrInternShard *shard = &pool->shards[i].shard;
+        str_arena_free_(&shard->arena);
+        STR_FREE(shard->slots);
+    }
+    memset(pool, 0, sizeof(*pool));
+}
 
-    char *buf = (char *)STR_REALLOC(STR_NULL, len + 1);
-    if (!buf) return STR_NULL;
+static inline bool
+str_intern_grow_slots_(StrInternShard *shard)
+{
+    size_t new_count = shard->slot_count ? shard->slot_count * 2 : 64;
+    if (new_count > SIZE_MAX / sizeof(StrInternSlot)) return false; // Overflow protection
+
+    StrInternSlot *slots = (StrInternSlot *)STR_REALLOC(STR_NULL, new_count * sizeof(StrInternSlot));
+    if (!slots) return false;
+    memset(slots, 0, new_count * sizeof(StrInternSlot));
+
+    // Hashes are cached in the slots, so rehashing never touches string bytes
+    size_t mask = new_count - 1;
+    for (size_t i = 0; i < shard->slot_count; ++i) {
+        StrInternSlot s = shard->slots[i];
+        if (!s.entry) continue;
+        size_t j = (size_t)s.hash & mask;
+        while (slots[j].entry) j = (j + 1) & mask;
+        slots[j] = s;
+    }
 
-    if (len) memcpy(buf, str->buffer, len);
-    buf[len] = '\0';
+    STR_FREE(shard->slots);
+    shard->slots = slots;
+    shard->slot_count = new_count;
+    return true;
+}
 
-    if (out_len) *out_len = len;
-    return buf;
+// Probe for the bytes. Returns the slot holding them, or the empty slot where
+// they belong. Requires slot_count > 0 and the shard lock held.
+static inline StrInternSlot *
+str_intern_probe_(StrInternShard *shard, const char *data, size_t len, uint64_t hash)
+{
+    size_t mask = shard->slot_count - 1;
+    size_t i = (size_t)hash & mask;
+    for (;;) {
+        StrInternSlot *s = &shard->slots[i];
+        if (!s->entry) return s;
+        if (s->hash == hash && s->entry->size == len &&
+            (len == 0 || memcmp(s->entry->data, data, len) == 0)) {
+            return s;
+        }
+        i = (i + 1) & mask;
+    }
 }
 
-STRDEF char *
-str_release(String *str, size_t *out_len) STR_NOEXCEPT
+static inline const StrInterned *
+str_intern_impl_(StrInternPool *pool, const char *data, size_t len, bool insert)
 {
-    if (!str) return STR_NULL;
+    if (!pool || (!data && len)) return STR_NULL;
+
+    uint64_t hash = str_hash64_n(data, len, 0);
+    StrInternShard *shard = &pool->shards[(size_t)(hash >> 56) & (STR_INTERN_SHARDS - 1)].shard;
+    const StrInterned *result = STR_NULL;
+
+    STR_INTERN_LOCK(&shard->lock);
+    shard->lookups += 1;
+
+    StrInternSlot *slot = shard->slot_count ? str_intern_probe_(shard, data, len, hash) : STR_NULL;
+    if (slot && slot->entry) {
+        shard->hits += 1;
+        result = slot->entry;
+    } else if (insert) {
+        // Keep the load factor at or below 3/4
+        if (shard->slot_count == 0 || (shard->count + 1) * 4 > shard->slot_count * 3) {
+            slot = str_intern_grow_slots_(shard) ? str_intern_probe_(shard, data, len, hash) : STR_NULL;
+        }
 
-    if (!str->buffer) {
-        char *z = (char *)STR_REALLOC(STR_NULL, 1);
-        if (!z) return STR_NULL;
-        z[0] = '\0';
-        if (out_len) *out_len = 0;
-        return z;
+        size_t need = sizeof(StrInterned) + len + 1;
+        char *mem = (slot && need > len) ? str_arena_alloc_(&shard->arena, need, STR_INTERN_BLOCK_SIZE) : STR_NULL;
+        if (mem) {
+            StrInterned *entry = (StrInterned *)mem;
+            char *bytes = mem + sizeof(StrInterned);
+            if (len) memcpy(bytes, data, len);
+            bytes[len] = '\0';
+            entry->data = bytes;
+            entry->size = len;
+            entry->hash = hash;
+
+            slot->hash  = hash;
+            slot->entry = entry;
+            shard->count += 1;
+            result = entry;
+        }
     }
 
-    str->buffer[str->size] = '\0';
-
-    if (out_len) *out_len = str->size;
-    char *result = str->buffer;
+    STR_INTERN_UNLOCK(&shard->lock);
+    return result;
+}
 
-    str->buffer   = STR_NULL;
-    str->capacity = 0;
-    str->size     = 0;
+STRDEF const StrInterned *
+str_intern_n(StrInternPool *pool, const char *data, size_t len) STR_NOEXCEPT
+{
+    return str_intern_impl_(pool, data, len, true);
+}
 
-    return result;
+STRDEF const StrInterned *
+str_intern(StrInternPool *pool, const char *cstr) STR_NOEXCEPT
+{
+    if (!cstr) return STR_NULL;
+    return str_intern_n(pool, cstr, strlen(cstr));
 }
 
-STRDEF char *
-str_shrink_and_release(String *str, size_t *out_len) STR_NOEXCEPT
+STRDEF const StrInterned *
+str_intern_str(StrInternPool *pool, const String *str) STR_NOEXCEPT
 {
     if (!str) return STR_NULL;
+    return str_intern_n(pool, str->buffer, str->size);
+}
 
-    if (!str->buffer) {
-        char *z = (char *)STR_REALLOC(STR_NULL, 1);
-        if (!z) return STR_NULL;
-        z[0] = '\0';
-        if (out_len) *out_len = 0;
-        return z;
+STRDEF const StrInterned *
+str_intern_find_n(StrInternPool *pool, const char *data, size_t len) STR_NOEXCEPT
+{
+    return str_intern_impl_(pool, data, len, false);
+}
+
+STRDEF StrInternStats
+str_intern_pool_stats(StrInternPool *pool) STR_NOEXCEPT
+{
+    StrInternStats stats;
+    memset(&stats, 0, sizeof(stats));
+    if (!pool) return stats;
+
+    for (size_t i = 0; i < STR_INTERN_SHARDS; ++i) {
+        StrInternShard *shard = &pool->shards[i].shard;
+        STR_INTERN_LOCK(&shard->lock);
+        stats.count          += shard->count;
+        stats.bytes_used     += shard->arena.used;
+        stats.bytes_reserved += shard->arena.reserved + shard->slot_count * sizeof(StrInternSlot);
+        stats.lookups        += shard->lookups;
+        stats.hits           += shard->hits;
+        STR_INTERN_UNLOCK(&shard->lock);
     }
 
-    size_t need = str->size + 1;
-    if (need < str->size) return STR_NULL; // Overflow protection
+    stats.hit_rate = stats.lookups ? (double)stats.hits / (double)stats.lookups : 0.0;
+    return stats;
+}
 
-    void *p = STR_REALLOC(str->buffer, need);
-    if (p) {
-        str->buffer   = (char *)p;
-        str->capacity = need;
-        str->buffer[str->size] = '\0';
-    } else {
-        str->buffer[str->size] = '\0';
-    }
 
-    if (out_len) *out_len = str->size;
-    char *result = str->buffer;
 
-    str->buffer   = STR_NULL;
-    str->capacity = 0;
-    str->size     = 0;
+//
+// Maps
+//
+// Swiss table: ctrl holds one byte per slot, either STR_MAP_EMPTY_,
+// STR_MAP_DELETED_ or the low 7 bits of the entry's hash. A probe loads a
+// whole group of control bytes and compares them at once, so most lookups
+// touch a single ctrl cache line plus the one entry that matches. The first
+// group is mirrored after the last slot so a group load never wraps.
+//
 
-    return result;
+#define STR_MAP_EMPTY_   0x80
+#define STR_MAP_DELETED_ 0xFE
+
+#if defined(STR_SSE2_)
+#define STR_MAP_GROUP_ 16u
+
+static inline uint64_t
+str_map_match_(const unsigned char *g, unsigned char h2)
+{
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)(const void *)g);
+    return (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8((char)h2), ctrl));
 }
 
-STRDEF bool
-str_shrink_to_fit(String *str) STR_NOEXCEPT
+static inline uint64_t
+str_map_match_empty_(const unsigned char *g)
 {
-    if (!str) return false;
-    if (!str->buffer) return true;
+    return str_map_match_(g, STR_MAP_EMPTY_);
+}
 
-    if (str->capacity == str->size + 1) {
-        str->buffer[str->size] = '\0';
-        return true;
-    }
+// Empty or deleted slots are the only ones with the high bit set
+static inline uint64_t
+str_map_match_free_(const unsigned char *g)
+{
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)(const void *)g);
+    return (uint64_t)(unsigned)_mm_movemask_epi8(ctrl);
+}
 
-    size_t need = str->size + 1;
-    if (need < str->size) return false; // Overflow protection
+static inline size_t
+str_map_mask_index_(uint64_t mask)
+{
+    return str_ctz64_(mask);
+}
+#else
+#define STR_MAP_GROUP_ 8u
+#define STR_MAP_LSBS_ 0x0101010101010101ull
+#define STR_MAP_MSBS_ 0x8080808080808080ull
 
-    void *p = STR_REALLOC(str->buffer, need);
-    if (!p) return false;
+static inline uint64_t
+str_map_load_group_(const unsigned char *g)
+{
+#if defined(STR_BIG_ENDIAN_)
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i) v = (v << 8) | g[i];
+    return v;
+#else
+    return str_read64_(g);
+#endif
+}
 
-    str->buffer   = (char *)p;
-    str->capacity = need;
-    str->buffer[str->size] = '\0';
-    return true;
+// May report false positives after a real match. Callers compare keys anyway.
+static inline uint64_t
+str_map_match_(const unsigned char *g, unsigned char h2)
+{
+    uint64_t x = str_map_load_group_(g) ^ (STR_MAP_LSBS_ * h2);
+    return (x - STR_MAP_LSBS_) & ~x & STR_MAP_MSBS_;
 }
 
-static inline bool
-str_would_overflow_(size_t a, size_t b)
+static inline uint64_t
+str_map_match_empty_(const unsigned char *g)
 {
-    return b > SIZE_MAX - a;
+    uint64_t ctrl = str_map_load_group_(g);
+    return ctrl & ~(ctrl << 6) & STR_MAP_MSBS_;
 }
 
-static inline bool
-str_grow_to_fit_(String *str, size_t n) STR_NOEXCEPT
+static inline uint64_t
+str_map_match_free_(const unsigned char *g)
 {
-    if (!str) return false;
+    uint64_t ctrl = str_map_load_group_(g);
+    return ctrl & ~(ctrl << 7) & STR_MAP_MSBS_;
+}
 
-    size_t np1 = n + 1; // 'n plus 1' to account for trailing NUL-terminator
-    if (np1 < n) return false; // Overflow protection
+static inline size_t
+str_map_mask_index_(uint64_t mask)
+{
+    return str_ctz64_(mask) >> 3;
+}
+#endif
 
-    if (str->buffer && np1 <= str->capacity) {
-        return true;
-    }
+static inline void
+str_map_set_ctrl_(StrMap *map, size_t i, unsigned char c)
+{
+    map->ctrl[i] = c;
+    map->ctrl[((i - STR_MAP_GROUP_) & (map->capacity - 1)) + STR_MAP_GROUP_] = c;
+}
 
-    size_t new_cap = str->capacity ? str->capacity : (STR_START_SIZE > 1 ? STR_START_SIZE : 1);
+// Slot holding key, or SIZE_MAX. Requires capacity > 0.
+static inline size_t
+str_map_lookup_(const StrMap *map, const char *key, size_t len, uint64_t hash)
+{
+    const size_t mask = map->capacity - 1;
+    const unsigned char h2 = (unsigned char)(hash & 0x7F);
+    size_t pos  = (size_t)(hash >> 7) & mask;
+    size_t step = 0;
 
-    // Exponential growth until threshold
-    while (new_cap < np1 && new_cap < STR_LIN_THRESHOLD) {
-        if (new_cap > SIZE_MAX / STR_EXP_GROWTH_FACTOR) { new_cap = SIZE_MAX; break; } // Overflow protection
-        new_cap *= STR_EXP_GROWTH_FACTOR;
+    for (;;) {
+        const unsigned char *g = map->ctrl + pos;
+        for (uint64_t m = str_map_match_(g, h2); m; m &= m - 1) {
+            size_t i = (pos + str_map_mask_index_(m)) & mask;
+            const StrMapEntry *e = &map->entries[i];
+            if (e->hash == hash && e->key_size == len && (len == 0 || memcmp(e->key, key, len) == 0)) {
+                return i;
+            }
+        }
+        if (str_map_match_empty_(g)) return SIZE_MAX;
+        step += STR_MAP_GROUP_;
+        pos = (pos + step) & mask;
     }
+}
+
+// First empty or deleted slot on the probe sequence of hash
+static inline size_t
+str_map_free_slot_(const unsigned char *ctrl, size_t capacity, uint64_t hash)
+{
+    const size_t mask = capacity - 1;
+    size_t pos  = (size_t)(hash >> 7) & mask;
+    size_t step = 0;
 
-    // Linear growth after threshold
-    while (new_cap < np1) {
-        if (new_cap > SIZE_MAX - STR_LIN_GROWTH_FACTOR) { new_cap = SIZE_MAX; break; } // Overflow protection
-        new_cap += STR_LIN_GROWTH_FACTOR;
+    for (;;) {
+        uint64_t m = str_map_match_free_(ctrl + pos);
+        if (m) return (pos + str_map_mask_index_(m)) & mask;
+        step += STR_MAP_GROUP_;
+        pos = (pos + step) & mask;
     }
+}
 
-    void *new_buffer = STR_REALLOC(str->buffer, new_cap);
-    if (!new_buffer) {
+// Move every entry into a fresh table of new_cap slots. Uses the cached
+// hashes, and drops all tombstones on the way.
+static inline bool
+str_map_resize_(StrMap *map, size_t new_cap)
+{
+    if (new_cap > (SIZE_MAX - STR_MAP_GROUP_) / sizeof(StrMapEntry)) return false; // Overflow protection
+
+    unsigned char *ctrl = (unsigned char *)STR_REALLOC(STR_NULL, new_cap + STR_MAP_GROUP_);
+    if (!ctrl) return false;
+    StrMapEntry *entries = (StrMapEntry *)STR_REALLOC(STR_NULL, new_cap * sizeof(StrMapEntry));
+    if (!entries) {
+        STR_FREE(ctrl);
         return false;
     }
+    memset(ctrl, STR_MAP_EMPTY_, new_cap + STR_MAP_GROUP_);
+
+    StrMap next = *map;
+    next.ctrl     = ctrl;
+    next.entries  = entries;
+    next.capacity = new_cap;
+
+    for (size_t i = 0; i < map->capacity; ++i) {
+        if (map->ctrl[i] & 0x80) continue;
+        const StrMapEntry *e = &map->entries[i];
+        size_t j = str_map_free_slot_(ctrl, new_cap, e->hash);
+        str_map_set_ctrl_(&next, j, (unsigned char)(e->hash & 0x7F));
+        entries[j] = *e;
+    }
 
-    str->buffer = (char *)new_buffer;
-    str->capacity = new_cap;
+    STR_FREE(map->ctrl);
+    STR_FREE(map->entries);
+    map->ctrl        = ctrl;
+    map->entries     = entries;
+    map->capacity    = new_cap;
+    map->growth_left = new_cap - new_cap / 8 - map->count;
+    return true;
+}
 
-    str->buffer[str->size] = '\0';
+STRDEF StrMap
+str_map_init(STR_NO_PARAMS) STR_NOEXCEPT
+{
+    StrMap map;
+    memset(&map, 0, sizeof(map));
+    return map;
+}
 
-    return true;
+STRDEF void
+str_map_free(StrMap *map) STR_NOEXCEPT
+{
+    if (!map) return;
+    STR_FREE(map->ctrl);
+    STR_FREE(map->entries);
+    str_arena_free_(&map->keys);
+    memset(map, 0, sizeof(*map));
 }
 
-STRDEF bool
-str_reserve(String *str, size_t new_len) STR_NOEXCEPT
+STRDEF void
+str_map_clear(StrMap *map) STR_NOEXCEPT
 {
-    if (!str) return false;
-    if (!str_grow_to_fit_(str, new_len)) return false;
-    str->buffer[str->size] = '\0';
-    return true;
+    if (!map) return;
+    if (map->capacity) memset(map->ctrl, STR_MAP_EMPTY_, map->capacity + STR_MAP_GROUP_);
+    map->count = 0;
+    map->growth_left = map->capacity - map->capacity / 8;
+    str_arena_free_(&map->keys);
 }
 
 STRDEF bool
-str_append_one_n(String *str, const char *cstr, size_t len) STR_NOEXCEPT
+str_map_reserve(StrMap *map, size_t count) STR_NOEXCEPT
 {
-    if (!str || (!cstr && len)) return false;
-
-    if (str_would_overflow_(str->size, len)) return false;
-    if (!str_grow_to_fit_(str, str->size + len)) return false;
+    if (!map) return false;
+    if (count <= map->count + map->growth_left) return true;
+    if (count > SIZE_MAX / 8) return false; // Overflow protection
+
+    size_t need = count + count / 7 + 1;
+    size_t cap  = map->capacity ? map->capacity : 16;
+    while (cap < need) {
+        if (cap > SIZE_MAX / 2) return false; // Overflow protection
+        cap *= 2;
+    }
+    return str_map_resize_(map, cap);
+}
 
-    if (len) memcpy(str->buffer + str->size, cstr, len);
-    str->size += len;
-    str->buffer[str->size] = '\0';
+STRDEF StrMapEntry *
+str_map_find_n(const StrMap *map, const char *key, size_t len) STR_NOEXCEPT
+{
+    if (!map || map->capacity == 0 || (!key && len)) return STR_NULL;
+    size_t i = str_map_lookup_(map, key, len, str_hash64_n(key, len, 0));
+    return i == SIZE_MAX ? STR_NULL : (StrMapEntry *)&map->entries[i];
+}
 
-    return true;
+STRDEF StrMapEntry *
+str_map_find(const StrMap *map, const String *key) STR_NOEXCEPT
+{
+    if (!key) return STR_NULL;
+    return str_map_find_n(map, key->buffer, key->size);
 }
 
-STRDEF bool
-str_append_one(String *str, const char *cstr) STR_NOEXCEPT
+STRDEF StrMapEntry *
+str_map_find_slice(const StrMap *map, StrSlice key) STR_NOEXCEPT
 {
-    if (!str || !cstr) return false;
-    size_t len = strlen(cstr);
-    return str_append_one_n(str, cstr, len);
+    return str_map_find_n(map, key.data, key.size);
 }
 
-STRDEF bool
-str_append_(String *str, const char *new_data1, ...) STR_NOEXCEPT
+STRDEF StrMapEntry *
+str_map_upsert_n(StrMap *map, const char *key, size_t len, bool *inserted) STR_NOEXCEPT
 {
-    if (!str) return false;
+    if (inserted) *inserted = false;
+    if (!map || (!key && len)) return STR_NULL;
 
-    va_list args;
-    va_start(args, new_data1);
+    uint64_t hash = str_hash64_n(key, len, 0);
+    if (map->capacity) {
+        size_t i = str_map_lookup_(map, key, len, hash);
+        if (i != SIZE_MAX) return &map->entries[i];
+    }
 
-    bool ok = true;
-    const char *data = new_data1;
-    while (ok && data != STR_NULL) {
-        if (!str_append_one(str, data)) ok = false;
-        data = va_arg(args, const char *);
+    if (map->growth_left == 0) {
+        // Mostly tombstones: rehash in place. Otherwise double.
+        size_t new_cap = map->capacity == 0 ? 16
+                       : map->count * 2 <= map->capacity - map->capacity / 8 ? map->capacity
+                       : map->capacity * 2;
+        if (new_cap < map->capacity || !str_map_resize_(map, new_cap)) return STR_NULL;
     }
 
-    va_end(args);
+    if (len + 1 < len) return STR_NULL; // Overflow protection
+    char *copy = str_arena_alloc_(&map->keys, len + 1, STR_MAP_BLOCK_SIZE);
+    if (!copy) return STR_NULL;
+    if (len) memcpy(copy, key, len);
+    copy[len] = '\0';
+
+    size_t i = str_map_free_slot_(map->ctrl, map->capacity, hash);
+    if (map->ctrl[i] == STR_MAP_EMPTY_) map->growth_left -= 1;
+    str_map_set_ctrl_(map, i, (unsigned char)(hash & 0x7F));
+
+    StrMapEntry *e = &map->entries[i];
+    e->hash     = hash;
+    e->key      = copy;
+    e->key_size = len;
+    e->value    = STR_NULL;
+    map->count += 1;
+
+    if (inserted) *inserted = true;
+    return e;
+}
 
-    return ok;
+STRDEF StrMapEntry *
+str_map_upsert(StrMap *map, const String *key, bool *inserted) STR_NOEXCEPT
+{
+    if (!key) {
+        if (inserted) *inserted = false;
+        return STR_NULL;
+    }
+    return str_map_upsert_n(map, key->buffer, key->size, inserted);
 }
 
 STRDEF bool
-str_append_char(String *str, char c) STR_NOEXCEPT
+str_map_put_n(StrMap *map, const char *key, size_t len, void *value) STR_NOEXCEPT
 {
-    if (!str) return false;
-    if (str_would_overflow_(str->size, 1)) return false;
-    if (!str_grow_to_fit_(str, str->size + 1)) return false;
-    str->buffer[str->size++] = c;
-    str->buffer[str->size] = '\0';
+    StrMapEntry *e = str_map_upsert_n(map, key, len, STR_NULL);
+    if (!e) return false;
+    e->value = value;
     return true;
 }
 
 STRDEF bool
-str_append_repeat(String *str, char c, size_t n) STR_NOEXCEPT
+str_map_put(StrMap *map, const String *key, void *value) STR_NOEXCEPT
 {
-    if (!str) return false;
-    if (n == 0) return true;
-    if (str_would_overflow_(str->size, n)) return false;
-    if (!str_grow_to_fit_(str, str->size + n)) return false;
+    if (!key) return false;
+    return str_map_put_n(map, key->buffer, key->size, value);
+}
 
-    memset(str->buffer + str->size, (unsigned char)c, n);
-    str->size += n;
-    str->buffer[str->size] = '\0';
+STRDEF bool
+str_map_remove_n(StrMap *map, const char *key, size_t len) STR_NOEXCEPT
+{
+    if (!map || map->capacity == 0 || (!key && len)) return false;
+
+    size_t i = str_map_lookup_(map, key, len, str_hash64_n(key, len, 0));
+    if (i == SIZE_MAX) return false;
+
+    // The slot can go straight back to empty if every group sized window
+    // around it still has an empty slot. Then no probe ever found the window
+    // full and moved past it, so no other key depends on this slot.
+    const size_t mask = map->capacity - 1;
+    size_t after = 0, before = 0;
+    while (after < STR_MAP_GROUP_ && map->ctrl[(i + after) & mask] != STR_MAP_EMPTY_) after++;
+    while (before < STR_MAP_GROUP_ && map->ctrl[(i - before - 1) & mask] != STR_MAP_EMPTY_) before++;
+    if (after + before < STR_MAP_GROUP_) {
+        str_map_set_ctrl_(map, i, STR_MAP_EMPTY_);
+        map->growth_left += 1;
+    } else {
+        str_map_set_ctrl_(map, i, STR_MAP_DELETED_);
+    }
+    map->count -= 1;
     return true;
 }
 
 STRDEF bool
-str_append_str(String *str, const String *app) STR_NOEXCEPT
+str_map_remove(StrMap *map, const String *key) STR_NOEXCEPT
 {
-    if (!str) return false;
-    if (!app || app->size == 0) return true;
+    if (!key) return false;
+    return str_map_remove_n(map, key->buffer, key->size);
+}
 
-    if (str == app) {
-        size_t len = str->size;
-        if (!str_grow_to_fit_(str, str->size + len)) return false;
-        // source and destination are the same allocation, so use memmove
-        memmove(str->buffer + str->size, str->buffer, len);
-        str->size += len;
-        str->buffer[str->size] = '\0';
-        return true;
+STRDEF StrMapEntry *
+str_map_next(const StrMap *map, size_t *iter) STR_NOEXCEPT
+{
+    if (!map || !iter) return STR_NULL;
+    while (*iter < map->capacity) {
+        size_t i = (*iter)++;
+        if (!(map->ctrl[i] & 0x80)) return (StrMapEntry *)&map->entries[i];
     }
+    return STR_NULL;
+}
 
-    return str_append_one_n(str, app->buffer, app->size);
+
+//
+// String vectors
+//
+
+// Grow an array of elem_size elements to hold at least need of them
+static inline bool
+str_vec_grow_(void **data, size_t *capacity, size_t need, size_t elem_size, size_t min_cap)
+{
+    if (need <= *capacity) return true;
+
+    size_t cap = *capacity ? *capacity : min_cap;
+    while (cap < need) {
+        if (cap > SIZE_MAX / 2) { cap = need; break; } // Overflow protection
+        cap *= 2;
+    }
+    if (cap > SIZE_MAX / elem_size) return false; // Overflow protection
+
+    void *p = STR_REALLOC(*data, cap * elem_size);
+    if (!p) return false;
+    *data = p;
+    *capacity = cap;
+    return true;
 }
 
-STRDEF bool
-str_vappendf(String *str, const char *fmt, va_list args) STR_NOEXCEPT
+static inline bool
+str_vec_grow_bytes_(StrVec *vec, size_t need)
 {
-    if (!str || !fmt) return false;
+    void *p = vec->bytes;
+    bool ok = str_vec_grow_(&p, &vec->bytes_capacity, need, 1, 256);
+    vec->bytes = (char *)p;
+    return ok;
+}
 
-    va_list ap;
-    va_copy(ap, args);
-    int need = vsnprintf(STR_NULL, 0, fmt, ap);
-    va_end(ap);
-    if (need < 0) return false;
+static inline bool
+str_vec_grow_items_(StrVec *vec, size_t need)
+{
+    void *p = vec->items;
+    bool ok = str_vec_grow_(&p, &vec->items_capacity, need, sizeof(StrVecItem), 16);
+    vec->items = (StrVecItem *)p;
+    return ok;
+}
 
-    if (!str_grow_to_fit_(str, str->size + (size_t)need)) return false;
+STRDEF StrVec
+str_vec_init(STR_NO_PARAMS) STR_NOEXCEPT
+{
+    StrVec vec;
+    memset(&vec, 0, sizeof(vec));
+    return vec;
+}
 
-    va_copy(ap, args);
-    vsnprintf(str->buffer + str->size, (size_t)need + 1, fmt, ap);
-    va_end(ap);
+STRDEF void
+str_vec_free(StrVec *vec) STR_NOEXCEPT
+{
+    if (!vec) return;
+    STR_FREE(vec->bytes);
+    STR_FREE(vec->items);
+    memset(vec, 0, sizeof(*vec));
+}
 
-    str->size += (size_t)need;
-    str->buffer[str->size] = '\0';
-    return true;
+STRDEF void
+str_vec_clear(StrVec *vec) STR_NOEXCEPT
+{
+    if (!vec) return;
+    vec->bytes_size = 0;
+    vec->count = 0;
+    vec->dead = 0;
 }
 
 STRDEF bool
-str_appendf(String *str, const char *fmt, ...) STR_NOEXCEPT
+str_vec_reserve(StrVec *vec, size_t count, size_t bytes) STR_NOEXCEPT
 {
-    if (!str || !fmt) return false;
-    va_list args;
-    va_start(args, fmt);
-    bool ok = str_vappendf(str, fmt, args);
-    va_end(args);
-    return ok;
+    if (!vec) return false;
+    if (str_would_overflow_(vec->count, count)) return false;
+    if (str_would_overflow_(vec->bytes_size, bytes)) return false;
+    return str_vec_grow_items_(vec, vec->count + count) &&
+           str_vec_grow_bytes_(vec, vec->bytes_size + bytes);
 }
 
 STRDEF bool
-str_insert_one_n(String *str, size_t pos, const char *cstr, size_t len) STR_NOEXCEPT
+str_vec_push_n(StrVec *vec, const char *data, size_t len) STR_NOEXCEPT
 {
-    if (!str) return false;
-    if (pos > str->size) return false;
-    if (!cstr && len) return false;
-    if (len == 0) return true;
-
-    if (str_would_overflow_(str->size, len)) return false;
-    if (!str_grow_to_fit_(str, str->size + len)) return false;
-
-    size_t tail = str->size - pos;
-    memmove(str->buffer + pos + len, str->buffer + pos, tail);
-    if (len) memcpy(str->buffer + pos, cstr, len);
-
-    str->size += len;
-    str->buffer[str->size] = '\0';
+    if (!vec || (!data && len)) return false;
+    if (str_would_overflow_(vec->bytes_size, len)) return false;
+    if (!str_vec_grow_items_(vec, vec->count + 1)) return false;
+
+    // data may point into our own blob, which growing can move
+    bool self = len && vec->bytes && data >= vec->bytes && data < vec->bytes + vec->bytes_size;
+    size_t self_off = self ? (size_t)(data - vec->bytes) : 0;
+    if (!str_vec_grow_bytes_(vec, vec->bytes_size + len)) return false;
+    if (self) data = vec->bytes + self_off;
+
+    if (len) memcpy(vec->bytes + vec->bytes_size, data, len);
+    vec->items[vec->count].offset = vec->bytes_size;
+    vec->items[vec->count].size   = len;
+    vec->bytes_size += len;
+    vec->count += 1;
     return true;
 }
 
 STRDEF bool
-str_insert_one(String *str, size_t pos, const char *cstr) STR_NOEXCEPT
+str_vec_push(StrVec *vec, const char *cstr) STR_NOEXCEPT
 {
-    if (!str || !cstr) return false;
-    size_t len = strlen(cstr);
-    return str_insert_one_n(str, pos, cstr, len);
+    if (!cstr) return false;
+    return str_vec_push_n(vec, cstr, strlen(cstr));
 }
 
 STRDEF bool
-str_erase(String *str, size_t pos, size_t len) STR_NOEXCEPT
+str_vec_push_str(StrVec *vec, const String *str) STR_NOEXCEPT
 {
     if (!str) return false;
-    if (pos > str->size) return false;
-    if (len == 0) return true;
-
-    size_t remain = str->size - pos;
-    if (len > remain) len = remain;
-
-    size_t end  = pos + len;
-    size_t tail = str->size - end;
+    return str_vec_push_n(vec, str->buffer, str->size);
+}
 
-    if (tail) memmove(str->buffer + pos, str->buffer + end, tail);
+STRDEF StrSlice
+str_vec_get(const StrVec *vec, size_t i) STR_NOEXCEPT
+{
+    if (!vec || i >= vec->count) return str_slice_n(STR_NULL, 0);
+    return str_slice_n(vec->bytes ? vec->bytes + vec->items[i].offset : STR_NULL, vec->items[i].size);
+}
 
-    str->size -= len;
-    str->buffer[str->size] = '\0';
+STRDEF bool
+str_vec_next(const StrVec *vec, size_t *iter, StrSlice *out) STR_NOEXCEPT
+{
+    if (!vec || !iter || *iter >= vec->count) return false;
+    if (out) *out = str_vec_get(vec, *iter);
+    *iter += 1;
     return true;
 }
 
 STRDEF bool
-str_replace_one_n(String *str, size_t pos, size_t len, const char *cstr, size_t slen) STR_NOEXCEPT
+str_vec_remove(StrVec *vec, size_t i) STR_NOEXCEPT
 {
-    if (!str) return false;
-    if (pos > str->size) return false;
-    if (!cstr && slen) return false;
-
-    // Calculate target end after erase
-    size_t end = pos + len;
-    if (end > str->size) end = str->size;
-    size_t cut = end - pos;
-
-    // Resize to new total size
-    size_t tmp = str->size - cut;
-    if (str_would_overflow_(tmp, slen)) return false;
-    size_t new_size = tmp + slen;
-    if (!str_grow_to_fit_(str, new_size)) return false;
-
-    // Move tail to its new position if needed
-    size_t old_tail = str->size - end;
-    if (old_tail && (slen != cut)) {
-        memmove(str->buffer + pos + slen, str->buffer + end, old_tail);
-    }
+    if (!vec || i >= vec->count) return false;
 
-    if (slen) memcpy(str->buffer + pos, cstr, slen);
+    size_t size = vec->items[i].size;
+    memmove(vec->items + i, vec->items + i + 1, (vec->count - i - 1) * sizeof(StrVecItem));
+    vec->count -= 1;
 
-    str->size = new_size;
-    str->buffer[str->size] = '\0';
+    // Everything after the last live element is dead and can be reused now
+    size_t end = vec->count ? vec->items[vec->count - 1].offset + vec->items[vec->count - 1].size : 0;
+    vec->dead += size;
+    vec->dead -= vec->bytes_size - end;
+    vec->bytes_size = end;
     return true;
 }
 
-STRDEF bool
-str_replace_one(String *str, size_t pos, size_t len, const char *cstr) STR_NOEXCEPT
+STRDEF void
+str_vec_compact(StrVec *vec) STR_NOEXCEPT
 {
-    if (!str) return false;
-    size_t slen = strlen(cstr);
-    return str_replace_one_n(str, pos, len, cstr, slen);
+    if (!vec || vec->dead == 0) return;
+
+    // Items are in blob order, so every element moves left or stays
+    size_t w = 0;
+    for (size_t i = 0; i < vec->count; ++i) {
+        StrVecItem *it = &vec->items[i];
+        if (it->offset != w && it->size) memmove(vec->bytes + w, vec->bytes + it->offset, it->size);
+        it->offset = w;
+        w += it->size;
+    }
+    vec->bytes_size = w;
+    vec->dead = 0;
 }
 
 STRDEF bool
-str_back(const String *str, char *out_char) STR_NOEXCEPT
+str_vec_push_strs(StrVec *vec, const String *strs, size_t n) STR_NOEXCEPT
 {
-    if (!str || str->size == 0) return false;
-    if (out_char) *out_char = str->buffer[str->size - 1];
+    if (!vec || (!strs && n)) return false;
+
+    size_t total = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (str_would_overflow_(total, strs[i].size)) return false;
+        total += strs[i].size;
+    }
+    if (!str_vec_reserve(vec, n, total)) return false;
+
+    for (size_t i = 0; i < n; ++i) {
+        size_t len = strs[i].size;
+        if (len) memcpy(vec->bytes + vec->bytes_size, strs[i].buffer, len);
+        vec->items[vec->count].offset = vec->bytes_size;
+        vec->items[vec->count].size   = len;
+        vec->bytes_size += len;
+        vec->count += 1;
+    }
     return true;
 }
 
 STRDEF bool
-str_pop_back(String *str, char *out_char) STR_NOEXCEPT
+str_vec_to_strs(const StrVec *vec, String *out) STR_NOEXCEPT
 {
-    if (!str || str->size == 0) return false;
-    if (out_char) *out_char = str->buffer[str->size - 1];
-    str->size -= 1;
-    str->buffer[str->size] = '\0';
+    if (!vec || (!out && vec->count)) return false;
+
+    for (size_t i = 0; i < vec->count; ++i) {
+        size_t len = vec->items[i].size;
+        if (len + 1 < len) return false; // Overflow protection
+        char *p = (char *)STR_REALLOC(STR_NULL, len + 1);
+        if (!p) {
+            while (i-- > 0) str_free(&out[i]);
+            return false;
+        }
+        if (len) memcpy(p, vec->bytes + vec->items[i].offset, len);
+        p[len] = '\0';
+        out[i].buffer   = p;
+        out[i].capacity = len + 1;
+        out[i].size     = len;
+    }
     return true;
 }
 
 STRDEF bool
-str_ltrim(String *str) STR_NOEXCEPT
+str_vec_write_file(const StrVec *vec, FILE *f) STR_NOEXCEPT
 {
-    if (!str || str->size == 0) return true;
+    if (!vec || !f) return false;
+    if (vec->dead == 0) {
+        if (vec->bytes_size == 0) return true;
+        return fwrite(vec->bytes, 1, vec->bytes_size, f) == vec->bytes_size;
+    }
 
+    // Write runs of adjacent live elements with one fwrite each
     size_t i = 0;
-    while (i < str->size && isspace((unsigned char)str->buffer[i])) i++;
-
-    if (i == 0) return true;
-    size_t remain = str->size - i;
-    memmove(str->buffer, str->buffer + i, remain);
-    str->size = remain;
-    str->buffer[str->size] = '\0';
+    while (i < vec->count) {
+        size_t start = vec->items[i].offset;
+        size_t end   = start + vec->items[i].size;
+        for (++i; i < vec->count && vec->items[i].offset == end; ++i) end += vec->items[i].size;
+        if (end > start && fwrite(vec->bytes + start, 1, end - start, f) != end - start) return false;
+    }
     return true;
 }
 
-STRDEF bool
-str_rtrim(String *str) STR_NOEXCEPT
+
+//
+// Sorting
+//
+// Multikey quicksort (Bentley and Sedgewick) over 8 byte digits. Each item
+// caches the digit at the current depth as a big endian integer, so the
+// partition loops compare integers in a flat array instead of chasing string
+// pointers. Items equal on a digit are sorted one digit deeper.
+//
+
+#define STR_SORT_SMALL_ 24
+
+typedef struct {
+    uint64_t    key;   // 8 bytes at the current depth, see str_load_be64_
+    const char *data;
+    size_t      size;
+    size_t      index; // position in the input
+} StrSortItem_;
+
+static inline void
+str_sort_load_keys_(StrSortItem_ *a, size_t n, size_t depth)
 {
-    if (!str || str->size == 0) return true;
+    for (size_t i = 0; i < n; ++i) {
+        size_t rest = a[i].size > depth ? a[i].size - depth : 0;
+        a[i].key = rest ? str_load_be64_((const unsigned char *)a[i].data + depth, rest) : 0;
+    }
+}
 
-    size_t i = str->size;
-    while (i > 0 && isspace((unsigned char)str->buffer[i - 1])) i--;
+// Full order of two items whose first depth bytes are equal
+static inline int
+str_sort_cmp_(const StrSortItem_ *x, const StrSortItem_ *y, size_t depth)
+{
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    size_t d = depth + 8;
+    if (x->size <= d || y->size <= d) {
+        return x->size < y->size ? -1 : x->size > y->size ? 1 : 0;
+    }
+    return str_compare_bytes_(x->data + d, x->size - d, y->data + d, y->size - d);
+}
 
-    if (i == str->size) return true;
-    str->size = i;
-    str->buffer[str->size] = '\0';
-    return true;
+static inline void
+str_sort_insertion_(StrSortItem_ *a, size_t n, size_t depth)
+{
+    for (size_t i = 1; i < n; ++i) {
+        StrSortItem_ t = a[i];
+        size_t j = i;
+        while (j > 0 && str_sort_cmp_(&t, &a[j - 1], depth) < 0) {
+            a[j] = a[j - 1];
+            j--;
+        }
+        a[j] = t;
+    }
 }
 
-STRDEF bool
-str_trim(String *str) STR_NOEXCEPT
+static inline void
+str_sort_swap_(StrSortItem_ *a, size_t i, size_t j)
 {
-    if (!str) return false;
-    bool ok = str_rtrim(str);
-    if (!ok) return false;
-    return str_ltrim(str);
+    StrSortItem_ t = a[i];
+    a[i] = a[j];
+    a[j] = t;
 }
 
-STRDEF size_t
-str_find_n(const String *str, const char *needle, size_t nlen) STR_NOEXCEPT
+static inline uint64_t
+str_sort_median3_(uint64_t a, uint64_t b, uint64_t c)
 {
-    if (!str || !str->buffer) return SIZE_MAX;
-    if (!needle) return SIZE_MAX;
-    if (nlen == 0) return 0;
-    if (str->size == 0 || nlen > str->size) return SIZE_MAX;
+    if (a < b) return b < c ? b : (a < c ? c : a);
+    return a < c ? a : (b < c ? c : b);
+}
 
-    const char *hay = str->buffer;
-    size_t last = str->size - nlen;
+// Sort a[0..n) whose first depth bytes are all equal and whose keys are
+// loaded for depth
+static inline void
+str_sort_mkqs_(StrSortItem_ *a, size_t n, size_t depth)
+{
+    while (n > STR_SORT_SMALL_) {
+        uint64_t pivot = str_sort_median3_(a[0].key, a[n / 2].key, a[n - 1].key);
+
+        // Three way partition: [0, lt) < pivot, [lt, gt) == pivot, [gt, n) > pivot
+        size_t lt = 0, i = 0, gt = n;
+        while (i < gt) {
+            if (a[i].key < pivot)      str_sort_swap_(a, lt++, i++);
+            else if (a[i].key > pivot) str_sort_swap_(a, i, --gt);
+            else                       i++;
+        }
 
-    for (size_t i = 0; i <= last; ++i) {
-        if (hay[i] == needle[0] && memcmp(hay + i, needle, nlen) == 0) {
-            return i;
+        // Strings that end inside the equal digit are prefixes of the ones
+        // that go on, and only differ from each other by length
+        StrSortItem_ *eq = a + lt;
+        size_t eq_n = gt - lt, ended = 0;
+        for (size_t k = 0; k < eq_n; ++k) {
+            if (eq[k].size <= depth + 8) str_sort_swap_(eq, ended++, k);
+        }
+        if (ended > 1) {
+            size_t at = 0;
+            for (size_t len = depth; len <= depth + 8 && at < ended; ++len) {
+                for (size_t k = at; k < ended; ++k) {
+                    if (eq[k].size == len) str_sort_swap_(eq, at++, k);
+                }
+            }
         }
+        if (eq_n - ended > 1) str_sort_load_keys_(eq + ended, eq_n - ended, depth + 8);
+
+        // Recurse into the two smaller parts and loop on the largest, so the
+        // stack stays O(log n) however long the shared prefixes are
+        StrSortItem_ *parts[3]  = {a, eq + ended, a + gt};
+        size_t        sizes[3]  = {lt, eq_n - ended, n - gt};
+        size_t        depths[3] = {depth, depth + 8, depth};
+        size_t big = 0;
+        if (sizes[1] > sizes[big]) big = 1;
+        if (sizes[2] > sizes[big]) big = 2;
+        for (size_t k = 0; k < 3; ++k) {
+            if (k != big && sizes[k] > 1) str_sort_mkqs_(parts[k], sizes[k], depths[k]);
+        }
+        a     = parts[big];
+        n     = sizes[big];
+        depth = depths[big];
     }
-    return SIZE_MAX;
+    str_sort_insertion_(a, n, depth);
 }
 
-STRDEF size_t
-str_find(const String *str, const char *needle) STR_NOEXCEPT
+static inline StrSortItem_ *
+str_sort_items_from_strs_(const String *strs, size_t n)
 {
-    if (!needle) return SIZE_MAX;
-    return str_find_n(str, needle, strlen(needle));
+    if (n > SIZE_MAX / sizeof(StrSortItem_)) return STR_NULL; // Overflow protection
+    StrSortItem_ *items = (StrSortItem_ *)STR_REALLOC(STR_NULL, n * sizeof(StrSortItem_));
+    if (!items) return STR_NULL;
+    for (size_t i = 0; i < n; ++i) {
+        items[i].data  = strs[i].buffer;
+        items[i].size  = strs[i].size;
+        items[i].index = i;
+    }
+    return items;
 }
 
-STRDEF size_t
-str_rfind_n(const String *str, const char *needle, size_t nlen) STR_NOEXCEPT
+static inline StrSortItem_ *
+str_sort_items_from_vec_(const StrVec *vec)
 {
-    if (!str || !str->buffer) return SIZE_MAX;
-    if (!needle) return SIZE_MAX;
-    if (nlen == 0) return str->size;
-    if (str->size == 0 || nlen > str->size) return SIZE_MAX;
-
-    const char *hay = str->buffer;
-    for (size_t i = str->size - nlen + 1; i-- > 0; ) {
-        if (hay[i] == needle[0] && memcmp(hay + i, needle, nlen) == 0) {
-            return i;
-        }
-        if (i == 0) break;
+    size_t n = vec->count;
+    if (n > SIZE_MAX / sizeof(StrSortItem_)) return STR_NULL; // Overflow protection
+    StrSortItem_ *items = (StrSortItem_ *)STR_REALLOC(STR_NULL, n * sizeof(StrSortItem_));
+    if (!items) return STR_NULL;
+    for (size_t i = 0; i < n; ++i) {
+        items[i].data  = vec->bytes + vec->items[i].offset;
+        items[i].size  = vec->items[i].size;
+        items[i].index = i;
     }
-    return SIZE_MAX;
+    return items;
 }
 
-STRDEF size_t
-str_rfind(const String *str, const char *needle) STR_NOEXCEPT
+// Reorder strs to match the sorted items
+static inline bool
+str_sort_apply_strs_(String *strs, const StrSortItem_ *items, size_t n)
 {
-    if (!needle) return SIZE_MAX;
-    return str_rfind_n(str, needle, strlen(needle));
+    String *tmp = (String *)STR_REALLOC(STR_NULL, n * sizeof(String));
+    if (!tmp) return false;
+    for (size_t i = 0; i < n; ++i) tmp[i] = strs[items[i].index];
+    memcpy(strs, tmp, n * sizeof(String));
+    STR_FREE(tmp);
+    return true;
 }
 
-STRDEF bool
-str_equals(const String *a, const String *b) STR_NOEXCEPT
+// Rebuild the blob in sorted order
+static inline bool
+str_sort_apply_vec_(StrVec *vec, const StrSortItem_ *items)
 {
-    if (a == b) return true;
-    if (!a || !b) return false;
-    if (a->size != b->size) return false;
-    if (a->size == 0) return true;
-    return memcmp(a->buffer, b->buffer, a->size) == 0;
+    char *bytes = (char *)STR_REALLOC(STR_NULL, vec->bytes_capacity ? vec->bytes_capacity : 1);
+    if (!bytes) return false;
+
+    size_t w = 0;
+    for (size_t i = 0; i < vec->count; ++i) {
+        if (items[i].size) memcpy(bytes + w, items[i].data, items[i].size);
+        vec->items[i].offset = w;
+        vec->items[i].size   = items[i].size;
+        w += items[i].size;
+    }
+
+    STR_FREE(vec->bytes);
+    vec->bytes      = bytes;
+    vec->bytes_size = w;
+    vec->dead       = 0;
+    return true;
 }
 
 STRDEF bool
-str_equals_cstr(const String *str, const char *cstr) STR_NOEXCEPT
+str_sort(String *strs, size_t n) STR_NOEXCEPT
 {
-    if (!str || !cstr) return false;
-    size_t len = strlen(cstr);
-    return str_equals_n(str, cstr, len);
+    if (!strs && n) return false;
+    if (n < 2) return true;
+
+    StrSortItem_ *items = str_sort_items_from_strs_(strs, n);
+    if (!items) return false;
+    str_sort_load_keys_(items, n, 0);
+    str_sort_mkqs_(items, n, 0);
+    bool ok = str_sort_apply_strs_(strs, items, n);
+    STR_FREE(items);
+    return ok;
 }
 
 STRDEF bool
-str_equals_n(const String *str, const char *buf, size_t n) STR_NOEXCEPT
+str_vec_sort(StrVec *vec) STR_NOEXCEPT
 {
-    if (!str || !buf) return false;
-    if (str->size != n) return false;
-    if (n == 0) return true;
-    return memcmp(str->buffer, buf, n) == 0;
+    if (!vec) return false;
+    if (vec->count < 2 && vec->dead == 0) return true;
+
+    StrSortItem_ *items = str_sort_items_from_vec_(vec);
+    if (!items && vec->count) return false;
+    str_sort_load_keys_(items, vec->count, 0);
+    str_sort_mkqs_(items, vec->count, 0);
+    bool ok = str_sort_apply_vec_(vec, items);
+    STR_FREE(items);
+    return ok;
 }
 
-STRDEF bool
-str_write_file(const String *str, FILE *f) STR_NOEXCEPT
+#ifdef STR_SORT_PARALLEL
+
+// Sample sort: splitters drawn from the input cut it into buckets, threads
+// classify and scatter their own chunk, then claim whole buckets to sort.
+// Splitters come from the data rather than the first byte, so inputs that
+// share long prefixes still spread out.
+
+#define STR_SORT_MAX_THREADS_  64
+#define STR_SORT_OVERSAMPLE_   32
+
+typedef struct {
+    const StrSortItem_ *items;
+    StrSortItem_       *out;
+    uint16_t           *bucket_of;
+    const StrSortItem_ *splitters;  // sorted, nbuckets - 1 of them
+    size_t              n;
+    size_t              nbuckets;
+    unsigned            threads;
+    size_t             *cursor;     // threads x nbuckets counts, then positions
+    size_t             *starts;     // nbuckets + 1
+    int                 phase;
+    volatile long       next;       // next bucket to claim in the last phase
+} StrSortShared_;
+
+typedef struct {
+    StrSortShared_ *sh;
+    unsigned        id;
+} StrSortThread_;
+
+static inline long
+str_sort_claim_(volatile long *next)
 {
-    if (!str || !f) return false;
-    if (str->size == 0) return true;
-    size_t n = fwrite(str->buffer, 1, str->size, f);
-    return n == str->size;
+#if defined(_WIN32)
+    return InterlockedIncrement(next) - 1;
+#else
+    return __atomic_fetch_add(next, 1, __ATOMIC_RELAXED);
+#endif
 }
 
-STRDEF bool
-str_read_file(String *str, FILE *f) STR_NOEXCEPT
+// Number of splitters that sort before item
+static inline size_t
+str_sort_bucket_(const StrSortShared_ *sh, const StrSortItem_ *item)
 {
-    if (!str || !f) return false;
+    size_t lo = 0, hi = sh->nbuckets - 1;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const StrSortItem_ *sp = &sh->splitters[mid];
+        if (str_compare_bytes_(sp->data, sp->size, item->data, item->size) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
 
-    char buf[32768];
-    for (;;) {
-        size_t r = fread(buf, 1, sizeof(buf), f);
-        if (r > 0) {
-            if (!str_append_one_n(str, buf, r)) return false;
+#if defined(_WIN32)
+static DWORD WINAPI
+#else
+static void *
+#endif
+str_sort_worker_(void *arg)
+{
+    StrSortThread_ *th = (StrSortThread_ *)arg;
+    StrSortShared_ *sh = th->sh;
+    size_t chunk = (sh->n + sh->threads - 1) / sh->threads;
+    size_t lo = (size_t)th->id * chunk;
+    size_t hi = lo + chunk < sh->n ? lo + chunk : sh->n;
+    size_t *cursor = sh->cursor + (size_t)th->id * sh->nbuckets;
+
+    if (sh->phase == 0) {
+        for (size_t i = lo; i < hi; ++i) {
+            size_t b = str_sort_bucket_(sh, &sh->items[i]);
+            sh->bucket_of[i] = (uint16_t)b;
+            cursor[b]++;
         }
-        if (r < sizeof(buf)) {
-            if (feof(f)) break;
-            if (ferror(f)) return false;
+    } else if (sh->phase == 1) {
+        for (size_t i = lo; i < hi; ++i) sh->out[cursor[sh->bucket_of[i]]++] = sh->items[i];
+    } else {
+        for (;;) {
+            long b = str_sort_claim_(&sh->next);
+            if (b < 0 || (size_t)b >= sh->nbuckets) break;
+            size_t start = sh->starts[b], count = sh->starts[b + 1] - start;
+            str_sort_load_keys_(sh->out + start, count, 0);
+            str_sort_mkqs_(sh->out + start, count, 0);
+        }
+    }
+    return 0;
+}
+
+// Run the current phase on all threads, the caller being thread 0
+static inline void
+str_sort_run_phase_(StrSortShared_ *sh, StrSortThread_ *th)
+{
+#if defined(_WIN32)
+    HANDLE handles[STR_SORT_MAX_THREADS_];
+#else
+    pthread_t handles[STR_SORT_MAX_THREADS_];
+#endif
+    bool started[STR_SORT_MAX_THREADS_] = {false};
+    for (unsigned t = 1; t < sh->threads; ++t) {
+#if defined(_WIN32)
+        handles[t] = CreateThread(STR_NULL, 0, str_sort_worker_, &th[t], 0, STR_NULL);
+        started[t] = handles[t] != STR_NULL;
+#else
+        started[t] = pthread_create(&handles[t], STR_NULL, str_sort_worker_, &th[t]) == 0;
+#endif
+        // Chunks are fixed per thread, so do the work here if the thread did not start
+        if (!started[t]) str_sort_worker_(&th[t]);
+    }
+    str_sort_worker_(&th[0]);
+    for (unsigned t = 1; t < sh->threads; ++t) {
+        if (!started[t]) continue;
+#if defined(_WIN32)
+        WaitForSingleObject(handles[t], INFINITE);
+        CloseHandle(handles[t]);
+#else
+        pthread_join(handles[t], STR_NULL);
+#endif
+    }
+}
+
+// Sort items into *pitems, which is replaced by the sorted array
+static inline bool
+str_sort_parallel_items_(StrSortItem_ **pitems, size_t n, unsigned threads)
+{
+    if (threads > STR_SORT_MAX_THREADS_) threads = STR_SORT_MAX_THREADS_;
+    StrSortShared_ sh;
+    memset(&sh, 0, sizeof(sh));
+    sh.items    = *pitems;
+    sh.n        = n;
+    sh.threads  = threads;
+    sh.nbuckets = 4 * (size_t)threads; // more buckets than threads evens out the last phase
+    if (sh.nbuckets > n / STR_SORT_OVERSAMPLE_) sh.nbuckets = n / STR_SORT_OVERSAMPLE_;
+
+    size_t nsample = sh.nbuckets * STR_SORT_OVERSAMPLE_;
+    StrSortItem_ *sample   = (StrSortItem_ *)STR_REALLOC(STR_NULL, nsample * sizeof(StrSortItem_));
+    sh.out                 = (StrSortItem_ *)STR_REALLOC(STR_NULL, n * sizeof(StrSortItem_));
+    sh.bucket_of           = (uint16_t *)STR_REALLOC(STR_NULL, n * sizeof(uint16_t));
+    sh.cursor              = (size_t *)STR_REALLOC(STR_NULL, threads * sh.nbuckets * sizeof(size_t));
+    sh.starts              = (size_t *)STR_REALLOC(STR_NULL, (sh.nbuckets + 1) * sizeof(size_t));
+    if (!sample || !sh.out || !sh.bucket_of || !sh.cursor || !sh.starts) {
+        STR_FREE(sample);
+        STR_FREE(sh.out);
+        STR_FREE(sh.bucket_of);
+        STR_FREE(sh.cursor);
+        STR_FREE(sh.starts);
+        return false;
+    }
+
+    // Evenly spaced sample, sorted, every OVERSAMPLE-th one is a splitter
+    for (size_t i = 0; i < nsample; ++i) sample[i] = sh.items[i * (n / nsample)];
+    str_sort_load_keys_(sample, nsample, 0);
+    str_sort_mkqs_(sample, nsample, 0);
+    for (size_t b = 1; b < sh.nbuckets; ++b) sample[b - 1] = sample[b * STR_SORT_OVERSAMPLE_];
+    sh.splitters = sample;
+    memset(sh.cursor, 0, threads * sh.nbuckets * sizeof(size_t));
+
+    StrSortThread_ th[STR_SORT_MAX_THREADS_];
+    for (unsigned t = 0; t < threads; ++t) {
+        th[t].sh = &sh;
+        th[t].id = t;
+    }
+
+    sh.phase = 0;
+    str_sort_run_phase_(&sh, th);
+
+    // Turn per thread counts into write positions, bucket major
+    size_t pos = 0;
+    for (size_t b = 0; b < sh.nbuckets; ++b) {
+        sh.starts[b] = pos;
+        for (unsigned t = 0; t < threads; ++t) {
+            size_t c = sh.cursor[t * sh.nbuckets + b];
+            sh.cursor[t * sh.nbuckets + b] = pos;
+            pos += c;
         }
     }
+    sh.starts[sh.nbuckets] = pos;
+
+    sh.phase = 1;
+    str_sort_run_phase_(&sh, th);
+    sh.phase = 2;
+    str_sort_run_phase_(&sh, th);
+
+    STR_FREE(sample);
+    STR_FREE(sh.bucket_of);
+    STR_FREE(sh.cursor);
+    STR_FREE(sh.starts);
+    STR_FREE(*pitems);
+    *pitems = sh.out;
     return true;
 }
 
+STRDEF bool
+str_sort_parallel(String *strs, size_t n, unsigned threads) STR_NOEXCEPT
+{
+    if (threads < 2 || n < 4096) return str_sort(strs, n);
+
+    StrSortItem_ *items = str_sort_items_from_strs_(strs, n);
+    if (!items) return false;
+    bool ok = str_sort_parallel_items_(&items, n, threads) && str_sort_apply_strs_(strs, items, n);
+    STR_FREE(items);
+    return ok;
+}
+
+STRDEF bool
+str_vec_sort_parallel(StrVec *vec, unsigned threads) STR_NOEXCEPT
+{
+    if (!vec) return false;
+    if (threads < 2 || vec->count < 4096) return str_vec_sort(vec);
+
+    StrSortItem_ *items = str_sort_items_from_vec_(vec);
+    if (!items) return false;
+    bool ok = str_sort_parallel_items_(&items, vec->count, threads) && str_sort_apply_vec_(vec, items);
+    STR_FREE(items);
+    return ok;
+}
+#endif // STR_SORT_PARALLEL
 
 
 #if defined(__cplusplus)
@@ -1073,6 +8624,40 @@ str_from_string_view(std::string_view sv)
 
 #endif // STR_IMPLEMENTATION
 
+// Call site attribution for STR_STATS. Defined after the implementation so
+// only calls from user code go through them.
+#if defined(STR_STATS)
+#define STR_STATS_AT_(call)     (str_stats_enter_(__FILE__, __LINE__), str_stats_leave_(call))
+#define STR_STATS_AT_STR_(call) (str_stats_enter_(__FILE__, __LINE__), str_stats_leave_str_(call))
+#define STR_STATS_AT_PTR_(call) (str_stats_enter_(__FILE__, __LINE__), str_stats_leave_ptr_(call))
+
+#define str_init()                STR_STATS_AT_STR_(str_init())
+#define str_init_hinted(...)      STR_STATS_AT_STR_(str_init_hinted(__VA_ARGS__))
+#define str_clone(...)            STR_STATS_AT_(str_clone(__VA_ARGS__))
+#define str_reserve(...)          STR_STATS_AT_(str_reserve(__VA_ARGS__))
+#define str_shrink_to_fit(...)    STR_STATS_AT_(str_shrink_to_fit(__VA_ARGS__))
+#define str_append_one_n(...)     STR_STATS_AT_(str_append_one_n(__VA_ARGS__))
+#define str_append_one(...)       STR_STATS_AT_(str_append_one(__VA_ARGS__))
+#define str_append_(...)          STR_STATS_AT_(str_append_(__VA_ARGS__))
+#define str_append_char(...)      STR_STATS_AT_(str_append_char(__VA_ARGS__))
+#define str_append_repeat(...)    STR_STATS_AT_(str_append_repeat(__VA_ARGS__))
+#define str_append_str(...)       STR_STATS_AT_(str_append_str(__VA_ARGS__))
+#define str_spare(...)            STR_STATS_AT_PTR_(str_spare(__VA_ARGS__))
+#define str_vappendf(...)         STR_STATS_AT_(str_vappendf(__VA_ARGS__))
+#define str_appendf(...)          STR_STATS_AT_(str_appendf(__VA_ARGS__))
+#define str_join(...)             STR_STATS_AT_(str_join(__VA_ARGS__))
+#define str_join_slices(...)      STR_STATS_AT_(str_join_slices(__VA_ARGS__))
+#define str_join_cstrs(...)       STR_STATS_AT_(str_join_cstrs(__VA_ARGS__))
+#define str_insert_one_n(...)     STR_STATS_AT_(str_insert_one_n(__VA_ARGS__))
+#define str_insert_one(...)       STR_STATS_AT_(str_insert_one(__VA_ARGS__))
+#define str_erase(...)            STR_STATS_AT_(str_erase(__VA_ARGS__))
+#define str_replace_one_n(...)    STR_STATS_AT_(str_replace_one_n(__VA_ARGS__))
+#define str_replace_one(...)      STR_STATS_AT_(str_replace_one(__VA_ARGS__))
+#define str_ltrim(...)            STR_STATS_AT_(str_ltrim(__VA_ARGS__))
+#define str_rtrim(...)            STR_STATS_AT_(str_rtrim(__VA_ARGS__))
+#define str_trim(...)             STR_STATS_AT_(str_trim(__VA_ARGS__))
+#endif // STR_STATS
+
 #endif // STR_H_
 
 
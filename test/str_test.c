@@ -1,11 +1,15 @@
 #define STRDEF static inline
 #define STR_IGNORE_NODISCARD
 #define STR_IMPLEMENTATION
+#if !defined(_WIN32)
+#define STR_SORT_PARALLEL
+#endif
 #include "../str.h"
 
 #include "minitest.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 MT_DEFINE_TEST(init)
 {
@@ -33,6 +37,156 @@ MT_DEFINE_TEST(reserve)
     str_free(&str);
 }
 
+#ifdef STR_LARGE_ALLOC
+MT_DEFINE_TEST(large_alloc)
+{
+    // Cross the threshold both ways, the bytes have to survive each move
+    String str = str_init();
+    size_t n = 3 * STR_LARGE_THRESHOLD + 12345;
+    for (size_t i = 0; str.size < n; ++i) {
+        MT_ASSERT_THAT(str_appendf(&str, "%zu,", i));
+    }
+    MT_CHECK_THAT(str.capacity > str.size);
+    size_t at = 0;
+    for (size_t i = 0; at + 16 < str.size; ++i) {
+        char expect[24];
+        int len = snprintf(expect, sizeof(expect), "%zu,", i);
+        MT_ASSERT_THAT(memcmp(str.buffer + at, expect, (size_t)len) == 0);
+        at += (size_t)len;
+    }
+
+    size_t size = str.size;
+    MT_CHECK_THAT(str_append_repeat(&str, 'x', STR_LARGE_THRESHOLD));
+    MT_CHECK_THAT(str_shrink_to_fit(&str));
+    MT_CHECK_THAT(str.capacity == str.size + 1 && str.buffer[str.size] == '\0');
+    MT_CHECK_THAT(str.buffer[size] == 'x' && str.buffer[str.size - 1] == 'x');
+
+    MT_CHECK_THAT(str_erase(&str, 100, str.size));
+    MT_CHECK_THAT(str_shrink_to_fit(&str));
+    MT_CHECK_THAT(memcmp(str.buffer, "0,1,2,3,", 8) == 0 && str.size == 100);
+
+    // Released buffers go back through STR_FREE
+    MT_CHECK_THAT(str_reserve(&str, 2 * STR_LARGE_THRESHOLD));
+    size_t len = 0;
+    char *raw = str_release(&str, &len);
+    MT_CHECK_THAT(raw != NULL && len == 100 && raw[100] == '\0');
+    STR_FREE(raw);
+
+    raw = (char *)str_large_realloc(NULL, 10);
+    MT_ASSERT_THAT(raw != NULL);
+    memcpy(raw, "0123456789", 10);
+    raw = (char *)str_large_realloc(raw, 2 * STR_LARGE_THRESHOLD);
+    MT_ASSERT_THAT(raw != NULL);
+    MT_CHECK_THAT(memcmp(raw, "0123456789", 10) == 0);
+    raw = (char *)str_large_realloc(raw, 5);
+    MT_ASSERT_THAT(raw != NULL);
+    MT_CHECK_THAT(memcmp(raw, "01234", 5) == 0);
+    str_large_free(raw);
+    str_large_free(NULL);
+}
+#endif
+
+MT_DEFINE_TEST(growth)
+{
+    StrGrowth exp = {STR_GROWTH_EXPONENTIAL, 16, 0, 0};
+    StrGrowth golden = {STR_GROWTH_GOLDEN, 0, 0, 0};
+    StrGrowth prop = {STR_GROWTH_PROPORTIONAL, 0, 0, 0};
+    StrGrowth page = {STR_GROWTH_PAGE, 0, 0, 0};
+    StrGrowth lin = {STR_GROWTH_DEFAULT, 0, 256, 100};
+
+    MT_CHECK_THAT(str_growth_next(&exp, 0, 17) == 32);
+    MT_CHECK_THAT(str_growth_next(&exp, 1u << 30, (1u << 30) + 1) == 1u << 31);
+    MT_CHECK_THAT(str_growth_next(&golden, 1000, 1001) == 1618);
+    MT_CHECK_THAT(str_growth_next(&prop, 1000, 1001) == 1500);
+    MT_CHECK_THAT(str_growth_next(&prop, 1, 2) == 2);
+    MT_CHECK_THAT(str_growth_next(&page, 1000, 1001) == 4096);
+    MT_CHECK_THAT(str_growth_next(&page, 8192, 8193) == 12288);
+    MT_CHECK_THAT(str_growth_next(&lin, 64, 300) == 356);
+    MT_CHECK_THAT(str_growth_next(NULL, 0, 1) == STR_START_SIZE);
+    MT_CHECK_THAT(str_growth_next(&prop, SIZE_MAX - 1, SIZE_MAX) == SIZE_MAX);
+
+    // The thread's policy applies to every String until it is put back
+    StrGrowth prev = str_growth_set(&prop);
+    MT_CHECK_THAT(prev.kind == STR_GROWTH_DEFAULT);
+    MT_CHECK_THAT(str_growth_get().kind == STR_GROWTH_PROPORTIONAL);
+    String str = str_init();
+    size_t last = str.capacity, grows = 0;
+    for (int i = 0; i < 4000; ++i) {
+        MT_ASSERT_THAT(str_append_char(&str, (char)('a' + i % 26)));
+        MT_CHECK_THAT(str.capacity > str.size);
+        if (str.capacity != last) {
+            // Never below the policy, more only when the allocator gave it
+            MT_CHECK_THAT(str.capacity >= str_growth_next(&prop, last, str.size + 1));
+            last = str.capacity;
+            grows++;
+        }
+    }
+    MT_CHECK_THAT(grows > 8);
+    str_growth_set(&prev);
+    MT_CHECK_THAT(str_growth_get().kind == STR_GROWTH_DEFAULT);
+
+    str_growth_set(&page);
+    str_clear(&str);
+    MT_CHECK_THAT(str_reserve(&str, 20000));
+    MT_CHECK_THAT(str.capacity >= 20001);
+    str_growth_set(NULL);
+
+    str_free(&str);
+}
+
+MT_DEFINE_TEST(size_hint)
+{
+    StrSizeHint hint;
+    memset(&hint, 0, sizeof(hint));
+
+    // Nothing learned yet: a plain str_init
+    String str = str_init_hinted(&hint);
+    MT_ASSERT_THAT(str.buffer != NULL);
+    MT_CHECK_THAT(str.capacity == 1);
+    str_free_hinted(&hint, &str);
+    MT_CHECK_THAT(str.buffer == NULL);
+    MT_CHECK_THAT(hint.estimate == 1 && hint.samples == 1);
+
+    // Sizes uniform in [1000, 2000): the estimate settles near the 90th percentile
+    memset(&hint, 0, sizeof(hint));
+    uint64_t x = 88172645463325252u;
+    size_t grown = 0;
+    for (int i = 0; i < 2000; ++i) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        size_t len = 1000 + (size_t)(x % 1000);
+        str = str_init_hinted(&hint);
+        MT_ASSERT_THAT(str.buffer != NULL);
+        MT_CHECK_THAT(str.capacity >= hint.estimate);
+        size_t cap = str.capacity;
+        MT_ASSERT_THAT(str_append_repeat(&str, 'x', len));
+        if (i >= 1000 && str.capacity != cap) grown++;
+        str_free_hinted(&hint, &str);
+    }
+    StrSizeHintStats stats = str_size_hint_stats(&hint);
+    MT_CHECK_THAT(stats.samples == 2000);
+    MT_CHECK_THAT(stats.estimate > 1800 && stats.estimate < 2100);
+    MT_CHECK_THAT(stats.fit_rate > 0.8 && stats.fit_rate < 0.97);
+    MT_CHECK_THAT(stats.mean_overshoot > 100 && stats.mean_overshoot < 1100);
+    MT_CHECK_THAT(grown < 200);
+
+    // It follows the call site when its sizes drop
+    for (int i = 0; i < 1000; ++i) {
+        str = str_init_hinted(&hint);
+        MT_ASSERT_THAT(str_append_repeat(&str, 'y', 100));
+        str_size_hint_record(&hint, &str);
+        str_free(&str);
+    }
+    MT_CHECK_THAT(hint.estimate >= 101 && hint.estimate < 150);
+
+    str_size_hint_record(NULL, &str);
+    str_size_hint_record(&hint, NULL);
+    stats = str_size_hint_stats(NULL);
+    MT_CHECK_THAT(stats.samples == 0 && stats.fit_rate == 0.0);
+    str = str_init_hinted(NULL);
+    MT_CHECK_THAT(str.buffer != NULL && str.size == 0);
+    str_free(&str);
+}
+
 MT_DEFINE_TEST(append_one)
 {
     String str = str_init();
@@ -67,6 +221,12 @@ MT_DEFINE_TEST(append)
     MT_CHECK_THAT(memcmp(str.buffer, "Hello world", 11) == 0);
     MT_CHECK_THAT(str.buffer[str.size] == '\0');
 
+    // More pieces than the lengths kept from the first pass
+    str_clear(&str);
+    MT_ASSERT_THAT(str_append(&str, "a", "b", "c", "d", "e", "f", "g", "h", "i", "j",
+                              "k", "", "m", "n", "o", "p", "qq", "rr", "ss", "tt"));
+    MT_CHECK_THAT(str_equals_cstr(&str, "abcdefghijkmnopqqrrsstt"));
+
     str_free(&str);
 }
 
@@ -92,6 +252,53 @@ MT_DEFINE_TEST(append_char)
     str_free(&str);
 }
 
+MT_DEFINE_TEST(spare_and_commit)
+{
+    String str = str_init();
+    MT_ASSERT_THAT(str_append_one(&str, "id="));
+
+    // Fill in place, as a read(2) or an encoder would
+    size_t avail = 0;
+    char *p = str_spare(&str, 100, &avail);
+    MT_ASSERT_THAT(p == str.buffer + 3);
+    MT_CHECK_THAT(avail >= 100);
+    MT_CHECK_THAT(avail == str.capacity - str.size - 1);
+    int n = snprintf(p, avail, "%d", 12345);
+    MT_ASSERT_THAT(str_commit(&str, (size_t)n));
+    MT_CHECK_THAT(str_equals_cstr(&str, "id=12345"));
+
+    // Committing more than was handed out fails and changes nothing
+    p = str_spare(&str, 0, &avail);
+    MT_ASSERT_THAT(p != NULL);
+    MT_CHECK_THAT(!str_commit(&str, avail + 1));
+    MT_CHECK_THAT(str_commit(&str, 0));
+    MT_CHECK_THAT(str.size == 8 && str.buffer[8] == '\0');
+
+    // Tight loop after one reserve
+    MT_ASSERT_THAT(str_reserve(&str, str.size + 26));
+    size_t cap = str.capacity;
+    for (char c = 'a'; c <= 'z'; ++c) str_push_unchecked(&str, c);
+    MT_CHECK_THAT(str.capacity == cap);
+    MT_CHECK_THAT(str_equals_cstr(&str, "id=12345abcdefghijklmnopqrstuvwxyz"));
+
+    // A String without a buffer gets one
+    String empty = {NULL, 0, 0};
+    p = str_spare(&empty, 4, &avail);
+    MT_ASSERT_THAT(p != NULL && avail >= 4);
+    memcpy(p, "abcd", 4);
+    MT_CHECK_THAT(str_commit(&empty, 4));
+    MT_CHECK_THAT(str_equals_cstr(&empty, "abcd"));
+    str_free(&empty);
+    MT_CHECK_THAT(str_commit(&empty, 0));
+    MT_CHECK_THAT(!str_commit(&empty, 1));
+
+    MT_CHECK_THAT(str_spare(NULL, 1, &avail) == NULL && avail == 0);
+    MT_CHECK_THAT(str_spare(&str, SIZE_MAX, NULL) == NULL);
+    MT_CHECK_THAT(!str_commit(NULL, 0));
+
+    str_free(&str);
+}
+
 MT_DEFINE_TEST(append_str)
 {
     String str1 = str_init();
@@ -149,6 +356,72 @@ MT_DEFINE_TEST(vappendf)
     str_free(&str);
 }
 
+MT_DEFINE_TEST(join)
+{
+    String out = str_init();
+    String strs[3];
+    strs[0] = str_init();
+    strs[1] = str_init();
+    strs[2] = str_init();
+    MT_ASSERT_THAT(str_append_one(&strs[0], "alpha"));
+    MT_ASSERT_THAT(str_append_one(&strs[2], "gamma"));
+
+    MT_ASSERT_THAT(str_join(&out, strs, 3, ", "));
+    MT_CHECK_THAT(str_equals_cstr(&out, "alpha, , gamma"));
+
+    // Appends, and no separator is no separator
+    MT_ASSERT_THAT(str_join(&out, strs, 3, NULL));
+    MT_CHECK_THAT(str_equals_cstr(&out, "alpha, , gammaalphagamma"));
+
+    const char *cstrs[] = {"usr", "local", "bin"};
+    str_clear(&out);
+    MT_ASSERT_THAT(str_join_cstrs(&out, cstrs, 3, "/"));
+    MT_CHECK_THAT(str_equals_cstr(&out, "usr/local/bin"));
+
+    StrSlice slices[2];
+    slices[0] = str_slice_n("key=value", 3);
+    slices[1] = str_slice_cstr("42");
+    str_clear(&out);
+    MT_ASSERT_THAT(str_join_slices(&out, slices, 2, " -> "));
+    MT_CHECK_THAT(str_equals_cstr(&out, "key -> 42"));
+
+    // Into a String without a buffer
+    String big = {NULL, 0, 0};
+    const char *many[100];
+    for (int i = 0; i < 100; ++i) many[i] = "0123456789";
+    MT_ASSERT_THAT(str_join_cstrs(&big, many, 100, ","));
+    MT_CHECK_THAT(big.size == 100 * 10 + 99);
+    MT_CHECK_THAT(big.buffer[big.size] == '\0');
+    MT_CHECK_THAT(strcmp(big.buffer + big.size - 13, "89,0123456789") == 0);
+    str_free(&big);
+
+    // out may be one of the inputs
+    str_clear(&out);
+    MT_ASSERT_THAT(str_append_one(&out, "xy"));
+    String self[2];
+    self[0] = out;
+    self[1] = strs[0];
+    MT_ASSERT_THAT(str_join(&self[0], self, 2, "|"));
+    MT_CHECK_THAT(str_equals_cstr(&self[0], "xyxy|alpha"));
+    out = self[0];
+
+    // Nothing to join, bad pieces leave out as it was
+    MT_ASSERT_THAT(str_join(&out, strs, 0, ","));
+    MT_CHECK_THAT(str_equals_cstr(&out, "xyxy|alpha"));
+    const char *bad[] = {"a", NULL};
+    MT_CHECK_THAT(!str_join_cstrs(&out, bad, 2, ","));
+    slices[1].data = NULL;
+    MT_CHECK_THAT(!str_join_slices(&out, slices, 2, ","));
+    MT_CHECK_THAT(str_equals_cstr(&out, "xyxy|alpha"));
+    MT_CHECK_THAT(!str_join(NULL, strs, 3, ","));
+    MT_CHECK_THAT(!str_join(&out, NULL, 1, ","));
+
+    str_free(&strs[0]);
+    str_free(&strs[1]);
+    str_free(&strs[2]);
+    str_free(&out);
+}
+
 MT_DEFINE_TEST(strdup)
 {
     String str = str_init();
@@ -268,6 +541,19 @@ MT_DEFINE_TEST(trim_both)
     str_trim(&str);
     MT_CHECK_THAT(strcmp(str.buffer, "hi there") == 0);
 
+    // Long runs go through the vector scan, all whitespace trims to empty
+    str_clear(&str);
+    str_append_repeat(&str, ' ', 100);
+    str_append_one(&str, "x\xA0");
+    str_append_repeat(&str, '\v', 100);
+    str_trim(&str);
+    MT_CHECK_THAT(strcmp(str.buffer, "x\xA0") == 0);
+
+    str_clear(&str);
+    str_append_repeat(&str, '\f', 70);
+    str_trim(&str);
+    MT_CHECK_THAT(str.size == 0 && str.buffer[0] == '\0');
+
     str_free(&str);
 }
 
@@ -308,6 +594,46 @@ MT_DEFINE_TEST(replace_one)
     str_free(&str);
 }
 
+#ifdef STR_STATS
+MT_DEFINE_TEST(stats)
+{
+    str_stats_reset();
+    String str = str_init();
+    for (int i = 0; i < 100; ++i) MT_ASSERT_THAT(str_append_char(&str, 'x'));
+    int insert_line = __LINE__ + 1;
+    MT_ASSERT_THAT(str_insert_one(&str, 0, "abc"));
+    MT_ASSERT_THAT(str_erase(&str, 0, 3));
+    MT_ASSERT_THAT(str_shrink_to_fit(&str));
+
+    StrStats st = str_stats_get();
+    MT_CHECK_THAT(st.allocs == 1);
+    MT_CHECK_THAT(st.reallocs >= 3);
+    MT_CHECK_THAT(st.bytes_allocated >= 103);
+    MT_CHECK_THAT(st.bytes_moved == 200);
+
+    String report = str_init();
+    MT_ASSERT_THAT(str_stats_dump(&report));
+    MT_CHECK_THAT(strncmp(report.buffer, "allocs 2, ", 10) == 0);
+
+    // One line per call site, the insert moved the 100 bytes after it
+    char site[64];
+    snprintf(site, sizeof(site), "str_test.c:%d: allocs 0, ", insert_line);
+    size_t at = str_find(&report, site);
+    MT_ASSERT_THAT(at != SIZE_MAX);
+    const char *moved = strstr(report.buffer + at, "moved 100,");
+    MT_CHECK_THAT(moved != NULL && moved < strchr(report.buffer + at, '\n'));
+
+    str_stats_reset();
+    MT_CHECK_THAT(str_stats_get().allocs == 0);
+    str_clear(&report);
+    MT_ASSERT_THAT(str_stats_dump(&report));
+    MT_CHECK_THAT(str_equals_cstr(&report, "allocs 0, reallocs 0, allocated 0, moved 0, slack 0\n"));
+
+    str_free(&report);
+    str_free(&str);
+}
+#endif
+
 MT_DEFINE_TEST(find_and_rfind)
 {
     String str = str_init();
@@ -331,6 +657,440 @@ MT_DEFINE_TEST(find_and_rfind)
     str_free(&str);
 }
 
+MT_DEFINE_TEST(find_long)
+{
+    MT_CHECK_THAT(str_simd_level() >= STR_SIMD_SCALAR && str_simd_level() <= STR_SIMD_AVX512);
+
+    // Every needle position and length across the vector block boundaries,
+    // with near misses planted in front so the filters see false positives
+    String hay = str_init();
+    str_append_repeat(&hay, 'a', 300);
+    for (size_t nlen = 1; nlen <= 40; nlen += 3) {
+        char needle[40];
+        memset(needle, 'a', nlen);
+        needle[0] = 'x';
+        needle[nlen - 1] = 'y';
+        for (size_t at = 0; at + nlen <= hay.size; at += 7) {
+            if (nlen > 2 && at >= nlen) {
+                memcpy(hay.buffer + at - nlen, needle, nlen);
+                hay.buffer[at - 2] = 'b';
+            }
+            memcpy(hay.buffer + at, needle, nlen);
+            MT_CHECK_THAT(str_find_n(&hay, needle, nlen) == at);
+            memset(hay.buffer, 'a', hay.size);
+        }
+        MT_CHECK_THAT(str_find_n(&hay, needle, nlen) == SIZE_MAX);
+    }
+
+    // Mismatch at every offset of a long compare
+    String a = str_init();
+    String b = str_init();
+    str_append_repeat(&a, 'q', 200);
+    str_append_repeat(&b, 'q', 200);
+    for (size_t i = 0; i < 200; ++i) {
+        b.buffer[i] = 'r';
+        MT_CHECK_THAT(str_compare(&a, &b) < 0 && !str_equals(&a, &b));
+        b.buffer[i] = 'q';
+    }
+    MT_CHECK_THAT(str_compare(&a, &b) == 0);
+
+    str_free(&a);
+    str_free(&b);
+    str_free(&hay);
+}
+
+static int
+ref_fold(int c)
+{
+    return c >= 'A' && c <= 'Z' ? c + 32 : c;
+}
+
+MT_DEFINE_TEST(icase)
+{
+    String a = str_init(), b = str_init();
+
+    // Every byte value, at every alignment of the vector and SWAR loops
+    for (size_t shift = 0; shift < 70; shift += 23) {
+        str_clear(&a);
+        str_append_repeat(&a, '.', shift);
+        for (int c = 0; c < 256; ++c) str_append_char(&a, (char)c);
+        MT_CHECK_THAT(str_clone(&a, &b));
+        MT_CHECK_THAT(str_to_lower(&a) && str_to_upper(&b));
+        bool ok = true;
+        for (int c = 0; c < 256; ++c) {
+            unsigned char lo = (unsigned char)a.buffer[shift + c], up = (unsigned char)b.buffer[shift + c];
+            ok = ok && lo == ref_fold(c);
+            ok = ok && up == (c >= 'a' && c <= 'z' ? c - 32 : c);
+        }
+        MT_CHECK_THAT(ok);
+    }
+
+    str_clear(&a);
+    str_clear(&b);
+    str_append_one(&a, "Content-Type: TEXT/html");
+    str_append_one(&b, "content-type: text/HTML");
+    MT_CHECK_THAT(str_equals_icase(&a, &b));
+    MT_CHECK_THAT(str_compare_icase(&a, &b) == 0);
+    b.buffer[0] = '@'; // '@' vs 'c', and 0x40 must not fold to 0x60
+    MT_CHECK_THAT(!str_equals_icase(&a, &b));
+    MT_CHECK_THAT(str_compare_icase(&a, &b) > 0);
+    str_pop_back(&b, NULL);
+    MT_CHECK_THAT(str_compare_icase(&b, &a) < 0);
+    MT_CHECK_THAT(str_compare_icase(NULL, &a) < 0 && str_compare_icase(&a, NULL) > 0);
+
+    // Random long strings against a folding reference
+    unsigned seed = 5;
+    for (int round = 0; round < 300; ++round) {
+        str_clear(&a);
+        seed = seed * 1103515245u + 12345u;
+        size_t n = (seed >> 16) % 300;
+        for (size_t i = 0; i < n; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            str_append_char(&a, "aAbB[@`{zZ\x80\xE1"[(seed >> 16) % 12]);
+        }
+        MT_CHECK_THAT(str_clone(&a, &b));
+        MT_CHECK_THAT(str_to_upper(&b));
+        MT_CHECK_THAT(str_equals_icase(&a, &b));
+        if (n) {
+            size_t at = (seed >> 8) % n;
+            b.buffer[at] = b.buffer[at] == 'Z' ? 'y' : 'Z';
+            size_t diff = SIZE_MAX;
+            for (size_t i = 0; i < n && diff == SIZE_MAX; ++i) {
+                if (ref_fold((unsigned char)a.buffer[i]) != ref_fold((unsigned char)b.buffer[i])) diff = i;
+            }
+            int expect = diff == SIZE_MAX ? 0 : ref_fold((unsigned char)a.buffer[diff]) < ref_fold((unsigned char)b.buffer[diff]) ? -1 : 1;
+            int got = str_compare_icase(&a, &b);
+            MT_CHECK_THAT((got > 0) - (got < 0) == expect);
+
+            // A needle copied out of a, in the other case, found no later than where it was taken
+            size_t start = (seed >> 12) % n, len = 1 + (seed >> 4) % (n - start);
+            char needle[300];
+            for (size_t i = 0; i < len; ++i) {
+                char c = a.buffer[start + i];
+                needle[i] = (char)(c >= 'a' && c <= 'z' ? c - 32 : c >= 'A' && c <= 'Z' ? c + 32 : c);
+            }
+            size_t ref = SIZE_MAX;
+            for (size_t i = 0; i + len <= n && ref == SIZE_MAX; ++i) {
+                size_t k = 0;
+                while (k < len && ref_fold((unsigned char)a.buffer[i + k]) == ref_fold((unsigned char)needle[k])) k++;
+                if (k == len) ref = i;
+            }
+            MT_CHECK_THAT(ref <= start);
+            MT_CHECK_THAT(str_find_icase_n(&a, needle, len) == ref);
+        }
+    }
+
+    str_clear(&a);
+    str_append_repeat(&a, 'x', 200);
+    str_append_one(&a, "Needle");
+    MT_CHECK_THAT(str_find_icase(&a, "NEEDLE") == 200);
+    MT_CHECK_THAT(str_find_icase(&a, "neEdlex") == SIZE_MAX);
+    MT_CHECK_THAT(str_find_icase(&a, "") == 0);
+
+    str_free(&a);
+    str_free(&b);
+}
+
+MT_DEFINE_TEST(byteset)
+{
+    StrByteSet set = str_byteset("aeiou");
+    MT_CHECK_THAT(str_byteset_contains(&set, 'e') && !str_byteset_contains(&set, 'b'));
+    str_byteset_add(&set, 0xFF);
+    MT_CHECK_THAT(str_byteset_contains(&set, 0xFF) && !str_byteset_contains(&set, 0x7F));
+
+    StrByteSet space = str_byteset_space();
+    StrByteSet manual = str_byteset(" \t\n\v\f\r");
+    MT_CHECK_THAT(memcmp(&space, &manual, sizeof(space)) == 0);
+
+    String str = str_init();
+    str_append_one(&str, "  hello, world  ");
+    StrByteSet punct = str_byteset(",!");
+    MT_CHECK_THAT(str_find_first_of(&str, &punct) == 7);
+    MT_CHECK_THAT(str_find_first_not_of(&str, &space) == 2);
+    MT_CHECK_THAT(str_find_last_of(&str, &space) == 15);
+    MT_CHECK_THAT(str_find_last_not_of(&str, &space) == 13);
+    MT_CHECK_THAT(str_span(&str, &space) == 2);
+    MT_CHECK_THAT(str_cspan(&str, &punct) == 7);
+    MT_CHECK_THAT(str_find_first_of(&str, &manual) == 0);
+    str_byteset_invert(&punct);
+    MT_CHECK_THAT(str_find_first_not_of(&str, &punct) == 7);
+
+    StrByteSet none = str_byteset(NULL);
+    MT_CHECK_THAT(str_find_first_of(&str, &none) == SIZE_MAX);
+    MT_CHECK_THAT(str_cspan(&str, &none) == str.size);
+
+    // Every byte value, all lengths and positions across the vector widths,
+    // checked against a direct table walk
+    unsigned seed = 1;
+    for (int round = 0; round < 40; ++round) {
+        StrByteSet rs = str_byteset(NULL);
+        for (int k = 0; k < round; ++k) {
+            seed = seed * 1103515245u + 12345u;
+            str_byteset_add(&rs, (unsigned char)(seed >> 16));
+        }
+        str_clear(&str);
+        size_t len = (size_t)round * 7;
+        for (size_t k = 0; k < len; ++k) {
+            seed = seed * 1103515245u + 12345u;
+            // Mostly members, so the not_of scans run long too
+            unsigned char c = (unsigned char)(seed >> 16);
+            if ((seed >> 8) & 3) c = (unsigned char)(round ? 'a' : c);
+            str_append_char(&str, (char)c);
+        }
+        if (round) str_byteset_add(&rs, 'a');
+
+        size_t first = SIZE_MAX, first_not = SIZE_MAX, last = SIZE_MAX, last_not = SIZE_MAX;
+        for (size_t k = 0; k < str.size; ++k) {
+            bool in = str_byteset_contains(&rs, (unsigned char)str.buffer[k]);
+            if (in && first == SIZE_MAX) first = k;
+            if (!in && first_not == SIZE_MAX) first_not = k;
+            if (in) last = k;
+            else last_not = k;
+        }
+        MT_CHECK_THAT(str_find_first_of(&str, &rs) == first);
+        MT_CHECK_THAT(str_find_first_not_of(&str, &rs) == first_not);
+        MT_CHECK_THAT(str_find_last_of(&str, &rs) == last);
+        MT_CHECK_THAT(str_find_last_not_of(&str, &rs) == last_not);
+    }
+
+    str_free(&str);
+}
+
+// Straightforward decoder to check str_utf8_valid against
+static size_t
+ref_utf8_invalid(const unsigned char *p, size_t n)
+{
+    size_t i = 0;
+    while (i < n) {
+        unsigned c = p[i];
+        size_t len;
+        unsigned long cp;
+        if (c < 0x80) { i++; continue; }
+        else if ((c & 0xE0) == 0xC0) { len = 2; cp = c & 0x1F; }
+        else if ((c & 0xF0) == 0xE0) { len = 3; cp = c & 0x0F; }
+        else if ((c & 0xF8) == 0xF0) { len = 4; cp = c & 0x07; }
+        else return i;
+        if (n - i < len) return i;
+        for (size_t k = 1; k < len; ++k) {
+            if ((p[i + k] & 0xC0) != 0x80) return i;
+            cp = (cp << 6) | (p[i + k] & 0x3F);
+        }
+        if ((len == 2 && cp < 0x80) || (len == 3 && cp < 0x800) || (len == 4 && cp < 0x10000)) return i;
+        if (cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) return i;
+        i += len;
+    }
+    return SIZE_MAX;
+}
+
+static void
+append_utf8(String *str, unsigned long cp)
+{
+    if (cp < 0x80) {
+        str_append_char(str, (char)cp);
+    } else if (cp < 0x800) {
+        str_append_char(str, (char)(0xC0 | (cp >> 6)));
+        str_append_char(str, (char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        str_append_char(str, (char)(0xE0 | (cp >> 12)));
+        str_append_char(str, (char)(0x80 | ((cp >> 6) & 0x3F)));
+        str_append_char(str, (char)(0x80 | (cp & 0x3F)));
+    } else {
+        str_append_char(str, (char)(0xF0 | (cp >> 18)));
+        str_append_char(str, (char)(0x80 | ((cp >> 12) & 0x3F)));
+        str_append_char(str, (char)(0x80 | ((cp >> 6) & 0x3F)));
+        str_append_char(str, (char)(0x80 | (cp & 0x3F)));
+    }
+}
+
+MT_DEFINE_TEST(utf8_valid)
+{
+    String str = str_init();
+    size_t bad = 0;
+    MT_CHECK_THAT(str_utf8_valid(&str, &bad));
+    MT_CHECK_THAT(str_utf8_valid_n("h\xC3\xA9llo \xE2\x82\xAC \xF0\x9F\x98\x80", 15, NULL));
+
+    static const char *const invalid[] = {
+        "\xC0\x80", "\xC1\xBF", "\xE0\x80\x80", "\xE0\x9F\xBF", "\xED\xA0\x80", "\xF0\x8F\xBF\xBF",
+        "\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xFF", "\x80", "\xC3", "\xE2\x82", "\xF0\x9F\x98",
+        "\xE2\x82\x41", "\xC3\xA9\xA9",
+    };
+
+    // Each one planted at every offset of a long valid string
+    for (size_t k = 0; k < sizeof(invalid) / sizeof(invalid[0]); ++k) {
+        size_t len = strlen(invalid[k]);
+        for (size_t at = 0; at < 150; at += 5) {
+            str_clear(&str);
+            for (size_t i = 0; str.size < at; ++i) append_utf8(&str, i % 7 ? 'a' + i % 26 : 0x20AC);
+            size_t start = str.size;
+            str_append_one_n(&str, invalid[k], len);
+            if (at % 2) str_append_repeat(&str, 'z', 100);
+            MT_CHECK_THAT(!str_utf8_valid(&str, &bad));
+            MT_CHECK_THAT(bad == ref_utf8_invalid((const unsigned char *)str.buffer, str.size));
+            MT_CHECK_THAT(bad >= start && bad <= start + 2);
+        }
+    }
+
+    // Random code points with occasional corrupted bytes, against the reference
+    unsigned seed = 3;
+    for (int round = 0; round < 3000; ++round) {
+        str_clear(&str);
+        seed = seed * 1103515245u + 12345u;
+        size_t cps = (seed >> 16) % 120;
+        for (size_t i = 0; i < cps; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            unsigned r = seed >> 8;
+            unsigned long cp;
+            switch (r % 5) {
+            case 0:  cp = 0x80 + r % 0x780; break;
+            case 1:  cp = 0x800 + r % 0xF800; break;
+            case 2:  cp = 0x10000 + r % 0x100000; break;
+            default: cp = r % 0x80; break;
+            }
+            if (cp >= 0xD800 && cp <= 0xDFFF) cp = 'x';
+            append_utf8(&str, cp);
+        }
+        size_t expect_len = cps;
+        if (round % 3 == 0 && str.size) {
+            seed = seed * 1103515245u + 12345u;
+            str.buffer[(seed >> 8) % str.size] = (char)(seed >> 3);
+        } else {
+            MT_CHECK_THAT(str_utf8_length(&str) == expect_len);
+        }
+        size_t expect = ref_utf8_invalid((const unsigned char *)str.buffer, str.size);
+        bad = SIZE_MAX;
+        bool ok = str_utf8_valid(&str, &bad);
+        MT_CHECK_THAT(ok == (expect == SIZE_MAX));
+        if (!ok) MT_CHECK_THAT(bad == expect);
+    }
+
+    str_free(&str);
+}
+
+MT_DEFINE_TEST(utf8_length_and_truncate)
+{
+    String str = str_init();
+    str_append_one(&str, "a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80"); // a e-acute euro emoji
+    MT_CHECK_THAT(str_utf8_length(&str) == 4);
+    MT_CHECK_THAT(str_utf8_length_n("\xFF\x80", 2) == 1);
+
+    MT_CHECK_THAT(str_utf8_truncate(&str, 100) && str.size == 10);
+    MT_CHECK_THAT(str_utf8_truncate(&str, 9) && str.size == 6);
+    MT_CHECK_THAT(str_utf8_truncate(&str, 5) && str.size == 3);
+    MT_CHECK_THAT(str_utf8_truncate(&str, 3) && str.size == 3);
+    MT_CHECK_THAT(str_utf8_truncate(&str, 2) && str.size == 1);
+    MT_CHECK_THAT(strcmp(str.buffer, "a") == 0);
+    MT_CHECK_THAT(str_utf8_truncate(&str, 0) && str.size == 0 && str.buffer[0] == '\0');
+
+    // Long input goes through the block counters
+    str_clear(&str);
+    for (int i = 0; i < 1000; ++i) str_append_one(&str, "\xE2\x82\xAC" "ab");
+    MT_CHECK_THAT(str_utf8_length(&str) == 3000);
+    MT_CHECK_THAT(str_utf8_valid(&str, NULL));
+
+    str_free(&str);
+}
+
+MT_DEFINE_TEST(utf8_case)
+{
+    String str = str_init();
+    // A-grave, y-diaeresis, A-macron, L-acute, dotless i, sigma, final sigma,
+    // Cyrillic IO and ZHE, Armenian AYB, euro sign, emoji
+    str_append_one(&str, "Hi \xC3\x80\xC3\xBF\xC4\x80\xC4\xB9\xC4\xB1 \xCE\xA3\xCF\x82 \xD0\x81\xD0\x96 \xD4\xB1 \xE2\x82\xAC\xF0\x9F\x98\x80");
+    MT_CHECK_THAT(str_utf8_to_lower(&str));
+    MT_CHECK_THAT(str_equals_cstr(&str, "hi \xC3\xA0\xC3\xBF\xC4\x81\xC4\xBA\xC4\xB1 \xCF\x83\xCF\x82 \xD1\x91\xD0\xB6 \xD5\xA1 \xE2\x82\xAC\xF0\x9F\x98\x80"));
+    MT_CHECK_THAT(str_utf8_to_upper(&str));
+    MT_CHECK_THAT(str_equals_cstr(&str, "HI \xC3\x80\xC5\xB8\xC4\x80\xC4\xB9\xC4\xB1 \xCE\xA3\xCE\xA3 \xD0\x81\xD0\x96 \xD4\xB1 \xE2\x82\xAC\xF0\x9F\x98\x80"));
+
+    // Lowering, uppering and lowering again is stable for every 2 byte code
+    // point but the two whose upper case lowers to something else
+    str_clear(&str);
+    for (unsigned long cp = 0x80; cp < 0x800; ++cp) {
+        if (cp != 0xB5 && cp != 0x3C2) append_utf8(&str, cp);
+    }
+    String orig = str_init();
+    MT_CHECK_THAT(str_clone(&str, &orig));
+    MT_CHECK_THAT(str_utf8_to_lower(&str) && str.size == orig.size && str_utf8_valid(&str, NULL));
+    MT_CHECK_THAT(str_utf8_to_upper(&str) && str_utf8_to_lower(&str));
+    MT_CHECK_THAT(str_utf8_to_lower(&orig) && str_equals(&str, &orig));
+
+    str_free(&orig);
+    str_free(&str);
+}
+
+MT_DEFINE_TEST(transcode)
+{
+    String utf8 = str_init(), wide = str_init(), back = str_init(), expect = str_init();
+    size_t bad = 0;
+
+    MT_CHECK_THAT(str_append_utf16(&wide, "a\xC3\xA9\xF0\x9F\x98\x80", 7, false, &bad));
+    MT_CHECK_THAT(wide.size == 8 && memcmp(wide.buffer, "a\0\xE9\0\x3D\xD8\x00\xDE", 8) == 0);
+    str_clear(&wide);
+    MT_CHECK_THAT(str_append_utf32(&wide, "a\xC3\xA9", 3, true, &bad));
+    MT_CHECK_THAT(wide.size == 8 && memcmp(wide.buffer, "\0\0\0a\0\0\0\xE9", 8) == 0);
+
+    // Random text, mostly in long ASCII or 2 byte runs so the block paths get used
+    unsigned seed = 11;
+    for (int round = 0; round < 400; ++round) {
+        str_clear(&utf8);
+        seed = seed * 1103515245u + 12345u;
+        size_t cps = (seed >> 16) % 200;
+        for (size_t i = 0; i < cps; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            unsigned r = seed >> 8;
+            unsigned long cp;
+            switch ((r >> 4) % 8 < 6 ? (unsigned)round % 3 : r % 4) {
+            case 0:  cp = 0x20 + r % 0x5F; break;
+            case 1:  cp = 0x80 + r % 0x780; break;
+            case 2:  cp = 0x800 + r % 0xF800; break;
+            default: cp = 0x10000 + r % 0x100000; break;
+            }
+            if (cp >= 0xD800 && cp <= 0xDFFF) cp = 'x';
+            append_utf8(&utf8, cp);
+        }
+        for (int mode = 0; mode < 4; ++mode) {
+            bool be = mode & 1;
+            str_clear(&wide);
+            str_clear(&back);
+            if (mode < 2) {
+                MT_CHECK_THAT(str_append_utf16(&wide, utf8.buffer, utf8.size, be, &bad));
+                MT_CHECK_THAT(str_append_from_utf16(&back, wide.buffer, wide.size, be, &bad));
+            } else {
+                MT_CHECK_THAT(str_append_utf32(&wide, utf8.buffer, utf8.size, be, &bad));
+                MT_CHECK_THAT(wide.size == 4 * cps);
+                MT_CHECK_THAT(str_append_from_utf32(&back, wide.buffer, wide.size, be, &bad));
+            }
+            MT_CHECK_THAT(str_equals(&back, &utf8));
+        }
+    }
+
+    // Errors leave out alone and point at the bad unit
+    str_clear(&wide);
+    str_append_one(&wide, "prefix");
+    MT_CHECK_THAT(!str_append_utf16(&wide, "abc\xC3", 4, false, &bad) && bad == 3);
+    MT_CHECK_THAT(!str_append_utf32(&wide, "\xED\xA0\x80", 3, false, &bad) && bad == 0);
+    MT_CHECK_THAT(wide.size == 6);
+
+    str_clear(&back);
+    for (size_t at = 0; at < 40; at += 3) {
+        str_clear(&expect);
+        for (size_t i = 0; i < at; ++i) str_append_one_n(&expect, "A\0", 2);
+        str_append_one_n(&expect, "\x00\xDC", 2); // lone low surrogate
+        str_append_repeat(&expect, 'B', 20);
+        MT_CHECK_THAT(!str_append_from_utf16(&back, expect.buffer, expect.size, false, &bad));
+        MT_CHECK_THAT(bad == 2 * at && back.size == 0);
+    }
+    MT_CHECK_THAT(!str_append_from_utf16(&back, "\x3D\xD8" "a\0", 4, false, &bad) && bad == 0);
+    MT_CHECK_THAT(!str_append_from_utf16(&back, "a\0b", 3, false, &bad) && bad == 2);
+    MT_CHECK_THAT(!str_append_from_utf32(&back, "a\0\0\0\0\0\x11\0", 8, false, &bad) && bad == 4);
+    MT_CHECK_THAT(!str_append_from_utf32(&back, "\0\0\0a\0", 5, true, &bad) && bad == 4);
+    MT_CHECK_THAT(back.size == 0);
+
+    str_free(&utf8);
+    str_free(&wide);
+    str_free(&back);
+    str_free(&expect);
+}
+
 MT_DEFINE_TEST(equals)
 {
     String a = str_init();
@@ -394,6 +1154,573 @@ MT_DEFINE_TEST(equals_n)
     str_free(&s);
 }
 
+MT_DEFINE_TEST(slice)
+{
+    String str = str_init();
+    str_append_one(&str, "abc");
+
+    StrSlice s = str_slice(&str);
+    MT_CHECK_THAT(s.data == str.buffer && s.size == 3);
+
+    s = str_slice_n("hello", 4);
+    MT_CHECK_THAT(s.size == 4 && memcmp(s.data, "hell", 4) == 0);
+
+    s = str_slice_cstr("hello");
+    MT_CHECK_THAT(s.size == 5);
+
+    s = str_slice_cstr(NULL);
+    MT_CHECK_THAT(s.data != NULL && s.size == 0);
+    s = str_slice(NULL);
+    MT_CHECK_THAT(s.data != NULL && s.size == 0);
+
+    str_free(&str);
+}
+
+MT_DEFINE_TEST(ref)
+{
+    MT_CHECK_THAT(sizeof(StrRef) == 16);
+
+    StrRef e = str_ref_cstr(NULL);
+    MT_CHECK_THAT(e.size == 0 && str_ref_data(&e)[0] == '\0');
+
+    // Inline up to 12 bytes, independent of the source
+    char buf[] = "hello world!";
+    StrRef a = str_ref_n(buf, 12);
+    buf[0] = 'j';
+    StrSlice s = str_ref_slice(&a);
+    MT_CHECK_THAT(s.size == 12 && memcmp(s.data, "hello world!", 12) == 0);
+
+    // Longer strings point at the source
+    String str = str_init();
+    str_append_one(&str, "hello world, long");
+    StrRef b = str_ref_str(&str);
+    MT_CHECK_THAT(b.size == 17 && str_ref_data(&b) == str.buffer);
+    MT_CHECK_THAT(memcmp(b.prefix, "hell", 4) == 0);
+
+    String out = str_init();
+    MT_CHECK_THAT(str_append_ref(&out, &a));
+    MT_CHECK_THAT(str_append_ref(&out, &b));
+    MT_CHECK_THAT(strcmp(out.buffer, "hello world!hello world, long") == 0);
+
+    StrRef a2 = str_ref_from_slice(str_slice_n("hello world!", 12));
+    StrRef b2 = str_ref_cstr("hello world, long");
+    MT_CHECK_THAT(str_ref_equals(&a, &a2));
+    MT_CHECK_THAT(str_ref_equals(&b, &b2));
+    MT_CHECK_THAT(!str_ref_equals(&a, &b));
+    MT_CHECK_THAT(str_ref_hash(&a, 5) == str_hash64_n("hello world!", 12, 5));
+    MT_CHECK_THAT(str_ref_hash(&b, 5) == str_hash64(&str, 5));
+
+    // Ordering matches str_compare, including NULs against the zero padding
+    static const char *const words[] = {
+        "", "\0", "a", "a\0", "ab", "abcd", "abcd\0", "abcde", "abcdefghijkl",
+        "abcdefghijkl\0", "abcdefghijklm", "abcdefghijkz", "abce", "b",
+    };
+    static const size_t lens[] = { 0, 1, 1, 2, 2, 4, 5, 5, 12, 13, 13, 12, 4, 1 };
+    for (size_t i = 0; i < sizeof(lens) / sizeof(lens[0]); ++i) {
+        for (size_t j = 0; j < sizeof(lens) / sizeof(lens[0]); ++j) {
+            StrRef x = str_ref_n(words[i], lens[i]);
+            StrRef y = str_ref_n(words[j], lens[j]);
+            int c = str_ref_compare(&x, &y);
+            MT_CHECK_THAT((i < j) == (c < 0) && (i == j) == (c == 0));
+            MT_CHECK_THAT(str_ref_equals(&x, &y) == (i == j));
+        }
+    }
+
+    str_free(&out);
+    str_free(&str);
+}
+
+MT_DEFINE_TEST(translate)
+{
+    String str = str_init();
+    StrTranslator tr = str_translator_init();
+    MT_CHECK_THAT(!str_translator_map(&tr, "ab", "x"));
+    MT_CHECK_THAT(tr.rows == 0);
+
+    // Control bytes to space, tabs squeezed with the spaces, digits removed
+    StrByteSet ctrl = str_byteset_n("\x01\x02\x1b\t\r\n", 6);
+    StrByteSet space = str_byteset(" ");
+    StrByteSet digits = str_byteset("0123456789");
+    str_translator_map_set(&tr, &ctrl, ' ');
+    MT_CHECK_THAT(str_translator_map(&tr, "ab", "AB"));
+    str_translator_remove(&tr, &digits);
+    str_translator_squeeze(&tr, &space);
+    str_append_one(&str, "a1 \t\t b2\x1b[0m  end\r\n");
+    MT_CHECK_THAT(str_translate(&str, &tr));
+    MT_CHECK_THAT(str_equals_cstr(&str, "A B [m end "));
+
+    // Random translators on random text against a byte at a time reference
+    String orig = str_init();
+    unsigned seed = 17;
+    for (int round = 0; round < 400; ++round) {
+        tr = str_translator_init();
+        unsigned char map[256];
+        for (int c = 0; c < 256; ++c) map[c] = (unsigned char)c;
+        bool removed[256] = {false}, squeezed[256] = {false};
+        StrByteSet rm, sq;
+        memset(&rm, 0, sizeof(rm));
+        memset(&sq, 0, sizeof(sq));
+        for (int k = 0; k < 6; ++k) {
+            seed = seed * 1103515245u + 12345u;
+            unsigned char a = (unsigned char)("abc \t.\xC3\x80"[(seed >> 16) % 8]), b = (unsigned char)(seed >> 8);
+            switch (round % 4 == 0 ? 3 : k % 3) {
+            case 0: {
+                char from[2] = {(char)a, 0}, to[2] = {(char)(b ? b : 'z'), 0};
+                MT_CHECK_THAT(str_translator_map(&tr, from, to));
+                map[a] = (unsigned char)to[0];
+                break;
+            }
+            case 1: str_byteset_add(&rm, a); removed[a] = true; break;
+            default: str_byteset_add(&sq, b % 2 ? a : ' '); squeezed[b % 2 ? a : ' '] = true; break;
+            }
+        }
+        str_translator_remove(&tr, &rm);
+        str_translator_squeeze(&tr, &sq);
+
+        str_clear(&orig);
+        seed = seed * 1103515245u + 12345u;
+        size_t n = (seed >> 16) % 300;
+        for (size_t i = 0; i < n; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            str_append_char(&orig, "abc  \t\t..\xC3\x80xyz"[(seed >> 16) % 15]);
+        }
+        MT_CHECK_THAT(str_clone(&orig, &str));
+        MT_CHECK_THAT(str_translate(&str, &tr));
+
+        char expect[300];
+        size_t len = 0;
+        for (size_t i = 0; i < n; ++i) {
+            unsigned char c = (unsigned char)orig.buffer[i];
+            if (removed[c]) continue;
+            c = map[c];
+            if (squeezed[c] && len && (unsigned char)expect[len - 1] == c) continue;
+            expect[len++] = (char)c;
+        }
+        MT_CHECK_THAT(str_equals_n(&str, expect, len));
+    }
+
+    str_free(&orig);
+    str_free(&str);
+}
+
+// Reference base64 decoder over a standard or URL alphabet, no checks
+static size_t
+ref_base64_decode(const char *src, size_t len, unsigned char *out)
+{
+    size_t n = 0, bits = 0;
+    uint32_t acc = 0;
+    for (size_t i = 0; i < len && src[i] != '='; ++i) {
+        const char *alpha = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+        const char *at = strchr(alpha, src[i]);
+        uint32_t v = at ? (uint32_t)(at - alpha) : (src[i] == '+' || src[i] == '-') ? 62u : 63u;
+        acc = acc << 6 | v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out[n++] = (unsigned char)(acc >> bits);
+        }
+    }
+    return n;
+}
+
+MT_DEFINE_TEST(base64_and_hex)
+{
+    String enc = str_init(), dec = str_init();
+    size_t bad = 0;
+
+    // RFC 4648 test vectors
+    static const char *const vectors[][2] = {
+        {"", ""}, {"f", "Zg=="}, {"fo", "Zm8="}, {"foo", "Zm9v"},
+        {"foob", "Zm9vYg=="}, {"fooba", "Zm9vYmE="}, {"foobar", "Zm9vYmFy"},
+    };
+    for (size_t k = 0; k < sizeof(vectors) / sizeof(vectors[0]); ++k) {
+        str_clear(&enc);
+        str_clear(&dec);
+        MT_CHECK_THAT(str_append_base64(&enc, vectors[k][0], strlen(vectors[k][0]), false));
+        MT_CHECK_THAT(str_equals_cstr(&enc, vectors[k][1]));
+        MT_CHECK_THAT(str_decode_base64(&dec, enc.buffer, enc.size, false, &bad));
+        MT_CHECK_THAT(str_equals_cstr(&dec, vectors[k][0]));
+    }
+    str_clear(&enc);
+    MT_CHECK_THAT(str_append_base64(&enc, "\xFB\xFF", 2, true));
+    MT_CHECK_THAT(str_equals_cstr(&enc, "-_8"));
+
+    // Random lengths through every kernel against the scalar reference
+    unsigned char data[600], back[600];
+    unsigned seed = 23;
+    for (size_t len = 0; len < 600; len += 1 + len / 16) {
+        for (size_t i = 0; i < len; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            data[i] = (unsigned char)(seed >> 16);
+        }
+        for (int url = 0; url < 2; ++url) {
+            str_clear(&enc);
+            str_clear(&dec);
+            str_append_one(&enc, "x"); // appending after existing content
+            MT_CHECK_THAT(str_append_base64(&enc, data, len, url));
+            MT_CHECK_THAT(enc.size == 1 + (url ? (len * 4 + 2) / 3 : (len + 2) / 3 * 4));
+            MT_CHECK_THAT(ref_base64_decode(enc.buffer + 1, enc.size - 1, back) == len);
+            MT_CHECK_THAT(memcmp(back, data, len) == 0);
+            MT_CHECK_THAT(str_decode_base64(&dec, enc.buffer + 1, enc.size - 1, url, &bad));
+            MT_CHECK_THAT(dec.size == len && memcmp(dec.buffer, data, len) == 0);
+
+            // A bad character anywhere is found at its offset
+            if (len) {
+                size_t at = 1 + (seed >> 8) % (enc.size - 1);
+                char saved = enc.buffer[at];
+                enc.buffer[at] = url ? '+' : '.';
+                str_clear(&dec);
+                MT_CHECK_THAT(!str_decode_base64(&dec, enc.buffer + 1, enc.size - 1, url, &bad));
+                MT_CHECK_THAT(bad == at - 1 && dec.size == 0 && dec.buffer[0] == '\0');
+                enc.buffer[at] = saved;
+            }
+        }
+
+        str_clear(&enc);
+        str_clear(&dec);
+        MT_CHECK_THAT(str_append_hex(&enc, data, len, len % 2));
+        MT_CHECK_THAT(enc.size == 2 * len);
+        bool ok = true;
+        for (size_t i = 0; i < len; ++i) {
+            char pair[3];
+            snprintf(pair, sizeof(pair), len % 2 ? "%02X" : "%02x", data[i]);
+            ok = ok && memcmp(enc.buffer + 2 * i, pair, 2) == 0;
+        }
+        MT_CHECK_THAT(ok);
+        MT_CHECK_THAT(str_decode_hex(&dec, enc.buffer, enc.size, &bad));
+        MT_CHECK_THAT(dec.size == len && memcmp(dec.buffer, data, len) == 0);
+        if (len) {
+            size_t at = (seed >> 8) % enc.size;
+            enc.buffer[at] = "gG/:@`"[seed % 6];
+            MT_CHECK_THAT(!str_decode_hex(&dec, enc.buffer, enc.size, &bad) && bad == at && dec.size == len);
+        }
+    }
+
+    // Strict structure
+    str_clear(&dec);
+    MT_CHECK_THAT(!str_decode_base64(&dec, "Zm8", 3, false, &bad) && bad == 3);
+    MT_CHECK_THAT(str_decode_base64(&dec, "Zm8", 3, true, &bad) && str_equals_cstr(&dec, "fo"));
+    str_clear(&dec);
+    MT_CHECK_THAT(!str_decode_base64(&dec, "Zm9=", 4, false, &bad) && bad == 2);  // trailing bits set
+    MT_CHECK_THAT(!str_decode_base64(&dec, "Zg=", 3, false, &bad) && bad == 3);
+    MT_CHECK_THAT(!str_decode_base64(&dec, "Zm9vY", 5, true, &bad) && bad == 4);
+    MT_CHECK_THAT(!str_decode_base64(&dec, "Zm=v", 4, false, &bad) && bad == 2);
+    MT_CHECK_THAT(!str_decode_base64(&dec, "Zg===", 5, false, &bad) && bad == 2);
+    MT_CHECK_THAT(!str_decode_base64(&dec, "Zm9v\n", 5, false, &bad) && bad == 4);
+    MT_CHECK_THAT(!str_decode_hex(&dec, "abc", 3, &bad) && bad == 2);
+    MT_CHECK_THAT(dec.size == 0);
+
+    str_free(&enc);
+    str_free(&dec);
+}
+
+MT_DEFINE_TEST(escape)
+{
+    String out = str_init(), back = str_init();
+    size_t bad = 0;
+
+    static const struct { StrEscape dialect; const char *in, *out; } cases[] = {
+        {STR_ESCAPE_JSON, "say \"hi\"\n\\\x01/", "say \\\"hi\\\"\\n\\\\\\u0001/"},
+        {STR_ESCAPE_HTML, "<a href='x'>&\"", "&lt;a href=&#39;x&#39;&gt;&amp;&quot;"},
+        {STR_ESCAPE_C,    "tab\there\x7f\xe2\x82\xac'0", "tab\\there\\177\\342\\202\\254\\'0"},
+        {STR_ESCAPE_CSV,  "plain", "plain"},
+        {STR_ESCAPE_CSV,  "a,\"b\"", "\"a,\"\"b\"\"\""},
+        {STR_ESCAPE_CSV,  "", ""},
+    };
+    for (size_t k = 0; k < sizeof(cases) / sizeof(cases[0]); ++k) {
+        str_clear(&out);
+        str_clear(&back);
+        MT_CHECK_THAT(str_append_escaped(&out, cases[k].in, strlen(cases[k].in), cases[k].dialect));
+        MT_CHECK_THAT(str_equals_cstr(&out, cases[k].out));
+        MT_CHECK_THAT(str_append_unescaped(&back, out.buffer, out.size, cases[k].dialect, &bad));
+        MT_CHECK_THAT(str_equals_cstr(&back, cases[k].in));
+    }
+
+    // Every byte value, in long runs so the vector scanners are involved
+    char data[700];
+    unsigned seed = 29;
+    for (int round = 0; round < 200; ++round) {
+        size_t len = (size_t)round * 3;
+        for (size_t i = 0; i < len; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            data[i] = (char)(round % 2 ? seed >> 16 : 'a' + (seed >> 16) % 26);
+        }
+        if (len && round % 4 == 1) data[len / 2] = '"';
+        for (int d = STR_ESCAPE_JSON; d <= STR_ESCAPE_CSV; ++d) {
+            str_clear(&out);
+            str_clear(&back);
+            MT_CHECK_THAT(str_append_escaped(&out, data, len, (StrEscape)d));
+            MT_CHECK_THAT(str_append_unescaped(&back, out.buffer, out.size, (StrEscape)d, &bad));
+            MT_CHECK_THAT(str_equals_n(&back, data, len));
+        }
+    }
+
+    // Unescape extras and errors
+    str_clear(&back);
+    MT_CHECK_THAT(str_append_unescaped(&back, "\\u00e9\\ud83d\\ude00\\/", 20, STR_ESCAPE_JSON, &bad));
+    MT_CHECK_THAT(str_equals_cstr(&back, "\xC3\xA9\xF0\x9F\x98\x80/"));
+    str_clear(&back);
+    MT_CHECK_THAT(str_append_unescaped(&back, "&#233;&#x1F600;&apos;", 21, STR_ESCAPE_HTML, &bad));
+    MT_CHECK_THAT(str_equals_cstr(&back, "\xC3\xA9\xF0\x9F\x98\x80'"));
+    str_clear(&back);
+    MT_CHECK_THAT(str_append_unescaped(&back, "\\x41\\1012\\?", 11, STR_ESCAPE_C, &bad));
+    MT_CHECK_THAT(str_equals_cstr(&back, "AA2?"));
+
+    static const struct { StrEscape dialect; const char *in; size_t at; } errors[] = {
+        {STR_ESCAPE_JSON, "ok\\q", 2},       {STR_ESCAPE_JSON, "a\"b", 1},
+        {STR_ESCAPE_JSON, "tab\there", 3},   {STR_ESCAPE_JSON, "x\\ud800y", 1},
+        {STR_ESCAPE_JSON, "\\udc00", 0},     {STR_ESCAPE_JSON, "\\u12", 0},
+        {STR_ESCAPE_JSON, "end\\", 3},       {STR_ESCAPE_HTML, "a &nbsp; b", 2},
+        {STR_ESCAPE_HTML, "&#xD800;", 0},    {STR_ESCAPE_HTML, "& alone", 0},
+        {STR_ESCAPE_C,    "\\400", 0},       {STR_ESCAPE_C, "x\\x", 1},
+        {STR_ESCAPE_C,    "\\x100", 0},      {STR_ESCAPE_C, "\\z", 0},
+        {STR_ESCAPE_CSV,  "a\"b", 1},        {STR_ESCAPE_CSV, "\"open", 5},
+        {STR_ESCAPE_CSV,  "\"a\"b\"", 2},
+    };
+    str_clear(&back);
+    str_append_one(&back, "keep");
+    for (size_t k = 0; k < sizeof(errors) / sizeof(errors[0]); ++k) {
+        bad = SIZE_MAX;
+        MT_CHECK_THAT(!str_append_unescaped(&back, errors[k].in, strlen(errors[k].in), errors[k].dialect, &bad));
+        MT_CHECK_THAT(bad == errors[k].at);
+    }
+    MT_CHECK_THAT(str_equals_cstr(&back, "keep"));
+
+    str_free(&out);
+    str_free(&back);
+}
+
+static bool
+slice_is(StrSlice s, const char *cstr)
+{
+    return s.size == strlen(cstr) && memcmp(s.data, cstr, s.size) == 0;
+}
+
+MT_DEFINE_TEST(url)
+{
+    String out = str_init();
+    size_t bad = 0;
+
+    MT_CHECK_THAT(str_append_url_encoded(&out, "a b&c=d/~_.-\xC3\xA9", 14, false));
+    MT_CHECK_THAT(str_equals_cstr(&out, "a%20b%26c%3Dd%2F~_.-%C3%A9"));
+    MT_CHECK_THAT(str_url_decode_inplace(&out, false, &bad));
+    MT_CHECK_THAT(str_equals_cstr(&out, "a b&c=d/~_.-\xC3\xA9"));
+
+    str_clear(&out);
+    MT_CHECK_THAT(str_append_url_encoded(&out, "x y+z", 5, true));
+    MT_CHECK_THAT(str_equals_cstr(&out, "x+y%2Bz"));
+    MT_CHECK_THAT(str_url_decode_inplace(&out, true, &bad));
+    MT_CHECK_THAT(str_equals_cstr(&out, "x y+z"));
+
+    // Every byte value, in long runs so the vector scanners are involved
+    char data[700];
+    unsigned seed = 31;
+    for (int round = 0; round < 200; ++round) {
+        size_t len = (size_t)round * 3;
+        for (size_t i = 0; i < len; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            data[i] = (char)(round % 2 ? seed >> 16 : 'a' + (seed >> 16) % 26);
+        }
+        if (len && round % 4 == 2) data[len / 2] = ' ';
+        for (int form = 0; form < 2; ++form) {
+            str_clear(&out);
+            MT_CHECK_THAT(str_append_url_encoded(&out, data, len, form));
+            MT_CHECK_THAT(str_url_decode_inplace(&out, form, &bad));
+            MT_CHECK_THAT(str_equals_n(&out, data, len));
+        }
+    }
+
+    // Malformed escapes fail without touching the String
+    static const struct { const char *in; size_t at; } errors[] = {
+        {"abc%", 3}, {"%4", 0}, {"a%zz", 1}, {"%41%g0", 3},
+    };
+    for (size_t k = 0; k < sizeof(errors) / sizeof(errors[0]); ++k) {
+        str_clear(&out);
+        str_append_one(&out, errors[k].in);
+        bad = SIZE_MAX;
+        MT_CHECK_THAT(!str_url_decode_inplace(&out, true, &bad));
+        MT_CHECK_THAT(bad == errors[k].at);
+        MT_CHECK_THAT(str_equals_cstr(&out, errors[k].in));
+    }
+
+    // Query strings
+    str_clear(&out);
+    str_append_one(&out, "?q=caf%C3%A9+au+lait&&flag&empty=&bad=100%&a%3Db=c%26d");
+    StrQueryIter it = str_query_iter(&out);
+    StrSlice key, value;
+    MT_CHECK_THAT(str_query_next(&it, &key, &value));
+    MT_CHECK_THAT(slice_is(key, "q") && slice_is(value, "caf\xC3\xA9 au lait"));
+    MT_CHECK_THAT(str_query_next(&it, &key, &value));
+    MT_CHECK_THAT(slice_is(key, "flag") && value.size == 0);
+    MT_CHECK_THAT(str_query_next(&it, &key, &value));
+    MT_CHECK_THAT(slice_is(key, "empty") && value.size == 0);
+    MT_CHECK_THAT(str_query_next(&it, &key, &value));
+    MT_CHECK_THAT(slice_is(key, "bad") && slice_is(value, "100%"));
+    MT_CHECK_THAT(str_query_next(&it, &key, &value));
+    MT_CHECK_THAT(slice_is(key, "a=b") && slice_is(value, "c&d"));
+    MT_CHECK_THAT(!str_query_next(&it, &key, &value));
+
+    str_clear(&out);
+    it = str_query_iter(&out);
+    MT_CHECK_THAT(!str_query_next(&it, &key, &value));
+
+    str_free(&out);
+}
+
+static bool
+same_double(double a, double b)
+{
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+MT_DEFINE_TEST(parse_numbers)
+{
+    int64_t i = 7;
+    uint64_t u = 7;
+    double d = 0;
+
+    MT_CHECK_THAT(str_parse_i64_n("-42abc", 6, &i) == 3 && i == -42);
+    MT_CHECK_THAT(str_parse_i64_n("+0012345678901234x", 18, &i) == 17 && i == 12345678901234);
+    MT_CHECK_THAT(str_parse_i64_n("9223372036854775807", 19, &i) == 19 && i == INT64_MAX);
+    MT_CHECK_THAT(str_parse_i64_n("-9223372036854775808", 20, &i) == 20 && i == INT64_MIN);
+    MT_CHECK_THAT(str_parse_i64_n("9223372036854775808", 19, &i) == 0 && i == INT64_MIN);
+    MT_CHECK_THAT(str_parse_i64_n("-", 1, &i) == 0);
+    MT_CHECK_THAT(str_parse_i64_n(" 1", 2, &i) == 0);
+    MT_CHECK_THAT(str_parse_u64_n("18446744073709551615", 20, &u) == 20 && u == UINT64_MAX);
+    MT_CHECK_THAT(str_parse_u64_n("000018446744073709551615", 24, &u) == 24 && u == UINT64_MAX);
+    MT_CHECK_THAT(str_parse_u64_n("18446744073709551616", 20, &u) == 0);
+    MT_CHECK_THAT(str_parse_u64_n("-1", 2, &u) == 0);
+    MT_CHECK_THAT(str_parse_u64_n("0", 1, &u) == 1 && u == 0);
+
+    // Integers of every length against strtoull
+    char text[64];
+    uint64_t x = 88172645463325252u;
+    for (int k = 0; k < 2000; ++k) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        uint64_t v = x >> (k % 64);
+        int n = snprintf(text, sizeof(text), "%llu;", (unsigned long long)v);
+        MT_CHECK_THAT(str_parse_u64_n(text, (size_t)n, &u) == (size_t)n - 1 && u == v);
+    }
+
+    String str = str_init();
+    str_append_one(&str, "3.25e2 rest");
+    MT_CHECK_THAT(str_parse_f64(&str, &d) == 6 && d == 325.0);
+    MT_CHECK_THAT(str_parse_f64_n(".5", 2, &d) == 2 && d == 0.5);
+    MT_CHECK_THAT(str_parse_f64_n("5.", 2, &d) == 2 && d == 5.0);
+    MT_CHECK_THAT(str_parse_f64_n("1e", 2, &d) == 1 && d == 1.0);
+    MT_CHECK_THAT(str_parse_f64_n("-0", 2, &d) == 2 && same_double(d, -0.0));
+    MT_CHECK_THAT(str_parse_f64_n("-InFinity", 9, &d) == 9 && d < 0 && d * 0 != d * 0);
+    MT_CHECK_THAT(str_parse_f64_n("nan", 3, &d) == 3 && d != d);
+    MT_CHECK_THAT(str_parse_f64_n(".", 1, &d) == 0);
+    MT_CHECK_THAT(str_parse_f64_n("e5", 2, &d) == 0);
+    MT_CHECK_THAT(str_parse_f64_n("1e999999999999", 14, &d) == 14 && d > 1e308);
+    MT_CHECK_THAT(str_parse_f64_n("1e-999999999999", 15, &d) == 15 && same_double(d, 0.0));
+
+    // Hard cases: halfway points, subnormals, long mantissas, edges of range
+    static const char *hard[] = {
+        "9007199254740993", "9007199254740992.999999999999999999999", "2.2250738585072011e-308",
+        "2.2250738585072014e-308", "4.9406564584124654e-324", "2.4703282292062327e-324",
+        "2.4703282292062328e-324", "1.7976931348623157e308", "1.7976931348623158e308",
+        "1.7976931348623159e308", "7.2057594037927933e16", "0.1", "0.3", "123456789012345678901234567890",
+        "1.00000000000000011102230246251565404236316680908203125",
+        "1.00000000000000011102230246251565404236316680908203124",
+        "1.00000000000000011102230246251565404236316680908203126",
+        "0.000000000000000000000000000000000000000000001e20", "1448997445238699", "8.98846567431158e307",
+        "3.0540412e5", "2.9802322387695312e-8", "1e23", "8.533e-309",
+    };
+    for (size_t k = 0; k < sizeof(hard) / sizeof(hard[0]); ++k) {
+        size_t n = strlen(hard[k]);
+        MT_CHECK_THAT(str_parse_f64_n(hard[k], n, &d) == n && same_double(d, strtod(hard[k], NULL)));
+    }
+
+    // Over 19 leading zeros, nothing past the slice is read
+    static const char zeros_then_digits[] = "00000000000000000000" "0000000000" "1234567890123456789012";
+    MT_CHECK_THAT(str_parse_f64_n(zeros_then_digits, 20, &d) == 20 && same_double(d, 0.0));
+    MT_CHECK_THAT(str_parse_f64_n(zeros_then_digits, 35, &d) == 35 && d == 12345.0);
+    MT_CHECK_THAT(str_parse_f64_n("0.0000000000000000000000001", 22, &d) == 22 && same_double(d, 0.0));
+    char *zeros = (char *)malloc(24);
+    MT_ASSERT_THAT(zeros);
+    memset(zeros, '0', 24);
+    MT_CHECK_THAT(str_parse_f64_n(zeros, 24, &d) == 24 && same_double(d, 0.0));
+    free(zeros);
+
+    // Random doubles printed at several precisions, round tripped
+    for (int k = 0; k < 20000; ++k) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        double v;
+        uint64_t bits = x & ~(1ull << 63);
+        memcpy(&v, &bits, sizeof(v));
+        if ((bits >> 52) == 0x7FF) continue;
+        int n = snprintf(text, sizeof(text), "%.*g", 1 + k % 20, v);
+        MT_CHECK_THAT(str_parse_f64_n(text, (size_t)n, &d) == (size_t)n && same_double(d, strtod(text, NULL)));
+    }
+
+    str_free(&str);
+}
+
+MT_DEFINE_TEST(buf)
+{
+    StrBuf buf = str_buf_init();
+    MT_CHECK_THAT(str_buf_size(&buf) == 0 && str_buf_data(&buf)[0] == '\0');
+
+    MT_ASSERT_THAT(str_buf_append(&buf, "  GET /index HTTP/1.1\r\n"));
+    char *start = buf.str.buffer;
+
+    // Front edits only move the offset
+    MT_CHECK_THAT(str_buf_ltrim(&buf));
+    MT_CHECK_THAT(str_buf_consume(&buf, 4));
+    MT_CHECK_THAT(buf.head == 6 && buf.str.buffer == start);
+    MT_CHECK_THAT(strcmp(str_buf_data(&buf), "/index HTTP/1.1\r\n") == 0);
+    MT_CHECK_THAT(str_buf_erase(&buf, 0, 1));
+    MT_CHECK_THAT(buf.head == 7);
+    MT_CHECK_THAT(!str_buf_consume(&buf, 100));
+
+    // Near the front the prefix moves, near the back the tail does
+    MT_CHECK_THAT(str_buf_erase(&buf, 1, 4));
+    MT_CHECK_THAT(strcmp(str_buf_data(&buf), "i HTTP/1.1\r\n") == 0 && buf.head == 11);
+    MT_CHECK_THAT(str_buf_erase(&buf, 6, 4));
+    MT_CHECK_THAT(strcmp(str_buf_data(&buf), "i HTTP\r\n") == 0 && buf.head == 11);
+
+    MT_CHECK_THAT(str_buf_trim(&buf));
+    StrSlice s = str_buf_slice(&buf);
+    MT_CHECK_THAT(s.size == 6 && memcmp(s.data, "i HTTP", 6) == 0);
+
+    String out = str_buf_take(&buf);
+    MT_CHECK_THAT(strcmp(out.buffer, "i HTTP") == 0 && out.size == 6);
+    MT_CHECK_THAT(str_buf_size(&buf) == 0);
+    str_free(&out);
+
+    // A parser loop: memory stays bounded and nothing moves per message
+    size_t max_capacity = 0, compactions = 0;
+    for (int i = 0; i < 20000; ++i) {
+        MT_ASSERT_THAT(str_buf_append(&buf, "line of some length\n"));
+        if (i % 3 == 2) {
+            while (str_buf_size(&buf) >= 20) {
+                size_t head = buf.head;
+                MT_ASSERT_THAT(str_buf_consume(&buf, 20));
+                if (buf.head < head + 20) compactions++;
+            }
+        }
+        if (buf.str.capacity > max_capacity) max_capacity = buf.str.capacity;
+    }
+    MT_CHECK_THAT(max_capacity <= 256);
+    MT_CHECK_THAT(str_buf_size(&buf) == 40 && compactions > 0);
+
+    // Appends fill the dead prefix before growing
+    str_buf_clear(&buf);
+    MT_ASSERT_THAT(str_buf_reserve(&buf, 8000));
+    size_t cap = buf.str.capacity;
+    for (int i = 0; i < 200; ++i) MT_ASSERT_THAT(str_buf_append(&buf, "0123456789"));
+    MT_ASSERT_THAT(str_buf_consume(&buf, 1500));
+    for (int i = 0; i < 100; ++i) MT_ASSERT_THAT(str_buf_append(&buf, "0123456789"));
+    MT_CHECK_THAT(buf.head == 1500 && buf.str.capacity == cap);
+    while (str_buf_size(&buf) + 10 < cap) MT_ASSERT_THAT(str_buf_append(&buf, "0123456789"));
+    MT_CHECK_THAT(buf.head == 0 && buf.str.capacity == cap);
+    MT_CHECK_THAT(memcmp(str_buf_data(&buf), "0123456789", 10) == 0);
+
+    str_buf_free(&buf);
+}
+
 MT_DEFINE_TEST(write_and_read_file)
 {
     String str = str_init();
@@ -409,12 +1736,85 @@ MT_DEFINE_TEST(write_and_read_file)
     String rd = str_init();
     MT_CHECK_THAT(str_read_file(&rd, f) == true);
     MT_CHECK_THAT(strcmp(rd.buffer, "alpha\nbeta\ngamma") == 0);
+    // A small file leaves a buffer sized to it, not to the read chunk
+    MT_CHECK_THAT(rd.capacity < 64);
+
+    fclose(f);
 
+    // An empty file reads as nothing
+    f = tmpfile();
+    MT_ASSERT_THAT(f != NULL);
+    String empty = str_init();
+    MT_CHECK_THAT(str_read_file(&empty, f) == true);
+    MT_CHECK_THAT(empty.size == 0);
     fclose(f);
+    str_free(&empty);
     str_free(&rd);
     str_free(&str);
 }
 
+MT_DEFINE_TEST(builder)
+{
+    StrBuilder b = str_builder_init();
+    String expect = str_init();
+    MT_CHECK_THAT(str_builder_size(&b) == 0);
+
+    // Enough to span many chunks, in pieces of every shape
+    char piece[3000];
+    for (size_t i = 0; i < sizeof(piece); ++i) piece[i] = (char)('a' + i % 26);
+    for (int k = 0; k < 3000; ++k) {
+        size_t len = (size_t)(k * 37) % sizeof(piece);
+        MT_CHECK_THAT(str_builder_append_n(&b, piece, len));
+        MT_CHECK_THAT(str_append_one_n(&expect, piece, len));
+        MT_CHECK_THAT(str_builder_appendf(&b, "<%d>", k));
+        MT_CHECK_THAT(str_appendf(&expect, "<%d>", k));
+        MT_CHECK_THAT(str_builder_append_char(&b, '\n'));
+        MT_CHECK_THAT(str_append_char(&expect, '\n'));
+        // Any append function through the tail
+        String *tail = str_builder_tail(&b, 8);
+        MT_ASSERT_THAT(tail != NULL);
+        MT_CHECK_THAT(str_append_hex(tail, "\x01\xff", 2, false));
+        MT_CHECK_THAT(str_append_hex(&expect, "\x01\xff", 2, false));
+    }
+    MT_CHECK_THAT(str_builder_append(&b, "end"));
+    MT_CHECK_THAT(str_append_one(&expect, "end"));
+    MT_CHECK_THAT(str_builder_size(&b) == expect.size);
+    MT_CHECK_THAT(b.count > 2);
+
+    FILE *f = tmpfile();
+    MT_ASSERT_THAT(f != NULL);
+    MT_CHECK_THAT(fputs("head:", f) >= 0);
+    MT_CHECK_THAT(str_builder_write_file(&b, f));
+    rewind(f);
+    String rd = str_init();
+    MT_CHECK_THAT(str_read_file(&rd, f));
+    MT_CHECK_THAT(rd.size == expect.size + 5 && memcmp(rd.buffer + 5, expect.buffer, expect.size) == 0);
+    fclose(f);
+
+    String out;
+    MT_CHECK_THAT(str_builder_take(&b, &out));
+    MT_CHECK_THAT(str_equals(&out, &expect));
+    MT_CHECK_THAT(out.capacity == out.size + 1);
+    MT_CHECK_THAT(str_builder_size(&b) == 0 && b.count == 0);
+    str_free(&out);
+
+    // A single chunk is trimmed rather than copied
+    MT_CHECK_THAT(str_builder_append(&b, "small"));
+    str_builder_clear(&b);
+    MT_CHECK_THAT(str_builder_append(&b, "tiny"));
+    MT_CHECK_THAT(str_builder_take(&b, &out));
+    MT_CHECK_THAT(str_equals_cstr(&out, "tiny") && out.capacity == 5);
+    str_free(&out);
+
+    MT_CHECK_THAT(str_builder_take(&b, &out));
+    MT_CHECK_THAT(out.size == 0 && out.buffer[0] == '\0');
+    str_free(&out);
+
+    str_builder_free(&b);
+    str_free(&rd);
+    str_free(&expect);
+}
+
 MT_DEFINE_TEST(free)
 {
     String str = str_init();
@@ -488,6 +1888,524 @@ MT_DEFINE_TEST(move)
     str_free(&src);
 }
 
+MT_DEFINE_TEST(hash)
+{
+    String a = str_init();
+    String b = str_init();
+    str_append_one(&a, "hello world");
+    str_append_one(&b, "hello world");
+
+    MT_CHECK_THAT(str_hash64(&a, 0) == str_hash64(&b, 0));
+    MT_CHECK_THAT(str_hash64(&a, 0) == str_hash64_n("hello world", 11, 0));
+    MT_CHECK_THAT(str_hash64(&a, 0) != str_hash64(&a, 1));
+    MT_CHECK_THAT(str_hash64_n("hello world", 11, 0) != str_hash64_n("hello worle", 11, 0));
+    MT_CHECK_THAT(str_hash64_n("", 0, 0) != str_hash64_n("\0", 1, 0));
+    MT_CHECK_THAT(str_hash64_n(NULL, 0, 7) == str_hash64_n("", 0, 7));
+
+    StrHash128 h = str_hash128(&a, 42);
+    MT_CHECK_THAT(h.lo == str_hash64(&a, 42));
+    MT_CHECK_THAT(h.hi != h.lo);
+
+    // Distinct hashes for all lengths of a run of the same byte
+    char buf[300];
+    memset(buf, 'x', sizeof(buf));
+    uint64_t prev = str_hash64_n(buf, 0, 0);
+    for (size_t len = 1; len <= sizeof(buf); ++len) {
+        uint64_t cur = str_hash64_n(buf, len, 0);
+        MT_CHECK_THAT(cur != prev);
+        prev = cur;
+    }
+
+    str_free(&a);
+    str_free(&b);
+}
+
+MT_DEFINE_TEST(hash_icase)
+{
+    MT_CHECK_THAT(str_hash64_icase_n("Content-Type", 12, 3) == str_hash64_icase_n("CONTENT-TYPE", 12, 3));
+    MT_CHECK_THAT(str_hash64_icase_n("content-type", 12, 3) == str_hash64_n("content-type", 12, 3));
+    MT_CHECK_THAT(str_hash64_icase_n("[", 1, 0) != str_hash64_icase_n("{", 1, 0));
+
+    String s = str_init();
+    str_append_repeat(&s, 'A', 1000);
+    String t = str_init();
+    str_append_repeat(&t, 'a', 1000);
+    MT_CHECK_THAT(str_hash64_icase(&s, 0) == str_hash64(&t, 0));
+    StrHash128 x = str_hash128_icase(&s, 9);
+    StrHash128 y = str_hash128(&t, 9);
+    MT_CHECK_THAT(x.lo == y.lo && x.hi == y.hi);
+
+    str_free(&s);
+    str_free(&t);
+}
+
+MT_DEFINE_TEST(hasher_streaming)
+{
+    char buf[1000];
+    for (size_t i = 0; i < sizeof(buf); ++i) buf[i] = (char)(i * 131u + (i >> 3));
+
+    static const size_t lens[] = { 0, 1, 3, 4, 15, 16, 17, 47, 48, 49, 96, 97, 200, 1000 };
+    static const size_t steps[] = { 1, 5, 16, 47, 48, 49, 64, 1000 };
+
+    for (size_t li = 0; li < sizeof(lens) / sizeof(lens[0]); ++li) {
+        size_t len = lens[li];
+        StrHash128 expect = str_hash128_n(buf, len, 99);
+        for (size_t si = 0; si < sizeof(steps) / sizeof(steps[0]); ++si) {
+            StrHasher h;
+            str_hasher_init(&h, 99);
+            for (size_t off = 0; off < len; off += steps[si]) {
+                size_t n = len - off < steps[si] ? len - off : steps[si];
+                str_hasher_update(&h, buf + off, n);
+            }
+            StrHash128 got = str_hasher_final128(&h);
+            MT_CHECK_THAT(got.lo == expect.lo && got.hi == expect.hi);
+            MT_CHECK_THAT(str_hasher_final64(&h) == expect.lo);
+        }
+    }
+
+    String str = str_init();
+    str_append_one(&str, "abc");
+    StrHasher h;
+    str_hasher_init(&h, 0);
+    str_hasher_update_str(&h, &str);
+    str_hasher_update_icase(&h, "DEF", 3);
+    MT_CHECK_THAT(str_hasher_final64(&h) == str_hash64_n("abcdef", 6, 0));
+
+    str_free(&str);
+}
+
+MT_DEFINE_TEST(intern_pool)
+{
+    StrInternPool pool;
+    str_intern_pool_init(&pool);
+
+    const StrInterned *a = str_intern(&pool, "label");
+    const StrInterned *b = str_intern_n(&pool, "label!", 5);
+    MT_ASSERT_THAT(a != NULL);
+    MT_CHECK_THAT(a == b);
+    MT_CHECK_THAT(a->size == 5);
+    MT_CHECK_THAT(strcmp(a->data, "label") == 0);
+
+    String str = str_init();
+    str_append_one(&str, "other");
+    const StrInterned *c = str_intern_str(&pool, &str);
+    MT_ASSERT_THAT(c != NULL);
+    MT_CHECK_THAT(c != a);
+    MT_CHECK_THAT(str_intern_find_n(&pool, "other", 5) == c);
+    MT_CHECK_THAT(str_intern_find_n(&pool, "missing", 7) == NULL);
+
+    const StrInterned *e = str_intern_n(&pool, NULL, 0);
+    MT_ASSERT_THAT(e != NULL);
+    MT_CHECK_THAT(e->size == 0 && e->data[0] == '\0');
+    MT_CHECK_THAT(str_intern(&pool, "") == e);
+
+    // Enough strings to grow the tables and spill into several blocks
+    char buf[32];
+    for (int i = 0; i < 5000; ++i) {
+        int n = snprintf(buf, sizeof(buf), "tag-%d", i);
+        MT_ASSERT_THAT(str_intern_n(&pool, buf, (size_t)n) != NULL);
+    }
+    for (int i = 0; i < 5000; ++i) {
+        int n = snprintf(buf, sizeof(buf), "tag-%d", i);
+        const StrInterned *h = str_intern_n(&pool, buf, (size_t)n);
+        MT_ASSERT_THAT(h != NULL);
+        MT_CHECK_THAT(h->size == (size_t)n && memcmp(h->data, buf, (size_t)n) == 0);
+    }
+    MT_CHECK_THAT(str_intern(&pool, "label") == a);
+
+    // A string larger than a block gets one of its own
+    String big = str_init();
+    str_append_repeat(&big, 'x', STR_INTERN_BLOCK_SIZE);
+    const StrInterned *h = str_intern_str(&pool, &big);
+    MT_ASSERT_THAT(h != NULL);
+    MT_CHECK_THAT(h->size == big.size);
+    MT_CHECK_THAT(str_intern_str(&pool, &big) == h);
+    MT_CHECK_THAT(str_intern_find_n(&pool, "tag-1234", 8) != NULL);
+
+    StrInternStats stats = str_intern_pool_stats(&pool);
+    MT_CHECK_THAT(stats.count == 5000 + 4);
+    MT_CHECK_THAT(stats.lookups == 10000 + 11);
+    MT_CHECK_THAT(stats.hits == 5000 + 6);
+    MT_CHECK_THAT(stats.hit_rate > 0.49 && stats.hit_rate < 0.51);
+    MT_CHECK_THAT(stats.bytes_used >= big.size);
+    MT_CHECK_THAT(stats.bytes_reserved >= stats.bytes_used);
+
+    str_intern_pool_free(&pool);
+    stats = str_intern_pool_stats(&pool);
+    MT_CHECK_THAT(stats.count == 0 && stats.bytes_reserved == 0);
+
+    str_free(&big);
+    str_free(&str);
+}
+
+MT_DEFINE_TEST(map)
+{
+    StrMap map = str_map_init();
+    MT_CHECK_THAT(str_map_find_n(&map, "a", 1) == NULL);
+    MT_CHECK_THAT(str_map_remove_n(&map, "a", 1) == false);
+
+    int one = 1, two = 2;
+    MT_CHECK_THAT(str_map_put_n(&map, "one", 3, &one));
+    MT_CHECK_THAT(str_map_put_n(&map, "two", 3, &two));
+    MT_CHECK_THAT(map.count == 2);
+
+    StrMapEntry *e = str_map_find_n(&map, "one", 3);
+    MT_ASSERT_THAT(e != NULL);
+    MT_CHECK_THAT(e->value == &one);
+    MT_CHECK_THAT(e->key_size == 3 && strcmp(e->key, "one") == 0);
+
+    String key = str_init();
+    str_append_one(&key, "two");
+    MT_CHECK_THAT(str_map_find(&map, &key)->value == &two);
+    MT_CHECK_THAT(str_map_find_slice(&map, str_slice_cstr("two"))->value == &two);
+    MT_CHECK_THAT(str_map_find_slice(&map, str_slice_n("twofold", 3))->value == &two);
+    MT_CHECK_THAT(str_map_find_n(&map, "tw", 2) == NULL);
+
+    // Overwrite keeps one entry
+    MT_CHECK_THAT(str_map_put(&map, &key, &one));
+    MT_CHECK_THAT(map.count == 2);
+    MT_CHECK_THAT(str_map_find(&map, &key)->value == &one);
+
+    bool inserted = true;
+    e = str_map_upsert_n(&map, "one", 3, &inserted);
+    MT_CHECK_THAT(e != NULL && inserted == false);
+    e = str_map_upsert_n(&map, "", 0, &inserted);
+    MT_CHECK_THAT(e != NULL && inserted == true && e->value == NULL);
+    MT_CHECK_THAT(str_map_find_n(&map, NULL, 0) == e);
+
+    MT_CHECK_THAT(str_map_remove(&map, &key) == true);
+    MT_CHECK_THAT(str_map_remove(&map, &key) == false);
+    MT_CHECK_THAT(str_map_find(&map, &key) == NULL);
+    MT_CHECK_THAT(map.count == 2);
+
+    str_map_clear(&map);
+    MT_CHECK_THAT(map.count == 0);
+    MT_CHECK_THAT(str_map_find_n(&map, "one", 3) == NULL);
+
+    str_map_free(&map);
+    str_free(&key);
+}
+
+MT_DEFINE_TEST(map_many)
+{
+    StrMap map = str_map_init();
+    MT_ASSERT_THAT(str_map_reserve(&map, 100));
+    size_t cap = map.capacity;
+    MT_CHECK_THAT(cap >= 100);
+
+    char buf[32];
+    for (size_t i = 0; i < 100; ++i) {
+        int n = snprintf(buf, sizeof(buf), "key-%zu", i);
+        MT_ASSERT_THAT(str_map_put_n(&map, buf, (size_t)n, (void *)(uintptr_t)(i + 1)));
+    }
+    MT_CHECK_THAT(map.capacity == cap);
+
+    for (size_t i = 100; i < 20000; ++i) {
+        int n = snprintf(buf, sizeof(buf), "key-%zu", i);
+        MT_ASSERT_THAT(str_map_put_n(&map, buf, (size_t)n, (void *)(uintptr_t)(i + 1)));
+    }
+    MT_CHECK_THAT(map.count == 20000);
+
+    // Remove every odd key, then churn to exercise tombstone reuse
+    for (size_t i = 1; i < 20000; i += 2) {
+        int n = snprintf(buf, sizeof(buf), "key-%zu", i);
+        MT_CHECK_THAT(str_map_remove_n(&map, buf, (size_t)n));
+    }
+    for (int round = 0; round < 3; ++round) {
+        for (size_t i = 1; i < 20000; i += 2) {
+            int n = snprintf(buf, sizeof(buf), "key-%zu", i);
+            MT_ASSERT_THAT(str_map_put_n(&map, buf, (size_t)n, (void *)(uintptr_t)(i + 1)));
+        }
+        for (size_t i = 1; i < 20000; i += 2) {
+            int n = snprintf(buf, sizeof(buf), "key-%zu", i);
+            MT_CHECK_THAT(str_map_remove_n(&map, buf, (size_t)n));
+        }
+    }
+    MT_CHECK_THAT(map.count == 10000);
+
+    size_t found = 0;
+    for (size_t i = 0; i < 20000; ++i) {
+        int n = snprintf(buf, sizeof(buf), "key-%zu", i);
+        StrMapEntry *e = str_map_find_n(&map, buf, (size_t)n);
+        if (i % 2 == 0) {
+            MT_ASSERT_THAT(e != NULL);
+            MT_CHECK_THAT(e->value == (void *)(uintptr_t)(i + 1));
+            found++;
+        } else {
+            MT_CHECK_THAT(e == NULL);
+        }
+    }
+    MT_CHECK_THAT(found == 10000);
+
+    size_t iter = 0, seen = 0;
+    for (StrMapEntry *e = str_map_next(&map, &iter); e; e = str_map_next(&map, &iter)) {
+        MT_CHECK_THAT(e->key[e->key_size] == '\0');
+        MT_CHECK_THAT(e->hash == str_hash64_n(e->key, e->key_size, 0));
+        seen++;
+    }
+    MT_CHECK_THAT(seen == 10000);
+
+    str_map_free(&map);
+    MT_CHECK_THAT(map.capacity == 0 && map.count == 0);
+}
+
+MT_DEFINE_TEST(vec)
+{
+    StrVec vec = str_vec_init();
+    MT_CHECK_THAT(vec.count == 0);
+    MT_CHECK_THAT(str_vec_get(&vec, 0).size == 0);
+
+    MT_CHECK_THAT(str_vec_push(&vec, "alpha"));
+    MT_CHECK_THAT(str_vec_push_n(&vec, "beta!", 4));
+    MT_CHECK_THAT(str_vec_push(&vec, ""));
+    String str = str_init();
+    str_append_one(&str, "gamma");
+    MT_CHECK_THAT(str_vec_push_str(&vec, &str));
+    MT_CHECK_THAT(vec.count == 4);
+
+    StrSlice s = str_vec_get(&vec, 1);
+    MT_CHECK_THAT(s.size == 4 && memcmp(s.data, "beta", 4) == 0);
+    MT_CHECK_THAT(str_vec_get(&vec, 2).size == 0);
+
+    // Pushing a slice of the vector itself survives the blob moving
+    MT_CHECK_THAT(str_vec_reserve(&vec, 0, 0));
+    for (int i = 0; i < 100; ++i) {
+        StrSlice first = str_vec_get(&vec, 0);
+        MT_ASSERT_THAT(str_vec_push_n(&vec, first.data, first.size));
+    }
+    s = str_vec_get(&vec, 103);
+    MT_CHECK_THAT(s.size == 5 && memcmp(s.data, "alpha", 5) == 0);
+
+    for (size_t i = 103; i >= 4; --i) MT_ASSERT_THAT(str_vec_remove(&vec, i));
+    MT_CHECK_THAT(vec.count == 4);
+    MT_CHECK_THAT(vec.dead == 0); // trailing removals are reclaimed right away
+
+    MT_CHECK_THAT(str_vec_remove(&vec, 0));
+    MT_CHECK_THAT(str_vec_remove(&vec, 7) == false);
+    MT_CHECK_THAT(vec.dead == 5);
+
+    size_t iter = 0, n = 0;
+    const char *expect[] = { "beta", "", "gamma" };
+    while (str_vec_next(&vec, &iter, &s)) {
+        MT_CHECK_THAT(s.size == strlen(expect[n]) && memcmp(s.data, expect[n], s.size) == 0);
+        n++;
+    }
+    MT_CHECK_THAT(n == 3);
+
+    str_vec_compact(&vec);
+    MT_CHECK_THAT(vec.dead == 0);
+    MT_CHECK_THAT(vec.bytes_size == 9);
+    MT_CHECK_THAT(memcmp(vec.bytes, "betagamma", 9) == 0);
+    s = str_vec_get(&vec, 2);
+    MT_CHECK_THAT(s.size == 5 && memcmp(s.data, "gamma", 5) == 0);
+
+    str_vec_clear(&vec);
+    MT_CHECK_THAT(vec.count == 0 && vec.bytes_size == 0);
+
+    str_vec_free(&vec);
+    str_free(&str);
+}
+
+MT_DEFINE_TEST(vec_strs_and_file)
+{
+    String strs[3];
+    strs[0] = str_init();
+    strs[1] = str_init();
+    strs[2] = str_init();
+    str_append_one(&strs[0], "one\n");
+    str_append_one(&strs[2], "three\n");
+
+    StrVec vec = str_vec_init();
+    MT_ASSERT_THAT(str_vec_push_strs(&vec, strs, 3));
+    MT_CHECK_THAT(vec.count == 3 && vec.bytes_size == 10);
+
+    String out[3];
+    MT_ASSERT_THAT(str_vec_to_strs(&vec, out));
+    for (int i = 0; i < 3; ++i) {
+        MT_CHECK_THAT(str_equals(&out[i], &strs[i]));
+        MT_CHECK_THAT(out[i].buffer[out[i].size] == '\0');
+        MT_CHECK_THAT(out[i].capacity == out[i].size + 1);
+        str_free(&out[i]);
+        str_free(&strs[i]);
+    }
+
+    MT_CHECK_THAT(str_vec_push(&vec, "four\n"));
+    MT_CHECK_THAT(str_vec_remove(&vec, 0));
+
+    FILE *f = tmpfile();
+    MT_ASSERT_THAT(f != NULL);
+    MT_CHECK_THAT(str_vec_write_file(&vec, f));
+    rewind(f);
+    String rd = str_init();
+    MT_CHECK_THAT(str_read_file(&rd, f));
+    MT_CHECK_THAT(strcmp(rd.buffer, "three\nfour\n") == 0);
+    fclose(f);
+
+    str_free(&rd);
+    str_vec_free(&vec);
+}
+
+MT_DEFINE_TEST(compare)
+{
+    String a = str_init();
+    String b = str_init();
+
+    MT_CHECK_THAT(str_compare(&a, &b) == 0);
+    MT_CHECK_THAT(str_compare(&a, NULL) == 0);
+    MT_CHECK_THAT(str_compare_cstr(&a, NULL) == 0);
+
+    str_append_one(&a, "abc");
+    str_append_one(&b, "abd");
+    MT_CHECK_THAT(str_compare(&a, &b) < 0);
+    MT_CHECK_THAT(str_compare(&b, &a) > 0);
+    MT_CHECK_THAT(str_compare(&a, &a) == 0);
+    MT_CHECK_THAT(str_compare(NULL, &a) < 0);
+
+    MT_CHECK_THAT(str_compare_cstr(&a, "ab") > 0);
+    MT_CHECK_THAT(str_compare_cstr(&a, "abcd") < 0);
+    MT_CHECK_THAT(str_compare_cstr(&a, "abc") == 0);
+    MT_CHECK_THAT(str_compare_n(&a, "abcz", 3) == 0);
+
+    // Bytes compare unsigned, and embedded NULs count
+    MT_CHECK_THAT(str_compare_n(&a, "ab\xff", 3) < 0);
+    str_append_one_n(&b, "\0x", 2);
+    MT_CHECK_THAT(str_compare_n(&b, "abd\0y", 5) < 0);
+
+    // Mismatch past the vector width
+    str_clear(&a);
+    str_clear(&b);
+    str_append_repeat(&a, 'x', 100);
+    str_append_repeat(&b, 'x', 100);
+    MT_CHECK_THAT(str_compare(&a, &b) == 0);
+    b.buffer[70] = 'y';
+    MT_CHECK_THAT(str_compare(&a, &b) < 0);
+
+    str_free(&a);
+    str_free(&b);
+}
+
+static int
+cmp_strings_for_qsort(const void *x, const void *y)
+{
+    return str_compare((const String *)x, (const String *)y);
+}
+
+// Random strings over a small alphabet with shared prefixes, so the sort
+// has to go several digits deep and see strings end inside a digit
+static void
+fill_random_strings(String *strs, size_t n, unsigned seed)
+{
+    static const char prefixes[][20] = { "", "a", "abcdefgh", "abcdefghijklmnop", "zz" };
+    for (size_t i = 0; i < n; ++i) {
+        strs[i] = str_init();
+        seed = seed * 1103515245u + 12345u;
+        str_append_one(&strs[i], prefixes[(seed >> 16) % 5]);
+        seed = seed * 1103515245u + 12345u;
+        size_t len = (seed >> 16) % 20;
+        for (size_t k = 0; k < len; ++k) {
+            seed = seed * 1103515245u + 12345u;
+            char c = "ab\0\xff"[(seed >> 16) % 4];
+            str_append_char(&strs[i], c);
+        }
+    }
+}
+
+MT_DEFINE_TEST(sort)
+{
+    enum { N = 3000 };
+    String *strs = (String *)malloc(N * sizeof(String));
+    String *ref = (String *)malloc(N * sizeof(String));
+    MT_ASSERT_THAT(strs && ref);
+
+    fill_random_strings(strs, N, 7);
+    memcpy(ref, strs, N * sizeof(String));
+    qsort(ref, N, sizeof(String), cmp_strings_for_qsort);
+
+    MT_ASSERT_THAT(str_sort(strs, N));
+    for (size_t i = 0; i < N; ++i) {
+        MT_CHECK_THAT(str_equals(&strs[i], &ref[i]));
+    }
+    MT_CHECK_THAT(str_sort(strs, 0));
+    MT_CHECK_THAT(str_sort(NULL, 0));
+    MT_CHECK_THAT(!str_sort(NULL, 1));
+
+#ifdef STR_SORT_PARALLEL
+    fill_random_strings(ref, N, 7);
+    MT_ASSERT_THAT(str_sort_parallel(ref, N, 4));
+    for (size_t i = 0; i < N; ++i) {
+        MT_CHECK_THAT(str_equals(&strs[i], &ref[i]));
+        str_free(&ref[i]);
+    }
+#endif
+
+    for (size_t i = 0; i < N; ++i) str_free(&strs[i]);
+    free(strs);
+    free(ref);
+}
+
+MT_DEFINE_TEST(sort_long_prefix)
+{
+    // More strings than the insertion sort cutoff, all equal for 2 MB, so
+    // every partition step lands in the equal part
+    enum { N = 40, PREFIX = 2 << 20 };
+    char *prefix = (char *)malloc(PREFIX);
+    String *strs = (String *)malloc(N * sizeof(String));
+    MT_ASSERT_THAT(prefix && strs);
+    memset(prefix, 'x', PREFIX);
+
+    for (size_t i = 0; i < N; ++i) {
+        char tail[2] = { (char)('a' + (N - 1 - i) / 8), (char)('a' + (N - 1 - i) % 8) };
+        strs[i] = str_init();
+        MT_ASSERT_THAT(str_append_one_n(&strs[i], prefix, PREFIX));
+        MT_ASSERT_THAT(str_append_one_n(&strs[i], tail, i % 3 ? 2 : 1));
+    }
+
+    MT_ASSERT_THAT(str_sort(strs, N));
+    for (size_t i = 1; i < N; ++i) {
+        MT_CHECK_THAT(str_compare(&strs[i - 1], &strs[i]) <= 0);
+    }
+
+    for (size_t i = 0; i < N; ++i) str_free(&strs[i]);
+    free(strs);
+    free(prefix);
+}
+
+MT_DEFINE_TEST(vec_sort)
+{
+    StrVec vec = str_vec_init();
+    const char *words[] = { "pear", "apple", "", "fig", "apple", "banana", "app" };
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); ++i) {
+        MT_ASSERT_THAT(str_vec_push(&vec, words[i]));
+    }
+    MT_CHECK_THAT(str_vec_remove(&vec, 0));
+
+    MT_ASSERT_THAT(str_vec_sort(&vec));
+    MT_CHECK_THAT(vec.count == 6 && vec.dead == 0);
+    MT_CHECK_THAT(vec.bytes_size == 22);
+    MT_CHECK_THAT(memcmp(vec.bytes, "appappleapplebananafig", 22) == 0);
+
+    StrSlice s = str_vec_get(&vec, 0);
+    MT_CHECK_THAT(s.size == 0);
+    s = str_vec_get(&vec, 5);
+    MT_CHECK_THAT(s.size == 3 && memcmp(s.data, "fig", 3) == 0);
+
+#ifdef STR_SORT_PARALLEL
+    String strs[5000];
+    fill_random_strings(strs, 5000, 11);
+    str_vec_clear(&vec);
+    MT_ASSERT_THAT(str_vec_push_strs(&vec, strs, 5000));
+    MT_ASSERT_THAT(str_vec_sort_parallel(&vec, 3));
+    MT_ASSERT_THAT(str_sort(strs, 5000));
+    for (size_t i = 0; i < 5000; ++i) {
+        s = str_vec_get(&vec, i);
+        MT_CHECK_THAT(str_compare_n(&strs[i], s.data, s.size) == 0);
+        str_free(&strs[i]);
+    }
+#endif
+
+    str_vec_free(&vec);
+}
+
 int
 main(void)
 {
@@ -496,13 +2414,20 @@ main(void)
     MT_RUN_TEST(init);
 
     MT_RUN_TEST(reserve);
+    MT_RUN_TEST(growth);
+#ifdef STR_LARGE_ALLOC
+    MT_RUN_TEST(large_alloc);
+#endif
+    MT_RUN_TEST(size_hint);
 
     MT_RUN_TEST(append_one);
     MT_RUN_TEST(append);
     MT_RUN_TEST(append_char);
+    MT_RUN_TEST(spare_and_commit);
     MT_RUN_TEST(append_str);
     MT_RUN_TEST(appendf);
     MT_RUN_TEST(vappendf);
+    MT_RUN_TEST(join);
 
     MT_RUN_TEST(strdup);
     MT_RUN_TEST(release);
@@ -513,12 +2438,31 @@ main(void)
     MT_RUN_TEST(trim_both);
     MT_RUN_TEST(insert_and_erase);
     MT_RUN_TEST(replace_one);
+#ifdef STR_STATS
+    MT_RUN_TEST(stats);
+#endif
     MT_RUN_TEST(find_and_rfind);
+    MT_RUN_TEST(find_long);
+    MT_RUN_TEST(icase);
+    MT_RUN_TEST(byteset);
+    MT_RUN_TEST(utf8_valid);
+    MT_RUN_TEST(utf8_length_and_truncate);
+    MT_RUN_TEST(utf8_case);
+    MT_RUN_TEST(transcode);
     MT_RUN_TEST(equals);
     MT_RUN_TEST(equals_cstr);
     MT_RUN_TEST(equals_n);
+    MT_RUN_TEST(slice);
+    MT_RUN_TEST(ref);
+    MT_RUN_TEST(translate);
+    MT_RUN_TEST(base64_and_hex);
+    MT_RUN_TEST(escape);
+    MT_RUN_TEST(url);
+    MT_RUN_TEST(parse_numbers);
+    MT_RUN_TEST(buf);
 
     MT_RUN_TEST(write_and_read_file);
+    MT_RUN_TEST(builder);
 
     MT_RUN_TEST(free);
     MT_RUN_TEST(clear);
@@ -526,6 +2470,23 @@ main(void)
     MT_RUN_TEST(clone);
     MT_RUN_TEST(move);
 
+    MT_RUN_TEST(hash);
+    MT_RUN_TEST(hash_icase);
+    MT_RUN_TEST(hasher_streaming);
+
+    MT_RUN_TEST(intern_pool);
+
+    MT_RUN_TEST(map);
+    MT_RUN_TEST(map_many);
+
+    MT_RUN_TEST(vec);
+    MT_RUN_TEST(vec_strs_and_file);
+
+    MT_RUN_TEST(compare);
+    MT_RUN_TEST(sort);
+    MT_RUN_TEST(sort_long_prefix);
+    MT_RUN_TEST(vec_sort);
+
     MT_PRINT_SUMMARY();
     return MT_EXIT_CODE;
 }